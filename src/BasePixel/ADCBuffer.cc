@@ -0,0 +1,51 @@
+/*!
+ * \file ADCBuffer.cc
+ * \brief Implementation of ADCBufferPool class.
+ */
+
+#include <boost/thread/lock_guard.hpp>
+
+#include "ADCBuffer.h"
+
+struct ADCBufferPool::Releaser {
+    ADCBufferPool* pool;
+    explicit Releaser(ADCBufferPool* _pool) : pool(_pool) {}
+    void operator()(ADCBuffer* buffer) const { pool->Release(buffer); }
+};
+
+ADCBufferPool& ADCBufferPool::Singleton()
+{
+    static ADCBufferPool pool;
+    return pool;
+}
+
+ADCBufferPool::ADCBufferPool(unsigned _bufferCapacity)
+    : bufferCapacity(_bufferCapacity) {}
+
+ADCBufferPool::~ADCBufferPool()
+{
+    for(std::vector<ADCBuffer*>::iterator iter = freeBuffers.begin(); iter != freeBuffers.end(); ++iter)
+        delete *iter;
+}
+
+PADCBuffer ADCBufferPool::Acquire()
+{
+    ADCBuffer* buffer = 0;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        if(!freeBuffers.empty()) {
+            buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+    }
+    if(!buffer)
+        buffer = new ADCBuffer(bufferCapacity);
+    buffer->SetSize(0);
+    return PADCBuffer(buffer, Releaser(this));
+}
+
+void ADCBufferPool::Release(ADCBuffer* buffer)
+{
+    boost::lock_guard<boost::mutex> lock(mutex);
+    freeBuffers.push_back(buffer);
+}
@@ -0,0 +1,93 @@
+/*!
+ * \file ADCBuffer.h
+ * \brief Definition of ADCBuffer, ADCBufferPool and ADCSpan classes.
+ */
+
+#pragma once
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "BasePixel/constants.h"
+
+/*!
+ * \brief Fixed-capacity storage for the ADC samples received from the testboard.
+ */
+class ADCBuffer {
+public:
+    explicit ADCBuffer(unsigned capacity) : samples(capacity), size(0) {}
+    short* Data() { return samples.data(); }
+    const short* Data() const { return samples.data(); }
+    unsigned Capacity() const { return samples.size(); }
+    unsigned Size() const { return size; }
+    void SetSize(unsigned _size) { size = _size < Capacity() ? _size : Capacity(); }
+
+private:
+    std::vector<short> samples;
+    unsigned size;
+};
+
+typedef boost::shared_ptr<ADCBuffer> PADCBuffer;
+
+/*!
+ * \brief Pool of reusable ADC buffers.
+ *
+ * Buffers are handed out as reference-counted pointers and are returned to the pool when the last reference is
+ * released, so repeated acquisitions do not allocate.
+ */
+class ADCBufferPool {
+public:
+    static ADCBufferPool& Singleton();
+
+    explicit ADCBufferPool(unsigned bufferCapacity = psi::FIFOSIZE);
+    ~ADCBufferPool();
+
+    PADCBuffer Acquire();
+    unsigned BufferCapacity() const { return bufferCapacity; }
+
+private:
+    struct Releaser;
+    void Release(ADCBuffer* buffer);
+
+private:
+    ADCBufferPool(const ADCBufferPool&);
+    ADCBufferPool& operator=(const ADCBufferPool&);
+
+    unsigned bufferCapacity;
+    std::vector<ADCBuffer*> freeBuffers;
+    boost::mutex mutex;
+};
+
+/*!
+ * \brief Read-only view over a part of a pooled ADC buffer.
+ *
+ * The span keeps the underlying buffer alive, so it can be passed on without copying the samples.
+ */
+class ADCSpan {
+public:
+    typedef const short* const_iterator;
+
+    ADCSpan() : first(0), length(0) {}
+    explicit ADCSpan(const PADCBuffer& _buffer)
+        : buffer(_buffer), first(_buffer->Data()), length(_buffer->Size()) {}
+
+    const short* data() const { return first; }
+    unsigned size() const { return length; }
+    bool empty() const { return length == 0; }
+    const_iterator begin() const { return first; }
+    const_iterator end() const { return first + length; }
+    short operator[](unsigned n) const { return first[n]; }
+
+    ADCSpan SubSpan(unsigned offset, unsigned count) const {
+        ADCSpan span(*this);
+        span.first += offset < length ? offset : length;
+        span.length = offset < length ? (count < length - offset ? count : length - offset) : 0;
+        return span;
+    }
+
+private:
+    PADCBuffer buffer;
+    const short* first;
+    unsigned length;
+};
@@ -3,15 +3,18 @@
  * \brief Implementation of AnalogTestBoard class.
  */
 
+#include <algorithm>
+
 #include "BasePixel/AnalogTestBoard.h"
 #include "constants.h"
 #include "BasePixel/RawPacketDecoder.h"
+#include "BasePixel/DecodedReadout.h"
 #include "psi/log.h"
 #include "interface/USBInterface.h"
 #include "psi/exception.h"
 #include "psi/date_time.h"
 
-AnalogTestBoard::AnalogTestBoard()
+AnalogTestBoard::AnalogTestBoard(UsbTraceMode usbTraceMode)
 {
     const ConfigParameters& configParameters = ConfigParameters::Singleton();
 
@@ -19,8 +22,20 @@ AnalogTestBoard::AnalogTestBoard()
     readPosition = 0;
     writePosition = 0;
     triggerSource = 0;
+    queueSettings = false;
 
     cTestboard = boost::shared_ptr<CTestboard>(new CTestboard());
+    if (configParameters.UsbTransport() != "FTDI") {
+        psi::LogInfo() << "Using USB transport '" << configParameters.UsbTransport() << "'.\n";
+        cTestboard->SetUsbTransport(psi::UsbTransport::Make(configParameters.UsbTransport()));
+    }
+    if (usbTraceMode == RecordUsbTrace) {
+        psi::LogInfo() << "Recording USB trace into '" << configParameters.FullUsbTraceFileName() << "'.\n";
+        cTestboard->RecordUsbTrace(configParameters.FullUsbTraceFileName());
+    } else if (usbTraceMode == ReplayUsbTrace) {
+        psi::LogInfo() << "Replaying USB trace from '" << configParameters.FullUsbTraceFileName() << "'.\n";
+        cTestboard->ReplayUsbTrace(configParameters.FullUsbTraceFileName(), configParameters.UsbTraceTimeScale());
+    }
     if (!cTestboard->Open(configParameters.TestboardName().c_str()))
         THROW_PSI_EXCEPTION("Unable to connect to the test board.");
     fIsPresent = 1;
@@ -74,8 +89,7 @@ AnalogTestBoard::AnalogTestBoard()
 
     DataEnable(true);
     cTestboard->ResetOn(); // send hard reset to connected modules / TBMs
-    cTestboard->Flush();
-    psi::Sleep(100.0 * psi::milli * psi::seconds);
+    cTestboard->mDelay(100);
     cTestboard->ResetOff();
     cTestboard->Flush();
 
@@ -348,10 +362,17 @@ void AnalogTestBoard::Flush()
 }
 
 
+void AnalogTestBoard::FlushSettings()
+{
+    if (!queueSettings)
+        Flush();
+}
+
+
 void AnalogTestBoard::SetClock(int n)
 {
     cTestboard->SetClock(n);
-    Flush();
+    FlushSettings();
 }
 
 
@@ -387,13 +408,13 @@ bool AnalogTestBoard::DataRead(short buffer[], unsigned short buffersize, unsign
 void AnalogTestBoard::SetDelay(int signal, int ns)
 {
     cTestboard->SetDelay(signal, ns);
-    Flush();
+    FlushSettings();
 }
 
 void AnalogTestBoard::SetClockStretch(unsigned char src, unsigned short delay, unsigned short width)
 {
     cTestboard->SetClockStretch(src, delay, width);
-    Flush();
+    FlushSettings();
 }
 
 
@@ -455,17 +476,15 @@ void AnalogTestBoard::SendCal(int nTrig)
 
 int AnalogTestBoard::CountADCReadouts(int count)
 {
-    unsigned short counter;
-    short data[psi::FIFOSIZE];
-
     int n = 0;
     for (int i = 0; i < count; i++) {
         DataCtrl(false, true); // no clear, trigger
         Single(RES | CAL | TRG | TOK);
         CDelay(100);
         Flush();
-        DataRead(data, psi::FIFOSIZE, counter);
-        n += ((int)counter - 56) / 6;
+        ADCSpan span;
+        AcquireData(span);
+        n += ((int)span.size() - 56) / 6;
     }
     return n;
 }
@@ -482,9 +501,14 @@ bool AnalogTestBoard::ADCData(short buffer[], unsigned short &wordsread)
 
 unsigned short AnalogTestBoard::ADC()
 {
-    unsigned short count;
-    short data[psi::FIFOSIZE];
-    ADCRead(data, count);
+    const ADCSpan data = AcquireADC();
+    LogADC(data);
+    return data.size();
+}
+
+void AnalogTestBoard::LogADC(const ADCSpan& data)
+{
+    const unsigned short count = data.size();
     //cTestboard->ProbeSelect(0,PROBE_ADC_COMP);
     //cTestboard->ProbeSelect(1,PROBE_ADC_GATE);
 
@@ -501,7 +525,6 @@ unsigned short AnalogTestBoard::ADC()
 
     psi::LogDebug() << std::endl;
     psi::LogInfo() << std::endl;
-    return count;
 }
 
 unsigned short AnalogTestBoard::ADC(int nbsize)
@@ -575,10 +598,9 @@ int AnalogTestBoard::LastDAC(int nTriggers, int chipId)
 {
     int numRepetitions = 0;
 
-    unsigned short count = 0;
-    short data[psi::FIFOSIZE];
-    while ( count == 0 && numRepetitions < 100 ) {
-        ADCRead(data, count, nTriggers);
+    ADCSpan data;
+    while ( data.empty() && numRepetitions < 100 ) {
+        data = AcquireADC(nTriggers);
 
         //psi::LogInfo() << "ADC = { ";
         //for ( int i = 0; i < count; i++ ){
@@ -608,6 +630,65 @@ void AnalogTestBoard::SendADCTrigsNoReset(int nTrig)
 }
 
 
+ADCSpan AnalogTestBoard::AcquireADC(short nTrig)
+{
+    const PADCBuffer buffer = ADCBufferPool::Singleton().Acquire();
+    cTestboard->ADCRead(*buffer, nTrig);
+    return ADCSpan(buffer);
+}
+
+
+bool AnalogTestBoard::ADCScan(unsigned nSteps, const ADCScanStep& setStep, short nTrig, std::vector<ADCSpan>& readouts)
+{
+    // The answers wait in the USB receive buffers until the whole command list is sent, so the number of steps
+    // sent at once is limited by an estimate of their readouts (twice the length of an empty readout).
+    static const unsigned maxBatchWords = 16384;
+    const unsigned readoutWords = std::max<int>(1, 2 * emptyReadoutLengthADC * std::max<short>(nTrig, 1));
+    const unsigned stepsPerBatch = std::max(1u, maxBatchWords / readoutWords);
+
+    readouts.clear();
+    readouts.reserve(nSteps);
+    for (unsigned first = 0; first < nSteps; first += stepsPerBatch) {
+        const unsigned last = std::min(nSteps, first + stepsPerBatch);
+        queueSettings = true;
+        try {
+            for (unsigned step = first; step < last; ++step) {
+                setStep(step);
+                cTestboard->QueueADCRead(nTrig);
+            }
+        } catch(...) {
+            queueSettings = false;
+            throw;
+        }
+        queueSettings = false;
+        Flush();
+
+        for (unsigned step = first; step < last; ++step) {
+            const PADCBuffer buffer = ADCBufferPool::Singleton().Acquire();
+            const bool ok = cTestboard->ReceiveADCRead(*buffer);
+            readouts.push_back(ADCSpan(buffer));
+            if (!ok) {
+                // The remaining answers can not be assigned to their steps anymore.
+                Clear();
+                psi::LogInfo() << "usb cleared" << std::endl;
+                readouts.resize(nSteps);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+bool AnalogTestBoard::AcquireData(ADCSpan& span)
+{
+    const PADCBuffer buffer = ADCBufferPool::Singleton().Acquire();
+    const bool result = cTestboard->DataRead(TBMChannel, *buffer);
+    span = ADCSpan(buffer);
+    return result;
+}
+
+
 bool AnalogTestBoard::GetADC(short buffer[], unsigned short buffersize, unsigned short &wordsread, int nTrig, int startBuffer[], int &nReadouts)
 {
     RawPacketDecoder *gDecoder = RawPacketDecoder::Singleton();
@@ -634,18 +715,34 @@ bool AnalogTestBoard::GetADC(short buffer[], unsigned short buffersize, unsigned
 
 
 
+namespace {
+const int DataTriggerLevelStep = 50;
+
+/// Step of the data trigger level scan: lowers the level by DataTriggerLevelStep per step.
+struct DataTriggerLevelScanStep {
+    AnalogTestBoard* testBoard;
+    explicit DataTriggerLevelScanStep(AnalogTestBoard* _testBoard) : testBoard(_testBoard) {}
+    void operator()(unsigned step) const { testBoard->DataTriggerLevel(-DataTriggerLevelStep * (int)step); }
+};
+} // anonymous namespace
+
 bool AnalogTestBoard::DataTriggerLevelScan()
 {
-    unsigned short count;
+    static const int nLevels = 40;
+
+    std::vector<ADCSpan> readouts;
+    if (!ADCScan(nLevels, DataTriggerLevelScanStep(this), 1, readouts)) {
+        psi::LogError() << "[AnalogTestBoard] Data trigger level scan failed: the testboard did not answer"
+                        << " all ADC readouts." << std::endl;
+        return false;
+    }
+
     bool result = false;
-    for (int delay = 0; delay < 2000; delay = delay + 50) {
-        psi::LogDebug() << "[AnalogTestBoard] dtl: " << delay
+    for (unsigned step = 0; step < readouts.size(); ++step) {
+        psi::LogDebug() << "[AnalogTestBoard] dtl: " << DataTriggerLevelStep * step
                         << " -------------------------------------" << std::endl;
-
-        DataTriggerLevel(-delay);
-        Flush();
-        count = ADC();
-        if (count == emptyReadoutLengthADC) result = true;
+        LogADC(readouts[step]);
+        if (readouts[step].size() == (unsigned)emptyReadoutLengthADC) result = true;
     }
     return result;
 }
@@ -794,9 +891,9 @@ int AnalogTestBoard::AoutLevel(int position, int nTriggers)
 }
 
 
-void AnalogTestBoard::DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[])
+bool AnalogTestBoard::DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[])
 {
-    cTestboard->DoubleColumnADCData(doubleColumn, data, readoutStop);
+    return cTestboard->DoubleColumnADCData(doubleColumn, data, readoutStop);
 }
 
 
@@ -867,6 +964,46 @@ int AnalogTestBoard::SCurveColumn(int column, int nTrig, int dacReg, int thr[],
 }
 
 
+bool AnalogTestBoard::ModulePixelHits(int column, int row, int nTrig, int nRocs, int counts[])
+{
+    RawPacketDecoder *gDecoder = RawPacketDecoder::Singleton();
+    for (int iRoc = 0; iRoc < nRocs; iRoc++) counts[iRoc] = 0;
+
+    // Readouts are separated at the TBM headers, as in GetADC.
+    const ADCSpan data = AcquireADC(nTrig);
+    std::vector<unsigned> readoutStart;
+    for (unsigned pos = 0; pos + 2 < data.size(); pos++) {
+        if (gDecoder->isUltraBlackTBM(data[pos]) && gDecoder->isUltraBlackTBM(data[pos + 1])
+                && gDecoder->isUltraBlackTBM(data[pos + 2])) {
+            readoutStart.push_back(pos);
+            pos += 2;
+        }
+    }
+
+    if (!decodedReadout) decodedReadout.reset(new DecodedReadoutModule());
+    bool result = readoutStart.size() == static_cast<unsigned>(nTrig);
+    for (unsigned n = 0; n < readoutStart.size(); n++) {
+        const unsigned readoutStop = n + 1 < readoutStart.size() ? readoutStart[n + 1] : data.size();
+        readoutBuffer.assign(data.begin() + readoutStart[n], data.begin() + readoutStop);
+        if (gDecoder->decode(readoutBuffer.size(), &readoutBuffer[0], *decodedReadout, nRocs) < 0) {
+            result = false;
+            continue;
+        }
+        for (int iRoc = 0; iRoc < nRocs; iRoc++) {
+            const DecodedReadoutROC& roc = decodedReadout->roc[iRoc];
+            for (int iHit = 0; iHit < roc.numPixelHits; iHit++) {
+                if (roc.pixelHit[iHit].columnROC == static_cast<unsigned>(column)
+                        && roc.pixelHit[iHit].rowROC == static_cast<unsigned>(row)) {
+                    counts[iRoc]++;
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+
 void AnalogTestBoard::ADCRead(short buffer[], unsigned short &wordsread, short nTrig)
 {
     cTestboard->ADCRead(buffer, wordsread, nTrig);
@@ -5,8 +5,11 @@
 
 #pragma once
 
+#include <boost/scoped_ptr.hpp>
 #include "TBAnalogInterface.h"
 
+struct DecodedReadoutModule;
+
 /*!
  * This class provides the functionality to program the analog testboard via USB
  * This class is mainly a dummy class which forwards the commands to Beat's
@@ -16,7 +19,13 @@
  */
 class AnalogTestBoard : public TBAnalogInterface {
 public:
-    AnalogTestBoard();
+    /*!
+     * With a USB trace mode the traffic with the testboard is recorded into UsbTraceFileName or replayed from it,
+     * see CUSB::StartRecording and CUSB::StartReplay.
+     */
+    enum UsbTraceMode { NoUsbTrace, RecordUsbTrace, ReplayUsbTrace };
+
+    explicit AnalogTestBoard(UsbTraceMode usbTraceMode = NoUsbTrace);
     virtual ~AnalogTestBoard();
 
     virtual void SetTBParameter(TBParameters::Register reg, int value);
@@ -82,6 +91,9 @@ public:
     virtual void SendADCTrigsNoReset(int nTrig);
     virtual bool GetADC(short buffer[], unsigned short buffersize, unsigned short &wordsread, int nTrig, int startBuffer[], int &nReadouts);
     virtual int LastDAC(int nTrig, int chipId);
+    virtual ADCSpan AcquireADC(short nTrig = 1);
+    virtual bool AcquireData(ADCSpan& span);
+    virtual bool ADCScan(unsigned nSteps, const ADCScanStep& setStep, short nTrig, std::vector<ADCSpan>& readouts);
 
     virtual void SetVA(psi::ElectricPotential V);   // set VA voltage in V
     virtual void SetIA(psi::ElectricCurrent A);   // set VA current limit in A
@@ -131,11 +143,12 @@ public:
     virtual int AoutLevelPartOfChip(int position, int nTriggers, int trims[], int res[], bool pxlFlags[]);
     virtual int ChipEfficiency(int nTriggers, int trim[], double res[]);
     virtual int MaskTest(short nTriggers, short res[]);
-    virtual void DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[]);
+    virtual bool DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[]);
     virtual int ChipThreshold(int start, int step, int thrLevel, int nTrig, int dacReg, int xtalk, int cals, int trim[], int res[]);
     virtual int PixelThreshold(int col, int row, int start, int step, int thrLevel, int nTrig, int dacReg, int xtalk, int cals, int trim);
     virtual int SCurve(int nTrig, int dacReg, int threshold, int res[]);
     virtual int SCurveColumn(int column, int nTrig, int dacReg, int thr[], int trims[], int chipId[], int res[]);
+    virtual bool ModulePixelHits(int column, int row, int nTrig, int nRocs, int counts[]);
     virtual void DacDac(int dac1, int dacRange1, int dac2, int dacRange2, int nTrig, int result[]);
     virtual void PHDac(int dac, int dacRange, int nTrig, int position, short result[]);
     virtual void AddressLevels(int position, int result[]);
@@ -165,6 +178,11 @@ private:
     int TBMChannel;
     int emptyReadoutLength, emptyReadoutLengthADC, emptyReadoutLengthADCDual;
     bool tbmenable;
+    bool queueSettings; // set while ADCScan queues its steps: the setters leave the flush to the scan
+
+    void FlushSettings();
+
+    void LogADC(const ADCSpan& data);
 
     // == data buffer ==============================================================
     static const int bufferSize = 2500000;
@@ -173,4 +191,8 @@ private:
     void ReadBackData();
 
     int triggerSource;  // 0 = local, 1 = extern
+
+    // == module readout decoding ==================================================
+    boost::scoped_ptr<DecodedReadoutModule> decodedReadout;
+    std::vector<short> readoutBuffer;
 };
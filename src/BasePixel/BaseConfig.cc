@@ -9,6 +9,7 @@
 
 #include <fstream>
 #include "psi/exception.h"
+#include "psi/fingerprint.h"
 #include "BaseConfig.h"
 
 void psi::BaseConfig::Read(const std::string& fileName)
@@ -43,3 +44,11 @@ void psi::BaseConfig::Write(const std::string& fileName) const
         f << iter->first << " " << iter->second << std::endl;
     }
 }
+
+uint64_t psi::BaseConfig::Fingerprint() const
+{
+    psi::Fingerprint fingerprint;
+    for(Map::const_iterator iter = parameters.begin(); iter != parameters.end(); ++iter)
+        fingerprint.Add(iter->first).Add(iter->second);
+    return fingerprint.Value();
+}
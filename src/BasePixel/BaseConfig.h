@@ -7,6 +7,7 @@
 #pragma once
 
 #include <map>
+#include <stdint.h>
 #include "psi/log.h"
 #include "psi/units.h"
 
@@ -99,6 +100,9 @@ public:
     virtual void Read(const std::string& fileName);
     virtual void Write(const std::string& fileName) const;
 
+    /// Hash of all parameter names and values.
+    uint64_t Fingerprint() const;
+
 protected:
     template<typename Value>
     bool Get(const std::string& name, Value& value) const {
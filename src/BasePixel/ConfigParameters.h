@@ -19,6 +19,8 @@ public:
     PSI_CONFIG_PARAMETER(bool, TbmEnable, true)
     PSI_CONFIG_PARAMETER(bool, TbmEmulator, false)
     PSI_CONFIG_PARAMETER(bool, GuiMode, false)
+    PSI_CONFIG_PARAMETER(bool, ResumeFullTest, true)
+    PSI_CONFIG_PARAMETER(bool, ModuleThresholdScan, false)
 
     PSI_CONFIG_PARAMETER(unsigned, NumberOfRocs, 16)
     PSI_CONFIG_PARAMETER(unsigned, NumberOfModules, 1)
@@ -33,7 +35,11 @@ public:
 
     PSI_CONFIG_PARAMETER(std::string, TestboardType, "Analog")
     PSI_CONFIG_PARAMETER(std::string, TestboardName, "")
+    PSI_CONFIG_PARAMETER(std::string, UsbTransport, "FTDI")
     PSI_CONFIG_PARAMETER(std::string, Directory, "")
+    PSI_CONFIG_PARAMETER(std::string, UsbTraceFileName, "usbTrace.bin")
+    PSI_FULL_CONFIG_FILE_NAME(UsbTraceFileName)
+    PSI_CONFIG_PARAMETER(double, UsbTraceTimeScale, 1.0)
     PSI_CONFIG_PARAMETER(std::string, DacParametersFileName, "defaultDACParameters.dat")
     PSI_FULL_CONFIG_FILE_NAME(DacParametersFileName)
     PSI_CONFIG_PARAMETER(std::string, TbmParametersFileName, "defaultTBMParameters.dat")
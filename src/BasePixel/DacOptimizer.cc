@@ -0,0 +1,236 @@
+/*!
+ * \file DacOptimizer.cc
+ * \brief Implementation of DacOptimizer class.
+ */
+
+#include <cmath>
+#include <sstream>
+
+#include "psi/log.h"
+#include "psi/exception.h"
+#include "DacOptimizer.h"
+
+namespace {
+std::string ToString(const DacOptimizer::Point& point)
+{
+    std::ostringstream ss;
+    ss << "(";
+    for(size_t n = 0; n < point.size(); ++n)
+        ss << (n ? ", " : "") << point[n];
+    ss << ")";
+    return ss.str();
+}
+} // anonymous namespace
+
+DacOptimizer::Range::Range(int _first, int _last, int _step)
+    : first(_first), last(_last), step(_step)
+{
+    if(!step || (last - first) / step < 0)
+        THROW_PSI_EXCEPTION("Invalid DAC range [" << first << ", " << last << "] with step " << step << ".");
+}
+
+DacOptimizer::DacOptimizer(const std::string& _name, const Objective& _objective, Goal _goal,
+                           unsigned _maxEvaluations)
+    : name(_name), objective(_objective), goal(_goal), maxEvaluations(_maxEvaluations), hasGoodEnough(false),
+      goodEnough(0), bestValue(0) {}
+
+double DacOptimizer::Evaluate(const Point& point)
+{
+    const std::map<Point, double>::const_iterator iter = cache.find(point);
+    if(iter != cache.end())
+        return iter->second;
+
+    const double value = objective(point);
+    cache[point] = value;
+    if(bestPoint.empty() || Better(value, bestValue)) {
+        bestPoint = point;
+        bestValue = value;
+    }
+    psi::LogDebug() << "[DacOptimizer] " << name << ": measurement #" << cache.size() << " at "
+                    << ToString(point) << " = " << value << ".\n";
+    return value;
+}
+
+bool DacOptimizer::Stop() const
+{
+    if(cache.size() >= maxEvaluations)
+        return true;
+    return hasGoodEnough && !bestPoint.empty() && !Better(goodEnough, bestValue);
+}
+
+DacOptimizer::Point DacOptimizer::MakePoint(const Point& start, unsigned coordinate, const Range& range, unsigned n)
+{
+    Point point(start);
+    point.at(coordinate) = range.Value(n);
+    return point;
+}
+
+double DacOptimizer::EvaluateAt(const Point& start, unsigned coordinate, const Range& range, unsigned n)
+{
+    return Evaluate(MakePoint(start, coordinate, range, n));
+}
+
+DacOptimizer::Point DacOptimizer::GoldenSection(const Point& start, unsigned coordinate, const Range& range)
+{
+    static const double invPhi = (std::sqrt(5.) - 1.) / 2.;
+
+    unsigned a = 0, b = range.Size() - 1;
+    while(b - a > 2 && !Stop()) {
+        unsigned c = b - static_cast<unsigned>(std::floor((b - a) * invPhi + 0.5));
+        unsigned d = a + static_cast<unsigned>(std::floor((b - a) * invPhi + 0.5));
+        if(c >= d) {
+            c = (a + b) / 2;
+            d = c + 1;
+        }
+        if(Better(EvaluateAt(start, coordinate, range, d), EvaluateAt(start, coordinate, range, c)))
+            a = c;
+        else
+            b = d;
+    }
+
+    unsigned best = a;
+    double bestLineValue = EvaluateAt(start, coordinate, range, a);
+    for(unsigned n = a + 1; n <= b; ++n) {
+        const double value = EvaluateAt(start, coordinate, range, n);
+        if(Better(value, bestLineValue)) {
+            best = n;
+            bestLineValue = value;
+        }
+    }
+    return MakePoint(start, coordinate, range, best);
+}
+
+DacOptimizer::Point DacOptimizer::Surrogate(const Point& start, unsigned coordinate, const Range& range,
+                                            unsigned nSeeds)
+{
+    const unsigned size = range.Size();
+    std::map<unsigned, double> measured;
+    if(nSeeds < 2 || size <= nSeeds) {
+        for(unsigned n = 0; n < size; ++n)
+            measured[n] = EvaluateAt(start, coordinate, range, n);
+    } else {
+        for(unsigned s = 0; s < nSeeds; ++s) {
+            const unsigned n = (s * (size - 1) + (nSeeds - 1) / 2) / (nSeeds - 1);
+            measured[n] = EvaluateAt(start, coordinate, range, n);
+        }
+    }
+
+    for(;;) {
+        std::map<unsigned, double>::const_iterator best = measured.begin();
+        for(std::map<unsigned, double>::const_iterator iter = measured.begin(); iter != measured.end(); ++iter) {
+            if(Better(iter->second, best->second))
+                best = iter;
+        }
+        if(Stop())
+            return MakePoint(start, coordinate, range, best->first);
+
+        const bool hasLeft = best != measured.begin();
+        std::map<unsigned, double>::const_iterator right = best;
+        ++right;
+        const bool hasRight = right != measured.end();
+        std::map<unsigned, double>::const_iterator left = best;
+        if(hasLeft)
+            --left;
+
+        const double x = best->first, y = best->second;
+        const unsigned leftGap = hasLeft ? best->first - left->first : 0;
+        const unsigned rightGap = hasRight ? right->first - best->first : 0;
+
+        // Vertex of the parabola through the best point and its measured neighbours.
+        unsigned candidate = size;
+        if(hasLeft && hasRight) {
+            const double x1 = left->first, y1 = left->second, x3 = right->first, y3 = right->second;
+            const double denominator = (x - x1) * (y - y3) - (x - x3) * (y - y1);
+            if(denominator != 0) {
+                const double vertex = x - 0.5 * ((x - x1) * (x - x1) * (y - y3) - (x - x3) * (x - x3) * (y - y1))
+                        / denominator;
+                if(vertex > x1 && vertex < x3) {
+                    const unsigned n = static_cast<unsigned>(std::floor(vertex + 0.5));
+                    if(!measured.count(n))
+                        candidate = n;
+                }
+            }
+        }
+
+        // Otherwise split the larger interval next to the best point.
+        if(candidate == size) {
+            if(leftGap > 1 && leftGap >= rightGap)
+                candidate = best->first - leftGap / 2;
+            else if(rightGap > 1)
+                candidate = best->first + rightGap / 2;
+            else
+                return MakePoint(start, coordinate, range, best->first);
+        }
+        measured[candidate] = EvaluateAt(start, coordinate, range, candidate);
+    }
+}
+
+DacOptimizer::Point DacOptimizer::CoordinateSearch(const Point& start, const std::vector<Range>& ranges,
+                                                   unsigned maxPasses)
+{
+    if(ranges.size() != start.size())
+        THROW_PSI_EXCEPTION("Number of DAC ranges does not match the number of coordinates.");
+
+    Point point(start);
+    for(unsigned pass = 0; pass < maxPasses && !Stop(); ++pass) {
+        const Point previous(point);
+        for(unsigned coordinate = 0; coordinate < ranges.size(); ++coordinate)
+            point = GoldenSection(point, coordinate, ranges[coordinate]);
+        if(point == previous)
+            break;
+    }
+    return point;
+}
+
+DacOptimizer::Point DacOptimizer::Bisection(const Point& start, unsigned coordinate, const Range& range,
+                                            double target)
+{
+    unsigned low = 0, high = range.Size() - 1;
+    const double lowValue = EvaluateAt(start, coordinate, range, low);
+    const double highValue = EvaluateAt(start, coordinate, range, high);
+    const bool increasing = highValue >= lowValue;
+    if((target <= lowValue) == increasing)
+        return MakePoint(start, coordinate, range, low);
+    if((target >= highValue) == increasing)
+        return MakePoint(start, coordinate, range, high);
+
+    while(high - low > 1 && NumberOfEvaluations() < maxEvaluations) {
+        const unsigned middle = (low + high) / 2;
+        if((EvaluateAt(start, coordinate, range, middle) < target) == increasing)
+            low = middle;
+        else
+            high = middle;
+    }
+    const double lowDistance = std::abs(EvaluateAt(start, coordinate, range, low) - target);
+    const double highDistance = std::abs(EvaluateAt(start, coordinate, range, high) - target);
+    return MakePoint(start, coordinate, range, lowDistance <= highDistance ? low : high);
+}
+
+DacOptimizer::Point DacOptimizer::Bisection(const Point& start, unsigned coordinate, const Range& range,
+                                            const Predicate& predicate)
+{
+    unsigned low = 0, high = range.Size() - 1;
+    if(predicate(EvaluateAt(start, coordinate, range, low)))
+        return MakePoint(start, coordinate, range, low);
+    if(!predicate(EvaluateAt(start, coordinate, range, high)))
+        return MakePoint(start, coordinate, range, high);
+
+    while(high - low > 1 && NumberOfEvaluations() < maxEvaluations) {
+        const unsigned middle = (low + high) / 2;
+        if(predicate(EvaluateAt(start, coordinate, range, middle)))
+            high = middle;
+        else
+            low = middle;
+    }
+    return MakePoint(start, coordinate, range, high);
+}
+
+void DacOptimizer::LogSummary(const Point& result, unsigned gridSize) const
+{
+    std::ostringstream value;
+    const std::map<Point, double>::const_iterator iter = cache.find(result);
+    if(iter != cache.end())
+        value << " = " << iter->second;
+    psi::LogInfo() << "[DacOptimizer] " << name << ": " << ToString(result) << value.str() << " after "
+                   << cache.size() << " measurements (full grid: " << gridSize << ").\n";
+}
@@ -0,0 +1,84 @@
+/*!
+ * \file DacOptimizer.h
+ * \brief Definition of DacOptimizer class.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+
+/*!
+ * \brief Search for the optimal settings of one or several DACs.
+ *
+ * The objective is evaluated at points of a DAC lattice. Each point is measured at most once, all searches share the
+ * cache of the measured values. A search stops when it converges, when the budget of measurements is exhausted or
+ * when the objective reaches a value that is good enough.
+ */
+class DacOptimizer {
+public:
+    typedef std::vector<int> Point;
+    typedef boost::function<double (const Point&)> Objective;
+    typedef boost::function<bool (double)> Predicate;
+    enum Goal { Maximize, Minimize };
+
+    /// Lattice of DAC values first, first + step, ..., last. The step can be negative.
+    struct Range {
+        int first, last, step;
+        Range(int _first, int _last, int _step = 1);
+        unsigned Size() const { return (last - first) / step + 1; }
+        int Value(unsigned n) const { return first + static_cast<int>(n) * step; }
+    };
+
+    DacOptimizer(const std::string& _name, const Objective& _objective, Goal _goal = Maximize,
+                 unsigned _maxEvaluations = 64);
+
+    void SetGoodEnough(double value) { goodEnough = value; hasGoodEnough = true; }
+
+    /// Value of the objective at the point, measured only if it was not measured before.
+    double Evaluate(const Point& point);
+
+    /// Optimum of a unimodal objective along one coordinate.
+    Point GoldenSection(const Point& start, unsigned coordinate, const Range& range);
+
+    /// Optimum along one coordinate using a quadratic model through the best measured point and its neighbours.
+    Point Surrogate(const Point& start, unsigned coordinate, const Range& range, unsigned nSeeds = 5);
+
+    /// Optimum over all coordinates by repeating the golden-section search along each of them.
+    Point CoordinateSearch(const Point& start, const std::vector<Range>& ranges, unsigned maxPasses = 3);
+
+    /// Point with the value closest to the target for an objective that is monotonic along the coordinate.
+    Point Bisection(const Point& start, unsigned coordinate, const Range& range, double target);
+
+    /*!
+     * First lattice point along the coordinate where the predicate is true, assuming that it is false before and
+     * true after some point. The last point of the range is returned if the predicate is never true.
+     */
+    Point Bisection(const Point& start, unsigned coordinate, const Range& range, const Predicate& predicate);
+
+    const Point& BestPoint() const { return bestPoint; }
+    double BestValue() const { return bestValue; }
+    unsigned NumberOfEvaluations() const { return cache.size(); }
+
+    /// Logs the chosen point together with the number of measurements needed by the full grid scan.
+    void LogSummary(const Point& result, unsigned gridSize) const;
+
+private:
+    bool Better(double first, double second) const { return goal == Maximize ? first > second : first < second; }
+    bool Stop() const;
+    double EvaluateAt(const Point& start, unsigned coordinate, const Range& range, unsigned n);
+    static Point MakePoint(const Point& start, unsigned coordinate, const Range& range, unsigned n);
+
+private:
+    std::string name;
+    Objective objective;
+    Goal goal;
+    unsigned maxEvaluations;
+    bool hasGoodEnough;
+    double goodEnough;
+    std::map<Point, double> cache;
+    Point bestPoint;
+    double bestValue;
+};
@@ -4,11 +4,13 @@
  * \author Konstantin Androsov <konstantin.androsov@gmail.com>
  */
 
+#include <sstream>
 #include <boost/scoped_ptr.hpp>
 
 #include <TGraph.h>
 #include <TFile.h>
 #include <TParameter.h>
+#include <TNamed.h>
 
 #include "psi/exception.h"
 #include "psi/log.h"
@@ -38,6 +40,8 @@ private:
     boost::scoped_ptr<TFile> tFile;
 };
 
+const char* const CheckpointsDirectoryName = "checkpoints";
+
 } // DataStorageInternals
 } // psi
 
@@ -55,11 +59,12 @@ psi::DataStorage::DataStorage(const std::string& _fileName, const std::string& d
     : fileName(_fileName)
 {
     Enable();
+    data::DetectorSummaryRecord summary;
+    summary.detector_name = detectorName;
+    summary.operator_name = operatorName;
+    summary.date = psi::DateTimeProvider::StartTime();
     data::DetectorSummary detectorSummary;
-    detectorSummary.detector_name() = detectorName;
-    detectorSummary.operator_name() = operatorName;
-    detectorSummary.date() = psi::DateTimeProvider::StartTime();
-    detectorSummary.Fill();
+    detectorSummary.Fill(summary);
     detectorSummary.Write();
     Disable();
 }
@@ -76,6 +81,13 @@ void psi::DataStorage::Disable()
     file = boost::shared_ptr<DataStorageInternals::File>();
 }
 
+TFile& psi::DataStorage::RootFile()
+{
+    if(!Enabled())
+        THROW_PSI_EXCEPTION("Data storage is not enabled.");
+    return **file;
+}
+
 bool psi::DataStorage::_SaveMeasurement(const std::string& name, double value)
 {
     if(!Enabled())
@@ -106,3 +118,40 @@ void psi::DataStorage::GoToPreviousDirectory()
     }
     (*file)->cd(dirName.c_str());
 }
+
+bool psi::DataStorage::HasCheckpoint(const std::string& name, uint64_t fingerprint)
+{
+    if(!Enabled())
+        THROW_PSI_EXCEPTION("Data storage is not enabled.");
+
+    TDirectory* checkpoints = (*file)->GetDirectory(DataStorageInternals::CheckpointsDirectoryName);
+    if(!checkpoints)
+        return false;
+    boost::scoped_ptr<TNamed> checkpoint(dynamic_cast<TNamed*>(checkpoints->Get(name.c_str())));
+    if(!checkpoint)
+        return false;
+
+    std::istringstream s(checkpoint->GetTitle());
+    uint64_t savedFingerprint;
+    std::string outputDirectory;
+    s >> std::hex >> savedFingerprint >> outputDirectory;
+    return !s.fail() && savedFingerprint == fingerprint && (*file)->GetDirectory(outputDirectory.c_str()) != 0;
+}
+
+void psi::DataStorage::SaveCheckpoint(const std::string& name, uint64_t fingerprint,
+                                      const std::string& outputDirectory)
+{
+    if(!Enabled())
+        THROW_PSI_EXCEPTION("Data storage is not enabled.");
+
+    TDirectory* checkpoints = (*file)->GetDirectory(DataStorageInternals::CheckpointsDirectoryName);
+    if(!checkpoints)
+        checkpoints = (*file)->mkdir(DataStorageInternals::CheckpointsDirectoryName);
+    std::ostringstream s;
+    s << std::hex << fingerprint << " " << outputDirectory;
+    TNamed checkpoint(name.c_str(), s.str().c_str());
+    if(!checkpoints->WriteTObject(&checkpoint, name.c_str(), "WriteDelete"))
+        THROW_PSI_EXCEPTION("Checkpoint '" << name << "' can't be saved into the output ROOT file.");
+    checkpoints->SaveSelf(kTRUE);
+    (*file)->Flush();
+}
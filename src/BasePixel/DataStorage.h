@@ -7,6 +7,7 @@
 #pragma once
 
 #include <stack>
+#include <stdint.h>
 #include <boost/shared_ptr.hpp>
 
 #include "psi/exception.h"
@@ -15,6 +16,8 @@
 
 #include <TTree.h>
 
+class TFile;
+
 namespace psi {
 namespace DataStorageInternals {
 
@@ -94,6 +97,9 @@ public:
     void Enable();
     void Disable();
 
+    /// The output ROOT file, e.g. to read back the results of an earlier run into the same file.
+    TFile& RootFile();
+
     /*!
      * Save a single measurement into the output ROOT file.
      */
@@ -105,6 +111,18 @@ public:
                                 " ROOT file.");
     }
 
+    /*!
+     * Checks whether the step with a given name was already done with the same parameters and its output is still
+     * present in the output ROOT file.
+     */
+    bool HasCheckpoint(const std::string& name, uint64_t fingerprint);
+
+    /*!
+     * Records that the step with a given name was done with the parameters described by the fingerprint and that its
+     * output was written into the given directory.
+     */
+    void SaveCheckpoint(const std::string& name, uint64_t fingerprint, const std::string& outputDirectory);
+
 private:
     bool _SaveMeasurement(const std::string& name, double value);
 
@@ -129,6 +129,17 @@ public:
     virtual int LastDAC(int nTrig, int chipId) {
         return 0;
     }
+    virtual ADCSpan AcquireADC(short nTrig = 1) {
+        return ADCSpan();
+    }
+    virtual bool ADCScan(unsigned nSteps, const ADCScanStep& setStep, short nTrig, std::vector<ADCSpan>& readouts) {
+        readouts.assign(nSteps, ADCSpan());
+        return false;
+    }
+    virtual bool AcquireData(ADCSpan& span) {
+        span = ADCSpan();
+        return false;
+    }
 
     virtual void SetVA(psi::ElectricPotential V) {}
     virtual void SetIA(psi::ElectricCurrent A) {}
@@ -198,7 +209,9 @@ public:
     virtual int MaskTest(short nTriggers, short res[]) {
         return 0;
     }
-    virtual void DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[]) {}
+    virtual bool DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[]) {
+        return false;
+    }
     virtual int ChipThreshold(int start, int step, int thrLevel, int nTrig, int dacReg, int xtalk, int cals,
                               int trim[], int res[]) {
         return 0;
@@ -214,6 +227,9 @@ public:
                              int res[]) {
         return 0;
     }
+    virtual bool ModulePixelHits(int column, int row, int nTrig, int nRocs, int counts[]) {
+        return false;
+    }
     virtual void DacDac(int dac1, int dacRange1, int dac2, int dacRange2, int nTrig, int result[]) {}
     virtual void PHDac(int dac, int dacRange, int nTrig, int position, short result[]) {}
     virtual void AddressLevels(int position, int result[]) {}
@@ -0,0 +1,81 @@
+/*!
+ * \file PhaseProfiler.cc
+ * \brief Implementation of PhaseProfiler class.
+ */
+
+#include "../config.h"
+
+#include "psi/log.h"
+#include "interface/TestBoardStatistics.h"
+#include "PhaseProfiler.h"
+
+PhaseProfiler& PhaseProfiler::Singleton()
+{
+    static PhaseProfiler profiler;
+    return profiler;
+}
+
+double PhaseProfiler::TestBoardTime()
+{
+#if ENABLE_TB_STATISTICS
+    return psi::TestBoardStatistics::Singleton().BusyTime();
+#else
+    return 0;
+#endif
+}
+
+void PhaseProfiler::Begin(const std::string& name)
+{
+    frames.push_back(Frame());
+    Frame& frame = frames.back();
+    frame.name = name;
+    for(std::vector<Profile>::iterator profile = profiles.begin(); profile != profiles.end(); ++profile) {
+        std::string path;
+        for(size_t n = profile->baseDepth; n < frames.size(); ++n)
+            path += (n == profile->baseDepth ? "" : "/") + frames[n].name;
+        std::map<std::string, size_t>::const_iterator iter = profile->index.find(path);
+        if(iter == profile->index.end()) {
+            iter = profile->index.insert(std::make_pair(path, profile->phases.size())).first;
+            profile->phases.push_back(Phase(path, frames.size() - 1 - profile->baseDepth));
+        }
+        frame.entries.push_back(iter->second);
+    }
+    frame.tbStart = TestBoardTime();
+    frame.start = Clock::now();
+}
+
+void PhaseProfiler::End()
+{
+    if(frames.empty()) {
+        psi::LogError() << "[PhaseProfiler] End of a phase that was not started.\n";
+        return;
+    }
+    const std::chrono::duration<double> wallTime = Clock::now() - frames.back().start;
+    const double tbTime = TestBoardTime() - frames.back().tbStart;
+    const Frame& frame = frames.back();
+    for(size_t n = 0; n < frame.entries.size() && n < profiles.size(); ++n) {
+        Phase& phase = profiles[n].phases.at(frame.entries[n]);
+        ++phase.calls;
+        phase.wallTime += wallTime.count();
+        phase.tbTime += tbTime;
+    }
+    frames.pop_back();
+}
+
+void PhaseProfiler::StartProfile()
+{
+    profiles.push_back(Profile());
+    profiles.back().baseDepth = frames.size();
+}
+
+PhaseProfiler::Phases PhaseProfiler::StopProfile()
+{
+    if(profiles.empty()) {
+        psi::LogError() << "[PhaseProfiler] Stop of a profile that was not started.\n";
+        return Phases();
+    }
+    Phases phases;
+    phases.swap(profiles.back().phases);
+    profiles.pop_back();
+    return phases;
+}
@@ -0,0 +1,78 @@
+/*!
+ * \file PhaseProfiler.h
+ * \brief Definition of PhaseProfiler class.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief Hierarchical wall and testboard time of the test phases.
+ *
+ * Phases are opened and closed in a stack; the path of a phase is the list of names of the open phases separated by
+ * '/'. A profile collects all phases opened while it is active, aggregated by path relative to the phase stack at
+ * the start of the profile. Profiles are started and stopped in LIFO order, each Test owns one for its lifetime, so
+ * the profile of an enclosing test also contains the phases of the tests it runs.
+ *
+ * The testboard time of a phase is the link and sleep time measured by psi::TestBoardStatistics, it is zero when the
+ * statistics are disabled.
+ */
+class PhaseProfiler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Phase {
+        std::string path;
+        unsigned depth;
+        uint64_t calls;
+        double wallTime, tbTime; // seconds
+        Phase(const std::string& _path, unsigned _depth)
+            : path(_path), depth(_depth), calls(0), wallTime(0), tbTime(0) {}
+    };
+    /// Phases in the order of their first start.
+    typedef std::vector<Phase> Phases;
+
+    /// Phase that lasts for the lifetime of the scope.
+    class Scope {
+    public:
+        explicit Scope(const std::string& name) { PhaseProfiler::Singleton().Begin(name); }
+        ~Scope() { PhaseProfiler::Singleton().End(); }
+    private:
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+    };
+
+    static PhaseProfiler& Singleton();
+
+    void Begin(const std::string& name);
+    void End();
+
+    void StartProfile();
+    Phases StopProfile();
+
+private:
+    PhaseProfiler() {}
+    static double TestBoardTime();
+
+private:
+    struct Frame {
+        std::string name;
+        Clock::time_point start;
+        double tbStart;
+        std::vector<size_t> entries; // index of the phase in each profile active at the start
+    };
+
+    struct Profile {
+        size_t baseDepth;
+        Phases phases;
+        std::map<std::string, size_t> index;
+    };
+
+    std::vector<Frame> frames;
+    std::vector<Profile> profiles;
+};
@@ -175,6 +175,94 @@ int RawPacketDecoder::decode(int dataLength, ADCword dataBuffer[], DecodedReadou
 //-------------------------------------------------------------------------------
 
 
+//-------------------------------------------------------------------------------
+int RawPacketDecoder::decodePixel(int dataLength, ADCword dataBuffer[], int numROCs, int rocId, unsigned columnROC,
+                                  unsigned rowROC, DecodedReadoutPixel& pixelHit)
+/*
+  Look for a hit of a single pixel (ROC coordinates starting at 0) in the raw data;
+  the headers of the ROCs in front of rocId are located without decoding their hits
+  and the search stops at the first hit of the pixel or at the end of the ROC sequence
+
+  Return value of function is 1 if the pixel hit has been found
+  (and stored in pixelHit), 0 otherwise
+
+  Error code: -1 TBM header not found
+              -2 TBM trailer not found
+              -3 ROC label error
+              -4 pixel data not equal to n*6
+	      -6 no Calibration object set
+*/
+{
+    if ( fCalibration == 0 ) {
+        psi::LogError() << "Error in <RawPacketDecoder::decodePixel>: no Calibration object set !" << std::endl;
+        return -6;
+    }
+
+    if ( rocId < 0 || rocId >= numROCs ) {
+        if ( fPrintError ) psi::LogError() << "Error in <RawPacketDecoder::decodePixel>: ROC " << rocId << " is not read out !" << std::endl;
+        return -3;
+    }
+
+//--- correct ADC values for pedestal of ADC
+    for ( int ivalue = 0; ivalue < dataLength; ivalue++ ) {
+        dataBuffer[ivalue] -= fCalibration->GetPedestalADC();
+    }
+
+    int indexTBMheader = findTBMheader(0, dataLength, dataBuffer);
+    if ( indexTBMheader < 0 ) {
+        if ( fPrintError ) psi::LogError() << "Error in <RawPacketDecoder::decodePixel>: could not find TBM header !" << std::endl;
+        return -1;
+    }
+
+//--- skip the ROC sequences in front of rocId
+//    (only their headers are needed to find the next one)
+    int indexStart = indexTBMheader + fNumClocksTBMheader;
+    for ( int iroc = 0; iroc <= rocId; iroc++ ) {
+        if ( iroc > 0 ) indexStart += fNumClocksROCheader;
+        indexStart = findROCheader(iroc, indexStart, dataLength - fNumClocksTBMtrailer, dataBuffer);
+        if ( indexStart < 0 ) {
+            if ( fPrintError ) psi::LogError() << "Error in <RawPacketDecoder::decodePixel>: could not find header of ROC " << iroc << " !" << std::endl;
+            return -3;
+        }
+    }
+
+//--- the sequence of rocId ends at the header of the next ROC or at the TBM trailer
+    int indexStop;
+    if ( rocId < (numROCs - 1) ) {
+        indexStop = findROCheader(rocId + 1, indexStart + fNumClocksROCheader, dataLength - fNumClocksTBMtrailer, dataBuffer);
+        if ( indexStop < 0 ) {
+            if ( fPrintError ) psi::LogError() << "Error in <RawPacketDecoder::decodePixel>: could not find header of ROC " << (rocId + 1) << " !" << std::endl;
+            return -3;
+        }
+    } else {
+        indexStop = findTBMtrailer(indexStart + fNumClocksROCheader, dataLength, dataBuffer);
+        if ( indexStop < 0 ) {
+            if ( fPrintError ) psi::LogError() << "Error in <RawPacketDecoder::decodePixel>: could not find TBM trailer !" << std::endl;
+            return -2;
+        }
+    }
+
+    int hitsLength = indexStop - indexStart - fNumClocksROCheader;
+    if ( hitsLength < 0 || (hitsLength % fNumClocksPixelHit) != 0 ) {
+        if ( fPrintError ) psi::LogError() << "Error in <RawPacketDecoder::decodePixel>: dataBuffer length = " << (indexStop - indexStart) << ", expect n*6 + " << fNumClocksROCheader << " !" << std::endl;
+        return -4;
+    }
+
+    for ( int index = indexStart + fNumClocksROCheader; index < indexStop; index += fNumClocksPixelHit ) {
+        unsigned hitColumnROC, hitRowROC, rawColumn, rawPixel;
+        if ( decodeROCaddress(rocId, &dataBuffer[index], hitColumnROC, hitRowROC, rawColumn, rawPixel) < 0 ) return -3;
+
+        if ( hitColumnROC - 1 == columnROC && hitRowROC - 1 == rowROC ) {
+            fillPixelHit(rocId, &dataBuffer[index], hitColumnROC, hitRowROC, numROCs, pixelHit);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+//-------------------------------------------------------------------------------
+
+
 //-------------------------------------------------------------------------------
 int RawPacketDecoder::transformROCaddress2ModuleAddress(int rocId, int columnROC, int rowROC, int& columnModule, int& rowModule) const
 /*
@@ -509,42 +597,54 @@ int RawPacketDecoder::decodeROCsequence(int rocId, int indexStart, int indexStop
         //rawADC[5] -= fCalibration->GetPedestalADC();
 
         if ( numPixelHits < MAX_PIXELSROC ) {
-            module.roc[rocId].pixelHit[numPixelHits].rocId = rocId;
+            fillPixelHit(rocId, rawADC, columnROC, rowROC, numROCs, module.roc[rocId].pixelHit[numPixelHits]);
+            numPixelHits++;
+        } else {
+            if ( fPrintError ) psi::LogError() << "Error in <RawPacketDecoder::decodeROCsequence>: pixel buffer too small !" << std::endl;
+        }
+    }
 
-            module.roc[rocId].pixelHit[numPixelHits].columnROC = columnROC - 1;
-            module.roc[rocId].pixelHit[numPixelHits].rowROC = rowROC - 1;
+    module.roc[rocId].numPixelHits = numPixelHits;
 
-            if ( numROCs == 1 ) {
-//--- use ROC coordinates
-                module.roc[rocId].pixelHit[numPixelHits].columnModule = columnROC - 1;
-                module.roc[rocId].pixelHit[numPixelHits].rowModule = rowROC - 1;
-            } else {
-//--- use module coordinates
-//    (WARNING: this section has to be extended for the Forward Pixel detector !!!)
-                int columnModule, rowModule;
-                transformROCaddress2ModuleAddress(rocId, columnROC, rowROC, columnModule, rowModule);
+    return numPixelHits;
+}
+//-------------------------------------------------------------------------------
 
-                if ( fPrintDebug ) psi::LogInfo() << "row in module coordinates = " << rowModule << ", column in module coordinates = " << columnModule << std::endl;
 
-                module.roc[rocId].pixelHit[numPixelHits].columnModule = columnModule - 1;
-                module.roc[rocId].pixelHit[numPixelHits].rowModule = rowModule - 1;
-            }
+//-------------------------------------------------------------------------------
+void RawPacketDecoder::fillPixelHit(int rocId, ADCword rawADC[], unsigned columnROC, unsigned rowROC, int numROCs,
+                                    DecodedReadoutPixel& pixelHit) const
+/*
+  Store the decoded hit information of a pixel
+  (ROC address as returned by decodeROCaddress, starting at 1)
+*/
+{
+    pixelHit.rocId = rocId;
 
-            module.roc[rocId].pixelHit[numPixelHits].analogPulseHeight = rawADC[5];
+    pixelHit.columnROC = columnROC - 1;
+    pixelHit.rowROC = rowROC - 1;
 
-            for ( int ivalue = 0; ivalue < fNumClocksPixelHit; ivalue++ ) {
-                module.roc[rocId].pixelHit[numPixelHits].rawADC[ivalue] = rawADC[ivalue];
-            }
+    if ( numROCs == 1 ) {
+//--- use ROC coordinates
+        pixelHit.columnModule = columnROC - 1;
+        pixelHit.rowModule = rowROC - 1;
+    } else {
+//--- use module coordinates
+//    (WARNING: this section has to be extended for the Forward Pixel detector !!!)
+        int columnModule, rowModule;
+        transformROCaddress2ModuleAddress(rocId, columnROC, rowROC, columnModule, rowModule);
 
-            numPixelHits++;
-        } else {
-            if ( fPrintError ) psi::LogError() << "Error in <RawPacketDecoder::decodeROCsequence>: pixel buffer too small !" << std::endl;
-        }
+        if ( fPrintDebug ) psi::LogInfo() << "row in module coordinates = " << rowModule << ", column in module coordinates = " << columnModule << std::endl;
+
+        pixelHit.columnModule = columnModule - 1;
+        pixelHit.rowModule = rowModule - 1;
     }
 
-    module.roc[rocId].numPixelHits = numPixelHits;
+    pixelHit.analogPulseHeight = rawADC[5];
 
-    return numPixelHits;
+    for ( int ivalue = 0; ivalue < fNumClocksPixelHit; ivalue++ ) {
+        pixelHit.rawADC[ivalue] = rawADC[ivalue];
+    }
 }
 //-------------------------------------------------------------------------------
 
@@ -28,6 +28,8 @@ public:
     }
 
     int decode(int dataLength, ADCword dataBuffer[], DecodedReadoutModule& module, int numROCs);
+    int decodePixel(int dataLength, ADCword dataBuffer[], int numROCs, int rocId, unsigned columnROC, unsigned rowROC,
+                    DecodedReadoutPixel& pixelHit);
 
     int findTBMheader(int indexStart, int dataLength, ADCword dataBuffer[]) const;
     int findTBMtrailer(int indexStart, int dataLength, ADCword dataBuffer[]) const;
@@ -52,6 +54,8 @@ protected:
     int decodeROCaddress(int rocId, ADCword rawADC[], unsigned& columnROC, unsigned& rowROC, unsigned& rawColumn,
                          unsigned& rawPixel) const;
     int decodeTBMtrailer(int indexStart, int dataLength, ADCword dataBuffer[], DecodedReadoutModule& module);
+    void fillPixelHit(int rocId, ADCword rawADC[], unsigned columnROC, unsigned rowROC, int numROCs,
+                      DecodedReadoutPixel& pixelHit) const;
     int transformROCaddress2ModuleAddress(int columnROC, int rowROC, int rocId, int& columnModule,
                                           int& rowModule) const;
 
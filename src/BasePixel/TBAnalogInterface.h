@@ -5,9 +5,13 @@
 
 #pragma once
 
+#include <vector>
+#include <boost/function.hpp>
+
 #include "BasePixel/TBInterface.h"
 #include "BasePixel/ConfigParameters.h"
 #include "BasePixel/psi46_tb.h"
+#include "BasePixel/ADCBuffer.h"
 #include "psi/units.h"
 
 /*!
@@ -15,6 +19,9 @@
  */
 class TBAnalogInterface: public TBInterface {
 public:
+    /// Queues the settings of a step of ADCScan. It must not wait for an answer of the testboard. The setters that
+    /// normally flush (SetDelay, SetClockStretch, SetClock) leave the flush to ADCScan while it queues the steps.
+    typedef boost::function<void (unsigned step)> ADCScanStep;
 
     // == General functions ================================================
 
@@ -57,6 +64,17 @@ public:
     virtual bool GetADC(short buffer[], unsigned short buffersize, unsigned short &wordsread, int nTrig, int startBuffer[], int &nReadouts) = 0;
     virtual int LastDAC(int nTrig, int chipId) = 0;
 
+    /// Sends nTrig triggers and returns the ADC samples as a view over a pooled buffer, without extra copies.
+    virtual ADCSpan AcquireADC(short nTrig = 1) = 0;
+    /// Reads the data FIFO into a pooled buffer. Returns false if the readout failed.
+    virtual bool AcquireData(ADCSpan& span) = 0;
+    /*!
+     * Scans nSteps settings without a round trip per step: the settings queued by setStep are followed by an ADC
+     * readout of nTrig triggers, and the commands of many steps are sent as one list. The readouts are then received
+     * together, one span per step. Returns false if a readout failed.
+     */
+    virtual bool ADCScan(unsigned nSteps, const ADCScanStep& setStep, short nTrig, std::vector<ADCSpan>& readouts) = 0;
+
     virtual void SetVA(psi::ElectricPotential V) = 0;   // set VA voltage in V
     virtual void SetIA(psi::ElectricCurrent A) = 0;   // set VA current limit in A
     virtual void SetVD(psi::ElectricPotential V) = 0;   // set VD voltage in V
@@ -102,11 +120,17 @@ public:
     virtual int AoutLevelPartOfChip(int position, int nTriggers, int trims[], int res[], bool pxlFlags[]) = 0;
     virtual int ChipEfficiency(int nTriggers, int trim[], double res[]) = 0;
     virtual int MaskTest(short nTriggers, short res[]) = 0;
-    virtual void DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[]) = 0;
+    virtual bool DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[]) = 0;
     virtual int ChipThreshold(int start, int step, int thrLevel, int nTrig, int dacReg, int xtalk, int cals, int trim[], int res[]) = 0;
     virtual int PixelThreshold(int col, int row, int start, int step, int thrLevel, int nTrig, int dacReg, int xtalk, int cals, int trim) = 0;
     virtual int SCurve(int nTrig, int dacReg, int threshold, int res[]) = 0;
     virtual int SCurveColumn(int column, int nTrig, int dacReg, int thr[], int trims[], int chipId[], int res[]) = 0;
+    /*!
+     * Sends nTrig triggers, decodes every ROC block of each module readout and counts per ROC (by its position in
+     * the readout) the readouts with a hit at the pixel (column, row). Returns false if a readout is missing or
+     * could not be decoded.
+     */
+    virtual bool ModulePixelHits(int column, int row, int nTrig, int nRocs, int counts[]) = 0;
     virtual void DacDac(int dac1, int dacRange1, int dac2, int dacRange2, int nTrig, int result[]) = 0;
     virtual void PHDac(int dac, int dacRange, int nTrig, int position, short result[]) = 0;
     virtual void AddressLevels(int position, int result[]) = 0;
@@ -25,6 +25,7 @@ public:
     bool GetDAC(TBMParameters::Register reg, int& value);
     void SetDAC(TBMParameters::Register reg, int value);
     bool GetReg(int reg, int &value);
+    const TBMParameters& GetParameters() const { return tbmParameters; }
 
     // Initilization routine. Do it at construction or nor?
     int init(void);
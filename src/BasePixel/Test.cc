@@ -3,10 +3,21 @@
  * \brief Implementation of Test class.
  */
 
+#include "../config.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <TFile.h>
+#include <TKey.h>
+
 #include "Test.h"
 #include "psi46expert/TestModule.h"
 #include "BasePixel/TBAnalogInterface.h"
 #include "BasePixel/DataStorage.h"
+#include "BasePixel/PhaseProfiler.h"
+#include "data/CommandStatistics.h"
+#include "data/PhaseProfile.h"
+#include "analysis/Analysis.h"
 
 namespace {
 psi::data::PerformedTests& PerformedTestsTree()
@@ -18,6 +29,31 @@ psi::data::PerformedTests& PerformedTestsTree()
 
 unsigned Test::LastTestId = 0;
 
+void Test::LoadPerformedTests()
+{
+    TFile& file = psi::DataStorage::Active().RootFile();
+    PerformedTestsTree().Reset();
+    LastTestId = 0;
+
+    // A test that was interrupted has a results directory, but no record.
+    TIter nextKey(file.GetListOfKeys());
+    for(TKey* key; (key = static_cast<TKey*>(nextKey())); ) {
+        unsigned id;
+        char separator;
+        if(std::sscanf(key->GetName(), "n%u%c", &id, &separator) == 2 && separator == '_')
+            LastTestId = std::max(LastTestId, id + 1);
+    }
+
+    if(!file.Get(psi::data::PerformedTests::TreeName().c_str()))
+        return;
+    psi::data::PerformedTests storedTests(file);
+    for(Long64_t n = 0; n < storedTests.GetEntries(); ++n) {
+        const psi::data::TestRecord& storedRecord = storedTests.GetEntry(n);
+        PerformedTestsTree().Fill(storedRecord);
+        LastTestId = std::max(LastTestId, storedRecord.id + 1);
+    }
+}
+
 Test::Test(const std::string& name, PTestRange _testRange)
     : testRange(_testRange), histograms(new TList()), debug(false),
       record(LastTestId++, name, psi::DateTimeProvider::Now())
@@ -28,23 +64,73 @@ Test::Test(const std::string& name, PTestRange _testRange)
     results = boost::shared_ptr<TTree>(new TTree(treeName.c_str(), treeName.c_str()));
     const std::string paramsTreeName = psi::data::TestNameProvider::TestParametersTreeName(record.id, name);
     params = boost::shared_ptr<TTree>(new TTree(paramsTreeName.c_str(), paramsTreeName.c_str()));
+    TB_STATISTICS(initialCommandStatistics = psi::TestBoardStatistics::Singleton().Current());
+    PhaseProfiler::Singleton().StartProfile();
+    PhaseProfiler::Singleton().Begin(name);
 }
 
 Test::~Test()
 {
+    PhaseProfiler::Singleton().End();
     record.end_time = psi::DateTimeProvider::Now();
     PerformedTestsTree().Fill(record);
     psi::DataStorage::Active().EnterDirectory("/");
-    PerformedTestsTree().RootTree().Write("", TObject::kWriteDelete);
+    PerformedTestsTree().Write("", TObject::kWriteDelete);
     psi::DataStorage::Active().GoToPreviousDirectory();
 
     results->Write();
     params->Write();
+    for(std::list<psi::analysis::PixelMap>::const_iterator map = pixelMaps.begin(); map != pixelMaps.end(); ++map)
+        histograms->Add(Analysis::ToMap(*map));
     histograms->Write();
+    TB_STATISTICS(WriteCommandStatistics());
+    WriteProfile();
     psi::DataStorage::Active().GoToPreviousDirectory();
     psi::LogInfo(record.name) << "Done. " << psi::LogInfo::TimestampString() << std::endl;
 }
 
+void Test::WriteCommandStatistics()
+{
+    const psi::TestBoardStatistics& statistics = psi::TestBoardStatistics::Singleton();
+    if(!statistics.Enabled() || initialCommandStatistics.size() != statistics.Current().size())
+        return;
+
+    const std::string treeName = psi::data::TestNameProvider::TestCommandStatisticsTreeName(record.id, record.name);
+    psi::data::CommandStatistics tree(treeName);
+    for(unsigned n = 0; n < psi::TestBoardStatistics::NumberOfCommands; ++n) {
+        psi::TestBoardStatistics::Counters counters = statistics.Current()[n];
+        counters.Subtract(initialCommandStatistics[n]);
+        if(!counters.calls && !(counters.TotalTime() > 0))
+            continue;
+        tree.command() = statistics.CommandName(n);
+        tree.calls() = counters.calls;
+        tree.bytes_out() = counters.bytesOut;
+        tree.bytes_in() = counters.bytesIn;
+        tree.link_time() = counters.linkTime;
+        tree.sleep_time() = counters.sleepTime;
+        tree.latency().assign(counters.latency, counters.latency + psi::TestBoardStatistics::NumberOfLatencyBins);
+        tree.Fill();
+    }
+    if(tree.GetEntries())
+        tree.Write();
+}
+
+void Test::WriteProfile()
+{
+    const PhaseProfiler::Phases phases = PhaseProfiler::Singleton().StopProfile();
+    const std::string treeName = psi::data::TestNameProvider::TestProfileTreeName(record.id, record.name);
+    psi::data::PhaseProfile tree(treeName);
+    for(PhaseProfiler::Phases::const_iterator phase = phases.begin(); phase != phases.end(); ++phase) {
+        tree.phase() = phase->path;
+        tree.depth() = phase->depth;
+        tree.calls() = phase->calls;
+        tree.wall_time() = phase->wallTime;
+        tree.tb_time() = phase->tbTime;
+        tree.Fill();
+    }
+    tree.Write();
+}
+
 boost::shared_ptr<TList> Test::GetHistos()
 {
     return histograms;
@@ -67,33 +153,57 @@ TH1D *Test::CreateHistogram(const std::string& histoName, unsigned chipId, unsig
     return new TH1D(name.str().c_str(), name.str().c_str(), 256, 0., 256.);
 }
 
+std::string Test::RocPhaseName(TestRoc& roc)
+{
+    std::ostringstream name;
+    name << "RocAction_C" << roc.GetChipId();
+    return name.str();
+}
+
 void Test::ModuleAction(TestModule& module)
 {
     for (unsigned i = 0; i < module.NRocs(); i++) {
-        if (testRange && testRange->IncludesRoc(module.GetRoc(i).GetChipId()))
+        if (testRange && testRange->IncludesRoc(module.GetRoc(i).GetChipId())) {
+            const PhaseProfiler::Scope phase(RocPhaseName(module.GetRoc(i)));
             RocAction(module.GetRoc(i));
+        }
     }
 }
 
 void Test::RocAction(TestRoc& roc)
 {
-    for (unsigned i = 0; i < psi::ROCNUMDCOLS; i++) {
-        if (testRange && testRange->IncludesDoubleColumn(roc.GetChipId(), i))
-            DoubleColumnAction(roc.GetDoubleColumnById(i));
+    if (!testRange) return;
+    const TestRange::DoubleColumnRange doubleColumns = testRange->DoubleColumns(roc.GetChipId());
+    for (TestRange::DoubleColumnIterator iter = doubleColumns.begin(); iter != doubleColumns.end(); ++iter) {
+        const PhaseProfiler::Scope phase("DoubleColumnAction");
+        DoubleColumnAction(roc.GetDoubleColumnById((*iter).doubleColumn));
     }
 }
 
 void Test::DoubleColumnAction(TestDoubleColumn& doubleColumn)
 {
     doubleColumn.EnableDoubleColumn();
-    for (unsigned i = 0; i < psi::ROCNUMROWS * 2; i++) {
-        TestPixel& pixel = doubleColumn.GetPixel(i);
-        if (testRange && testRange->IncludesPixel(pixel.GetRoc().GetChipId(), pixel.GetColumn(), pixel.GetRow()))
-            PixelAction(doubleColumn.GetPixel(i));
+    if (testRange) {
+        const TestRange::PixelRange pixels = testRange->Pixels(doubleColumn.GetRoc().GetChipId(),
+                                                               doubleColumn.DoubleColumnNumber());
+        for (TestRange::PixelIterator iter = pixels.begin(); iter != pixels.end(); ++iter) {
+            const TestRange::Pixel pixel = *iter;
+            PixelAction(doubleColumn.GetPixel(pixel.column, pixel.row));
+        }
     }
     doubleColumn.DisableDoubleColumn();
 }
 
+std::vector<TestRoc*> Test::IncludedRocs(TestModule& module) const
+{
+    std::vector<TestRoc*> rocs;
+    for (unsigned i = 0; i < module.NRocs(); i++) {
+        if (testRange && testRange->IncludesRoc(module.GetRoc(i).GetChipId()))
+            rocs.push_back(&module.GetRoc(i));
+    }
+    return rocs;
+}
+
 void Test::RestoreDacParameters(TestRoc& roc)
 {
     roc.RestoreDacParameters(savedDacParameters);
@@ -7,6 +7,7 @@
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <list>
 #include <TTree.h>
 #include <TList.h>
 #include <TH2D.h>
@@ -18,8 +19,10 @@
 #include "BasePixel/DACParameters.h"
 
 #include "psi/exception.h"
+#include "interface/TestBoardStatistics.h"
 #include "data/PerformedTests.h"
 #include "data/TestNameProvider.h"
+#include "analysis/PixelMap.h"
 
 class TestModule;
 class TestRoc;
@@ -38,10 +41,19 @@ public:
     explicit Test(const std::string& name, PTestRange testRange = PTestRange());
     virtual ~Test();
 
+    /*!
+     * Continues the list of performed tests and the test numbering of the output file of the active data storage, so
+     * the tests of a resumed run neither overwrite the records nor reuse the directories of the earlier runs. Must be
+     * called while the data storage is enabled and before the first test is created.
+     */
+    static void LoadPerformedTests();
+
     boost::shared_ptr<TList> GetHistos();
     boost::shared_ptr<TTree> GetResults() { return results; }
+    const psi::data::TestRecord& GetRecord() const { return record; }
     static TH2D *CreateMap(const std::string& mapName, unsigned chipId, unsigned mapId = 0);
     static TH1D *CreateHistogram(const std::string& histoName, unsigned chipId, unsigned column, unsigned row);
+    static std::string RocPhaseName(TestRoc& roc);
     virtual void ModuleAction(TestModule& testModule);
     virtual void RocAction(TestRoc& testRoc);
     virtual void DoubleColumnAction(TestDoubleColumn& testDoubleColumn);
@@ -50,12 +62,27 @@ public:
     void SaveDacParameters(TestRoc& roc);
     void RestoreDacParameters(TestRoc& roc);
 
+protected:
+    /// ROCs of the module included into the test range.
+    std::vector<TestRoc*> IncludedRocs(TestModule& module) const;
+
+    /// Stores the map with the test results, it is converted to TH2D only when the test is written.
+    void AddMap(const psi::analysis::PixelMap& map) { pixelMaps.push_back(map); }
+
 protected:
     PTestRange testRange;
     boost::shared_ptr<TList> histograms;
+    std::list<psi::analysis::PixelMap> pixelMaps;
     boost::shared_ptr<TTree> results, params;
     boost::shared_ptr<DACParameters> savedDacParameters;
 
     bool debug;
     psi::data::TestRecord record;
+
+private:
+    void WriteCommandStatistics();
+    void WriteProfile();
+
+private:
+    psi::TestBoardStatistics::Snapshot initialCommandStatistics;
 };
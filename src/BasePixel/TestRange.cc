@@ -3,85 +3,163 @@
  * \brief Implementation of TestRange class.
  */
 
+#include <algorithm>
+
 #include "psi/log.h"
-#include "BasePixel/constants.h"
+#include "psi/exception.h"
 #include "TestRange.h"
 
-unsigned TestRange::Index(unsigned roc, unsigned col, unsigned row)
+namespace {
+inline unsigned CountTrailingZeros(uint64_t word)
 {
-    return row + psi::ROCNUMROWS * ( col + psi::ROCNUMCOLS * roc );
+    return __builtin_ctzll(word);
 }
+} // anonymous namespace
 
 TestRange::TestRange()
+    : totalCount(0)
+{
+    std::fill(pixels, pixels + NumberOfPixelWords, 0);
+    std::fill(summary, summary + NumberOfSummaryWords, 0);
+    std::fill(doubleColumnMask, doubleColumnMask + NumberOfDoubleColumnWords, 0);
+    std::fill(rocCounts, rocCounts + psi::MODULENUMROCS, 0);
+    std::fill(doubleColumnCounts, doubleColumnCounts + NumberOfDoubleColumns, 0);
+    std::fill(columnCounts, columnCounts + psi::MODULENUMROCS * psi::ROCNUMCOLS, 0);
+    std::fill(moduleColumnCounts, moduleColumnCounts + psi::ROCNUMCOLS, 0);
+}
+
+TestRange::Pixel TestRange::MakePixel(unsigned index)
 {
-    pixels.assign(psi::MODULENUMROCS * psi::ROCNUMCOLS * psi::ROCNUMROWS, false);
+    const unsigned row = index % psi::ROCNUMROWS;
+    const unsigned column = (index / psi::ROCNUMROWS) % psi::ROCNUMCOLS;
+    const unsigned roc = index / NumberOfPixelsPerRoc;
+    return Pixel(roc, column, row);
+}
+
+void TestRange::SetPixel(unsigned index)
+{
+    const unsigned wordId = index / BitsPerWord;
+    const Word bit = Word(1) << (index % BitsPerWord);
+    if(pixels[wordId] & bit) return;
+
+    pixels[wordId] |= bit;
+    summary[wordId / BitsPerWord] |= Word(1) << (wordId % BitsPerWord);
+
+    const Pixel pixel = MakePixel(index);
+    const unsigned doubleColumnId = pixel.roc * psi::ROCNUMDCOLS + pixel.column / 2;
+    ++totalCount;
+    ++rocCounts[pixel.roc];
+    ++doubleColumnCounts[doubleColumnId];
+    ++columnCounts[pixel.roc * psi::ROCNUMCOLS + pixel.column];
+    ++moduleColumnCounts[pixel.column];
+    doubleColumnMask[doubleColumnId / BitsPerWord] |= Word(1) << (doubleColumnId % BitsPerWord);
 }
 
 void TestRange::CompleteRange()
 {
-    pixels.assign(pixels.size(), true);
+    for(unsigned roc = 0; roc < psi::MODULENUMROCS; ++roc)
+        CompleteRoc(roc);
 }
 
 void TestRange::CompleteRoc(unsigned roc)
 {
+    CheckRoc(roc);
     const unsigned lastIndex = Index(roc + 1, 0, 0);
     for(unsigned n = Index(roc, 0, 0); n < lastIndex; ++n)
-        pixels.at(n) = true;
+        SetPixel(n);
 }
 
 void TestRange::AddPixel(unsigned roc, unsigned col, unsigned row)
 {
-    pixels.at(Index(roc, col, row)) = true;
+    if(roc >= psi::MODULENUMROCS || col >= psi::ROCNUMCOLS || row >= psi::ROCNUMROWS)
+        THROW_PSI_EXCEPTION("Pixel (roc=" << roc << ", col=" << col << ", row=" << row << ") is out of range.");
+    SetPixel(Index(roc, col, row));
+}
+
+unsigned TestRange::FindNextBit(const Word* words, unsigned firstIndex, unsigned lastIndex)
+{
+    unsigned wordId = firstIndex / BitsPerWord;
+    Word bits = firstIndex < lastIndex ? words[wordId] & (~Word(0) << (firstIndex % BitsPerWord)) : 0;
+    for(;;) {
+        if(bits)
+            return std::min(wordId * BitsPerWord + CountTrailingZeros(bits), lastIndex);
+        ++wordId;
+        if(wordId * BitsPerWord >= lastIndex)
+            return lastIndex;
+        bits = words[wordId];
+    }
 }
 
-bool TestRange::IncludesPixel(unsigned roc, unsigned col, unsigned row) const
+unsigned TestRange::FindNextPixel(unsigned firstIndex, unsigned lastIndex) const
 {
-    return pixels.at(Index(roc, col, row));
+    if(firstIndex >= lastIndex)
+        return lastIndex;
+
+    // Check the remaining part of the current word, then use the summary level to jump over empty words.
+    const unsigned wordId = firstIndex / BitsPerWord;
+    const Word bits = pixels[wordId] & (~Word(0) << (firstIndex % BitsPerWord));
+    if(bits)
+        return std::min(wordId * BitsPerWord + CountTrailingZeros(bits), lastIndex);
+
+    const unsigned lastWordId = (lastIndex + BitsPerWord - 1) / BitsPerWord;
+    const unsigned nextWordId = FindNextBit(summary, wordId + 1, lastWordId);
+    if(nextWordId >= lastWordId)
+        return lastIndex;
+    return std::min(nextWordId * BitsPerWord + CountTrailingZeros(pixels[nextWordId]), lastIndex);
 }
 
-bool TestRange::IncludesAtLeastOnePixelInRange(unsigned firstIndex, unsigned lastIndex) const
+unsigned TestRange::FindNextDoubleColumn(unsigned firstIndex, unsigned lastIndex) const
 {
-    for(unsigned n = firstIndex; n < lastIndex; ++n)
-        if(pixels.at(n)) return true;
-    return false;
+    return FindNextBit(doubleColumnMask, firstIndex, lastIndex);
 }
 
-bool TestRange::IncludesRoc(unsigned roc) const
+TestRange::PixelRange TestRange::MakePixelRange(unsigned firstIndex, unsigned lastIndex) const
 {
-    const unsigned firstIndex = Index(roc, 0, 0);
-    const unsigned lastIndex = Index(roc + 1, 0, 0);
-    return IncludesAtLeastOnePixelInRange(firstIndex, lastIndex);
+    const PixelIterator first(*this, FindNextPixel(firstIndex, lastIndex), lastIndex);
+    const PixelIterator last(*this, lastIndex, lastIndex);
+    return PixelRange(first, last);
+}
+
+TestRange::PixelRange TestRange::Pixels() const
+{
+    return MakePixelRange(0, NumberOfPixels);
+}
+
+TestRange::PixelRange TestRange::Pixels(unsigned roc) const
+{
+    CheckRoc(roc);
+    return MakePixelRange(Index(roc, 0, 0), Index(roc + 1, 0, 0));
 }
 
-bool TestRange::IncludesDoubleColumn(unsigned roc, unsigned doubleColumn) const
+TestRange::PixelRange TestRange::Pixels(unsigned roc, unsigned doubleColumn) const
 {
-    const unsigned firstIndex = Index(roc, doubleColumn * 2, 0);
-    const unsigned lastIndex = Index(roc, (doubleColumn + 1) * 2, 0);
-    return IncludesAtLeastOnePixelInRange(firstIndex, lastIndex);
+    CheckRoc(roc);
+    CheckDoubleColumn(doubleColumn);
+    return MakePixelRange(Index(roc, doubleColumn * 2, 0), Index(roc, (doubleColumn + 1) * 2, 0));
 }
 
-bool TestRange::IncludesColumn(unsigned column) const
+TestRange::DoubleColumnRange TestRange::DoubleColumns() const
 {
-    for (unsigned roc = 0; roc < psi::MODULENUMROCS; ++roc)
-        if(IncludesColumn(roc, column)) return true;
-    return false;
+    const DoubleColumnIterator first(*this, FindNextDoubleColumn(0, NumberOfDoubleColumns), NumberOfDoubleColumns);
+    const DoubleColumnIterator last(*this, NumberOfDoubleColumns, NumberOfDoubleColumns);
+    return DoubleColumnRange(first, last);
 }
 
-bool TestRange::IncludesColumn(unsigned roc, unsigned column) const
+TestRange::DoubleColumnRange TestRange::DoubleColumns(unsigned roc) const
 {
-    const unsigned firstIndex = Index(roc, column, 0);
-    const unsigned lastIndex = Index(roc, column + 1, 0);
-    return IncludesAtLeastOnePixelInRange(firstIndex, lastIndex);
+    CheckRoc(roc);
+    const unsigned firstIndex = roc * psi::ROCNUMDCOLS;
+    const unsigned lastIndex = (roc + 1) * psi::ROCNUMDCOLS;
+    const DoubleColumnIterator first(*this, FindNextDoubleColumn(firstIndex, lastIndex), lastIndex);
+    const DoubleColumnIterator last(*this, lastIndex, lastIndex);
+    return DoubleColumnRange(first, last);
 }
 
 void TestRange::Print() const
 {
-    for (unsigned i = 0; i < psi::MODULENUMROCS; i++) {
-        for (unsigned k = 0; k < psi::ROCNUMCOLS; k++) {
-            for (unsigned l = 0; l < psi::ROCNUMROWS; l++) {
-                if (pixels.at(Index(i, k, l)))
-                    psi::LogInfo() << "pixel " << i << " " << k << " " << l << std::endl;
-            }
-        }
+    const PixelRange range = Pixels();
+    for(PixelIterator iter = range.begin(); iter != range.end(); ++iter) {
+        const Pixel pixel = *iter;
+        psi::LogInfo() << "pixel " << pixel.roc << " " << pixel.column << " " << pixel.row << std::endl;
     }
 }
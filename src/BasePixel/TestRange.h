@@ -5,12 +5,111 @@
 
 #pragma once
 
-#include <vector>
+#include <cstddef>
+#include <iterator>
+#include <stdint.h>
+
+#include "psi/exception.h"
+#include "BasePixel/constants.h"
 
 /*!
  * \brief Defines for which entities a test should be performed
+ *
+ * Pixels are stored as a two-level bitset: one bit per pixel and one summary bit per non-empty pixel word.
+ * Population counts per ROC, column and double column are kept up to date, so all Includes* queries
+ * are O(1), and iteration over included pixels or double columns is proportional to their number.
+ * All queries throw psi::exception for ROC, column, double column or row ids that are out of range.
  */
 class TestRange {
+private:
+    typedef uint64_t Word;
+    static const unsigned BitsPerWord = 64;
+    static const unsigned NumberOfPixelsPerRoc = psi::ROCNUMCOLS * psi::ROCNUMROWS;
+    static const unsigned NumberOfPixels = psi::MODULENUMROCS * NumberOfPixelsPerRoc;
+    static const unsigned NumberOfPixelWords = (NumberOfPixels + BitsPerWord - 1) / BitsPerWord;
+    static const unsigned NumberOfSummaryWords = (NumberOfPixelWords + BitsPerWord - 1) / BitsPerWord;
+    static const unsigned NumberOfDoubleColumns = psi::MODULENUMROCS * psi::ROCNUMDCOLS;
+    static const unsigned NumberOfDoubleColumnWords = (NumberOfDoubleColumns + BitsPerWord - 1) / BitsPerWord;
+
+public:
+    struct Pixel {
+        unsigned roc, column, row;
+        Pixel(unsigned _roc, unsigned _column, unsigned _row) : roc(_roc), column(_column), row(_row) {}
+    };
+
+    struct DoubleColumn {
+        unsigned roc, doubleColumn;
+        DoubleColumn(unsigned _roc, unsigned _doubleColumn) : roc(_roc), doubleColumn(_doubleColumn) {}
+    };
+
+    /*!
+     * \brief Forward iterator over the included pixels within a contiguous index range.
+     */
+    class PixelIterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Pixel value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Pixel* pointer;
+        typedef Pixel reference;
+
+        PixelIterator() : range(0), index(0), lastIndex(0) {}
+        Pixel operator*() const { return TestRange::MakePixel(index); }
+        PixelIterator& operator++() { index = range->FindNextPixel(index + 1, lastIndex); return *this; }
+        PixelIterator operator++(int) { PixelIterator iter(*this); ++(*this); return iter; }
+        bool operator==(const PixelIterator& other) const { return index == other.index; }
+        bool operator!=(const PixelIterator& other) const { return index != other.index; }
+
+    private:
+        friend class TestRange;
+        PixelIterator(const TestRange& _range, unsigned _index, unsigned _lastIndex)
+            : range(&_range), index(_index), lastIndex(_lastIndex) {}
+        const TestRange* range;
+        unsigned index, lastIndex;
+    };
+
+    /*!
+     * \brief Forward iterator over the double columns that include at least one pixel.
+     */
+    class DoubleColumnIterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef DoubleColumn value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const DoubleColumn* pointer;
+        typedef DoubleColumn reference;
+
+        DoubleColumnIterator() : range(0), index(0), lastIndex(0) {}
+        DoubleColumn operator*() const { return DoubleColumn(index / psi::ROCNUMDCOLS, index % psi::ROCNUMDCOLS); }
+        DoubleColumnIterator& operator++() { index = range->FindNextDoubleColumn(index + 1, lastIndex); return *this; }
+        DoubleColumnIterator operator++(int) { DoubleColumnIterator iter(*this); ++(*this); return iter; }
+        bool operator==(const DoubleColumnIterator& other) const { return index == other.index; }
+        bool operator!=(const DoubleColumnIterator& other) const { return index != other.index; }
+
+    private:
+        friend class TestRange;
+        DoubleColumnIterator(const TestRange& _range, unsigned _index, unsigned _lastIndex)
+            : range(&_range), index(_index), lastIndex(_lastIndex) {}
+        const TestRange* range;
+        unsigned index, lastIndex;
+    };
+
+    /*!
+     * \brief Pair of iterators that can be used in a range-based for loop.
+     */
+    template<typename Iterator>
+    struct IteratorRange {
+        IteratorRange(const Iterator& _first, const Iterator& _last) : first(_first), last(_last) {}
+        Iterator begin() const { return first; }
+        Iterator end() const { return last; }
+        bool empty() const { return first == last; }
+    private:
+        Iterator first, last;
+    };
+
+    typedef IteratorRange<PixelIterator> PixelRange;
+    typedef IteratorRange<DoubleColumnIterator> DoubleColumnRange;
+
 public:
     TestRange();
 
@@ -19,17 +118,79 @@ public:
     void CompleteRange();
     void CompleteRoc(unsigned roc);
 
-    bool IncludesPixel(unsigned roc, unsigned col, unsigned row) const;
-    bool IncludesRoc(unsigned roc) const;
-    bool IncludesDoubleColumn(unsigned roc, unsigned doubleColumn) const;
-    bool IncludesColumn(unsigned roc, unsigned column) const;
-    bool IncludesColumn(unsigned column) const;
+    bool IncludesPixel(unsigned roc, unsigned col, unsigned row) const {
+        CheckRoc(roc);
+        CheckColumn(col);
+        if(row >= psi::ROCNUMROWS)
+            THROW_PSI_EXCEPTION("Row " << row << " is out of range.");
+        const unsigned index = Index(roc, col, row);
+        return (pixels[index / BitsPerWord] >> (index % BitsPerWord)) & 1;
+    }
+    bool IncludesRoc(unsigned roc) const { return NumberOfIncludedPixels(roc) != 0; }
+    bool IncludesDoubleColumn(unsigned roc, unsigned doubleColumn) const {
+        return NumberOfIncludedPixels(roc, doubleColumn) != 0;
+    }
+    bool IncludesColumn(unsigned roc, unsigned column) const {
+        CheckRoc(roc);
+        CheckColumn(column);
+        return columnCounts[roc * psi::ROCNUMCOLS + column] != 0;
+    }
+    bool IncludesColumn(unsigned column) const {
+        CheckColumn(column);
+        return moduleColumnCounts[column] != 0;
+    }
+
+    unsigned NumberOfIncludedPixels() const { return totalCount; }
+    unsigned NumberOfIncludedPixels(unsigned roc) const {
+        CheckRoc(roc);
+        return rocCounts[roc];
+    }
+    unsigned NumberOfIncludedPixels(unsigned roc, unsigned doubleColumn) const {
+        CheckRoc(roc);
+        CheckDoubleColumn(doubleColumn);
+        return doubleColumnCounts[roc * psi::ROCNUMDCOLS + doubleColumn];
+    }
+
+    PixelRange Pixels() const;
+    PixelRange Pixels(unsigned roc) const;
+    PixelRange Pixels(unsigned roc, unsigned doubleColumn) const;
+    DoubleColumnRange DoubleColumns() const;
+    DoubleColumnRange DoubleColumns(unsigned roc) const;
 
     void Print() const;
 
 private:
-    static unsigned Index(unsigned roc, unsigned col, unsigned row);
-    bool& Get(unsigned roc, unsigned col, unsigned row);
-    bool IncludesAtLeastOnePixelInRange(unsigned firstIndex, unsigned lastIndex) const;
-    std::vector<bool> pixels;
+    static void CheckRoc(unsigned roc) {
+        if(roc >= psi::MODULENUMROCS)
+            THROW_PSI_EXCEPTION("ROC id " << roc << " is out of range.");
+    }
+    static void CheckColumn(unsigned column) {
+        if(column >= psi::ROCNUMCOLS)
+            THROW_PSI_EXCEPTION("Column " << column << " is out of range.");
+    }
+    static void CheckDoubleColumn(unsigned doubleColumn) {
+        if(doubleColumn >= psi::ROCNUMDCOLS)
+            THROW_PSI_EXCEPTION("Double column " << doubleColumn << " is out of range.");
+    }
+    static unsigned Index(unsigned roc, unsigned col, unsigned row) {
+        return row + psi::ROCNUMROWS * ( col + psi::ROCNUMCOLS * roc );
+    }
+    static Pixel MakePixel(unsigned index);
+    static unsigned FindNextBit(const Word* words, unsigned firstIndex, unsigned lastIndex);
+
+    void SetPixel(unsigned index);
+    PixelRange MakePixelRange(unsigned firstIndex, unsigned lastIndex) const;
+    unsigned FindNextPixel(unsigned firstIndex, unsigned lastIndex) const;
+    unsigned FindNextDoubleColumn(unsigned firstIndex, unsigned lastIndex) const;
+
+private:
+    Word pixels[NumberOfPixelWords];
+    Word summary[NumberOfSummaryWords];
+    Word doubleColumnMask[NumberOfDoubleColumnWords];
+
+    unsigned totalCount;
+    unsigned rocCounts[psi::MODULENUMROCS];
+    unsigned doubleColumnCounts[NumberOfDoubleColumns];
+    unsigned columnCounts[psi::MODULENUMROCS * psi::ROCNUMCOLS];
+    unsigned moduleColumnCounts[psi::ROCNUMCOLS];
 };
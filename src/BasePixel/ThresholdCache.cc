@@ -0,0 +1,81 @@
+/*!
+ * \file ThresholdCache.cc
+ * \brief Implementation of ThresholdCache class.
+ */
+
+#include <algorithm>
+
+#include "ThresholdCache.h"
+#include "TestRange.h"
+#include "psi46expert/TestRoc.h"
+
+namespace {
+/// DACs that move the thresholds. WBC is left out: it selects the bunch crossing, not the threshold.
+const DACParameters::Register THRESHOLD_DACS[] = {
+    DACParameters::Vtrim, DACParameters::VthrComp, DACParameters::Vcal, DACParameters::CtrlReg
+};
+const size_t NUMBER_OF_THRESHOLD_DACS = sizeof(THRESHOLD_DACS) / sizeof(THRESHOLD_DACS[0]);
+const int NOT_CACHED = -1;
+} // anonymous namespace
+
+std::vector<int> ThresholdCache::DacState(TestRoc& roc, DACParameters::Register dacReg)
+{
+    std::vector<int> state;
+    for (size_t n = 0; n < NUMBER_OF_THRESHOLD_DACS; n++)
+        state.push_back(THRESHOLD_DACS[n] == dacReg ? 0 : roc.GetDAC(THRESHOLD_DACS[n]));
+    return state;
+}
+
+ThresholdCache::Seeds ThresholdCache::GetSeeds(const std::string& mapName, TestRoc& roc,
+                                               DACParameters::Register dacReg) const
+{
+    Seeds seeds;
+    const std::map<Key, Entry>::const_iterator iter = entries.find(Key(mapName, roc.GetChipId()));
+    if (iter == entries.end()) return seeds;
+    const Entry& entry = iter->second;
+    const bool sameDacs = entry.dacState == DacState(roc, dacReg);
+
+    seeds.resize(psi::ROCNUMCOLS * psi::ROCNUMROWS);
+    for (unsigned col = 0; col < psi::ROCNUMCOLS; col++) {
+        for (unsigned row = 0; row < psi::ROCNUMROWS; row++) {
+            const unsigned index = col * psi::ROCNUMROWS + row;
+            if (entry.thresholds[index] == NOT_CACHED) continue;
+            seeds[index].threshold = entry.thresholds[index];
+            if (!sameDacs)
+                seeds[index].width = DacChangedWidth;
+            else if (entry.trims[index] != roc.GetPixel(col, row).GetTrim())
+                seeds[index].width = TrimChangedWidth;
+            else
+                seeds[index].width = ExactStateWidth;
+        }
+    }
+    return seeds;
+}
+
+int ThresholdCache::StartValue(const Seeds& seeds, int defaultStart)
+{
+    std::vector<int> thresholds;
+    for (size_t n = 0; n < seeds.size(); n++) {
+        if (seeds[n].width) thresholds.push_back(seeds[n].threshold);
+    }
+    if (thresholds.empty()) return defaultStart;
+    std::nth_element(thresholds.begin(), thresholds.begin() + thresholds.size() / 2, thresholds.end());
+    return thresholds[thresholds.size() / 2];
+}
+
+void ThresholdCache::Store(const std::string& mapName, TestRoc& roc, DACParameters::Register dacReg,
+                           const TestRange& testRange, const int thresholds[])
+{
+    Entry& entry = entries[Key(mapName, roc.GetChipId())];
+    entry.dacState = DacState(roc, dacReg);
+    entry.thresholds.assign(psi::ROCNUMCOLS * psi::ROCNUMROWS, NOT_CACHED);
+    entry.trims.assign(psi::ROCNUMCOLS * psi::ROCNUMROWS, 0);
+    for (unsigned col = 0; col < psi::ROCNUMCOLS; col++) {
+        for (unsigned row = 0; row < psi::ROCNUMROWS; row++) {
+            const unsigned index = col * psi::ROCNUMROWS + row;
+            if (!testRange.IncludesPixel(roc.GetChipId(), col, row) || thresholds[index] == NoThreshold) continue;
+            entry.thresholds[index] = thresholds[index];
+            entry.trims[index] = roc.GetPixel(col, row).GetTrim();
+        }
+    }
+}
@@ -0,0 +1,61 @@
+/*!
+ * \file ThresholdCache.h
+ * \brief Definition of ThresholdCache class.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "DACParameters.h"
+
+class TestRoc;
+class TestRange;
+
+/*!
+ * \brief Thresholds of the last measured map of each kind and ROC, used to seed the next scans.
+ *
+ * Each pixel entry keeps the trim bits and the DAC settings of its measurement. The closer the current state is to
+ * the cached one, the narrower the bracket around the previous threshold that is searched first.
+ */
+class ThresholdCache {
+public:
+    /// Expected threshold of a pixel and the half-width of the first bracket in DAC steps, 0 if there is no seed.
+    struct Seed {
+        int threshold;
+        unsigned width;
+        Seed() : threshold(0), width(0) {}
+    };
+    typedef std::vector<Seed> Seeds;
+
+    static const unsigned ExactStateWidth = 2;
+    static const unsigned TrimChangedWidth = 6;
+    static const unsigned DacChangedWidth = 16;
+    static const int NoThreshold = 255;
+
+public:
+    /// Returns seeds for all pixels of the ROC in the ChipThreshold layout, or an empty vector.
+    Seeds GetSeeds(const std::string& mapName, TestRoc& roc, DACParameters::Register dacReg) const;
+
+    /// Typical threshold of the seeds, to start a scan that has a single start value.
+    static int StartValue(const Seeds& seeds, int defaultStart);
+
+    /// Stores the thresholds of the pixels of the ROC included into the range, except NoThreshold.
+    void Store(const std::string& mapName, TestRoc& roc, DACParameters::Register dacReg, const TestRange& testRange,
+               const int thresholds[]);
+
+    void Clear() { entries.clear(); }
+
+private:
+    struct Entry {
+        std::vector<int> dacState, thresholds, trims;
+    };
+    typedef std::pair<std::string, int> Key;
+
+    static std::vector<int> DacState(TestRoc& roc, DACParameters::Register dacReg);
+
+private:
+    std::map<Key, Entry> entries;
+};
@@ -6,8 +6,14 @@
 #include "ThresholdMap.h"
 #include "data/HistogramNameProvider.h"
 #include "psi46expert/TestRoc.h"
+#include "psi46expert/TestModule.h"
 #include "BasePixel/constants.h"
 #include "BasePixel/TBAnalogInterface.h"
+#include "BasePixel/PhaseProfiler.h"
+
+namespace {
+const int DEFAULT_START = 100;
+}
 
 const ThresholdMap::Parameters ThresholdMap::VcalThresholdMapParameters(
         psi::data::HistogramNameProvider::VcalThresholdMapName(), DACParameters::Vcal, false, false, false);
@@ -31,6 +37,7 @@ TH2D* ThresholdMap::MeasureMap(const Parameters& parameters, TestRoc& roc, const
 TH2D* ThresholdMap::MeasureMap(const Parameters& parameters, TestRoc& roc, const TestRange& testRange,
                                unsigned thrLevel, unsigned nTrig, unsigned mapId)
 {
+    const PhaseProfiler::Scope phase("ThresholdMap::MeasureMap_" + parameters.mapName);
     const std::string fullMapName =
             psi::data::HistogramNameProvider::FullMapName(parameters.mapName, roc.GetChipId(), mapId);
     TH2D* histo = new TH2D(fullMapName.c_str(), fullMapName.c_str(), psi::ROCNUMCOLS, 0., psi::ROCNUMCOLS,
@@ -43,8 +50,10 @@ TH2D* ThresholdMap::MeasureMap(const Parameters& parameters, TestRoc& roc, const
     }
 
     int data[4160];
-    roc.ChipThreshold(100, parameters.sign(), thrLevel, nTrig, parameters.dacReg, parameters.xtalk, parameters.cals,
+    int start = ThresholdCache::StartValue(cache.GetSeeds(parameters.mapName, roc, parameters.dacReg), DEFAULT_START);
+    roc.ChipThreshold(start, parameters.sign(), thrLevel, nTrig, parameters.dacReg, parameters.xtalk, parameters.cals,
                       data);
+    cache.Store(parameters.mapName, roc, parameters.dacReg, testRange, data);
 
     for (unsigned iCol = 0; iCol < psi::ROCNUMCOLS ; iCol++) {
         for (unsigned iRow = 0; iRow < psi::ROCNUMROWS ; iRow++) {
@@ -60,20 +69,110 @@ TH2D* ThresholdMap::MeasureMap(const Parameters& parameters, TestRoc& roc, const
 
         if (histo->GetMaximum() == 255) { // if there are pixels where no threshold could be found, test other wbc
             int data2[4160];
-            roc.ChipThreshold(100, parameters.sign(), thrLevel, nTrig, parameters.dacReg, parameters.xtalk,
+            start = ThresholdCache::StartValue(cache.GetSeeds(parameters.mapName, roc, parameters.dacReg),
+                                               DEFAULT_START);
+            roc.ChipThreshold(start, parameters.sign(), thrLevel, nTrig, parameters.dacReg, parameters.xtalk,
                               parameters.cals, data2);
 
             for (unsigned iCol = 0; iCol < psi::ROCNUMCOLS ; iCol++) {
                 for (unsigned iRow = 0; iRow < psi::ROCNUMROWS ; iRow++) {
                     if (testRange.IncludesPixel(roc.GetChipId(), iCol, iRow)) {
                         int index = iCol * psi::ROCNUMROWS + iRow;
-                        if (data2[index] < data[index]) histo->SetBinContent(iCol + 1, iRow + 1, data2[index]);
+                        if (data2[index] < data[index]) {
+                            histo->SetBinContent(iCol + 1, iRow + 1, data2[index]);
+                            data[index] = data2[index];
+                        }
                     }
                 }
             }
+            cache.Store(parameters.mapName, roc, parameters.dacReg, testRange, data);
         }
     }
 
     roc.SetDAC(DACParameters::WBC, wbc); // restore original wbc
     return histo;
 }
+
+std::vector<TH2D*> ThresholdMap::MeasureMaps(const Parameters& parameters, const std::vector<TestRoc*>& rocs,
+                                             const TestRange& testRange, unsigned nTrig, unsigned mapId)
+{
+    return MeasureMaps(parameters, rocs, testRange, nTrig / 2, nTrig, mapId);
+}
+
+std::vector<TH2D*> ThresholdMap::MeasureMaps(const Parameters& parameters, const std::vector<TestRoc*>& rocs,
+                                             const TestRange& testRange, unsigned thrLevel, unsigned nTrig,
+                                             unsigned mapId)
+{
+    const PhaseProfiler::Scope phase("ThresholdMap::MeasureMaps_" + parameters.mapName);
+    std::vector<TH2D*> histos;
+    if (rocs.empty()) return histos;
+    TestModule& module = rocs.front()->GetModule();
+
+    std::vector<int> wbc;
+    for (size_t n = 0; n < rocs.size(); n++) {
+        const std::string fullMapName =
+                psi::data::HistogramNameProvider::FullMapName(parameters.mapName, rocs[n]->GetChipId(), mapId);
+        histos.push_back(new TH2D(fullMapName.c_str(), fullMapName.c_str(), psi::ROCNUMCOLS, 0., psi::ROCNUMCOLS,
+                                  psi::ROCNUMROWS, 0., psi::ROCNUMROWS));
+        wbc.push_back(rocs[n]->GetDAC(DACParameters::WBC));
+        if (doubleWbc) rocs[n]->SetDAC(DACParameters::WBC, wbc.back() - 1);
+    }
+    if (doubleWbc) rocs.front()->Flush();
+
+    std::vector<ThresholdCache::Seeds> seeds;
+    for (size_t n = 0; n < rocs.size(); n++)
+        seeds.push_back(cache.GetSeeds(parameters.mapName, *rocs[n], parameters.dacReg));
+
+    std::vector< std::vector<int> > data;
+    module.ChipThreshold(rocs, testRange, DEFAULT_START, parameters.sign(), thrLevel, nTrig, parameters.dacReg,
+                         parameters.xtalk, parameters.cals, data, &seeds);
+    for (size_t n = 0; n < rocs.size(); n++)
+        cache.Store(parameters.mapName, *rocs[n], parameters.dacReg, testRange, &data[n][0]);
+
+    bool missingThresholds = false;
+    for (size_t n = 0; n < rocs.size(); n++) {
+        for (unsigned iCol = 0; iCol < psi::ROCNUMCOLS ; iCol++) {
+            for (unsigned iRow = 0; iRow < psi::ROCNUMROWS ; iRow++) {
+                if (testRange.IncludesPixel(rocs[n]->GetChipId(), iCol, iRow)) {
+                    const int threshold = data[n][iCol * psi::ROCNUMROWS + iRow];
+                    histos[n]->SetBinContent(iCol + 1, iRow + 1, threshold);
+                    if (threshold == 255) missingThresholds = true;
+                }
+            }
+        }
+    }
+
+    if (doubleWbc) {
+        for (size_t n = 0; n < rocs.size(); n++)
+            rocs[n]->SetDAC(DACParameters::WBC, wbc[n]);
+        rocs.front()->Flush();
+
+        if (missingThresholds) { // if there are pixels where no threshold could be found, test other wbc
+            for (size_t n = 0; n < rocs.size(); n++)
+                seeds[n] = cache.GetSeeds(parameters.mapName, *rocs[n], parameters.dacReg);
+
+            std::vector< std::vector<int> > data2;
+            module.ChipThreshold(rocs, testRange, DEFAULT_START, parameters.sign(), thrLevel, nTrig,
+                                 parameters.dacReg, parameters.xtalk, parameters.cals, data2, &seeds);
+
+            for (size_t n = 0; n < rocs.size(); n++) {
+                for (unsigned iCol = 0; iCol < psi::ROCNUMCOLS ; iCol++) {
+                    for (unsigned iRow = 0; iRow < psi::ROCNUMROWS ; iRow++) {
+                        if (testRange.IncludesPixel(rocs[n]->GetChipId(), iCol, iRow)) {
+                            int index = iCol * psi::ROCNUMROWS + iRow;
+                            if (data2[n][index] < data[n][index]) {
+                                histos[n]->SetBinContent(iCol + 1, iRow + 1, data2[n][index]);
+                                data[n][index] = data2[n][index];
+                            }
+                        }
+                    }
+                }
+                cache.Store(parameters.mapName, *rocs[n], parameters.dacReg, testRange, &data[n][0]);
+            }
+        }
+    }
+
+    for (size_t n = 0; n < rocs.size(); n++)
+        rocs[n]->SetDAC(DACParameters::WBC, wbc[n]); // restore original wbc
+    return histos;
+}
@@ -8,6 +8,7 @@
 #include <TH2D.h>
 #include "psi46expert/TestRoc.h"
 #include "TestRange.h"
+#include "ThresholdCache.h"
 
 /*!
  * \brief Trim functions
@@ -42,10 +43,22 @@ public:
     TH2D* MeasureMap(const Parameters& parameters, TestRoc& roc, const TestRange& testRange, unsigned thrLevel,
                      unsigned nTrig, unsigned mapId);
 
+    /*!
+     * Measures the maps of several ROCs of one module at once with TestModule::ChipThreshold. The maps are returned
+     * in the order of the ROCs.
+     */
+    std::vector<TH2D*> MeasureMaps(const Parameters& parameters, const std::vector<TestRoc*>& rocs,
+                                   const TestRange& testRange, unsigned nTrig, unsigned mapId = 0);
+
+    std::vector<TH2D*> MeasureMaps(const Parameters& parameters, const std::vector<TestRoc*>& rocs,
+                                   const TestRange& testRange, unsigned thrLevel, unsigned nTrig, unsigned mapId);
 
     void SetDoubleWbc() { doubleWbc = true; }
     void SetSingleWbc() { doubleWbc = false; }
 
 private:
     bool doubleWbc;
+
+    /// Thresholds of the maps measured by this object, the following scans start around them.
+    ThresholdCache cache;
 };
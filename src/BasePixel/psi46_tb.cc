@@ -3,9 +3,15 @@
  * \brief Implementation of CTestboard class.
  */
 
+#include "../config.h"
+
+#include <algorithm>
+
 #include "psi46_tb.h"
 #include "constants.h"
+#include "ADCBuffer.h"
 #include "psi/date_time.h"
+#include "interface/TestBoardStatistics.h"
 // --- begin command table -----------------------------------------------
 
 enum TestBoardCommand {
@@ -19,12 +25,21 @@ enum TestBoardCommand {
     CMD_Dummy
 };
 
+static const char* const CommandNames[] = {
+#include "remotecalls_names.inc"
+    "CMD_GetReg41",
+    "CMD_TBMEmulatorOn",
+    "CMD_TBMEmulatorOff",
+    "CMD_Dummy"
+};
+
 // --- end command table -------------------------------------------------
 
 
 #define ESC_EXTENDED 0x8f
 
-#define SEND_COMMAND(x) usb.Write_UCHAR(ESC_EXTENDED); usb.Write_UCHAR(x);
+#define SEND_COMMAND(x) TB_STATISTICS(psi::TestBoardStatistics::Singleton().BeginCommand(x);) \
+    usb.Write_UCHAR(ESC_EXTENDED); usb.Write_UCHAR(x);
 
 #define GET_CHAR(x,ret)        char x; if (!usb.Read_CHAR(x))   return (ret);
 #define GET_CHARS(x,n,max,ret) char x[max]; if (!usb.Read_CHARS(x,n)) return (ret);
@@ -69,9 +84,16 @@ enum TestBoardCommand {
 
 static const psi::Time DEFAULT_DELAY = 50.0 * psi::milli * psi::seconds;
 static const psi::Time RECEIVE_DELAY = 200.0 * psi::milli * psi::seconds;
-static const psi::Time ADC_READ_DELAY = 150.0 * psi::milli * psi::seconds;
+static const unsigned ADC_READ_TIMEOUT = 2000; // ms; the read itself blocks on the FTDI timeout afterwards
 
 namespace CTestboardInternals {
+/// Fixed delay that is accounted to the last command sent.
+static void Wait(CUSB& usb, const psi::Time& delay)
+{
+    usb.Delay(delay);
+    TB_STATISTICS(psi::TestBoardStatistics::Singleton().AddSleepTime(delay / psi::seconds));
+}
+
 template<typename Value>
 struct ConversionFactor {};
 
@@ -115,7 +137,7 @@ static Value ReceiveValue(CTestboard& board, CUSB& usb, TestBoardCommand cmd)
 {
     SEND_COMMAND(cmd)
     board.Flush();
-    psi::Sleep(RECEIVE_DELAY);
+    Wait(usb, RECEIVE_DELAY);
     DeviceValue v = 0;
     usb.Read(v);
     return CTestboardInternals::ValueConverter<Value, DeviceValue>::FromDeviceUnits(v);
@@ -128,6 +150,8 @@ using namespace CTestboardInternals;
 CTestboard::CTestboard()
 {
     TBM_present = false;
+    TB_STATISTICS(psi::TestBoardStatistics::Singleton().SetCommandNames(CommandNames,
+                  sizeof(CommandNames) / sizeof(CommandNames[0]));)
 }
 
 
@@ -257,11 +281,7 @@ void CTestboard::uDelay(unsigned short us)
 void CTestboard::mDelay(unsigned short ms)
 {
     Flush();
-#ifdef _WIN32
-    Sleep(ms);			// Windows
-#else
-    usleep(ms * 1000);	// Linux
-#endif
+    Wait(usb, ms * psi::milli * psi::seconds);
 }
 
 
@@ -552,12 +572,73 @@ bool CTestboard::DataReadRaw(char channel, short buffer[], unsigned short buffer
 }
 
 
+bool CTestboard::DataRead(char channel, ADCBuffer& buffer)
+{
+    const unsigned short buffersize = buffer.Capacity();
+    SEND_COMMAND(CMD_DataRead)
+    PUT_USHORT(buffersize)
+    Flush();
+    buffer.SetSize(0);
+    unsigned char res;
+    if (!usb.Read_UCHAR(res))
+        return false;
+    unsigned short wordsread;
+    if (!usb.Read_USHORT(wordsread))
+        return false;
+    if (wordsread > buffersize) wordsread = buffersize;
+    ReceiveSamples(buffer, wordsread);
+    return res != 0;
+}
+
+
+bool CTestboard::ReceiveSamples(ADCBuffer& buffer, unsigned short count)
+{
+    const unsigned short nStored = count < buffer.Capacity() ? count : buffer.Capacity();
+    const bool ok = ReadSamples(buffer.Data(), nStored, count);
+    buffer.SetSize(ok ? nStored : 0);
+    return ok;
+}
+
+
+// A transport read may return less than requested, so ReadDirect is repeated until it makes no progress.
+bool CTestboard::ReadSamples(short data[], unsigned nStored, unsigned count)
+{
+    const unsigned int bytesToRead = nStored * sizeof(short);
+    unsigned int total = 0;
+    while (total < bytesToRead) {
+        unsigned int bytesRead = 0;
+        const bool ok = usb.ReadDirect(bytesToRead - total, (char*)data + total, bytesRead);
+        total += bytesRead;
+        if (!ok || !bytesRead)
+            break;
+    }
+    if (total != bytesToRead) {
+        const unsigned nRead = total / sizeof(short);
+        psi::LogError() << "ADC readout: only " << nRead << " of " << count << " samples received." << std::endl;
+        DrainSamples(count - nRead);
+        return false;
+    }
+    return DrainSamples(count - nStored);
+}
+
+
+bool CTestboard::DrainSamples(unsigned count)
+{
+    for (unsigned n = 0; n < count; ++n) {
+        short sample;
+        if (!usb.Read_SHORT(sample))
+            return false;
+    }
+    return true;
+}
+
+
 unsigned short CTestboard::GetModRoCnt(unsigned short index)
 {
     SEND_COMMAND(CMD_GetModRoCnt)
     PUT_USHORT(index)
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     GET_USHORT(value, 0)
     return value;
 }
@@ -917,7 +998,7 @@ void CTestboard::MemRead(unsigned int addr, unsigned short size,
     PUT_UINT(addr)
     PUT_USHORT(size)
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     usb.Read_UCHARS(s, size);
 }
 
@@ -1088,7 +1169,7 @@ bool CTestboard::GetPixel(int x)
     sdata[2] = (unsigned char)(x);
     Write(3, sdata);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     Read(1, sdata, bytesRead);
     return sdata[0] != 0;
 }
@@ -1102,7 +1183,7 @@ int CTestboard::FindLevel()
     sdata[1] = 2;
     Write(2, sdata);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     Read(1, sdata, bytesRead);
     return sdata[0];
 }
@@ -1114,7 +1195,7 @@ int CTestboard::AoutLevel(short position, short nTriggers)
     PUT_SHORT(position);
     PUT_SHORT(nTriggers);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     short result;
     usb.Read_SHORT(result);
     return (int)result;
@@ -1127,7 +1208,7 @@ int CTestboard::CountReadouts(int count, int chipId)
     PUT_SHORT(count);
     PUT_SHORT(chipId);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     GET_SHORT(result, -1)
     return result;
 }
@@ -1142,7 +1223,7 @@ int CTestboard::AoutLevelChip(short position, short nTriggers, int trim[], int r
     PUT_SHORT(nTriggers);
     PUT_SHORTS(trimShort, psi::ROCNUMROWS * psi::ROCNUMCOLS);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     short sdata[psi::ROCNUMROWS * psi::ROCNUMCOLS] = {0};
     usb.Read_SHORTS(sdata, psi::ROCNUMROWS * psi::ROCNUMCOLS);
     for (unsigned i = 0; i < psi::ROCNUMROWS * psi::ROCNUMCOLS; i++) res[i] = sdata[i];
@@ -1162,7 +1243,7 @@ int CTestboard::AoutLevelPartOfChip(short position, short nTriggers, int trim[],
     for (unsigned i = 0; i < psi::ROCNUMROWS * psi::ROCNUMCOLS; i++) pxlFlagsShort[i] = (pxlFlags[i] == true) ? 1 : 0;
     PUT_SHORTS(pxlFlagsShort, psi::ROCNUMROWS * psi::ROCNUMCOLS);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     short sdata[psi::ROCNUMROWS * psi::ROCNUMCOLS] = {0};
     usb.Read_SHORTS(sdata, psi::ROCNUMROWS * psi::ROCNUMCOLS);
     for (unsigned i = 0; i < psi::ROCNUMROWS * psi::ROCNUMCOLS; i++) res[i] = sdata[i];
@@ -1178,7 +1259,7 @@ int CTestboard::ChipEfficiency(short nTriggers, int trim[], double res[])
     PUT_SHORT(nTriggers);
     PUT_SHORTS(trimShort, psi::ROCNUMROWS * psi::ROCNUMCOLS);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
 
     short sdata[psi::ROCNUMROWS * psi::ROCNUMCOLS] = {0};
     usb.Read_SHORTS(sdata, psi::ROCNUMROWS * psi::ROCNUMCOLS);
@@ -1194,7 +1275,7 @@ int CTestboard::MaskTest(short nTriggers, short res[])
     SEND_COMMAND(CMD_MaskTest)
     PUT_SHORT(nTriggers);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     usb.Read_SHORTS(res, psi::ROCNUMROWS * psi::ROCNUMCOLS);
     return 1;
 }
@@ -1207,30 +1288,44 @@ void CTestboard::TrimAboveNoise(short nTrigs, short thr, short mode, short resul
     PUT_SHORT(thr);
     PUT_SHORT(mode);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     usb.Read_SHORTS(result, psi::ROCNUMROWS * psi::ROCNUMCOLS);
 }
 
 
-void CTestboard::DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[])
+bool CTestboard::DoubleColumnADCData(int doubleColumn, short data[], unsigned readoutStop[])
 {
+    static const unsigned nPixels = 2 * psi::ROCNUMROWS;
+
     SEND_COMMAND(CMD_DoubleColumnADCData)
     PUT_SHORT(doubleColumn)
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    if (!usb.WaitForData(sizeof(unsigned short), ADC_READ_TIMEOUT)) {
+        psi::LogError() << "Double column " << doubleColumn << " ADC data: no answer from the testboard." << std::endl;
+        return false;
+    }
 
     unsigned short wordsread = 0;
-    if (!usb.Read_USHORT(wordsread)) {
-        wordsread = 0;
-        return;
+    if (!usb.Read_USHORT(wordsread))
+        return false;
+    if (wordsread < nPixels) {
+        psi::LogError() << "Double column " << doubleColumn << " ADC data: only " << wordsread << " words received."
+                        << std::endl;
+        DrainSamples(wordsread);
+        return false;
     }
 
-    psi::Sleep(DEFAULT_DELAY);
-    std::vector<short> sdata(wordsread);
-    usb.Read_SHORTS(sdata.data(), wordsread);
+    // The readout stops are followed by the ADC data, which is received directly into the caller buffer.
+    short stops[nPixels];
+    if (!ReadSamples(stops, nPixels, nPixels)) {
+        DrainSamples(wordsread - nPixels);
+        return false;
+    }
+    for (unsigned i = 0; i < nPixels; i++) readoutStop[i] = stops[i];
 
-    for (unsigned i = 0; i < 2 * psi::ROCNUMROWS; i++) readoutStop[i] = sdata[i];
-    for (unsigned i = 0; i < readoutStop[2 * psi::ROCNUMROWS - 1]; i++) data[i] = sdata[i + 2 * psi::ROCNUMROWS];
+    const unsigned nData = wordsread - nPixels;
+    const unsigned nStored = std::min<unsigned>(readoutStop[nPixels - 1], nData);
+    return ReadSamples(data, nStored, nData);
 }
 
 
@@ -1248,7 +1343,7 @@ int CTestboard::PixelThreshold(int col, int row, int start, int step, int thrLev
     PUT_SHORT(cals);
     PUT_SHORT(trim);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     GET_SHORT(result, 7777)
     return result;
 }
@@ -1268,7 +1363,7 @@ int CTestboard::ChipThreshold(int start, int step, int thrLevel, int nTrig, int
     PUT_SHORT(cals);
     PUT_SHORTS(trimShort, psi::ROCNUMROWS * psi::ROCNUMCOLS);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     short sdata[psi::ROCNUMROWS * psi::ROCNUMCOLS] = {0};
     for (unsigned i = 0; i < psi::ROCNUMROWS * psi::ROCNUMCOLS; i++) sdata[i] = -1;
     bool result = usb.Read_SHORTS(sdata, psi::ROCNUMROWS * psi::ROCNUMCOLS);
@@ -1285,7 +1380,7 @@ int CTestboard::SCurve(int nTrig, int dacReg, int threshold, int res[])
     PUT_INT(dacReg);
     PUT_SHORT((short)threshold);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     short sdata[256] = {0};
     usb.Read_SHORTS(sdata, 256);
 // 	GET_SHORTS(sdata, bytesRead, 256, 0);
@@ -1310,7 +1405,7 @@ int CTestboard::SCurveColumn(int column, int nTrig, int dacReg, int thr[], int t
     PUT_SHORTS(chipIds, 16);
 
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
 
     ReadFPGAData(psi::ROCNUMROWS * 16 * 32, res);
     return 1;
@@ -1323,16 +1418,44 @@ void CTestboard::ADCRead(short buffer[], unsigned short &wordsread, short nTrig)
     SEND_COMMAND(CMD_ADCRead)
     PUT_SHORT(nTrig);
     Flush();
-    psi::Sleep(ADC_READ_DELAY);
-    if (!usb.Read_USHORT(wordsread)) {
+    if (!usb.WaitForData(sizeof(unsigned short), ADC_READ_TIMEOUT) || !usb.Read_USHORT(wordsread)) {
         wordsread = 0;
     }
-    if (wordsread) {
-        usb.Read_SHORTS(buffer, wordsread);
+    if (wordsread && !ReadSamples(buffer, wordsread, wordsread)) {
+        wordsread = 0;
     }
 }
 
 
+bool CTestboard::ADCRead(ADCBuffer& buffer, short nTrig)
+{
+    QueueADCRead(nTrig);
+    Flush();
+    return ReceiveADCRead(buffer);
+}
+
+
+void CTestboard::QueueADCRead(short nTrig)
+{
+    SEND_COMMAND(CMD_ADCRead)
+    PUT_SHORT(nTrig);
+}
+
+
+bool CTestboard::ReceiveADCRead(ADCBuffer& buffer)
+{
+    buffer.SetSize(0);
+    if (!usb.WaitForData(sizeof(unsigned short), ADC_READ_TIMEOUT)) {
+        psi::LogError() << "ADC readout: no answer from the testboard." << std::endl;
+        return false;
+    }
+    unsigned short wordsread;
+    if (!usb.Read_USHORT(wordsread))
+        return false;
+    return ReceiveSamples(buffer, wordsread);
+}
+
+
 void CTestboard::DacDac(int dac1, int dacRange1, int dac2, int dacRange2, int nTrig, int result[])
 {
     SEND_COMMAND(CMD_DacDac)
@@ -1342,7 +1465,7 @@ void CTestboard::DacDac(int dac1, int dacRange1, int dac2, int dacRange2, int nT
     PUT_SHORT(dacRange2);
     PUT_SHORT(nTrig);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     ReadFPGAData(dacRange1 * dacRange2, result);
 }
 
@@ -1355,7 +1478,7 @@ void CTestboard::PHDac(int dac, int dacRange, int nTrig, int position, short res
     PUT_SHORT(nTrig);
     PUT_SHORT(position);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     usb.Read_SHORTS(result, dacRange);
 }
 
@@ -1366,7 +1489,7 @@ void CTestboard::AddressLevels(int position, int result[])
     SEND_COMMAND(CMD_AddressLevels)
     PUT_SHORT(position);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     usb.Read_SHORTS(sdata, 4000);
     for (int i = 0; i < 4000; i++) result[i] = sdata[i];
 }
@@ -1377,7 +1500,7 @@ void CTestboard::TBMAddressLevels(int result[])
     short sdata[4000];
     SEND_COMMAND(CMD_TBMAddressLevels)
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     usb.Read_SHORTS(sdata, 4000);
     for (int i = 0; i < 4000; i++) result[i] = sdata[i];
 }
@@ -1391,7 +1514,7 @@ void CTestboard::ReadData(int position, int size, int result[])
     PUT_INT(position);
     PUT_INT(size);
     Flush();
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     usb.Read_SHORTS(sdata.data(), size);
     for (int i = 0; i < size; i++) result[i] = sdata[i];
 }
@@ -1509,7 +1632,7 @@ void CTestboard::ScanAdac(unsigned short chip, unsigned char dac,
     int count = int(max - min) / step;
     if (count < 0) return;
     if (count > 256) count = 256;
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     usb.Read_UCHARS(res, count);
 }
 
@@ -1526,7 +1649,7 @@ void CTestboard::CdVc(unsigned short chip, unsigned char wbcmin, unsigned char w
     PUT_USHORT(lres)
     Flush();
     unsigned short lres2;
-    psi::Sleep(DEFAULT_DELAY);
+    Wait(usb, DEFAULT_DELAY);
     if(usb.Read_USHORT(lres2)) {
         usb.Read_USHORTS(res, lres2);
     }
@@ -1538,7 +1661,7 @@ char CTestboard::CountAllReadouts(int nTrig, int counts[], int amplitudes[])
     SEND_COMMAND(CMD_CountAllReadouts)
     PUT_SHORT(nTrig);
     Flush();
-    psi::Sleep((100.0 + nTrig * 0.1) * psi::milli * psi::seconds);
+    Wait(usb, (100.0 + nTrig * 0.1) * psi::milli * psi::seconds);
     GET_CHAR(res, -1);
     if(!usb.Read_INTS(counts, 16)) return -1;
     if(!usb.Read_INTS(amplitudes, 16)) return -1;
@@ -9,6 +9,7 @@
 #include "interface/USBInterface.h"
 #include "psi/units.h"
 
+class ADCBuffer;
 
 #define DAC8       256 // Max 8-bit dacs
 
@@ -129,6 +130,15 @@ public:
     bool IsConnected() {
         return usb.Connected();
     }
+    void SetUsbTransport(psi::UsbTransport* transport) {
+        usb.SetTransport(transport);
+    }
+    void RecordUsbTrace(const std::string& traceFileName) {
+        usb.StartRecording(traceFileName);
+    }
+    void ReplayUsbTrace(const std::string& traceFileName, double timeScale) {
+        usb.StartReplay(traceFileName, timeScale);
+    }
     const char * ConnectionError() {
         return usb.GetErrorMsg(usb.GetLastError());
     }
@@ -230,6 +240,7 @@ public:
                   unsigned short &wordsread);
     bool DataReadRaw(char channel, short buffer[], unsigned short buffersize,
                      unsigned short &wordsread);
+    bool DataRead(char channel, ADCBuffer& buffer);
     unsigned short GetModRoCnt(unsigned short index);
     void GetModRoCntAll(unsigned short *counts);
 
@@ -333,6 +344,12 @@ private:
         return usb.Read(bytesToRead, buffer, bytesRead);
     }
 
+    bool ReceiveSamples(ADCBuffer& buffer, unsigned short count);
+    /// Reads nStored of the count announced samples into data and drains the rest. Returns false on a short read.
+    bool ReadSamples(short data[], unsigned nStored, unsigned count);
+    /// Reads and drops count samples, to keep the stream synchronized after an error.
+    bool DrainSamples(unsigned count);
+
     // === old function ==================================================
 public:
     bool Mem_SetAddr(unsigned int addr) {
@@ -417,12 +434,16 @@ public:
     int AoutLevelPartOfChip(short position, short nTriggers, int trims[], int res[], bool pxlFlags[]);
     int ChipEfficiency(short nTriggers, int trim[], double res[]);
     int MaskTest(short nTriggers, short res[]);
-    void DoubleColumnADCData(int column, short data[], unsigned readoutStop[]);
+    bool DoubleColumnADCData(int column, short data[], unsigned readoutStop[]);
     int PixelThreshold(int col, int row, int start, int step, int thrLevel, int nTrig, int dacReg, int xtalk, int cals, int trim);
     int ChipThreshold(int start, int step, int thrLevel, int nTrig, int dacReg, int xtalk, int cals, int trim[], int res[]);
     int SCurve(int nTrig, int dacReg, int threshold, int res[]);
     int SCurveColumn(int column, int nTrig, int dacReg, int thr[], int trims[], int chipId[], int res[]);
     void ADCRead(short buffer[], unsigned short &wordsread, short nTrig);
+    bool ADCRead(ADCBuffer& buffer, short nTrig);
+    /// Queues an ADC readout without sending it. The answers are received in the same order by ReceiveADCRead.
+    void QueueADCRead(short nTrig);
+    bool ReceiveADCRead(ADCBuffer& buffer);
     void DacDac(int dac1, int dacRange1, int dac2, int dacRange2, int nTrig, int result[]);
     void PHDac(int dac, int dacRange, int nTrig, int position, short result[]);
     void AddressLevels(int position, int result[]);
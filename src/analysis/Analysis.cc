@@ -4,49 +4,53 @@
  */
 
 #include <sstream>
+#include <vector>
 
+#include "psi/exception.h"
 #include "Analysis.h"
-#include <TMath.h>
 #include "data/HistogramNameProvider.h"
 #include "BasePixel/constants.h"
 
+namespace {
+const unsigned NumberOfPixels = psi::ROCNUMCOLS * psi::ROCNUMROWS;
+const unsigned NumberOfDacValues = 256;
+}
+
 // -- Computes the differences of two maps and fills the result in a 1D histogram
 TH1D* Analysis::TrimBitTest(TH2D *calMap, TH2D *trimMap, const std::string& histoName)
 {
-    TH1D *histo = new TH1D(histoName.c_str(), histoName.c_str(), 260, 0., 260.);
-    for (unsigned iCol = 0; iCol < psi::ROCNUMCOLS; iCol++) {
-        for (unsigned iRow = 0; iRow < psi::ROCNUMROWS; iRow++) {
-            Float_t difference = calMap->GetBinContent(iCol + 1, iRow + 1) - trimMap->GetBinContent(iCol + 1, iRow + 1);
-            histo->Fill(difference);
-        }
-    }
-    return histo;
+    std::vector<double> calValues(NumberOfPixels), trimValues(NumberOfPixels), difference(NumberOfPixels);
+    ToArray(calMap, calValues.data());
+    ToArray(trimMap, trimValues.data());
+    psi::analysis::Difference(calValues.data(), trimValues.data(), difference.data(), NumberOfPixels);
+    return ToHistogram(psi::analysis::MakeDistribution(difference.data(), NumberOfPixels, 260, 0., 260.), histoName);
 }
 
 // -- Computes the difference map of two maps
 TH2D* Analysis::DifferenceMap(TH2D *map1, TH2D *map2, const std::string &mapName)
 {
-    TH2D *differenceMap = new TH2D(mapName.c_str(), mapName.c_str(), psi::ROCNUMCOLS, 0., psi::ROCNUMCOLS,
-                                   psi::ROCNUMROWS, 0., psi::ROCNUMROWS);
-    for (unsigned iCol = 0; iCol < psi::ROCNUMCOLS; iCol++) {
-        for (unsigned iRow = 0; iRow < psi::ROCNUMROWS; iRow++) {
-            Float_t difference = map1->GetBinContent(iCol + 1, iRow + 1) - map2->GetBinContent(iCol + 1, iRow + 1);
-            differenceMap->SetBinContent(iCol + 1, iRow + 1, difference);
-        }
-    }
-    return differenceMap;
+    std::vector<double> values1(NumberOfPixels), values2(NumberOfPixels), difference(NumberOfPixels);
+    ToArray(map1, values1.data());
+    ToArray(map2, values2.data());
+    psi::analysis::Difference(values1.data(), values2.data(), difference.data(), NumberOfPixels);
+    return ToMap(difference.data(), mapName);
 }
 
 // -- Computes the sum map of three maps
 TH2D* Analysis::SumVthrVcal(TH2D *map1, TH2D *map2, TH2D *map3, const std::string &mapName)
 {
-    TH2D *sumMap = new TH2D(mapName.c_str(), mapName.c_str(), 256, 0., 255., 256, 0., 255.);
-    for (int i = 0; i < 256; i++) {
-        for (int k = 0; k < 256; k++) {
-            Float_t sum = map1->GetBinContent(i + 1, k + 1) + map2->GetBinContent(i + 1, k + 1)
-                    + map3->GetBinContent(i + 1, k + 1);
-            sumMap->SetBinContent(i + 1, k + 1, sum);
-        }
+    static const unsigned size = NumberOfDacValues * NumberOfDacValues;
+    std::vector<double> values1(size), values2(size), values3(size), sum(size);
+    ToArray(map1, values1.data(), NumberOfDacValues, NumberOfDacValues);
+    ToArray(map2, values2.data(), NumberOfDacValues, NumberOfDacValues);
+    ToArray(map3, values3.data(), NumberOfDacValues, NumberOfDacValues);
+    psi::analysis::Sum(values1.data(), values2.data(), values3.data(), sum.data(), size);
+
+    TH2D *sumMap = new TH2D(mapName.c_str(), mapName.c_str(), NumberOfDacValues, 0., 255., NumberOfDacValues, 0.,
+                            255.);
+    for (unsigned i = 0; i < NumberOfDacValues; i++) {
+        for (unsigned k = 0; k < NumberOfDacValues; k++)
+            sumMap->SetBinContent(i + 1, k + 1, sum[i * NumberOfDacValues + k]);
     }
     return sumMap;
 }
@@ -54,28 +58,104 @@ TH2D* Analysis::SumVthrVcal(TH2D *map1, TH2D *map2, TH2D *map3, const std::strin
 // -- Fills a 1D histogram with the data of a map
 TH1D* Analysis::Distribution(TH2D *map, int nBins, double lowerEdge, double upperEdge, unsigned id)
 {
+    std::vector<double> values(NumberOfPixels);
+    ToArray(map, values.data());
     const std::string name = psi::data::HistogramNameProvider::DistributionName(map->GetName(), id);
-    TH1D *histo = new TH1D(name.c_str(), name.c_str(), nBins, lowerEdge, upperEdge);
-    for (unsigned iCol = 0; iCol < psi::ROCNUMCOLS; iCol++) {
-        for (unsigned iRow = 0; iRow < psi::ROCNUMROWS; iRow++) {
-            histo->Fill(map->GetBinContent(iCol + 1, iRow + 1));
-        }
-    }
-    return histo;
+    return ToHistogram(psi::analysis::MakeDistribution(values.data(), NumberOfPixels, nBins, lowerEdge, upperEdge), name);
 }
 
 // -- Fills a 1D histogram with the data of a map, the range of the 1D histogram is computed automatically
 TH1D* Analysis::Distribution(TH2D *map, unsigned id)
 {
-    double lowerEdge = TMath::Floor(map->GetMinimum()) - 5;
-    double upperEdge = TMath::Floor(map->GetMaximum()) + 5;
-    int nBins = (int)(upperEdge - lowerEdge);
+    std::vector<double> values(NumberOfPixels);
+    ToArray(map, values.data());
     const std::string name = psi::data::HistogramNameProvider::DistributionName(map->GetName(), id);
-    TH1D *histo = new TH1D(name.c_str(), name.c_str(), nBins, lowerEdge, upperEdge);
+    return ToHistogram(psi::analysis::MakeDistribution(values.data(), NumberOfPixels), name);
+}
+
+// -- Computes the difference map of two pixel maps
+psi::analysis::PixelMap Analysis::DifferenceMap(const psi::analysis::PixelMap& map1,
+                                                const psi::analysis::PixelMap& map2, const std::string& mapName)
+{
+    return psi::analysis::Difference(map1, map2, mapName);
+}
+
+// -- Fills a 1D histogram with the unmasked values of a pixel map
+TH1D* Analysis::Distribution(const psi::analysis::PixelMap& map, int nBins, double lowerEdge, double upperEdge,
+                             unsigned id)
+{
+    const std::string name = psi::data::HistogramNameProvider::DistributionName(map.Name(), id);
+    return ToHistogram(map.MakeDistribution(nBins, lowerEdge, upperEdge), name);
+}
+
+TH1D* Analysis::Distribution(const psi::analysis::PixelMap& map, unsigned id)
+{
+    const std::string name = psi::data::HistogramNameProvider::DistributionName(map.Name(), id);
+    return ToHistogram(map.MakeDistribution(), name);
+}
+
+// -- Reads the bin contents directly from the histogram storage, which has an underflow and an overflow bin on
+// -- each axis: bin (x, y) is stored at x + (nBinsX + 2) * y.
+void Analysis::ToArray(const TH2D *map, double *values, unsigned nCols, unsigned nRows)
+{
+    if (map->GetNbinsX() < static_cast<int>(nCols) || map->GetNbinsY() < static_cast<int>(nRows))
+        THROW_PSI_EXCEPTION("Map '" << map->GetName() << "' with " << map->GetNbinsX() << "x" << map->GetNbinsY()
+                            << " bins is smaller than the requested " << nCols << "x" << nRows << " values.");
+    const Double_t *contents = map->GetArray();
+    const unsigned stride = map->GetNbinsX() + 2;
+    for (unsigned iCol = 0; iCol < nCols; iCol++) {
+        for (unsigned iRow = 0; iRow < nRows; iRow++)
+            values[iCol * nRows + iRow] = contents[(iCol + 1) + stride * (iRow + 1)];
+    }
+}
+
+void Analysis::ToArray(const TH2D *map, double *values)
+{
+    ToArray(map, values, psi::ROCNUMCOLS, psi::ROCNUMROWS);
+}
+
+TH2D* Analysis::ToMap(const double *values, const std::string& mapName)
+{
+    TH2D *map = new TH2D(mapName.c_str(), mapName.c_str(), psi::ROCNUMCOLS, 0., psi::ROCNUMCOLS,
+                         psi::ROCNUMROWS, 0., psi::ROCNUMROWS);
     for (unsigned iCol = 0; iCol < psi::ROCNUMCOLS; iCol++) {
-        for (unsigned iRow = 0; iRow < psi::ROCNUMROWS; iRow++) {
-            histo->Fill(map->GetBinContent(iCol + 1, iRow + 1));
-        }
+        for (unsigned iRow = 0; iRow < psi::ROCNUMROWS; iRow++)
+            map->SetBinContent(iCol + 1, iRow + 1, values[iCol * psi::ROCNUMROWS + iRow]);
+    }
+    return map;
+}
+
+// -- Writes the bin contents directly into the histogram storage, see ToArray for the layout
+TH2D* Analysis::ToMap(const psi::analysis::PixelMap& map)
+{
+    const unsigned nCols = map.NumberOfColumns(), nRows = map.NumberOfRows();
+    TH2D *histo = new TH2D(map.Name().c_str(), map.Name().c_str(), nCols, 0., nCols, nRows, 0., nRows);
+    Double_t *contents = histo->GetArray();
+    const unsigned stride = nCols + 2;
+    for (unsigned iCol = 0; iCol < nCols; iCol++) {
+        for (unsigned iRow = 0; iRow < nRows; iRow++)
+            contents[(iCol + 1) + stride * (iRow + 1)] = map(iCol, iRow);
     }
+    histo->SetEntries(map.Size());
+    return histo;
+}
+
+psi::analysis::PixelMap Analysis::ToPixelMap(const TH2D *map)
+{
+    psi::analysis::PixelMap pixelMap(map->GetName(), map->GetNbinsX(), map->GetNbinsY());
+    ToArray(map, pixelMap.Data(), pixelMap.NumberOfColumns(), pixelMap.NumberOfRows());
+    return pixelMap;
+}
+
+// -- Creates a 1D histogram with the same contents and statistics as if it was filled value by value
+TH1D* Analysis::ToHistogram(const psi::analysis::Distribution& distribution, const std::string& histoName)
+{
+    TH1D *histo = new TH1D(histoName.c_str(), histoName.c_str(), distribution.NumberOfBins(),
+                           distribution.lowerEdge, distribution.upperEdge);
+    for (unsigned bin = 0; bin < distribution.binContents.size(); bin++)
+        histo->SetBinContent(bin, distribution.binContents[bin]);
+    Double_t stats[] = { distribution.sumw, distribution.sumw2, distribution.sumwx, distribution.sumwx2 };
+    histo->PutStats(stats);
+    histo->SetEntries(distribution.entries);
     return histo;
 }
@@ -8,8 +8,14 @@
 #include <TH2D.h>
 #include <TH1D.h>
 
+#include "MapKernels.h"
+#include "PixelMap.h"
+
 /*!
  * \brief Utilities to analyse histograms
+ *
+ * The computations are done by the ROOT-free kernels from MapKernels.h on contiguous arrays; ROOT histograms are
+ * only read once on input and created once on output.
  */
 class Analysis {
 public:
@@ -18,6 +24,19 @@ public:
     static TH2D* SumVthrVcal(TH2D *map1, TH2D *map2, TH2D *map3, const std::string& mapName);
     static TH1D* Distribution(TH2D *map, int nBins, double lowerEdge, double upperEdge, unsigned id = 0);
     static TH1D* Distribution(TH2D *map, unsigned id = 0);
+    static psi::analysis::PixelMap DifferenceMap(const psi::analysis::PixelMap& map1,
+                                                 const psi::analysis::PixelMap& map2, const std::string& mapName);
+    static TH1D* Distribution(const psi::analysis::PixelMap& map, int nBins, double lowerEdge, double upperEdge,
+                              unsigned id = 0);
+    static TH1D* Distribution(const psi::analysis::PixelMap& map, unsigned id = 0);
+
+    /// Copies the first nCols x nRows bins of the map into a column-major array.
+    static void ToArray(const TH2D *map, double *values, unsigned nCols, unsigned nRows);
+    static void ToArray(const TH2D *map, double *values);
+    static TH2D* ToMap(const double *values, const std::string& mapName);
+    static TH2D* ToMap(const psi::analysis::PixelMap& map);
+    static psi::analysis::PixelMap ToPixelMap(const TH2D *map);
+    static TH1D* ToHistogram(const psi::analysis::Distribution& distribution, const std::string& histoName);
 private:
     Analysis() {}
 };
@@ -0,0 +1,178 @@
+/*!
+ * \file LevelFinder.cc
+ * \brief Implementation of LevelFinder class.
+ */
+
+#include <algorithm>
+#include <unistd.h>
+
+#include "psi/exception.h"
+#include "LevelFinder.h"
+
+namespace psi {
+namespace analysis {
+
+LevelHistograms::LevelHistograms(unsigned _nChannels, unsigned _nBins, double _min, double _max)
+    : nChannels(_nChannels), nBins(_nBins), min(_min), scale(0), counts(_nChannels * _nBins, 0.),
+      entries(_nChannels, 0.)
+{
+    if(!nBins || !(_max > _min))
+        THROW_PSI_EXCEPTION("Invalid level histogram range [" << _min << ", " << _max << ") with " << nBins
+                            << " bins.");
+    scale = nBins / (_max - _min);
+}
+
+void LevelHistograms::SetChannel(unsigned channel, const int* content)
+{
+    double* bins = &counts.at(channel * nBins);
+    double sum = 0;
+    for(unsigned b = 0; b < nBins; ++b) {
+        bins[b] = std::max(content[b], 0);
+        sum += bins[b];
+    }
+    entries[channel] = sum;
+}
+
+bool LevelHistograms::SameBinning(const LevelHistograms& other) const
+{
+    return nChannels == other.nChannels && nBins == other.nBins && min == other.min && scale == other.scale;
+}
+
+void LevelHistograms::Add(const LevelHistograms& other)
+{
+    if(!SameBinning(other))
+        THROW_PSI_EXCEPTION("Level histograms with different binnings can not be added.");
+    const size_t size = counts.size();
+    double* sums = counts.data();
+    const double* values = other.counts.data();
+    for(size_t n = 0; n < size; ++n)
+        sums[n] += values[n];
+    for(unsigned channel = 0; channel < nChannels; ++channel)
+        entries[channel] += other.entries[channel];
+}
+
+void LevelHistograms::Reset()
+{
+    std::fill(counts.begin(), counts.end(), 0.);
+    std::fill(entries.begin(), entries.end(), 0.);
+}
+
+void MergeClosestPeaks(std::vector<double>& peaks, size_t nPeaks)
+{
+    while(nPeaks && peaks.size() > nPeaks) {
+        size_t m = 0;
+        for(size_t n = 1; n + 1 < peaks.size(); ++n) {
+            if(peaks[n + 1] - peaks[n] < peaks[m + 1] - peaks[m])
+                m = n;
+        }
+        peaks[m] = (peaks[m] + peaks[m + 1]) / 2;
+        peaks.erase(peaks.begin() + m + 1);
+    }
+}
+
+LevelFinder::LevelFinder(unsigned nChannels, unsigned nBins, double min, double max)
+    : histograms(nChannels, nBins, min, max), searches(nChannels), levels(nChannels), complete(nChannels, 0),
+      searchedEntries(nChannels, 0.)
+{
+    pthread_mutex_init(&mutex, NULL);
+}
+
+LevelFinder::~LevelFinder()
+{
+    pthread_mutex_destroy(&mutex);
+}
+
+LevelHistograms LevelFinder::MakeAccumulator() const
+{
+    const double min = histograms.Min();
+    const double max = min + histograms.NumberOfBins() * histograms.BinWidth();
+    return LevelHistograms(histograms.NumberOfChannels(), histograms.NumberOfBins(), min, max);
+}
+
+void LevelFinder::Add(const LevelHistograms& accumulator)
+{
+    pthread_mutex_lock(&mutex);
+    try {
+        histograms.Add(accumulator);
+    } catch(...) {
+        pthread_mutex_unlock(&mutex);
+        throw;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+unsigned LevelFinder::Update(unsigned nThreads, double minNewEntries)
+{
+    pthread_mutex_lock(&mutex);
+    std::vector<unsigned> channels;
+    for(unsigned channel = 0; channel < histograms.NumberOfChannels(); ++channel) {
+        if(histograms.Entries(channel) - searchedEntries[channel] >= minNewEntries)
+            channels.push_back(channel);
+    }
+
+    if(!nThreads) {
+        const long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+        nThreads = nProcessors > 0 ? nProcessors : 1;
+    }
+    nThreads = std::min<size_t>(nThreads, channels.size());
+
+    if(nThreads <= 1) {
+        for(size_t n = 0; n < channels.size(); ++n)
+            Search(channels[n]);
+    } else {
+        std::vector<Worker> workers(nThreads);
+        for(size_t n = 0; n < channels.size(); ++n)
+            workers[n % nThreads].channels.push_back(channels[n]);
+        for(unsigned n = 0; n < nThreads; ++n) {
+            workers[n].finder = this;
+            workers[n].started = pthread_create(&workers[n].thread, NULL, LevelFinder::RunWorker, &workers[n]) == 0;
+            if(!workers[n].started)
+                RunWorker(&workers[n]);
+        }
+        for(unsigned n = 0; n < nThreads; ++n) {
+            if(workers[n].started)
+                pthread_join(workers[n].thread, NULL);
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return channels.size();
+}
+
+void LevelFinder::UpdateChannel(unsigned channel)
+{
+    if(channel >= histograms.NumberOfChannels())
+        THROW_PSI_EXCEPTION("Invalid level channel " << channel << ".");
+    pthread_mutex_lock(&mutex);
+    Search(channel);
+    pthread_mutex_unlock(&mutex);
+}
+
+void* LevelFinder::RunWorker(void* worker)
+{
+    Worker* w = static_cast<Worker*>(worker);
+    for(size_t n = 0; n < w->channels.size(); ++n)
+        w->finder->Search(w->channels[n]);
+    return NULL;
+}
+
+// Each channel writes only its own elements of levels, complete and searchedEntries.
+void LevelFinder::Search(unsigned channel)
+{
+    const LevelSearch& search = searches[channel];
+    const double* content = histograms.Content(channel);
+    const unsigned nBins = histograms.NumberOfBins();
+    std::vector<double>& peaks = levels[channel];
+    bool fits = true;
+    if(search.algorithm == ZonePeaks)
+        fits = FindPeaksByZones(content, nBins, histograms.Min(), histograms.BinWidth(), search.integralLimit,
+                                search.nPeaks, peaks);
+    else {
+        FindPeaksByClustering(content, nBins, histograms.Min(), histograms.BinWidth(), peaks);
+        MergeClosestPeaks(peaks, search.nPeaks);
+    }
+    complete[channel] = fits && (!search.nPeaks || peaks.size() == search.nPeaks);
+    searchedEntries[channel] = histograms.Entries(channel);
+}
+
+} // analysis
+} // psi
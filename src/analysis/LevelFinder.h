@@ -0,0 +1,199 @@
+/*!
+ * \file LevelFinder.h
+ * \brief Definition of LevelFinder class.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <cstddef>
+#include <vector>
+
+namespace psi {
+namespace analysis {
+
+/*!
+ * \brief ADC histograms with uniform bins for a set of readout channels, e.g. the TBM and every ROC of a module.
+ *
+ * The bins of all channels are kept in one contiguous array, so filling a hit of any channel touches a single counter.
+ * Values outside of [min, max) are ignored. Histograms with the same binning can be merged, which allows each reading
+ * thread to fill a private accumulator and hand it over to the LevelFinder at the end.
+ */
+class LevelHistograms {
+public:
+    LevelHistograms(unsigned _nChannels, unsigned _nBins, double _min, double _max);
+
+    void Fill(unsigned channel, double value)
+    {
+        const double x = (value - min) * scale;
+        if(x < 0 || x >= nBins)
+            return;
+        ++counts[channel * nBins + static_cast<unsigned>(x)];
+        ++entries[channel];
+    }
+
+    /// Replaces the content of the channel by nBins values, e.g. a histogram made by the testboard.
+    void SetChannel(unsigned channel, const int* content);
+    void Add(const LevelHistograms& other);
+    void Reset();
+    bool SameBinning(const LevelHistograms& other) const;
+
+    unsigned NumberOfChannels() const { return nChannels; }
+    unsigned NumberOfBins() const { return nBins; }
+    double Min() const { return min; }
+    double BinWidth() const { return 1. / scale; }
+    const double* Content(unsigned channel) const { return &counts.at(channel * nBins); }
+    double Entries(unsigned channel) const { return entries.at(channel); }
+
+private:
+    unsigned nChannels, nBins;
+    double min, scale;
+    std::vector<double> counts, entries;
+};
+
+/*!
+ * Peak search by bin clustering: neighbouring bins above 1% of the maximum (plus one entry) form a peak, gaps of up
+ * to three bins are allowed within a peak. Peak positions are the content weighted means of the bin centers.
+ */
+template<typename T>
+void FindPeaksByClustering(const T* content, unsigned nBins, double min, double binWidth, std::vector<double>& peaks)
+{
+    static const unsigned nMiss = 3;
+    double maximum = 0;
+    for(unsigned b = 0; b < nBins; ++b) {
+        if(content[b] > maximum)
+            maximum = content[b];
+    }
+    const double threshold = maximum / 100. + 1;
+    unsigned nLow = nMiss + 1;
+    double sum = 0, sumX = 0;
+    peaks.clear();
+    for(unsigned b = 0; b < nBins; ++b) {
+        if(content[b] > threshold) {
+            if(nLow > nMiss) {
+                sum = sumX = 0;
+                peaks.push_back(0);
+            }
+            sum += content[b];
+            sumX += (min + (b + 0.5) * binWidth) * content[b];
+            peaks.back() = sumX / sum;
+            nLow = 0;
+        } else
+            ++nLow;
+    }
+}
+
+/*!
+ * Peak search by zones, the algorithm used for the testboard address level histograms: a peak starts at the first
+ * non-empty bin where the next 10 bins hold more than integralLimit entries and ends at the first empty bin where the
+ * next 15 bins hold less than integralLimit entries. Peak positions are the middles of the zones. At most maxPeaks
+ * peaks are searched; returns false if the histogram has more.
+ */
+template<typename T>
+bool FindPeaksByZones(const T* content, unsigned nBins, double min, double binWidth, double integralLimit,
+                      unsigned maxPeaks, std::vector<double>& peaks)
+{
+    static const unsigned startWindow = 10, stopWindow = 15;
+    bool zeroZone = true;
+    double start = min;
+    peaks.clear();
+    for(unsigned b = 0; b < nBins; ++b) {
+        const unsigned window = zeroZone ? startWindow : stopWindow;
+        double integral = 0;
+        for(unsigned k = b; k < b + window && k < nBins; ++k)
+            integral += content[k];
+        const double edge = min + b * binWidth;
+        if(zeroZone && content[b] > 0 && integral > integralLimit) {
+            start = edge;
+            zeroZone = false;
+        } else if(!zeroZone && content[b] == 0 && integral < integralLimit) {
+            if(peaks.size() == maxPeaks)
+                return false;
+            peaks.push_back((start + edge) / 2);
+            zeroZone = true;
+        }
+    }
+    return true;
+}
+
+/// Merges the two closest peaks into one at their middle until at most nPeaks are left.
+void MergeClosestPeaks(std::vector<double>& peaks, size_t nPeaks);
+
+enum PeakAlgorithm { ClusteringPeaks, ZonePeaks };
+
+/// Settings of the peak search for one channel.
+struct LevelSearch {
+    PeakAlgorithm algorithm;
+    /// Clustering: the closest peaks are merged down to this number. Zones: the maximal number of peaks.
+    unsigned nPeaks;
+    /// Zones only, see FindPeaksByZones.
+    double integralLimit;
+
+    LevelSearch(PeakAlgorithm _algorithm = ClusteringPeaks, unsigned _nPeaks = 0, double _integralLimit = 0)
+        : algorithm(_algorithm), nPeaks(_nPeaks), integralLimit(_integralLimit) {}
+};
+
+/*!
+ * \brief Finds the analog readout levels of several channels at once.
+ *
+ * The histograms of all channels are filled in a single pass over the data, either directly through Histograms() by
+ * the reading thread or through private accumulators made by MakeAccumulator() and merged with Add(), which may be
+ * called from several threads. The peak search of the channels is independent, so Update() runs it for all channels
+ * in parallel on worker threads.
+ *
+ * The levels can be refined while the data is still streaming in: Update() searches again only in the channels that
+ * received at least minNewEntries entries since their previous search and keeps the earlier result for all others.
+ */
+class LevelFinder {
+public:
+    LevelFinder(unsigned nChannels, unsigned nBins, double min, double max);
+    ~LevelFinder();
+
+    void SetSearch(unsigned channel, const LevelSearch& search) { searches.at(channel) = search; }
+
+    LevelHistograms& Histograms() { return histograms; }
+    const LevelHistograms& Histograms() const { return histograms; }
+    LevelHistograms MakeAccumulator() const;
+    void Add(const LevelHistograms& accumulator);
+
+    /*!
+     * Runs the peak search of all channels with at least minNewEntries new entries on nThreads worker threads, or on
+     * one thread per processor if nThreads is 0. Returns the number of searched channels. If a worker thread can not
+     * be started, its channels are searched by the calling thread.
+     */
+    unsigned Update(unsigned nThreads = 0, double minNewEntries = 1);
+
+    /// Runs the peak search of a single channel in the calling thread.
+    void UpdateChannel(unsigned channel);
+
+    /// Peak positions found by the last search of the channel, in increasing order.
+    const std::vector<double>& Levels(unsigned channel) const { return levels.at(channel); }
+    /// True if the last search of the channel found exactly the requested number of peaks.
+    bool Complete(unsigned channel) const { return complete.at(channel) != 0; }
+
+private:
+    struct Worker {
+        LevelFinder* finder;
+        std::vector<unsigned> channels;
+        pthread_t thread;
+        bool started;
+    };
+
+    static void* RunWorker(void* worker);
+    void Search(unsigned channel);
+
+private:
+    LevelFinder(const LevelFinder&);
+    LevelFinder& operator=(const LevelFinder&);
+
+private:
+    pthread_mutex_t mutex;
+    LevelHistograms histograms;
+    std::vector<LevelSearch> searches;
+    std::vector< std::vector<double> > levels;
+    std::vector<char> complete;
+    std::vector<double> searchedEntries;
+};
+
+} // analysis
+} // psi
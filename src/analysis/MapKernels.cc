@@ -0,0 +1,121 @@
+/*!
+ * \file MapKernels.cc
+ * \brief Implementation of ROOT-free kernels to analyse pixel maps stored as contiguous arrays.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "MapKernels.h"
+
+namespace {
+const size_t NumberOfLanes = 4;
+}
+
+namespace psi {
+namespace analysis {
+
+MapStatistics Statistics(const double* values, size_t n)
+{
+    MapStatistics result;
+    if(!n) return result;
+
+    double sum[NumberOfLanes] = { 0, 0, 0, 0 }, sum2[NumberOfLanes] = { 0, 0, 0, 0 };
+    double minimum[NumberOfLanes], maximum[NumberOfLanes];
+    std::fill(minimum, minimum + NumberOfLanes, values[0]);
+    std::fill(maximum, maximum + NumberOfLanes, values[0]);
+
+    const size_t nBlocks = n / NumberOfLanes * NumberOfLanes;
+    for(size_t k = 0; k < nBlocks; k += NumberOfLanes) {
+        for(size_t lane = 0; lane < NumberOfLanes; ++lane) {
+            const double x = values[k + lane];
+            sum[lane] += x;
+            sum2[lane] += x * x;
+            minimum[lane] = x < minimum[lane] ? x : minimum[lane];
+            maximum[lane] = x > maximum[lane] ? x : maximum[lane];
+        }
+    }
+    for(size_t k = nBlocks; k < n; ++k) {
+        const double x = values[k];
+        sum[0] += x;
+        sum2[0] += x * x;
+        minimum[0] = std::min(minimum[0], x);
+        maximum[0] = std::max(maximum[0], x);
+    }
+
+    double totalSum = 0, totalSum2 = 0;
+    result.min = minimum[0];
+    result.max = maximum[0];
+    for(size_t lane = 0; lane < NumberOfLanes; ++lane) {
+        totalSum += sum[lane];
+        totalSum2 += sum2[lane];
+        result.min = std::min(result.min, minimum[lane]);
+        result.max = std::max(result.max, maximum[lane]);
+    }
+    result.n = n;
+    result.mean = totalSum / n;
+    result.rms = std::sqrt(std::max(0., totalSum2 / n - result.mean * result.mean));
+    return result;
+}
+
+void Difference(const double* __restrict__ first, const double* __restrict__ second, double* __restrict__ result,
+                size_t n)
+{
+    for(size_t k = 0; k < n; ++k)
+        result[k] = first[k] - second[k];
+}
+
+void Sum(const double* __restrict__ first, const double* __restrict__ second, const double* __restrict__ third,
+         double* __restrict__ result, size_t n)
+{
+    for(size_t k = 0; k < n; ++k)
+        result[k] = first[k] + second[k] + third[k];
+}
+
+// Bin numbering follows TAxis::FindBin: 0 is the underflow and nBins + 1 is the overflow.
+void Fill(Distribution& distribution, const double* values, size_t n)
+{
+    const unsigned nBins = distribution.NumberOfBins();
+    const double lowerEdge = distribution.lowerEdge, upperEdge = distribution.upperEdge;
+    const double scale = nBins / (upperEdge - lowerEdge);
+    double* contents = distribution.binContents.data();
+    double sumw = 0, sumwx = 0, sumwx2 = 0;
+    for(size_t k = 0; k < n; ++k) {
+        const double x = values[k];
+        unsigned bin;
+        if(x < lowerEdge)
+            bin = 0;
+        else if(!(x < upperEdge))
+            bin = nBins + 1;
+        else {
+            bin = 1 + static_cast<unsigned>(scale * (x - lowerEdge));
+            sumw += 1;
+            sumwx += x;
+            sumwx2 += x * x;
+        }
+        contents[bin] += 1;
+    }
+    distribution.entries += n;
+    distribution.sumw += sumw;
+    distribution.sumw2 += sumw;
+    distribution.sumwx += sumwx;
+    distribution.sumwx2 += sumwx2;
+}
+
+Distribution MakeDistribution(const double* values, size_t n, unsigned nBins, double lowerEdge, double upperEdge)
+{
+    Distribution distribution(nBins, lowerEdge, upperEdge);
+    Fill(distribution, values, n);
+    return distribution;
+}
+
+Distribution MakeDistribution(const double* values, size_t n)
+{
+    const MapStatistics statistics = Statistics(values, n);
+    const double lowerEdge = std::floor(statistics.min) - 5;
+    const double upperEdge = std::floor(statistics.max) + 5;
+    return MakeDistribution(values, n, static_cast<unsigned>(upperEdge - lowerEdge), lowerEdge, upperEdge);
+}
+
+} // analysis
+} // psi
@@ -0,0 +1,49 @@
+/*!
+ * \file MapKernels.h
+ * \brief Definition of ROOT-free kernels to analyse pixel maps stored as contiguous arrays.
+ *
+ * Maps are stored column-major (index = column * nRows + row), the same layout as returned by
+ * TBAnalogInterface::ChipThreshold. The loops are written with independent accumulators and without aliasing
+ * between inputs and outputs, so the compiler can vectorize them.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace psi {
+namespace analysis {
+
+struct MapStatistics {
+    size_t n;
+    double mean, rms, min, max;
+    MapStatistics() : n(0), mean(0), rms(0), min(0), max(0) {}
+};
+
+/*!
+ * \brief Result of filling values into a histogram with uniform binning.
+ *
+ * binContents has nBins + 2 entries: underflow, nBins regular bins and overflow, as in ROOT.
+ * The statistics sums include only values inside the histogram range, as TH1::Fill does by default.
+ */
+struct Distribution {
+    double lowerEdge, upperEdge;
+    std::vector<double> binContents;
+    size_t entries;
+    double sumw, sumw2, sumwx, sumwx2;
+    Distribution(unsigned nBins, double _lowerEdge, double _upperEdge)
+        : lowerEdge(_lowerEdge), upperEdge(_upperEdge), binContents(nBins + 2, 0.), entries(0),
+          sumw(0), sumw2(0), sumwx(0), sumwx2(0) {}
+    unsigned NumberOfBins() const { return binContents.size() - 2; }
+};
+
+MapStatistics Statistics(const double* values, size_t n);
+void Difference(const double* first, const double* second, double* result, size_t n);
+void Sum(const double* first, const double* second, const double* third, double* result, size_t n);
+void Fill(Distribution& distribution, const double* values, size_t n);
+Distribution MakeDistribution(const double* values, size_t n, unsigned nBins, double lowerEdge, double upperEdge);
+Distribution MakeDistribution(const double* values, size_t n);
+
+} // analysis
+} // psi
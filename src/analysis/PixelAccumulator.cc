@@ -0,0 +1,145 @@
+/*!
+ * \file PixelAccumulator.cc
+ * \brief Implementation of PixelAccumulator class.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "psi/exception.h"
+#include "PixelAccumulator.h"
+
+namespace psi {
+namespace analysis {
+
+PixelAccumulator::PixelAccumulator(size_t _nPixels)
+    : nPixels(_nPixels), count(0), mean(_nPixels, 0.), m2(_nPixels, 0.), minimum(_nPixels, 0.),
+      maximum(_nPixels, 0.), nQuantileBins(0), quantileLowerEdge(0), quantileBinWidth(0) {}
+
+void PixelAccumulator::EnableQuantiles(unsigned nBins, double lowerEdge, double upperEdge)
+{
+    if(count)
+        THROW_PSI_EXCEPTION("Quantiles should be enabled before the first readout is added.");
+    if(!nBins || !(upperEdge > lowerEdge))
+        THROW_PSI_EXCEPTION("Invalid quantile sketch range [" << lowerEdge << ", " << upperEdge << ") with "
+                            << nBins << " bins.");
+    nQuantileBins = nBins;
+    quantileLowerEdge = lowerEdge;
+    quantileBinWidth = (upperEdge - lowerEdge) / nBins;
+    quantileCounts.assign(nPixels * (nBins + 2), 0);
+}
+
+// Bins of the sketch: 0 is the underflow, nQuantileBins + 1 is the overflow.
+void PixelAccumulator::Add(const int* __restrict__ values)
+{
+    ++count;
+    const double weight = 1. / count;
+    double* __restrict__ means = mean.data();
+    double* __restrict__ sums2 = m2.data();
+    double* __restrict__ minima = minimum.data();
+    double* __restrict__ maxima = maximum.data();
+
+    if(count == 1) {
+        for(size_t k = 0; k < nPixels; ++k) {
+            means[k] = minima[k] = maxima[k] = values[k];
+            sums2[k] = 0;
+        }
+    } else {
+        for(size_t k = 0; k < nPixels; ++k) {
+            const double x = values[k];
+            const double delta = x - means[k];
+            means[k] += delta * weight;
+            sums2[k] += delta * (x - means[k]);
+            minima[k] = x < minima[k] ? x : minima[k];
+            maxima[k] = x > maxima[k] ? x : maxima[k];
+        }
+    }
+
+    if(!nQuantileBins) return;
+    const unsigned stride = nQuantileBins + 2;
+    const double scale = 1. / quantileBinWidth;
+    uint32_t* counts = quantileCounts.data();
+    for(size_t k = 0; k < nPixels; ++k) {
+        const double position = (values[k] - quantileLowerEdge) * scale;
+        unsigned bin;
+        if(position < 0)
+            bin = 0;
+        else if(!(position < nQuantileBins))
+            bin = nQuantileBins + 1;
+        else
+            bin = 1 + static_cast<unsigned>(position);
+        ++counts[k * stride + bin];
+    }
+}
+
+double PixelAccumulator::Variance(size_t pixel) const
+{
+    return count > 1 ? m2.at(pixel) / (count - 1) : 0.;
+}
+
+double PixelAccumulator::StandardDeviation(size_t pixel) const
+{
+    return std::sqrt(Variance(pixel));
+}
+
+double PixelAccumulator::Quantile(size_t pixel, double q) const
+{
+    if(!nQuantileBins)
+        THROW_PSI_EXCEPTION("Quantile sketch is not enabled.");
+    if(pixel >= nPixels)
+        THROW_PSI_EXCEPTION("Pixel index " << pixel << " is out of range.");
+    if(!count) return 0.;
+
+    const unsigned stride = nQuantileBins + 2;
+    const uint32_t* counts = quantileCounts.data() + pixel * stride;
+    const double goal = std::min(std::max(q, 0.), 1.) * count;
+    double cumulative = counts[0];
+    if(goal <= cumulative)
+        return quantileLowerEdge;
+    for(unsigned bin = 1; bin <= nQuantileBins; ++bin) {
+        if(goal <= cumulative + counts[bin]) {
+            const double fraction = (goal - cumulative) / counts[bin];
+            return quantileLowerEdge + (bin - 1 + fraction) * quantileBinWidth;
+        }
+        cumulative += counts[bin];
+    }
+    return quantileLowerEdge + nQuantileBins * quantileBinWidth;
+}
+
+void PixelAccumulator::Means(double* values) const
+{
+    std::copy(mean.begin(), mean.end(), values);
+}
+
+void PixelAccumulator::MeanSquares(double* values) const
+{
+    const double scale = count ? 1. / count : 0.;
+    for(size_t k = 0; k < nPixels; ++k)
+        values[k] = mean[k] * mean[k] + m2[k] * scale;
+}
+
+void PixelAccumulator::StandardDeviations(double* values) const
+{
+    const double scale = count > 1 ? 1. / (count - 1) : 0.;
+    for(size_t k = 0; k < nPixels; ++k)
+        values[k] = std::sqrt(m2[k] * scale);
+}
+
+void PixelAccumulator::Mins(double* values) const
+{
+    std::copy(minimum.begin(), minimum.end(), values);
+}
+
+void PixelAccumulator::Maxs(double* values) const
+{
+    std::copy(maximum.begin(), maximum.end(), values);
+}
+
+void PixelAccumulator::Quantiles(double q, double* values) const
+{
+    for(size_t k = 0; k < nPixels; ++k)
+        values[k] = Quantile(k, q);
+}
+
+} // analysis
+} // psi
@@ -0,0 +1,60 @@
+/*!
+ * \file PixelAccumulator.h
+ * \brief Definition of PixelAccumulator class.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+namespace psi {
+namespace analysis {
+
+/*!
+ * \brief Streaming per-pixel statistics of repeated readouts.
+ *
+ * Each call of Add() takes one value for every pixel, in the layout returned by TBAnalogInterface::AoutLevelChip.
+ * Mean and variance are updated with Welford's algorithm, which stays accurate for many readouts; the variance is
+ * the unbiased sample variance. All pixels share the number of readouts, so one update is a single vectorizable loop
+ * over contiguous arrays.
+ *
+ * The optional quantile sketch counts values in uniform bins for each pixel; quantiles are interpolated within a
+ * bin and clamped to the sketch range.
+ */
+class PixelAccumulator {
+public:
+    explicit PixelAccumulator(size_t _nPixels);
+
+    void EnableQuantiles(unsigned nBins, double lowerEdge, double upperEdge);
+    void Add(const int* values);
+
+    size_t NumberOfPixels() const { return nPixels; }
+    size_t Count() const { return count; }
+
+    double Mean(size_t pixel) const { return mean.at(pixel); }
+    double Variance(size_t pixel) const;
+    double StandardDeviation(size_t pixel) const;
+    double Min(size_t pixel) const { return minimum.at(pixel); }
+    double Max(size_t pixel) const { return maximum.at(pixel); }
+    double Quantile(size_t pixel, double q) const;
+
+    /// Per-pixel values written into arrays of NumberOfPixels() elements.
+    void Means(double* values) const;
+    void MeanSquares(double* values) const;
+    void StandardDeviations(double* values) const;
+    void Mins(double* values) const;
+    void Maxs(double* values) const;
+    void Quantiles(double q, double* values) const;
+
+private:
+    size_t nPixels, count;
+    std::vector<double> mean, m2, minimum, maximum;
+    unsigned nQuantileBins;
+    double quantileLowerEdge, quantileBinWidth;
+    std::vector<uint32_t> quantileCounts;
+};
+
+} // analysis
+} // psi
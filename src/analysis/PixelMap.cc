@@ -0,0 +1,164 @@
+/*!
+ * \file PixelMap.cc
+ * \brief Implementation of PixelMap class.
+ */
+
+#include <algorithm>
+
+#include "psi/exception.h"
+#include "BasePixel/constants.h"
+
+#include "PixelMap.h"
+
+namespace psi {
+namespace analysis {
+
+const unsigned PixelMap::ModuleNumberOfColumns;
+const unsigned PixelMap::ModuleNumberOfRows;
+
+PixelMap PixelMap::Roc(const std::string& name, double value)
+{
+    return PixelMap(name, psi::ROCNUMCOLS, psi::ROCNUMROWS, value);
+}
+
+PixelMap PixelMap::Module(const std::string& name, double value)
+{
+    return PixelMap(name, ModuleNumberOfColumns, ModuleNumberOfRows, value);
+}
+
+PixelMap::PixelMap(const std::string& _name, unsigned _nCols, unsigned _nRows, double value)
+    : name(_name), nCols(_nCols), nRows(_nRows), values(_nCols * _nRows, value), nMasked(0)
+{
+}
+
+void PixelMap::SetAll(double value)
+{
+    std::fill(values.begin(), values.end(), value);
+}
+
+void PixelMap::Assign(const double* source)
+{
+    std::copy(source, source + values.size(), values.begin());
+}
+
+PixelMap& PixelMap::operator+=(const PixelMap& other)
+{
+    CheckSameShape(other);
+    double* result = values.data();
+    const double* addend = other.values.data();
+    const size_t n = values.size();
+    for(size_t k = 0; k < n; ++k)
+        result[k] += addend[k];
+    return *this;
+}
+
+PixelMap& PixelMap::operator-=(const PixelMap& other)
+{
+    CheckSameShape(other);
+    double* result = values.data();
+    const double* subtrahend = other.values.data();
+    const size_t n = values.size();
+    for(size_t k = 0; k < n; ++k)
+        result[k] -= subtrahend[k];
+    return *this;
+}
+
+PixelMap& PixelMap::operator*=(double factor)
+{
+    double* result = values.data();
+    const size_t n = values.size();
+    for(size_t k = 0; k < n; ++k)
+        result[k] *= factor;
+    return *this;
+}
+
+void PixelMap::Mask(unsigned col, unsigned row)
+{
+    if(mask.empty())
+        mask.assign(values.size(), 0);
+    unsigned char& flag = mask[Index(col, row)];
+    if(!flag) {
+        flag = 1;
+        ++nMasked;
+    }
+}
+
+void PixelMap::Unmask(unsigned col, unsigned row)
+{
+    if(!nMasked) return;
+    unsigned char& flag = mask[Index(col, row)];
+    if(flag) {
+        flag = 0;
+        --nMasked;
+    }
+}
+
+void PixelMap::ClearMask()
+{
+    mask.clear();
+    nMasked = 0;
+}
+
+MapStatistics PixelMap::Statistics() const
+{
+    std::vector<double> buffer;
+    size_t n;
+    const double* selected = Selected(buffer, n);
+    return psi::analysis::Statistics(selected, n);
+}
+
+Distribution PixelMap::MakeDistribution(unsigned nBins, double lowerEdge, double upperEdge) const
+{
+    std::vector<double> buffer;
+    size_t n;
+    const double* selected = Selected(buffer, n);
+    return psi::analysis::MakeDistribution(selected, n, nBins, lowerEdge, upperEdge);
+}
+
+Distribution PixelMap::MakeDistribution() const
+{
+    std::vector<double> buffer;
+    size_t n;
+    const double* selected = Selected(buffer, n);
+    return psi::analysis::MakeDistribution(selected, n);
+}
+
+void PixelMap::CheckSameShape(const PixelMap& other) const
+{
+    if(other.nCols != nCols || other.nRows != nRows)
+        THROW_PSI_EXCEPTION("Pixel map '" << other.name << "' (" << other.nCols << "x" << other.nRows
+                            << ") does not match map '" << name << "' (" << nCols << "x" << nRows << ").");
+}
+
+// Without masked pixels the values are used in place, otherwise the unmasked ones are packed into the buffer.
+const double* PixelMap::Selected(std::vector<double>& buffer, size_t& n) const
+{
+    if(!nMasked) {
+        n = values.size();
+        return values.data();
+    }
+    buffer.reserve(values.size() - nMasked);
+    for(size_t k = 0; k < values.size(); ++k) {
+        if(!mask[k])
+            buffer.push_back(values[k]);
+    }
+    n = buffer.size();
+    return buffer.data();
+}
+
+PixelMap Difference(const PixelMap& first, const PixelMap& second, const std::string& name)
+{
+    PixelMap result(first);
+    result.SetName(name);
+    result -= second;
+    for(unsigned col = 0; col < second.NumberOfColumns(); ++col) {
+        for(unsigned row = 0; row < second.NumberOfRows(); ++row) {
+            if(second.IsMasked(col, row))
+                result.Mask(col, row);
+        }
+    }
+    return result;
+}
+
+} // analysis
+} // psi
@@ -0,0 +1,84 @@
+/*!
+ * \file PixelMap.h
+ * \brief Definition of PixelMap class.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MapKernels.h"
+
+namespace psi {
+namespace analysis {
+
+/*!
+ * \brief ROOT-free map of per-pixel values.
+ *
+ * Values are stored in one contiguous column-major array (index = column * nRows + row), the layout used by
+ * MapKernels.h, so the element-wise arithmetic runs as plain vectorizable loops. Masked pixels keep their values,
+ * but are excluded from Statistics and MakeDistribution. Tests convert maps to TH2D only when they are saved.
+ */
+class PixelMap {
+public:
+    static const unsigned ModuleNumberOfColumns = 416;
+    static const unsigned ModuleNumberOfRows = 160;
+
+    /// Map of a single ROC, 52 x 80 pixels.
+    static PixelMap Roc(const std::string& name, double value = 0);
+    /// Map of a full module, 416 x 160 pixels (8 x 2 ROCs).
+    static PixelMap Module(const std::string& name, double value = 0);
+
+    PixelMap(const std::string& name, unsigned nCols, unsigned nRows, double value = 0);
+
+    const std::string& Name() const { return name; }
+    void SetName(const std::string& _name) { name = _name; }
+    unsigned NumberOfColumns() const { return nCols; }
+    unsigned NumberOfRows() const { return nRows; }
+    size_t Size() const { return values.size(); }
+
+    double& operator()(unsigned col, unsigned row) { return values[Index(col, row)]; }
+    double operator()(unsigned col, unsigned row) const { return values[Index(col, row)]; }
+    double* Data() { return values.data(); }
+    const double* Data() const { return values.data(); }
+
+    void Fill(unsigned col, unsigned row, double weight = 1) { values[Index(col, row)] += weight; }
+    void SetAll(double value);
+    /// Copies Size() values in the column-major layout.
+    void Assign(const double* source);
+
+    PixelMap& operator+=(const PixelMap& other);
+    PixelMap& operator-=(const PixelMap& other);
+    PixelMap& operator*=(double factor);
+
+    void Mask(unsigned col, unsigned row);
+    void Unmask(unsigned col, unsigned row);
+    void ClearMask();
+    bool IsMasked(unsigned col, unsigned row) const { return nMasked && mask[Index(col, row)]; }
+    size_t NumberOfMasked() const { return nMasked; }
+
+    MapStatistics Statistics() const;
+    Distribution MakeDistribution(unsigned nBins, double lowerEdge, double upperEdge) const;
+    /// The range of the distribution is computed from the unmasked values.
+    Distribution MakeDistribution() const;
+
+private:
+    size_t Index(unsigned col, unsigned row) const { return col * nRows + row; }
+    void CheckSameShape(const PixelMap& other) const;
+    /// Unmasked values, to be passed to the kernels.
+    const double* Selected(std::vector<double>& buffer, size_t& n) const;
+
+private:
+    std::string name;
+    unsigned nCols, nRows;
+    std::vector<double> values;
+    std::vector<unsigned char> mask;
+    size_t nMasked;
+};
+
+/// Element-wise difference of two maps of the same shape, the masks are combined.
+PixelMap Difference(const PixelMap& first, const PixelMap& second, const std::string& name);
+
+} // analysis
+} // psi
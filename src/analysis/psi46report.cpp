@@ -5,7 +5,13 @@
  * Creates a report from ROOT file with measurements made by psi46expert.
  */
 
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <boost/program_options.hpp>
 #include <TFile.h>
 #include <TKey.h>
@@ -14,6 +20,8 @@
 #include "RootPrintToPdf.h"
 #include "data/TestNameProvider.h"
 #include "data/HistogramNameProvider.h"
+#include "data/PhaseProfile.h"
+#include "data/PerformedTests.h"
 
 namespace psi {
 namespace psi46report {
@@ -50,6 +58,9 @@ public:
     {
         if(inputFile.IsZombie())
             THROW_PSI_EXCEPTION("Unable to open input ROOT file '" << config.inputFileName << "'.");
+        TIter nextkey(inputFile.GetListOfKeys());
+        for(TKey* key; (key = (TKey*)nextkey()); )
+            keyNames.push_back(key->GetName());
         const size_t m_pos = config.inputFileName.find_first_of('/');
         const size_t c_pos = config.inputFileName.find_first_of('/', m_pos + 1);
         _moduleName.append(config.inputFileName.begin() + m_pos + 1, config.inputFileName.begin() + c_pos);
@@ -76,11 +87,9 @@ private:
     str_vector FindTest(const std::string& shortName) const
     {
         str_vector result;
-        TIter nextkey(inputFile.GetListOfKeys());
-        for(TKey* key; (key = (TKey*)nextkey()); ) {
-            const std::string fullName(key->GetName());
-            if(fullName.find(shortName) != std::string::npos)
-                result.push_back(fullName);
+        for(str_vector::const_iterator iter = keyNames.begin(); iter != keyNames.end(); ++iter) {
+            if(iter->find(shortName) != std::string::npos)
+                result.push_back(*iter);
         }
         return result;
     }
@@ -166,9 +175,203 @@ private:
 private:
     Config config;
     TFile inputFile;
+    str_vector keyNames;
     std::string _chipName;
     std::string _moduleName;
 };
+
+/*!
+ * Creates reports for many input files. ROOT canvases can't be shared between threads, so each report is printed by
+ * a forked worker process with its own canvas and the pages of a report keep their order. Reports that are newer
+ * than their input file are not printed again.
+ */
+class Batch {
+private:
+    typedef std::vector<std::string> str_vector;
+public:
+    struct Config {
+        str_vector inputFileNames;
+        std::string outputDirectory;
+        unsigned nJobs;
+        bool compatibilityMode;
+        bool force;
+        Config() : nJobs(1), compatibilityMode(false), force(false) {}
+    };
+
+public:
+    Batch(const Config& _config) : config(_config) {}
+
+    /// Returns the number of reports that failed.
+    unsigned Run()
+    {
+        unsigned failed = 0, running = 0;
+        for(str_vector::const_iterator iter = config.inputFileNames.begin(); iter != config.inputFileNames.end();
+            ++iter) {
+            Program::Config reportConfig;
+            reportConfig.inputFileName = *iter;
+            reportConfig.outputFileName = OutputFileName(*iter);
+            reportConfig.compatibilityMode = config.compatibilityMode;
+            if(!config.force && IsUpToDate(reportConfig.inputFileName, reportConfig.outputFileName)) {
+                std::cout << "Report '" << reportConfig.outputFileName << "' is up to date." << std::endl;
+                continue;
+            }
+
+            if(config.nJobs <= 1) {
+                failed += MakeReport(reportConfig);
+                continue;
+            }
+            if(running == config.nJobs) {
+                failed += WaitForReport();
+                --running;
+            }
+            std::cout.flush();
+            const pid_t pid = fork();
+            if(pid == 0) {
+                const unsigned status = MakeReport(reportConfig);
+                std::cout.flush();
+                _exit(status);
+            }
+            if(pid < 0)
+                failed += MakeReport(reportConfig);
+            else
+                ++running;
+        }
+        for(; running; --running)
+            failed += WaitForReport();
+        return failed;
+    }
+
+private:
+    std::string OutputFileName(const std::string& inputFileName) const
+    {
+        static const std::string extension = ".root";
+        std::string name(inputFileName);
+        if(name.size() > extension.size() && !name.compare(name.size() - extension.size(), extension.size(), extension))
+            name.erase(name.size() - extension.size());
+        for(size_t n = 0; n < name.size(); ++n) {
+            if(name[n] == '/')
+                name[n] = '_';
+        }
+        return config.outputDirectory + "/" + name + ".pdf";
+    }
+
+    static bool IsUpToDate(const std::string& inputFileName, const std::string& outputFileName)
+    {
+        struct stat input, output;
+        return !stat(inputFileName.c_str(), &input) && !stat(outputFileName.c_str(), &output)
+                && output.st_mtime >= input.st_mtime;
+    }
+
+    static unsigned MakeReport(const Program::Config& reportConfig)
+    {
+        try {
+            std::cout << "Creating report '" << reportConfig.outputFileName << "'." << std::endl;
+            Program program(reportConfig);
+            program.Run();
+            return 0;
+        } catch(psi::exception& e) {
+            std::cerr << "ERROR: " << reportConfig.inputFileName << ": " << e.message() << std::endl;
+        } catch(std::exception& e) {
+            std::cerr << "ERROR: " << reportConfig.inputFileName << ": " << e.what() << std::endl;
+        }
+        // a partially written report must not be taken for an up to date one
+        std::remove(reportConfig.outputFileName.c_str());
+        return 1;
+    }
+
+    static unsigned WaitForReport()
+    {
+        int status;
+        if(wait(&status) < 0)
+            return 1;
+        return WIFEXITED(status) && !WEXITSTATUS(status) ? 0 : 1;
+    }
+
+private:
+    Config config;
+};
+
+/*!
+ * Prints the phase profiles of all tests in a file: the phases are indented by their depth, the wall time share is
+ * relative to the whole test.
+ */
+class ProfileReport {
+public:
+    ProfileReport(const std::string& _inputFileName)
+        : inputFileName(_inputFileName), inputFile(inputFileName.c_str(), "READ")
+    {
+        if(inputFile.IsZombie())
+            THROW_PSI_EXCEPTION("Unable to open input ROOT file '" << inputFileName << "'.");
+    }
+
+    void Print(std::ostream& s)
+    {
+        unsigned nProfiles = 0;
+        TIter nextkey(inputFile.GetListOfKeys());
+        for(TKey* key; (key = (TKey*)nextkey()); ) {
+            const std::string testName = key->GetName();
+            const std::string treeName = testName + "/" + testName + "_profile";
+            if(!inputFile.Get(treeName.c_str()))
+                continue;
+            psi::data::PhaseProfile profile(treeName, inputFile);
+            s << inputFileName << ": " << testName << "\n" << std::left << std::setw(60) << "  phase" << std::right
+              << std::setw(10) << "calls" << std::setw(12) << "wall, s" << std::setw(12) << "tb, s"
+              << std::setw(8) << "wall %" << "\n";
+            double totalTime = 0;
+            for(Long64_t n = 0; n < profile.GetEntries(); ++n) {
+                profile.GetEntry(n);
+                if(!n)
+                    totalTime = profile.wall_time();
+                const std::string& path = profile.phase();
+                const size_t pos = path.find_last_of('/');
+                const std::string name = std::string(2 * (profile.depth() + 1), ' ')
+                        + (pos == std::string::npos ? path : path.substr(pos + 1));
+                s << std::left << std::setw(60) << name << std::right << std::setw(10) << profile.calls()
+                  << std::fixed << std::setprecision(3) << std::setw(12) << profile.wall_time() << std::setw(12)
+                  << profile.tb_time() << std::setprecision(1) << std::setw(8)
+                  << (totalTime > 0 ? 100. * profile.wall_time() / totalTime : 0.) << "\n";
+                s.unsetf(std::ios_base::floatfield);
+            }
+            s << "\n";
+            ++nProfiles;
+        }
+        if(!nProfiles)
+            s << inputFileName << ": no test profiles found.\n";
+    }
+
+private:
+    std::string inputFileName;
+    TFile inputFile;
+};
+
+/*!
+ * Writes the list of performed tests of a file in the flat binary form (see data/FlatRecord.h), for readers without
+ * ROOT. The written file is read back to check that it holds all tests.
+ */
+void WriteFlatPerformedTests(const std::string& inputFileName, const std::string& outputFileName)
+{
+    TFile inputFile(inputFileName.c_str(), "READ");
+    if(inputFile.IsZombie())
+        THROW_PSI_EXCEPTION("Unable to open input ROOT file '" << inputFileName << "'.");
+    psi::data::PerformedTests tests(inputFile);
+
+    std::ofstream output(outputFileName.c_str(), std::ios::binary);
+    tests.WriteFlat(output);
+    output.close();
+    if(output.fail())
+        THROW_PSI_EXCEPTION("Unable to write the performed tests to '" << outputFileName << "'.");
+
+    std::ifstream input(outputFileName.c_str(), std::ios::binary);
+    root_ext::flat::ReadHeader<psi::data::TestRecord>(input);
+    psi::data::TestRecord record;
+    Long64_t nRead = 0;
+    while(root_ext::flat::ReadEntry(input, record))
+        ++nRead;
+    if(nRead != tests.GetEntries())
+        THROW_PSI_EXCEPTION("'" << outputFileName << "' holds " << nRead << " performed tests instead of "
+                            << tests.GetEntries() << ".");
+    std::cout << inputFileName << ": " << nRead << " performed tests written to '" << outputFileName << "'.\n";
+}
 } // psi46report
 } // psi
 
@@ -180,7 +383,12 @@ const int PRINT_ARGS_EXIT_CODE = 2;
 const std::string optHelp = "help";
 const std::string optInputFile = "input";
 const std::string optOutputFile = "output";
+const std::string optOutputDirectory = "output-dir";
+const std::string optJobs = "jobs";
+const std::string optForce = "force";
 const std::string optCompatibility = "compatibility";
+const std::string optProfile = "profile";
+const std::string optFlatTests = "flat-tests";
 
 static boost::program_options::options_description CreateProgramOptions()
 {
@@ -188,13 +396,24 @@ static boost::program_options::options_description CreateProgramOptions()
     boost::program_options::options_description desc("Available command line arguments");
     desc.add_options()
             (optHelp.c_str(), "print help message")
-            (optInputFile.c_str(), value<std::string>(), "input ROOT file with measurements")
+            (optInputFile.c_str(), value< std::vector<std::string> >()->multitoken(),
+             "input ROOT file(s) with measurements")
             (optOutputFile.c_str(), value<std::string>(), "output PDF file with a report")
+            (optOutputDirectory.c_str(), value<std::string>(),
+             "batch mode: directory for the reports of all input files")
+            (optJobs.c_str(), value<unsigned>(), "batch mode: number of reports created in parallel"
+             " (default: number of CPUs)")
+            (optForce.c_str(), "batch mode: recreate reports that are newer than their input")
+            (optProfile.c_str(), "print the phase profiles of the tests instead of creating a report")
+            (optFlatTests.c_str(), value<std::string>(),
+             "write the list of performed tests to the given file in the flat binary form instead of creating a report")
             (optCompatibility.c_str(), "run program in compatibility mode to read old psi46expert files");
     return desc;
 }
 
-bool ParseProgramArguments(int argc, char* argv[], psi::psi46report::Program::Config& config)
+bool ParseProgramArguments(int argc, char* argv[], psi::psi46report::Batch::Config& config,
+                           std::string& outputFileName, bool& printProfile,
+                           std::string& flatTestsFileName)
 {
     using namespace boost::program_options;
     static options_description description = CreateProgramOptions();
@@ -218,14 +437,36 @@ bool ParseProgramArguments(int argc, char* argv[], psi::psi46report::Program::Co
         std::cerr << "Please, specify input ROOT file.\n\n" << description << std::endl;
         return false;
     }
-    config.inputFileName = variables[optInputFile].as<std::string>();
+    config.inputFileNames = variables[optInputFile].as< std::vector<std::string> >();
 
-    if(!variables.count(optOutputFile)) {
+    printProfile = variables.count(optProfile);
+    if(printProfile)
+        return true;
+
+    if(variables.count(optFlatTests)) {
+        if(config.inputFileNames.size() != 1) {
+            std::cerr << "Please, specify a single input file to write the performed tests.\n\n" << description
+                      << std::endl;
+            return false;
+        }
+        flatTestsFileName = variables[optFlatTests].as<std::string>();
+        return true;
+    }
+
+    if(variables.count(optOutputDirectory))
+        config.outputDirectory = variables[optOutputDirectory].as<std::string>();
+    else if(config.inputFileNames.size() != 1) {
+        std::cerr << "Please, specify output directory for several input files.\n\n" << description << std::endl;
+        return false;
+    } else if(!variables.count(optOutputFile)) {
         std::cerr << "Please, specify output PDF file.\n\n" << description << std::endl;
         return false;
-    }
-    config.outputFileName = variables[optOutputFile].as<std::string>();
+    } else
+        outputFileName = variables[optOutputFile].as<std::string>();
 
+    const long nCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    config.nJobs = variables.count(optJobs) ? variables[optJobs].as<unsigned>() : (nCpus > 0 ? nCpus : 1);
+    config.force = variables.count(optForce);
     config.compatibilityMode = variables.count(optCompatibility);
 
     return true;
@@ -239,11 +480,35 @@ int main(int argc, char* argv[])
         gErrorIgnoreLevel = kWarning;
         gPrintViaErrorHandler = false;
 
-        psi::psi46report::Program::Config config;
-        if(!ParseProgramArguments(argc, argv, config))
+        psi::psi46report::Batch::Config config;
+        std::string outputFileName;
+        std::string flatTestsFileName;
+        bool printProfile;
+        if(!ParseProgramArguments(argc, argv, config, outputFileName, printProfile, flatTestsFileName))
             return PRINT_ARGS_EXIT_CODE;
-        psi::psi46report::Program program(config);
-        program.Run();
+        if(printProfile) {
+            for(std::vector<std::string>::const_iterator iter = config.inputFileNames.begin();
+                iter != config.inputFileNames.end(); ++iter) {
+                psi::psi46report::ProfileReport report(*iter);
+                report.Print(std::cout);
+            }
+        } else if(!flatTestsFileName.empty()) {
+            psi::psi46report::WriteFlatPerformedTests(config.inputFileNames.front(), flatTestsFileName);
+        } else if(config.outputDirectory.empty()) {
+            psi::psi46report::Program::Config reportConfig;
+            reportConfig.inputFileName = config.inputFileNames.front();
+            reportConfig.outputFileName = outputFileName;
+            reportConfig.compatibilityMode = config.compatibilityMode;
+            psi::psi46report::Program program(reportConfig);
+            program.Run();
+        } else {
+            psi::psi46report::Batch batch(config);
+            const unsigned failed = batch.Run();
+            if(failed) {
+                std::cerr << "ERROR: " << failed << " report(s) failed." << std::endl;
+                return ERROR_EXIT_CODE;
+            }
+        }
     } catch(psi::exception& e) {
         std::cerr << "ERROR: " << e.message() << std::endl;
         return ERROR_EXIT_CODE;
@@ -0,0 +1,69 @@
+/*!
+ * \file Benchmark.cc
+ * \brief Implementation of the microbenchmark harness.
+ */
+
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <time.h>
+
+#include "Benchmark.h"
+
+namespace {
+size_t allocationCount = 0;
+}
+
+void* operator new(size_t size)
+{
+    ++allocationCount;
+    void* memory = std::malloc(size ? size : 1);
+    if(!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) throw()
+{
+    std::free(memory);
+}
+
+namespace psi {
+namespace benchmark {
+
+size_t AllocationCount()
+{
+    return allocationCount;
+}
+
+double Now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + 1e-9 * time.tv_nsec;
+}
+
+Suite::Suite(int argc, char* argv[])
+    : minTime(0.5)
+{
+    if(argc > 1)
+        filter = argv[1];
+    if(argc > 2)
+        minTime = std::atof(argv[2]);
+    std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(16) << "events/s"
+              << std::setw(16) << "allocs/call" << std::setw(12) << "calls" << std::endl;
+}
+
+void Suite::Report(const std::string& name, unsigned long calls, unsigned eventsPerCall, double elapsed,
+                   size_t allocations)
+{
+    const double eventsPerSecond = calls * double(eventsPerCall) / elapsed;
+    const double allocationsPerCall = double(allocations) / calls;
+    std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+              << std::setw(16) << std::setprecision(0) << eventsPerSecond
+              << std::setw(16) << std::setprecision(2) << allocationsPerCall
+              << std::setw(12) << calls << std::endl;
+}
+
+} // benchmark
+} // psi
@@ -0,0 +1,71 @@
+/*!
+ * \file Benchmark.h
+ * \brief Definition of the microbenchmark harness.
+ *
+ * A benchmark is any callable without arguments that processes a known number of events per call. Run() calls it
+ * in doubling batches until the minimal time has passed and prints the rate in events per second together with the
+ * number of heap allocations per call. Allocations are counted by the replacement of the global operator new in
+ * Benchmark.cc, so that file must be linked into every benchmark program.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+namespace psi {
+namespace benchmark {
+
+/// Number of calls of the global operator new since the start of the program.
+size_t AllocationCount();
+
+/// Monotonic time in seconds.
+double Now();
+
+/// Prevents the compiler from discarding a value computed only for the benchmark.
+template<typename T>
+inline void Consume(const T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+/*!
+ * Runs the benchmarks selected on the command line: 'program [filter] [min_time]' runs only the benchmarks whose
+ * name contains the filter, each for at least min_time seconds (0.5 by default).
+ */
+class Suite {
+public:
+    Suite(int argc, char* argv[]);
+
+    template<typename Function>
+    void Run(const std::string& name, Function function, unsigned eventsPerCall = 1)
+    {
+        if(name.find(filter) == std::string::npos)
+            return;
+        function();
+        const size_t firstAllocation = AllocationCount();
+        const double start = Now();
+        unsigned long calls = 0, batch = 1;
+        double elapsed;
+        do {
+            for(unsigned long n = 0; n < batch; ++n)
+                function();
+            calls += batch;
+            batch *= 2;
+            elapsed = Now() - start;
+        } while(elapsed < minTime);
+        Report(name, calls, eventsPerCall, elapsed, AllocationCount() - firstAllocation);
+    }
+
+private:
+    void Report(const std::string& name, unsigned long calls, unsigned eventsPerCall, double elapsed,
+                size_t allocations);
+
+private:
+    std::string filter;
+    double minTime;
+};
+
+} // benchmark
+} // psi
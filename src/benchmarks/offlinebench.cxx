@@ -0,0 +1,158 @@
+/*!
+ * \file offlinebench.cxx
+ * \brief Microbenchmarks of the offline reconstruction hot paths on synthetic data.
+ *
+ * Built by 'make bench' in src/offline, since the offline code is compiled with its own Makefile.
+ * Usage: offlinebench [filter] [min_time]. No input files are needed, the PH calibration is written to a temporary
+ * directory and removed at the end.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "TH1.h"
+#include "TTree.h"
+
+#include "BinaryFileReader.h"
+#include "PHCalibration.h"
+
+#include "Benchmark.h"
+
+namespace {
+
+const int NumberOfRocs = 16;
+const int NumberOfColumns = 52, NumberOfRows = 80;
+const unsigned NumberOfEvents = 256;
+
+/// Deterministic generator, so that all runs process the same data.
+class Random {
+public:
+    explicit Random(unsigned seed) : state(seed) {}
+    unsigned Next(unsigned n)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) % n;
+    }
+private:
+    unsigned state;
+};
+
+/// Module events with a few compact clusters, in the pixel format filled by BinaryFileReader::decodePixels.
+struct SyntheticHits {
+    std::vector< std::vector<pixel> > events;
+
+    SyntheticHits()
+    {
+        Random random(42);
+        for(unsigned n = 0; n < NumberOfEvents; ++n) {
+            std::vector<pixel> event;
+            const unsigned nClusters = 1 + random.Next(4);
+            for(unsigned c = 0; c < nClusters; ++c) {
+                const int roc = random.Next(NumberOfRocs);
+                const int col = random.Next(NumberOfColumns - 1), row = random.Next(NumberOfRows - 1);
+                const unsigned size = 1 + random.Next(4);
+                for(unsigned k = 0; k < size; ++k) {
+                    pixel p;
+                    p.roc = roc;
+                    p.colROC = p.col = col + k % 2;
+                    p.rowROC = p.row = row + k / 2;
+                    p.ana = 100 + random.Next(200);
+                    p.anaVcal = p.ana;
+                    p.xy[0] = 0.015 * p.col;
+                    p.xy[1] = 0.010 * p.row;
+                    event.push_back(p);
+                }
+            }
+            events.push_back(event);
+        }
+    }
+};
+
+/// The body of BinaryFileReader::getHits on already decoded pixels, the decoding of raw records is not included.
+struct FindClusters {
+    BinaryFileReader* reader;
+    const SyntheticHits* hits;
+    size_t eventId;
+
+    void operator()()
+    {
+        const std::vector<pixel>& event = hits->events[eventId++ % hits->events.size()];
+        const vector<cluster> clusters = reader->findClusters(&event[0], event.size());
+        reader->fillClusterTree(clusters);
+        psi::benchmark::Consume(clusters.size());
+    }
+};
+
+/// Writes fit parameters of the default (version 1) parametrization for all pixels of all ROCs.
+void WriteCalibration(const std::string& directory)
+{
+    for(int roc = 0; roc < NumberOfRocs; ++roc) {
+        char fileName[1000];
+        std::sprintf(fileName, "%s/phCalibrationFit_C%i.dat", directory.c_str(), roc);
+        FILE* file = std::fopen(fileName, "w");
+        std::fprintf(file, "Parameters of the vcal vs. pulse height fits\n");
+        std::fprintf(file, "TMath::Tan(par[0]*x[0] - par[4]) + par[1]*x[0]*x[0]*x[0] + par[5]*x[0]*x[0]"
+                     " + par[2]*x[0] + par[3]\n\n");
+        for(int col = 0; col < NumberOfColumns; ++col) {
+            for(int row = 0; row < NumberOfRows; ++row)
+                std::fprintf(file, "%e %e %e %e %e %e    Pix %2i %2i\n", 0.003, 1e-7, 0.5, 10., 0.1, 1e-5, col, row);
+        }
+        std::fclose(file);
+    }
+}
+
+void RemoveCalibration(const std::string& directory)
+{
+    for(int roc = 0; roc < NumberOfRocs; ++roc) {
+        char fileName[1000];
+        std::sprintf(fileName, "%s/phCalibrationFit_C%i.dat", directory.c_str(), roc);
+        unlink(fileName);
+    }
+    rmdir(directory.c_str());
+}
+
+struct GetVcal {
+    PHCalibration* calibration;
+    Random random;
+
+    GetVcal(PHCalibration* _calibration) : calibration(_calibration), random(7) {}
+
+    void operator()()
+    {
+        double sum = 0;
+        for(int n = 0; n < 1000; ++n) {
+            const unsigned pixelId = random.Next(NumberOfRocs * NumberOfColumns * NumberOfRows);
+            const int roc = pixelId / (NumberOfColumns * NumberOfRows);
+            const int col = pixelId / NumberOfRows % NumberOfColumns, row = pixelId % NumberOfRows;
+            sum += calibration->GetVcal(100 + n % 200, roc, col, row);
+        }
+        psi::benchmark::Consume(sum);
+    }
+};
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    TH1::AddDirectory(kFALSE);
+    psi::benchmark::Suite suite(argc, argv);
+
+    const SyntheticHits hits;
+    BinaryFileReader reader("none", NumberOfRocs, 0);
+    FindClusters findClusters = { &reader, &hits, 0 };
+    suite.Run("BinaryFileReader::findClusters+fillClusterTree", findClusters);
+
+    char directory[] = "/tmp/offlinebenchXXXXXX";
+    if(!mkdtemp(directory)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    WriteCalibration(directory);
+    PHCalibration* calibration = new PHCalibration();
+    calibration->LoadFitParameters(directory, 0);
+    RemoveCalibration(directory);
+    suite.Run("PHCalibration::GetVcal", GetVcal(calibration), 1000);
+    delete calibration;
+    return 0;
+}
@@ -0,0 +1,225 @@
+/*!
+ * \file psi46bench.cpp
+ * \brief Microbenchmarks of the host-side hot paths of psi46expert on synthetic data.
+ *
+ * Usage: psi46bench [filter] [min_time]. No testboard or input files are needed.
+ */
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+
+#include <TH1.h>
+
+#include "BasePixel/RawPacketDecoder.h"
+#include "BasePixel/DecoderCalibration.h"
+#include "BasePixel/TestRange.h"
+#include "BasePixel/constants.h"
+#include "analysis/Analysis.h"
+#include "analysis/PixelMap.h"
+
+#include "Benchmark.h"
+
+namespace {
+
+const unsigned NumberOfRocs = psi::MODULENUMROCS;
+const unsigned NumberOfEvents = 256;
+const double MeanHitsPerRoc = 2.;
+const ADCword UltraBlack = -800, Black = -400, PulseHeight = 150;
+
+/*!
+ * Synthetic analog readouts of a module: address level boundaries are 200 ADC units apart, the ultra black level is
+ * below the lowest boundary and the black level (fixed to 300 by DecoderCalibrationModule) above it.
+ */
+class SyntheticReadout {
+public:
+    SyntheticReadout()
+        : generator(42)
+    {
+        ADCword levelsTBM[DecoderCalibrationConstants::NUM_LEVELSTBM + 1];
+        for(int n = 0; n <= DecoderCalibrationConstants::NUM_LEVELSTBM; ++n)
+            levelsTBM[n] = Boundary(n);
+        ADCword levelsROC[RawPacketDecoderConstants::MAX_ROCS][DecoderCalibrationConstants::NUM_LEVELSROC + 1];
+        for(unsigned roc = 0; roc < NumberOfRocs; ++roc) {
+            for(int n = 0; n <= DecoderCalibrationConstants::NUM_LEVELSROC; ++n)
+                levelsROC[roc][n] = Boundary(n);
+        }
+        calibration.reset(new DecoderCalibrationModule(levelsTBM, levelsROC, NumberOfRocs));
+
+        std::poisson_distribution<unsigned> nHits(MeanHitsPerRoc);
+        for(unsigned n = 0; n < NumberOfEvents; ++n) {
+            std::vector<ADCword> event;
+            AddTbmBlock(event, true);
+            for(unsigned roc = 0; roc < NumberOfRocs; ++roc) {
+                event.push_back(UltraBlack);
+                event.push_back(Black);
+                event.push_back(Level(0));
+                const unsigned nRocHits = std::min<unsigned>(nHits(generator), 20);
+                for(unsigned hit = 0; hit < nRocHits; ++hit)
+                    AddHit(event);
+            }
+            AddTbmBlock(event, false);
+            events.push_back(event);
+        }
+    }
+
+    boost::shared_ptr<DecoderCalibrationModule> Calibration() const { return calibration; }
+    const std::vector< std::vector<ADCword> >& Events() const { return events; }
+
+private:
+    static ADCword Boundary(int level) { return -500 + 200 * level; }
+    static ADCword Level(int level) { return Boundary(level) + 100; }
+
+    void AddTbmBlock(std::vector<ADCword>& event, bool header)
+    {
+        event.push_back(UltraBlack);
+        event.push_back(UltraBlack);
+        event.push_back(header ? UltraBlack : Black);
+        event.push_back(Black);
+        for(int n = 0; n < 4; ++n)
+            event.push_back(Level(n));
+    }
+
+    // Raw double column 0-25 and raw pixel 2-161, each digit is one address level.
+    void AddHit(std::vector<ADCword>& event)
+    {
+        std::uniform_int_distribution<int> rawColumns(0, 25), rawPixels(2, 161);
+        const int rawColumn = rawColumns(generator), rawPixel = rawPixels(generator);
+        const int nLevels = DecoderCalibrationConstants::NUM_LEVELSROC;
+        event.push_back(Level(rawColumn / nLevels));
+        event.push_back(Level(rawColumn % nLevels));
+        event.push_back(Level(rawPixel / (nLevels * nLevels)));
+        event.push_back(Level(rawPixel / nLevels % nLevels));
+        event.push_back(Level(rawPixel % nLevels));
+        event.push_back(PulseHeight);
+    }
+
+private:
+    std::mt19937 generator;
+    boost::shared_ptr<DecoderCalibrationModule> calibration;
+    std::vector< std::vector<ADCword> > events;
+};
+
+void DecoderBenchmarks(psi::benchmark::Suite& suite)
+{
+    const SyntheticReadout readout;
+    RawPacketDecoder& decoder = *RawPacketDecoder::Singleton();
+    decoder.SetCalibration(readout.Calibration());
+    const std::vector< std::vector<ADCword> >& events = readout.Events();
+
+    size_t maxLength = 0;
+    for(size_t n = 0; n < events.size(); ++n)
+        maxLength = std::max(maxLength, events[n].size());
+    std::vector<ADCword> buffer(maxLength);
+    boost::scoped_ptr<DecodedReadoutModule> module(new DecodedReadoutModule());
+
+    size_t eventId = 0;
+    suite.Run("RawPacketDecoder::decode", [&]() {
+        const std::vector<ADCword>& event = events[eventId++ % events.size()];
+        std::copy(event.begin(), event.end(), buffer.begin());
+        psi::benchmark::Consume(decoder.decode(event.size(), &buffer[0], *module, NumberOfRocs));
+    });
+
+    DecodedReadoutPixel pixel;
+    suite.Run("RawPacketDecoder::decodePixel", [&]() {
+        const std::vector<ADCword>& event = events[eventId++ % events.size()];
+        std::copy(event.begin(), event.end(), buffer.begin());
+        psi::benchmark::Consume(decoder.decodePixel(event.size(), &buffer[0], NumberOfRocs, NumberOfRocs - 1, 10, 10,
+                                                    pixel));
+    });
+}
+
+void AnalysisBenchmarks(psi::benchmark::Suite& suite)
+{
+    TH1::AddDirectory(kFALSE);
+    std::mt19937 generator(7);
+    std::normal_distribution<double> thresholds(60., 5.);
+    psi::analysis::PixelMap map = psi::analysis::PixelMap::Roc("VcalThresholdMap_C0");
+    for(size_t n = 0; n < map.Size(); ++n)
+        map.Data()[n] = thresholds(generator);
+    TH2D* histo = Analysis::ToMap(map);
+    const unsigned nPixels = map.Size();
+
+    suite.Run("Analysis::Distribution(TH2D)", [&]() {
+        TH1D* distribution = Analysis::Distribution(histo, 255, 0., 255.);
+        psi::benchmark::Consume(distribution);
+        delete distribution;
+    }, nPixels);
+
+    suite.Run("Analysis::Distribution(TH2D, auto range)", [&]() {
+        TH1D* distribution = Analysis::Distribution(histo);
+        psi::benchmark::Consume(distribution);
+        delete distribution;
+    }, nPixels);
+
+    suite.Run("Analysis::Distribution(PixelMap)", [&]() {
+        TH1D* distribution = Analysis::Distribution(map, 255, 0., 255.);
+        psi::benchmark::Consume(distribution);
+        delete distribution;
+    }, nPixels);
+
+    suite.Run("analysis::MakeDistribution", [&]() {
+        psi::benchmark::Consume(psi::analysis::MakeDistribution(map.Data(), nPixels, 255, 0., 255.));
+    }, nPixels);
+
+    suite.Run("analysis::Statistics", [&]() {
+        psi::benchmark::Consume(psi::analysis::Statistics(map.Data(), nPixels));
+    }, nPixels);
+
+    delete histo;
+}
+
+void TestRangeBenchmarks(psi::benchmark::Suite& suite)
+{
+    static const unsigned nPixels = psi::MODULENUMROCS * psi::ROCNUMCOLS * psi::ROCNUMROWS;
+    std::mt19937 generator(11);
+    std::bernoulli_distribution included(0.1);
+    boost::scoped_ptr<TestRange> range(new TestRange());
+    for(unsigned roc = 0; roc < psi::MODULENUMROCS; ++roc) {
+        for(unsigned col = 0; col < psi::ROCNUMCOLS; ++col) {
+            for(unsigned row = 0; row < psi::ROCNUMROWS; ++row) {
+                if(included(generator))
+                    range->AddPixel(roc, col, row);
+            }
+        }
+    }
+
+    suite.Run("TestRange::IncludesPixel", [&]() {
+        unsigned count = 0;
+        for(unsigned roc = 0; roc < psi::MODULENUMROCS; ++roc) {
+            for(unsigned col = 0; col < psi::ROCNUMCOLS; ++col) {
+                for(unsigned row = 0; row < psi::ROCNUMROWS; ++row)
+                    count += range->IncludesPixel(roc, col, row);
+            }
+        }
+        psi::benchmark::Consume(count);
+    }, nPixels);
+
+    suite.Run("TestRange::IncludesDoubleColumn", [&]() {
+        unsigned count = 0;
+        for(unsigned roc = 0; roc < psi::MODULENUMROCS; ++roc) {
+            for(unsigned dcol = 0; dcol < psi::ROCNUMDCOLS; ++dcol)
+                count += range->IncludesDoubleColumn(roc, dcol);
+        }
+        psi::benchmark::Consume(count);
+    }, psi::MODULENUMROCS * psi::ROCNUMDCOLS);
+
+    suite.Run("TestRange::Pixels", [&]() {
+        unsigned count = 0;
+        for(const TestRange::Pixel& pixel : range->Pixels())
+            count += pixel.row;
+        psi::benchmark::Consume(count);
+    }, range->NumberOfIncludedPixels());
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    psi::benchmark::Suite suite(argc, argv);
+    DecoderBenchmarks(suite);
+    AnalysisBenchmarks(suite);
+    TestRangeBenchmarks(suite);
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*!
+ * \file EventColumnsCheck.cpp
+ * \brief Checks that the columnar hit file of the offline reader reads back complete and rejects truncated blocks.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "offline/EventColumns.h"
+
+namespace {
+
+/// Two blocks of events with a few hits each.
+std::string MakeFile()
+{
+    std::ostringstream s;
+    EventColumns::writeHeader(s);
+    EventColumns columns;
+    for(int block = 0; block < 2; ++block) {
+        for(int event = 0; event < 3; ++event) {
+            columns.addEvent(10 * block + event);
+            for(int hit = 0; hit <= event; ++hit)
+                columns.addHit(hit, 2 * hit, 3 * hit - 1, 100 + hit, 1.5f * hit);
+        }
+        columns.write(s);
+        columns.clear();
+    }
+    return s.str();
+}
+
+/// Reads all blocks, returns the number of blocks or -1 if the reader rejected the data.
+int ReadBlocks(const std::string& data, int& nEvents, int& nHits)
+{
+    std::istringstream s(data);
+    if(!EventColumns::readHeader(s))
+        return -1;
+    EventColumns columns;
+    int nBlocks = 0;
+    nEvents = nHits = 0;
+    try {
+        while(columns.read(s)) {
+            ++nBlocks;
+            nEvents += columns.nEvents();
+            nHits += columns.nHits();
+        }
+    } catch(std::runtime_error&) {
+        return -1;
+    }
+    return nBlocks;
+}
+
+} // anonymous namespace
+
+int main()
+{
+    const std::string data = MakeFile();
+    int nEvents, nHits;
+    const int nBlocks = ReadBlocks(data, nEvents, nHits);
+    if(nBlocks != 2 || nEvents != 6 || nHits != 12) {
+        std::cerr << "Complete file: read " << nBlocks << " blocks, " << nEvents << " events and " << nHits
+                  << " hits instead of 2, 6 and 12.\n";
+        return 1;
+    }
+
+    // cut within the counts of the second block, within its payload and one byte before the end
+    const size_t blockSize = (data.size() - 8) / 2;
+    const size_t cuts[] = { 8 + blockSize + 3, 8 + blockSize + 20, data.size() - 1 };
+    for(size_t n = 0; n < sizeof(cuts) / sizeof(cuts[0]); ++n) {
+        if(ReadBlocks(data.substr(0, cuts[n]), nEvents, nHits) != -1) {
+            std::cerr << "File cut at " << cuts[n] << " of " << data.size() << " bytes was not rejected.\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*!
+ * \file RecordTreeCheck.cpp
+ * \brief Checks that records written with RecordTree read back the same through ROOT and through the flat form.
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <TFile.h>
+
+#include "data/PerformedTests.h"
+
+namespace {
+
+const std::string FileName = "RecordTreeCheck.root";
+
+std::vector<psi::data::TestRecord> MakeRecords()
+{
+    std::vector<psi::data::TestRecord> records;
+    for(unsigned n = 0; n < 3; ++n) {
+        std::ostringstream name;
+        name << "Test" << std::string(n * 10, 'x');
+        psi::data::TestRecord record(n, name.str(), "2026-10-18 10:00:00");
+        record.end_time = n ? "2026-10-18 11:00:00" : "";
+        record.result = 10 * n + 1;
+        records.push_back(record);
+    }
+    return records;
+}
+
+bool Compare(const std::string& source, const psi::data::TestRecord& record, const psi::data::TestRecord& expected)
+{
+    if(record.id == expected.id && record.name == expected.name && record.start_time == expected.start_time
+            && record.end_time == expected.end_time && record.result == expected.result)
+        return true;
+    std::cerr << source << ": read #" << record.id << " '" << record.name << "' '" << record.start_time << "' '"
+              << record.end_time << "' " << record.result << " instead of #" << expected.id << " '" << expected.name
+              << "' '" << expected.start_time << "' '" << expected.end_time << "' " << expected.result << ".\n";
+    return false;
+}
+
+bool CheckRoot(const std::vector<psi::data::TestRecord>& records)
+{
+    {
+        TFile file(FileName.c_str(), "RECREATE");
+        psi::data::PerformedTests tests;
+        for(size_t n = 0; n < records.size(); ++n)
+            tests.Push(records[n]);
+        tests.Write();
+    }
+
+    TFile file(FileName.c_str(), "READ");
+    psi::data::PerformedTests tests(file);
+    if(tests.GetEntries() != static_cast<Long64_t>(records.size())) {
+        std::cerr << "ROOT: " << tests.GetEntries() << " entries instead of " << records.size() << ".\n";
+        return false;
+    }
+    bool ok = true;
+    for(size_t n = 0; n < records.size(); ++n)
+        ok = Compare("ROOT", tests.GetEntry(n), records[n]) && ok;
+
+    std::stringstream stream;
+    tests.WriteFlat(stream);
+    root_ext::flat::ReadHeader<psi::data::TestRecord>(stream);
+    psi::data::TestRecord record;
+    size_t nRead = 0;
+    for(; root_ext::flat::ReadEntry(stream, record); ++nRead) {
+        if(nRead < records.size())
+            ok = Compare("flat", record, records[nRead]) && ok;
+    }
+    if(nRead != records.size()) {
+        std::cerr << "flat: " << nRead << " entries instead of " << records.size() << ".\n";
+        ok = false;
+    }
+    return ok;
+}
+
+} // anonymous namespace
+
+int main()
+{
+    try {
+        const bool ok = CheckRoot(MakeRecords());
+        std::remove(FileName.c_str());
+        return ok ? 0 : 1;
+    } catch(std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+    }
+    return 1;
+}
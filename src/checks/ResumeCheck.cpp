@@ -0,0 +1,88 @@
+/*!
+ * \file ResumeCheck.cpp
+ * \brief Checks that a run into an output file with earlier results continues its list of performed tests.
+ *
+ * Two runs are simulated in one process: each creates its own data storage for the same file and calls
+ * Test::LoadPerformedTests, as psi46expert does on start. No testboard is needed.
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include <TFile.h>
+
+#include "BasePixel/DataStorage.h"
+#include "BasePixel/Test.h"
+#include "data/PerformedTests.h"
+#include "data/TestNameProvider.h"
+
+namespace {
+
+const std::string FileName = "ResumeCheck.root";
+
+void Run(const std::vector<std::string>& testNames)
+{
+    boost::shared_ptr<psi::DataStorage> storage(new psi::DataStorage(FileName, "ResumeCheck", "ResumeCheck"));
+    psi::DataStorage::setActive(storage);
+    storage->Enable();
+    Test::LoadPerformedTests();
+    for(size_t n = 0; n < testNames.size(); ++n)
+        Test test(testNames[n]);
+    storage->Disable();
+}
+
+bool Check(const std::vector<std::string>& expectedNames)
+{
+    TFile file(FileName.c_str(), "READ");
+    if(file.IsZombie()) {
+        std::cerr << "Unable to open '" << FileName << "'.\n";
+        return false;
+    }
+    psi::data::PerformedTests tests(file);
+    if(tests.GetEntries() != static_cast<Long64_t>(expectedNames.size())) {
+        std::cerr << "performed_tests has " << tests.GetEntries() << " entries instead of " << expectedNames.size()
+                  << ".\n";
+        return false;
+    }
+    bool ok = true;
+    for(unsigned n = 0; n < expectedNames.size(); ++n) {
+        const psi::data::TestRecord& record = tests.GetEntry(n);
+        if(record.id != n || record.name != expectedNames[n]) {
+            std::cerr << "Entry " << n << " is test #" << record.id << " '" << record.name << "' instead of #" << n
+                      << " '" << expectedNames[n] << "'.\n";
+            ok = false;
+        }
+        const std::string directory = psi::data::TestNameProvider::TestResultsTreeName(n, expectedNames[n]);
+        if(!file.GetDirectory(directory.c_str())) {
+            std::cerr << "Directory '" << directory << "' is missing.\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+} // anonymous namespace
+
+int main()
+{
+    try {
+        std::remove(FileName.c_str());
+        std::vector<std::string> names;
+        names.push_back("First");
+        names.push_back("Second");
+        Run(names);
+        Run(std::vector<std::string>(1, "Third"));
+        names.push_back("Third");
+        const bool ok = Check(names);
+        std::remove(FileName.c_str());
+        return ok ? 0 : 1;
+    } catch(psi::exception& e) {
+        std::cerr << "ERROR: " << e.message() << std::endl;
+    } catch(std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+    }
+    return 1;
+}
@@ -0,0 +1,29 @@
+/*!
+ * \file CommandStatistics.h
+ * \brief Definition of CommandStatistics class.
+ */
+
+#pragma once
+
+#include "data/SmartTree.h"
+
+namespace psi {
+namespace data {
+/*!
+ * Statistics of the testboard commands sent during one test, one entry per command. Times are in seconds, the latency
+ * histogram has bins of powers of two microseconds as defined by psi::TestBoardStatistics.
+ */
+class CommandStatistics : public root_ext::SmartTree {
+public:
+    CommandStatistics(const std::string& treeName) : SmartTree(treeName) {}
+    CommandStatistics(const std::string& treeName, TFile& file) : SmartTree(treeName, file) {}
+    POINTER_TREE_BRANCH(std::string, command)
+    SIMPLE_TREE_BRANCH(ULong64_t, calls, 0)
+    SIMPLE_TREE_BRANCH(ULong64_t, bytes_out, 0)
+    SIMPLE_TREE_BRANCH(ULong64_t, bytes_in, 0)
+    SIMPLE_TREE_BRANCH(Double_t, link_time, 0)
+    SIMPLE_TREE_BRANCH(Double_t, sleep_time, 0)
+    VECTOR_TREE_BRANCH(ULong64_t, latency)
+};
+} // data
+} // psi
@@ -6,18 +6,31 @@
 
 #pragma once
 
-#include "data/SmartTree.h"
+#include "data/RecordTree.h"
 
 namespace psi {
 namespace data {
-class DetectorSummary : public root_ext::SmartTree {
+
+struct DetectorSummaryRecord {
+    std::string detector_name;
+    std::string operator_name;
+    std::string date;
+
+    template<typename Record, typename Visitor>
+    static void Schema(Record& record, Visitor& visitor)
+    {
+        visitor("detector_name", record.detector_name);
+        visitor("operator_name", record.operator_name);
+        visitor("date", record.date);
+    }
+};
+
+class DetectorSummary : public root_ext::RecordTree<DetectorSummaryRecord> {
 public:
     static std::string TreeName() { return "detector_test_summary"; }
-    DetectorSummary() : SmartTree(TreeName()) {}
-    DetectorSummary(TFile& file) : SmartTree(TreeName(), file) {}
-    POINTER_TREE_BRANCH(std::string, detector_name)
-    POINTER_TREE_BRANCH(std::string, operator_name)
-    POINTER_TREE_BRANCH(std::string, date)
+    DetectorSummary() : RecordTree(TreeName()) {}
+    DetectorSummary(TFile& file) : RecordTree(TreeName(), file) {}
 };
+
 } // data
 } // psi
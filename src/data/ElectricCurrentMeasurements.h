@@ -6,18 +6,35 @@
 
 #pragma once
 
-#include "data/SmartTree.h"
+#include "data/RecordTree.h"
 
 namespace psi {
 namespace data {
-class ElectricCurrentMeasurements : public root_ext::SmartTree {
+
+struct ElectricCurrentMeasurement {
+    double current;
+    double voltage;
+    double timestamp;
+
+    ElectricCurrentMeasurement() : current(0), voltage(0), timestamp(0) {}
+    ElectricCurrentMeasurement(double _current, double _voltage, double _timestamp)
+        : current(_current), voltage(_voltage), timestamp(_timestamp) {}
+
+    template<typename Record, typename Visitor>
+    static void Schema(Record& record, Visitor& visitor)
+    {
+        visitor("current", record.current);
+        visitor("voltage", record.voltage);
+        visitor("timestamp", record.timestamp);
+    }
+};
+
+class ElectricCurrentMeasurements : public root_ext::RecordTree<ElectricCurrentMeasurement> {
 public:
     static std::string TreeName() { return "current_measurements"; }
-    ElectricCurrentMeasurements() : SmartTree(TreeName()) {}
-    ElectricCurrentMeasurements(TFile& file) : SmartTree(TreeName(), file) {}
-    SIMPLE_TREE_BRANCH(Double_t, current, 0)
-    SIMPLE_TREE_BRANCH(Double_t, voltage, 0)
-    SIMPLE_TREE_BRANCH(Double_t, timestamp, 0)
+    ElectricCurrentMeasurements() : RecordTree(TreeName()) {}
+    ElectricCurrentMeasurements(TFile& file) : RecordTree(TreeName(), file) {}
 };
+
 } // data
 } // psi
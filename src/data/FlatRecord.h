@@ -0,0 +1,212 @@
+/*!
+ * \file FlatRecord.h
+ * \brief Flat binary form of records with a compile-time schema.
+ *
+ * A record is a plain struct that describes its fields with a static member template
+ *
+ *     template<typename Record, typename Visitor>
+ *     static void Schema(Record& record, Visitor& visitor) { visitor("id", record.id); ... }
+ *
+ * which is instantiated for const and non-const records. Supported field types are bool, int, unsigned, long long,
+ * unsigned long long, float, double, std::string and std::vector of the numeric types.
+ *
+ * The flat form starts with the magic "PSIFLAT1", the number of fields and, for each field, its type code and name.
+ * The entries follow until the end of the stream: numeric fields as raw bytes in host order, strings and vectors as
+ * a 32-bit element count followed by the elements. This header does not depend on ROOT, so non-ROOT readers can
+ * include it directly.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace root_ext {
+namespace flat {
+
+namespace detail {
+template<typename T> struct TypeCode;
+template<> struct TypeCode<bool> { static const uint8_t value = 1; };
+template<> struct TypeCode<int> { static const uint8_t value = 2; };
+template<> struct TypeCode<unsigned> { static const uint8_t value = 3; };
+template<> struct TypeCode<long long> { static const uint8_t value = 4; };
+template<> struct TypeCode<unsigned long long> { static const uint8_t value = 5; };
+template<> struct TypeCode<float> { static const uint8_t value = 6; };
+template<> struct TypeCode<double> { static const uint8_t value = 7; };
+template<> struct TypeCode<std::string> { static const uint8_t value = 8; };
+template<typename T> struct TypeCode< std::vector<T> > { static const uint8_t value = 0x80 | TypeCode<T>::value; };
+
+const char Magic[] = "PSIFLAT1";
+const size_t MagicSize = sizeof(Magic) - 1;
+
+template<typename T>
+void WriteRaw(std::ostream& stream, const T* values, size_t n)
+{
+    stream.write(reinterpret_cast<const char*>(values), n * sizeof(T));
+}
+
+template<typename T>
+bool ReadRaw(std::istream& stream, T* values, size_t n)
+{
+    return stream.read(reinterpret_cast<char*>(values), n * sizeof(T)).good();
+}
+
+struct FieldDescription {
+    uint8_t type;
+    std::string name;
+};
+
+struct SchemaCollector {
+    std::vector<FieldDescription> fields;
+    template<typename T>
+    void operator()(const char* name, const T&)
+    {
+        FieldDescription field;
+        field.type = TypeCode<T>::value;
+        field.name = name;
+        fields.push_back(field);
+    }
+};
+
+struct FieldWriter {
+    std::ostream* stream;
+    template<typename T>
+    void operator()(const char*, const T& value) { WriteRaw(*stream, &value, 1); }
+    void operator()(const char*, const std::string& value)
+    {
+        const uint32_t size = value.size();
+        WriteRaw(*stream, &size, 1);
+        WriteRaw(*stream, value.data(), size);
+    }
+    template<typename T>
+    void operator()(const char*, const std::vector<T>& value)
+    {
+        const uint32_t size = value.size();
+        WriteRaw(*stream, &size, 1);
+        if(size)
+            WriteRaw(*stream, &value[0], size);
+    }
+    // vector<bool> has no contiguous storage, so it is written element by element.
+    void operator()(const char*, const std::vector<bool>& value)
+    {
+        const uint32_t size = value.size();
+        WriteRaw(*stream, &size, 1);
+        for(uint32_t n = 0; n < size; ++n) {
+            const bool element = value[n];
+            WriteRaw(*stream, &element, 1);
+        }
+    }
+};
+
+struct FieldReader {
+    std::istream* stream;
+    bool ok;
+    template<typename T>
+    void operator()(const char*, T& value) { ok = ok && ReadRaw(*stream, &value, 1); }
+    void operator()(const char*, std::string& value)
+    {
+        uint32_t size;
+        if(!(ok = ok && ReadRaw(*stream, &size, 1))) return;
+        value.resize(size);
+        if(size)
+            ok = ReadRaw(*stream, &value[0], size);
+    }
+    template<typename T>
+    void operator()(const char*, std::vector<T>& value)
+    {
+        uint32_t size;
+        if(!(ok = ok && ReadRaw(*stream, &size, 1))) return;
+        value.resize(size);
+        if(size)
+            ok = ReadRaw(*stream, &value[0], size);
+    }
+    void operator()(const char*, std::vector<bool>& value)
+    {
+        uint32_t size;
+        if(!(ok = ok && ReadRaw(*stream, &size, 1))) return;
+        value.resize(size);
+        for(uint32_t n = 0; ok && n < size; ++n) {
+            bool element;
+            ok = ReadRaw(*stream, &element, 1);
+            value[n] = element;
+        }
+    }
+};
+} // detail
+
+/// Writes the header that describes the fields of Record.
+template<typename Record>
+void WriteHeader(std::ostream& stream)
+{
+    detail::SchemaCollector collector;
+    const Record record = Record();
+    Record::Schema(record, collector);
+    stream.write(detail::Magic, detail::MagicSize);
+    const uint32_t nFields = collector.fields.size();
+    detail::WriteRaw(stream, &nFields, 1);
+    for(uint32_t n = 0; n < nFields; ++n) {
+        const detail::FieldDescription& field = collector.fields[n];
+        const uint32_t nameSize = field.name.size();
+        detail::WriteRaw(stream, &field.type, 1);
+        detail::WriteRaw(stream, &nameSize, 1);
+        detail::WriteRaw(stream, field.name.data(), nameSize);
+    }
+}
+
+template<typename Record>
+void WriteEntry(std::ostream& stream, const Record& record)
+{
+    detail::FieldWriter writer;
+    writer.stream = &stream;
+    Record::Schema(record, writer);
+}
+
+/// Reads the header and checks that it describes the same fields as Record, throws std::runtime_error otherwise.
+template<typename Record>
+void ReadHeader(std::istream& stream)
+{
+    char magic[detail::MagicSize];
+    uint32_t nFields;
+    if(!detail::ReadRaw(stream, magic, detail::MagicSize) || std::string(magic, detail::MagicSize) != detail::Magic
+            || !detail::ReadRaw(stream, &nFields, 1))
+        throw std::runtime_error("Invalid flat record header.");
+
+    detail::SchemaCollector collector;
+    const Record record = Record();
+    Record::Schema(record, collector);
+    if(nFields != collector.fields.size())
+        throw std::runtime_error("Flat record schema mismatch.");
+    for(uint32_t n = 0; n < nFields; ++n) {
+        uint8_t type;
+        uint32_t nameSize;
+        if(!detail::ReadRaw(stream, &type, 1) || !detail::ReadRaw(stream, &nameSize, 1))
+            throw std::runtime_error("Invalid flat record header.");
+        std::string name(nameSize, ' ');
+        if(nameSize && !detail::ReadRaw(stream, &name[0], nameSize))
+            throw std::runtime_error("Invalid flat record header.");
+        if(type != collector.fields[n].type || name != collector.fields[n].name)
+            throw std::runtime_error("Flat record schema mismatch.");
+    }
+}
+
+/// Returns false if the stream ends before the entry, throws std::runtime_error if it ends within the entry.
+template<typename Record>
+bool ReadEntry(std::istream& stream, Record& record)
+{
+    if(stream.peek() == std::istream::traits_type::eof())
+        return false;
+    detail::FieldReader reader;
+    reader.stream = &stream;
+    reader.ok = true;
+    Record::Schema(record, reader);
+    if(!reader.ok)
+        throw std::runtime_error("Truncated flat record entry.");
+    return true;
+}
+
+} // flat
+} // root_ext
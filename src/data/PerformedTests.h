@@ -6,7 +6,7 @@
 
 #pragma once
 
-#include "data/SmartTree.h"
+#include "data/RecordTree.h"
 
 namespace psi {
 namespace data {
@@ -21,29 +21,23 @@ struct TestRecord {
     TestRecord() : id(0), result(0) {}
     TestRecord(unsigned _id, const std::string& _name, const std::string _start_time)
         : id(_id), name(_name), start_time(_start_time), result(0) {}
+
+    template<typename Record, typename Visitor>
+    static void Schema(Record& record, Visitor& visitor)
+    {
+        visitor("id", record.id);
+        visitor("name", record.name);
+        visitor("start_time", record.start_time);
+        visitor("end_time", record.end_time);
+        visitor("result", record.result);
+    }
 };
 
-class PerformedTests : public root_ext::SmartTree {
+class PerformedTests : public root_ext::RecordTree<TestRecord> {
 public:
     static std::string TreeName() { return "performed_tests"; }
-    PerformedTests() : SmartTree(TreeName()) {}
-    PerformedTests(TFile& file) : SmartTree(TreeName(), file) {}
-
-    SIMPLE_TREE_BRANCH(UInt_t, id, 0)
-    POINTER_TREE_BRANCH(std::string, name)
-    POINTER_TREE_BRANCH(std::string, start_time)
-    POINTER_TREE_BRANCH(std::string, end_time)
-    SIMPLE_TREE_BRANCH(UInt_t, result, 0)
-
-    void Fill(const TestRecord& record)
-    {
-        id() = record.id;
-        name() = record.name;
-        start_time() = record.start_time;
-        end_time() = record.end_time;
-        result() = record.result;
-        SmartTree::Fill();
-    }
+    PerformedTests() : RecordTree(TreeName()) {}
+    PerformedTests(TFile& file) : RecordTree(TreeName(), file) {}
 };
 
 } // data
@@ -0,0 +1,27 @@
+/*!
+ * \file PhaseProfile.h
+ * \brief Definition of PhaseProfile class.
+ */
+
+#pragma once
+
+#include "data/SmartTree.h"
+
+namespace psi {
+namespace data {
+/*!
+ * Wall and testboard time of the phases of one test, one entry per phase path in the order of the first start.
+ * The path starts with the test name, the depth is the number of enclosing phases. Times are in seconds.
+ */
+class PhaseProfile : public root_ext::SmartTree {
+public:
+    PhaseProfile(const std::string& treeName) : SmartTree(treeName) {}
+    PhaseProfile(const std::string& treeName, TFile& file) : SmartTree(treeName, file) {}
+    POINTER_TREE_BRANCH(std::string, phase)
+    SIMPLE_TREE_BRANCH(UInt_t, depth, 0)
+    SIMPLE_TREE_BRANCH(ULong64_t, calls, 0)
+    SIMPLE_TREE_BRANCH(Double_t, wall_time, 0)
+    SIMPLE_TREE_BRANCH(Double_t, tb_time, 0)
+};
+} // data
+} // psi
@@ -0,0 +1,284 @@
+/*!
+ * \file PixelRawDataFile.h
+ * \brief Definition of the compressed columnar binary format for the raw per-pixel test data.
+ *
+ * File layout (host byte order, the structs are written as they are in memory):
+ *   FileHeader, FileHeader::nParameters x int32 parameters,
+ *   FileHeader::nRocs x (BlockHeader, zlib-compressed block payload).
+ * Block payload is columnar: nPixels x uint8 column, nPixels x uint8 row, nPixels x int16 offset,
+ *   nPixels x uint8 count, nPixels x valuesPerPixel x int16 values.
+ * The reader checks the kind and all sizes, so a file written on a host with the other byte order is rejected.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace psi {
+namespace data {
+
+enum class PixelRawDataKind { SCurve = 1, PHCalibration = 2 };
+
+namespace detail {
+static const char PixelRawDataMagic[8] = { 'P', 'S', 'I', 'R', 'A', 'W', '0', '1' };
+static const uint32_t MaxParameters = 1024, MaxValuesPerPixel = 1024, MaxPixelsPerRoc = 52 * 80;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t kind;
+    uint32_t valuesPerPixel;
+    uint32_t nParameters;
+    uint32_t nRocs;
+};
+
+struct BlockHeader {
+    uint32_t chipId;
+    uint32_t nPixels;
+    uint32_t compressedSize;
+    uint32_t uncompressedSize;
+};
+
+template<typename Value>
+void AppendColumn(std::vector<char>& payload, const std::vector<Value>& column)
+{
+    const size_t size = column.size() * sizeof(Value);
+    const size_t position = payload.size();
+    payload.resize(position + size);
+    if(size)
+        std::memcpy(payload.data() + position, column.data(), size);
+}
+
+/// Size of the payload of a block: the address, offset and count columns and valuesPerPixel values per pixel.
+inline uint64_t BlockPayloadSize(uint32_t nPixels, uint32_t valuesPerPixel)
+{
+    const uint64_t pixelSize = 2 * sizeof(uint8_t) + sizeof(int16_t) + sizeof(uint8_t)
+            + uint64_t(valuesPerPixel) * sizeof(int16_t);
+    return nPixels * pixelSize;
+}
+
+template<typename Value>
+const char* ExtractColumn(const char* position, const char* end, size_t count, std::vector<Value>& column)
+{
+    const size_t size = count * sizeof(Value);
+    if(position + size > end)
+        throw std::runtime_error("Pixel raw data block is truncated.");
+    column.resize(count);
+    if(size)
+        std::memcpy(column.data(), position, size);
+    return position + size;
+}
+} // detail
+
+/*!
+ * \brief Raw data of all pixels of one ROC stored as contiguous columns.
+ */
+struct PixelRawDataBlock {
+    unsigned chipId;
+    unsigned valuesPerPixel;
+    std::vector<uint8_t> columns, rows, counts;
+    std::vector<int16_t> offsets, values;
+
+    PixelRawDataBlock() : chipId(0), valuesPerPixel(0) {}
+    PixelRawDataBlock(unsigned _chipId, unsigned _valuesPerPixel)
+        : chipId(_chipId), valuesPerPixel(_valuesPerPixel) {}
+
+    size_t NumberOfPixels() const { return columns.size(); }
+
+    /// Contiguous array of PixelValueCount(n) values measured for n-th pixel.
+    const int16_t* PixelValues(size_t n) const { return values.data() + n * valuesPerPixel; }
+    unsigned PixelValueCount(size_t n) const { return counts.at(n); }
+
+    void AddPixel(unsigned column, unsigned row, int offset, const int16_t* pixelValues, unsigned count)
+    {
+        if(count > valuesPerPixel)
+            throw std::runtime_error("Too many values for one pixel record.");
+        columns.push_back(column);
+        rows.push_back(row);
+        offsets.push_back(offset);
+        counts.push_back(count);
+        const size_t position = values.size();
+        values.resize(position + valuesPerPixel, 0);
+        std::copy(pixelValues, pixelValues + count, values.begin() + position);
+    }
+};
+
+/*!
+ * \brief Collects per-pixel records grouped by ROC and writes them in one pass on Close().
+ */
+class PixelRawDataWriter {
+public:
+    PixelRawDataWriter(const std::string& _fileName, PixelRawDataKind _kind, unsigned _valuesPerPixel,
+                       const std::vector<int32_t>& _parameters = std::vector<int32_t>())
+        : fileName(_fileName), kind(_kind), valuesPerPixel(_valuesPerPixel), parameters(_parameters), closed(false) {}
+
+    ~PixelRawDataWriter()
+    {
+        try {
+            Close();
+        } catch(std::exception&) {}
+    }
+
+    void AddPixel(unsigned chipId, unsigned column, unsigned row, int offset, const int16_t* pixelValues,
+                  unsigned count)
+    {
+        std::map<unsigned, PixelRawDataBlock>::iterator iter = blocks.find(chipId);
+        if(iter == blocks.end())
+            iter = blocks.insert(std::make_pair(chipId, PixelRawDataBlock(chipId, valuesPerPixel))).first;
+        iter->second.AddPixel(column, row, offset, pixelValues, count);
+    }
+
+    void Close()
+    {
+        if(closed) return;
+        closed = true;
+
+        std::ofstream file(fileName.c_str(), std::ios::binary);
+        if(!file.is_open())
+            throw std::runtime_error("Unable to create '" + fileName + "'.");
+
+        detail::FileHeader header;
+        std::memcpy(header.magic, detail::PixelRawDataMagic, sizeof(header.magic));
+        header.kind = static_cast<uint32_t>(kind);
+        header.valuesPerPixel = valuesPerPixel;
+        header.nParameters = parameters.size();
+        header.nRocs = blocks.size();
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if(!parameters.empty())
+            file.write(reinterpret_cast<const char*>(parameters.data()), parameters.size() * sizeof(int32_t));
+
+        for(std::map<unsigned, PixelRawDataBlock>::const_iterator iter = blocks.begin(); iter != blocks.end(); ++iter)
+            WriteBlock(file, iter->second);
+        if(!file.good())
+            throw std::runtime_error("Error while writing '" + fileName + "'.");
+    }
+
+private:
+    static void WriteBlock(std::ofstream& file, const PixelRawDataBlock& block)
+    {
+        std::vector<char> payload;
+        detail::AppendColumn(payload, block.columns);
+        detail::AppendColumn(payload, block.rows);
+        detail::AppendColumn(payload, block.offsets);
+        detail::AppendColumn(payload, block.counts);
+        detail::AppendColumn(payload, block.values);
+
+        uLongf compressedSize = compressBound(payload.size());
+        std::vector<Bytef> compressed(compressedSize);
+        if(compress2(compressed.data(), &compressedSize, reinterpret_cast<const Bytef*>(payload.data()),
+                     payload.size(), Z_BEST_SPEED) != Z_OK)
+            throw std::runtime_error("Unable to compress pixel raw data block.");
+
+        detail::BlockHeader header;
+        header.chipId = block.chipId;
+        header.nPixels = block.NumberOfPixels();
+        header.compressedSize = compressedSize;
+        header.uncompressedSize = payload.size();
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(compressed.data()), compressedSize);
+    }
+
+private:
+    std::string fileName;
+    PixelRawDataKind kind;
+    unsigned valuesPerPixel;
+    std::vector<int32_t> parameters;
+    std::map<unsigned, PixelRawDataBlock> blocks;
+    bool closed;
+};
+
+/*!
+ * \brief Reads a whole pixel raw data file into memory.
+ *
+ * Throws std::runtime_error if the file holds another kind of data, if any size in the headers is out of range or
+ * does not match the payload, or if the file is truncated.
+ */
+class PixelRawDataReader {
+public:
+    PixelRawDataReader(const std::string& fileName, PixelRawDataKind expectedKind)
+    {
+        std::ifstream file(fileName.c_str(), std::ios::binary);
+        if(!file.is_open())
+            throw std::runtime_error("Unable to open '" + fileName + "'.");
+
+        detail::FileHeader header;
+        if(!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+                || std::memcmp(header.magic, detail::PixelRawDataMagic, sizeof(header.magic)))
+            throw std::runtime_error("'" + fileName + "' is not a pixel raw data file.");
+        if(header.kind != static_cast<uint32_t>(expectedKind))
+            throw std::runtime_error("'" + fileName + "' holds another kind of pixel raw data.");
+        if(!header.valuesPerPixel || header.valuesPerPixel > detail::MaxValuesPerPixel
+                || header.nParameters > detail::MaxParameters)
+            throw std::runtime_error("'" + fileName + "' has an invalid header.");
+        kind = expectedKind;
+        valuesPerPixel = header.valuesPerPixel;
+        parameters.resize(header.nParameters);
+        if(header.nParameters
+                && !file.read(reinterpret_cast<char*>(parameters.data()), header.nParameters * sizeof(int32_t)))
+            throw std::runtime_error("'" + fileName + "' is truncated.");
+
+        std::vector<Bytef> compressed;
+        std::vector<char> payload;
+        for(uint32_t n = 0; n < header.nRocs; ++n) {
+            detail::BlockHeader blockHeader;
+            if(!file.read(reinterpret_cast<char*>(&blockHeader), sizeof(blockHeader)))
+                throw std::runtime_error("'" + fileName + "' is truncated.");
+            if(blockHeader.nPixels > detail::MaxPixelsPerRoc
+                    || blockHeader.uncompressedSize != detail::BlockPayloadSize(blockHeader.nPixels, valuesPerPixel)
+                    || blockHeader.compressedSize > compressBound(blockHeader.uncompressedSize))
+                throw std::runtime_error("'" + fileName + "' has an invalid block header.");
+            compressed.resize(blockHeader.compressedSize);
+            if(!file.read(reinterpret_cast<char*>(compressed.data()), blockHeader.compressedSize))
+                throw std::runtime_error("'" + fileName + "' is truncated.");
+            payload.resize(blockHeader.uncompressedSize);
+            uLongf size = payload.size();
+            if(uncompress(reinterpret_cast<Bytef*>(payload.data()), &size, compressed.data(),
+                          compressed.size()) != Z_OK || size != payload.size())
+                throw std::runtime_error("Unable to decompress block in '" + fileName + "'.");
+
+            PixelRawDataBlock block(blockHeader.chipId, valuesPerPixel);
+            const size_t nPixels = blockHeader.nPixels;
+            const char* position = payload.data();
+            const char* end = position + payload.size();
+            position = detail::ExtractColumn(position, end, nPixels, block.columns);
+            position = detail::ExtractColumn(position, end, nPixels, block.rows);
+            position = detail::ExtractColumn(position, end, nPixels, block.offsets);
+            position = detail::ExtractColumn(position, end, nPixels, block.counts);
+            detail::ExtractColumn(position, end, nPixels * valuesPerPixel, block.values);
+            for(size_t pixel = 0; pixel < nPixels; ++pixel) {
+                if(block.counts[pixel] > valuesPerPixel)
+                    throw std::runtime_error("'" + fileName + "' has a pixel record with too many values.");
+            }
+            blocks.push_back(block);
+        }
+    }
+
+    PixelRawDataKind Kind() const { return kind; }
+    unsigned ValuesPerPixel() const { return valuesPerPixel; }
+    const std::vector<int32_t>& Parameters() const { return parameters; }
+    size_t NumberOfRocs() const { return blocks.size(); }
+    const PixelRawDataBlock& Roc(size_t n) const { return blocks.at(n); }
+
+    const PixelRawDataBlock* FindRoc(unsigned chipId) const
+    {
+        for(std::vector<PixelRawDataBlock>::const_iterator iter = blocks.begin(); iter != blocks.end(); ++iter)
+            if(iter->chipId == chipId) return &(*iter);
+        return 0;
+    }
+
+private:
+    PixelRawDataKind kind;
+    unsigned valuesPerPixel;
+    std::vector<int32_t> parameters;
+    std::vector<PixelRawDataBlock> blocks;
+};
+
+} // data
+} // psi
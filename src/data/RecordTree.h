@@ -0,0 +1,191 @@
+/*!
+ * \file RecordTree.h
+ * \brief Definition of RecordTree class.
+ */
+
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include "data/FlatRecord.h"
+
+namespace root_ext {
+
+/*!
+ * \brief ROOT tree with the branches described at compile time by a record struct.
+ *
+ * The record type defines its fields with a static Schema member template, see FlatRecord.h. The branches are
+ * created once, in the constructor, with the addresses of the fields of a single record buffer, so a fill is one copy
+ * of the record followed by TTree::Fill, and a read is TTree::GetEntry into the same buffer. Records added with Push
+ * are kept in memory and filled in one batch by Flush or Write. Like in SmartTree, object fields (strings and vectors)
+ * are read through a pointer to the field, which ROOT requires for object branches.
+ */
+template<typename Record>
+class RecordTree {
+public:
+    explicit RecordTree(const std::string& name, bool detachFromFile = true)
+        : readMode(false), tree(new TTree(name.c_str(), name.c_str()))
+    {
+        if(detachFromFile)
+            tree->SetDirectory(0);
+        BranchCreator creator = { tree };
+        Record::Schema(buffer, creator);
+    }
+
+    /// Opens an existing tree for reading. Fields without a branch in the tree keep their default values.
+    RecordTree(const std::string& name, TFile& file)
+        : readMode(true)
+    {
+        tree = static_cast<TTree*>(file.Get(name.c_str()));
+        if(!tree)
+            throw std::runtime_error("Tree not found.");
+        if(tree->GetNbranches())
+            tree->SetBranchStatus("*", 0);
+        BranchAttacher attacher = { tree, &objectAddresses };
+        Record::Schema(buffer, attacher);
+    }
+
+    virtual ~RecordTree()
+    {
+        if(!readMode)
+            delete tree;
+    }
+
+    void Fill(const Record& record)
+    {
+        buffer = record;
+        tree->Fill();
+    }
+
+    template<typename Iterator>
+    void Fill(Iterator first, Iterator last)
+    {
+        for(; first != last; ++first) {
+            buffer = *first;
+            tree->Fill();
+        }
+    }
+
+    void Push(const Record& record) { pending.push_back(record); }
+
+    /// Removes all entries, including the pending ones.
+    void Reset()
+    {
+        pending.clear();
+        tree->Reset();
+    }
+
+    void Flush()
+    {
+        Fill(pending.begin(), pending.end());
+        pending.clear();
+    }
+
+    Long64_t GetEntries() const { return tree->GetEntries(); }
+
+    const Record& GetEntry(Long64_t entry)
+    {
+        tree->GetEntry(entry);
+        return buffer;
+    }
+
+    void ReadAll(std::vector<Record>& records)
+    {
+        const Long64_t nEntries = tree->GetEntries();
+        records.reserve(records.size() + nEntries);
+        for(Long64_t n = 0; n < nEntries; ++n)
+            records.push_back(GetEntry(n));
+    }
+
+    void Write(const char* name = 0, Int_t option = 0)
+    {
+        Flush();
+        tree->Write(name, option);
+    }
+
+    /// Writes all entries of the tree in the flat binary form described in FlatRecord.h.
+    void WriteFlat(std::ostream& stream)
+    {
+        Flush();
+        flat::WriteHeader<Record>(stream);
+        const Long64_t nEntries = tree->GetEntries();
+        for(Long64_t n = 0; n < nEntries; ++n)
+            flat::WriteEntry(stream, GetEntry(n));
+    }
+
+    TTree& RootTree() { return *tree; }
+
+private:
+    struct BranchCreator {
+        TTree* tree;
+        template<typename T>
+        void operator()(const char* name, T& value) { tree->Branch(name, &value); }
+    };
+
+    struct ObjectAddress {
+        virtual ~ObjectAddress() {}
+    };
+
+    template<typename T>
+    struct TypedObjectAddress : public ObjectAddress {
+        T* pointer;
+        explicit TypedObjectAddress(T* _pointer) : pointer(_pointer) {}
+    };
+
+    typedef std::vector< std::unique_ptr<ObjectAddress> > ObjectAddressCollection;
+
+    struct BranchAttacher {
+        TTree* tree;
+        ObjectAddressCollection* objectAddresses;
+
+        template<typename T>
+        void operator()(const char* name, T& value)
+        {
+            if(EnableBranch(name))
+                tree->SetBranchAddress(name, &value);
+        }
+
+        void operator()(const char* name, std::string& value) { AttachObject(name, value); }
+
+        template<typename T>
+        void operator()(const char* name, std::vector<T>& value) { AttachObject(name, value); }
+
+        template<typename T>
+        void AttachObject(const char* name, T& value)
+        {
+            if(!EnableBranch(name))
+                return;
+            TypedObjectAddress<T>* address = new TypedObjectAddress<T>(&value);
+            objectAddresses->push_back(std::unique_ptr<ObjectAddress>(address));
+            tree->SetBranchAddress(name, &address->pointer);
+        }
+
+        bool EnableBranch(const char* name)
+        {
+            if(!tree->GetBranch(name))
+                return false;
+            tree->SetBranchStatus(name, 1);
+            return true;
+        }
+    };
+
+private:
+    RecordTree(const RecordTree&);
+    RecordTree& operator=(const RecordTree&);
+
+private:
+    bool readMode;
+    TTree* tree;
+    Record buffer;
+    std::vector<Record> pending;
+    ObjectAddressCollection objectAddresses;
+};
+
+} // root_ext
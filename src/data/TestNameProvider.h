@@ -25,6 +25,16 @@ struct TestNameProvider {
         return TestResultsTreeName(testId, testName) + "_params";
     }
 
+    static std::string TestCommandStatisticsTreeName(unsigned testId, const std::string& testName)
+    {
+        return TestResultsTreeName(testId, testName) + "_tb_commands";
+    }
+
+    static std::string TestProfileTreeName(unsigned testId, const std::string& testName)
+    {
+        return TestResultsTreeName(testId, testName) + "_profile";
+    }
+
     static const std::string& BumpBondingTestName() { static std::string name = "BumpBonding"; return name; }
 
 private:
@@ -0,0 +1,196 @@
+/*!
+ * \file FtdiTransport.cc
+ * \brief Implementation of FtdiTransport class.
+ */
+
+#include "../config.h"
+#if HAVE_LIBUSB_1_0
+#  include <libusb-1.0/libusb.h>
+#endif
+
+#include <string>
+
+#include "psi/log.h"
+#include "psi/date_time.h"
+
+#include "FtdiTransport.h"
+
+namespace psi {
+
+bool FtdiTransport::EnumFirst(unsigned int &nDevices)
+{
+    status = FT_ListDevices(&enumCount, NULL, FT_LIST_NUMBER_ONLY);
+    if (status != FT_OK) {
+        nDevices = enumCount = enumPos = 0;
+        return false;
+    }
+
+    nDevices = enumCount;
+    enumPos = 0;
+    return true;
+}
+
+
+bool FtdiTransport::EnumNext(char name[])
+{
+    if (enumPos >= enumCount) return false;
+    status = FT_ListDevices((PVOID)enumPos, name, FT_LIST_BY_INDEX);
+    if (status != FT_OK) {
+        enumCount = enumPos = 0;
+        return false;
+    }
+
+    enumPos++;
+    return true;
+}
+
+
+bool FtdiTransport::Open(const char* serialNumber)
+{
+    status = FT_OpenEx((PVOID)serialNumber, FT_OPEN_BY_SERIAL_NUMBER, &ftHandle);
+    if (status != FT_OK) {
+        /* maybe the ftdi_sio and usbserial kernel modules are attached to the device */
+        if (!DetachKernelDriver(serialNumber))
+            return false;
+
+        /* try to re-open with the detached device */
+        status = FT_OpenEx((PVOID)serialNumber, FT_OPEN_BY_SERIAL_NUMBER, &ftHandle);
+        if (status != FT_OK)
+            return false;
+    }
+
+    FT_SetTimeouts(ftHandle, LinkTimeout, LinkTimeout);
+    return true;
+}
+
+
+bool FtdiTransport::DetachKernelDriver(const char* serialNumber)
+{
+#if HAVE_LIBUSB_1_0
+    /* try to detach the kernel modules using the libusb library directly */
+
+    /* prepare libusb structures */
+    libusb_device ** list;
+    libusb_device_handle *handle;
+    struct libusb_device_descriptor descriptor;
+
+    /* initialise libusb and get device list*/
+    libusb_init(NULL);
+    ssize_t ndevices = libusb_get_device_list(NULL, &list);
+    if (ndevices < 0)
+        return false;
+
+    char serial [20];
+
+    bool found = false;
+
+    /* loop over all USB devices */
+    for (int dev = 0; dev < ndevices; dev++) {
+        /* get the device descriptor */
+        int ok = libusb_get_device_descriptor(list[dev], &descriptor);
+        if (ok != 0)
+            continue;
+
+        /* we're only interested in devices with one vendor and product ID */
+        if (descriptor.idVendor != 0x0403 || descriptor.idProduct != 0x6001)
+            continue;
+
+        /* open the device */
+        ok = libusb_open(list[dev], &handle);
+        if (ok != 0)
+            continue;
+
+        /* Read the serial number from the device */
+        ok = libusb_get_string_descriptor_ascii(handle, descriptor.iSerialNumber, (unsigned char *) serial, 20);
+        if (ok < 0)
+            continue;
+
+        /* Check the device serial number */
+        if (std::string(serialNumber) == std::string(serial)) {
+            /* that's our device */
+            found = true;
+
+            /* Detach the kernel module from the device */
+            ok = libusb_detach_kernel_driver(handle, 0);
+            if (ok == 0)
+                psi::LogInfo() << "Detached kernel driver from selected testboard.\n";
+            else
+                psi::LogInfo() << "Unable to detach kernel driver from selected testboard.\n";
+            break;
+        }
+
+        libusb_close(handle);
+    }
+
+    libusb_free_device_list(list, 1);
+
+    /* if the device was not found in the previous loop, don't try again */
+    return found;
+#else
+    return false;
+#endif /* HAVE_LIBUSB_1_0 */
+}
+
+
+void FtdiTransport::Close()
+{
+    FT_Close(ftHandle);
+}
+
+
+bool FtdiTransport::Write(const void* data, uint32_t size)
+{
+    DWORD bytesWritten;
+    status = FT_Write(ftHandle, (void*)data, size, &bytesWritten);
+    if (status != FT_OK) return false;
+    if (bytesWritten != size) {
+        status = FT_IO_ERROR;
+        return false;
+    }
+    return true;
+}
+
+
+bool FtdiTransport::Read(void* buffer, uint32_t size, uint32_t& received)
+{
+    DWORD bytesRead = 0;
+    status = FT_Read(ftHandle, buffer, size, &bytesRead);
+    received = bytesRead;
+    return status == FT_OK;
+}
+
+
+bool FtdiTransport::BytesAvailable(uint32_t& size)
+{
+    DWORD bytesAvailable = 0;
+    status = FT_GetQueueStatus(ftHandle, &bytesAvailable);
+    size = bytesAvailable;
+    return status == FT_OK;
+}
+
+
+bool FtdiTransport::WaitForData(uint32_t minBytes, unsigned timeout)
+{
+    static const psi::Time pollInterval = 100.0 * psi::micro * psi::seconds;
+    static const psi::Time maxPollInterval = 5.0 * psi::milli * psi::seconds;
+
+    const psi::Time deadline = psi::DateTimeProvider::ElapsedTime() + double(timeout) * psi::milli * psi::seconds;
+    psi::Time interval = pollInterval;
+    for (;;) {
+        uint32_t bytesAvailable;
+        if (!BytesAvailable(bytesAvailable)) return false;
+        if (bytesAvailable >= minBytes) return true;
+        if (psi::DateTimeProvider::ElapsedTime() >= deadline) return false;
+        psi::Sleep(interval);
+        if (interval < maxPollInterval) interval = 2.0 * interval;
+    }
+}
+
+
+bool FtdiTransport::Purge()
+{
+    status = FT_Purge(ftHandle, FT_PURGE_RX | FT_PURGE_TX);
+    return status == FT_OK;
+}
+
+} // psi
@@ -0,0 +1,39 @@
+/*!
+ * \file FtdiTransport.h
+ * \brief Definition of FtdiTransport class.
+ */
+
+#pragma once
+
+#include "ftd2xx.h"
+#include "UsbTransport.h"
+
+namespace psi {
+
+/// Synchronous transport through the FTDI D2XX library.
+class FtdiTransport : public UsbTransport {
+public:
+    FtdiTransport() : ftHandle(0), enumPos(0), enumCount(0) {}
+
+    virtual bool EnumFirst(unsigned int &nDevices);
+    virtual bool EnumNext(char name[]);
+    virtual bool Open(const char* serialNumber);
+    virtual void Close();
+    virtual bool Write(const void* data, uint32_t size);
+    virtual bool Read(void* buffer, uint32_t size, uint32_t& received);
+    virtual bool BytesAvailable(uint32_t& size);
+
+    /// Polls FT_GetQueueStatus with an interval growing from 100 us up to 5 ms.
+    virtual bool WaitForData(uint32_t minBytes, unsigned timeout);
+    virtual bool Purge();
+
+private:
+    bool DetachKernelDriver(const char* serialNumber);
+
+private:
+    FT_HANDLE ftHandle;
+    uintptr_t enumPos;
+    unsigned int enumCount;
+};
+
+} // psi
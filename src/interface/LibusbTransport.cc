@@ -0,0 +1,365 @@
+/*!
+ * \file LibusbTransport.cc
+ * \brief Implementation of LibusbTransport class.
+ */
+
+#include "../config.h"
+#if HAVE_LIBUSB_1_0
+#include <libusb-1.0/libusb.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "ftd2xx.h"
+#include "psi/log.h"
+#include "psi/exception.h"
+#include "LibusbTransport.h"
+
+namespace {
+const uint16_t TestboardVendorId = 0x0403;
+const uint16_t TestboardProductId = 0x6001;
+const int Interface = 0;
+const unsigned char EndpointIn = 0x81;
+const unsigned char EndpointOut = 0x02;
+
+// Vendor requests of the FTDI chip, as used by libftdi.
+const unsigned char FtdiRequestReset = 0x00;
+const unsigned char FtdiRequestSetLatencyTimer = 0x09;
+const unsigned short FtdiResetSio = 0;
+const unsigned short FtdiPurgeRx = 1;
+const unsigned short FtdiPurgeTx = 2;
+const unsigned short FtdiPortIndex = 1;
+const unsigned short FtdiLatencyTimer = 16; // ms, default of the D2XX library
+
+/// Every bulk-in packet of the FTDI chip starts with two modem status bytes.
+const int FtdiStatusSize = 2;
+const int DefaultMaxPacketSize = 64;
+const size_t SerialNumberSize = 64;
+}
+
+namespace psi {
+
+LibusbTransport::LibusbTransport()
+    : context(0), handle(0), enumPos(0), transferBuffers(NumberOfTransfers * TransferSize), transfersInFlight(0),
+      maxPacketSize(DefaultMaxPacketSize), closing(false), linkError(FT_OK), inputPos(0)
+{
+    const int result = libusb_init(&context);
+    if(result != LIBUSB_SUCCESS)
+        THROW_PSI_EXCEPTION("Unable to initialize libusb: " << libusb_error_name(result) << ".");
+}
+
+LibusbTransport::~LibusbTransport()
+{
+    Close();
+    libusb_exit(context);
+}
+
+bool LibusbTransport::EnumFirst(unsigned int &nDevices)
+{
+    serialNumbers.clear();
+    enumPos = 0;
+    nDevices = 0;
+    OpenTestboard(0, &serialNumbers);
+    nDevices = serialNumbers.size();
+    return status == FT_OK;
+}
+
+bool LibusbTransport::EnumNext(char name[])
+{
+    if(enumPos >= serialNumbers.size()) return false;
+    std::strcpy(name, serialNumbers[enumPos].c_str());
+    enumPos++;
+    return true;
+}
+
+libusb_device_handle* LibusbTransport::OpenTestboard(const char* serialNumber,
+                                                     std::vector<std::string>* serialNumbers)
+{
+    libusb_device** list;
+    const ssize_t nDevices = libusb_get_device_list(context, &list);
+    if(nDevices < 0) {
+        Failed(nDevices);
+        return 0;
+    }
+    status = FT_OK;
+
+    libusb_device_handle* testboard = 0;
+    for(ssize_t n = 0; n < nDevices && !testboard; ++n) {
+        libusb_device_descriptor descriptor;
+        if(libusb_get_device_descriptor(list[n], &descriptor) != LIBUSB_SUCCESS
+                || descriptor.idVendor != TestboardVendorId || descriptor.idProduct != TestboardProductId)
+            continue;
+
+        libusb_device_handle* device;
+        if(libusb_open(list[n], &device) != LIBUSB_SUCCESS)
+            continue;
+        unsigned char serial[SerialNumberSize];
+        const int length = libusb_get_string_descriptor_ascii(device, descriptor.iSerialNumber, serial,
+                                                              sizeof(serial));
+        if(length > 0) {
+            const std::string deviceSerialNumber(reinterpret_cast<char*>(serial), length);
+            if(serialNumbers)
+                serialNumbers->push_back(deviceSerialNumber);
+            if(serialNumber && deviceSerialNumber == serialNumber) {
+                testboard = device;
+                continue;
+            }
+        }
+        libusb_close(device);
+    }
+
+    libusb_free_device_list(list, 1);
+    if(serialNumber && !testboard && status == FT_OK)
+        status = FT_DEVICE_NOT_FOUND;
+    return testboard;
+}
+
+bool LibusbTransport::Open(const char* serialNumber)
+{
+    handle = OpenTestboard(serialNumber, 0);
+    if(!handle) return false;
+
+    if(libusb_kernel_driver_active(handle, Interface) == 1) {
+        if(libusb_detach_kernel_driver(handle, Interface) == LIBUSB_SUCCESS)
+            psi::LogInfo() << "Detached kernel driver from selected testboard.\n";
+        else
+            psi::LogInfo() << "Unable to detach kernel driver from selected testboard.\n";
+    }
+
+    int result = libusb_claim_interface(handle, Interface);
+    if(result != LIBUSB_SUCCESS) {
+        libusb_close(handle);
+        handle = 0;
+        return Failed(result);
+    }
+
+    maxPacketSize = libusb_get_max_packet_size(libusb_get_device(handle), EndpointIn);
+    if(maxPacketSize <= FtdiStatusSize)
+        maxPacketSize = DefaultMaxPacketSize;
+
+    closing = false;
+    linkError = FT_OK;
+    inputQueue.clear();
+    inputPos = 0;
+    if(!Control(FtdiRequestReset, FtdiResetSio) || !Control(FtdiRequestSetLatencyTimer, FtdiLatencyTimer)
+            || !Control(FtdiRequestReset, FtdiPurgeRx) || !Control(FtdiRequestReset, FtdiPurgeTx)) {
+        Close();
+        return false;
+    }
+
+    for(unsigned n = 0; n < NumberOfTransfers; ++n) {
+        libusb_transfer* transfer = libusb_alloc_transfer(0);
+        if(!transfer) {
+            Close();
+            status = FT_INSUFFICIENT_RESOURCES;
+            return false;
+        }
+        libusb_fill_bulk_transfer(transfer, handle, EndpointIn, &transferBuffers[n * TransferSize], TransferSize,
+                                  &LibusbTransport::ReadCallback, this, 0);
+        transfers.push_back(transfer);
+        Submit(transfer);
+    }
+    if(linkError != FT_OK) {
+        status = linkError;
+        Close();
+        return false;
+    }
+    status = FT_OK;
+    return true;
+}
+
+void LibusbTransport::Close()
+{
+    if(!handle) return;
+
+    closing = true;
+    for(unsigned n = 0; n < transfers.size(); ++n)
+        libusb_cancel_transfer(transfers[n]);
+    while(transfersInFlight) {
+        if(libusb_handle_events(context) != LIBUSB_SUCCESS)
+            break;
+    }
+    for(unsigned n = 0; n < transfers.size(); ++n)
+        libusb_free_transfer(transfers[n]);
+    transfers.clear();
+    transfersInFlight = 0;
+
+    libusb_release_interface(handle, Interface);
+    libusb_close(handle);
+    handle = 0;
+    inputQueue.clear();
+    inputPos = 0;
+}
+
+bool LibusbTransport::Write(const void* data, uint32_t size)
+{
+    int transferred = 0;
+    const int result = libusb_bulk_transfer(handle, EndpointOut, (unsigned char*)data, size, &transferred,
+                                            LinkTimeout);
+    if(result != LIBUSB_SUCCESS) return Failed(result);
+    if(static_cast<uint32_t>(transferred) != size) {
+        status = FT_IO_ERROR;
+        return false;
+    }
+    return true;
+}
+
+bool LibusbTransport::Read(void* buffer, uint32_t size, uint32_t& received)
+{
+    received = 0;
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(LinkTimeout);
+    for(;;) {
+        const uint32_t n = std::min<size_t>(size - received, InputSize());
+        if(n) {
+            std::memcpy(static_cast<unsigned char*>(buffer) + received, &inputQueue[inputPos], n);
+            inputPos += n;
+            received += n;
+        }
+        if(received == size) return true;
+
+        // As FT_Read, a read that times out is not an error, it returns fewer bytes.
+        const Clock::time_point now = Clock::now();
+        if(now >= deadline) return true;
+        if(!HandleEvents(deadline - now)) return false;
+    }
+}
+
+bool LibusbTransport::BytesAvailable(uint32_t& size)
+{
+    const bool ok = HandleEvents(Clock::duration::zero());
+    size = InputSize();
+    return ok;
+}
+
+bool LibusbTransport::WaitForData(uint32_t minBytes, unsigned timeout)
+{
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    while(InputSize() < minBytes) {
+        const Clock::time_point now = Clock::now();
+        if(now >= deadline) return false;
+        if(!HandleEvents(deadline - now)) return false;
+    }
+    return true;
+}
+
+bool LibusbTransport::Purge()
+{
+    if(!Control(FtdiRequestReset, FtdiPurgeRx) || !Control(FtdiRequestReset, FtdiPurgeTx))
+        return false;
+    const bool ok = HandleEvents(Clock::duration::zero());
+    inputQueue.clear();
+    inputPos = 0;
+    return ok;
+}
+
+void LibusbTransport::ReadCallback(libusb_transfer* transfer)
+{
+    static_cast<LibusbTransport*>(transfer->user_data)->ReadCompleted(transfer);
+}
+
+void LibusbTransport::ReadCompleted(libusb_transfer* transfer)
+{
+    --transfersInFlight;
+    if(transfer->status == LIBUSB_TRANSFER_CANCELLED)
+        return;
+    if(transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+        // The error is reported by the next HandleEvents. Unless the device is gone, the transfer is submitted
+        // again, so that the input stream continues after the failed transfer.
+        const bool noDevice = transfer->status == LIBUSB_TRANSFER_NO_DEVICE;
+        if(linkError == FT_OK)
+            linkError = noDevice ? FT_DEVICE_NOT_FOUND : FT_IO_ERROR;
+        if(!noDevice && !closing)
+            Submit(transfer);
+        return;
+    }
+
+    // The consumed part of the queue is dropped before it becomes larger than the unread one.
+    if(inputPos == inputQueue.size()) {
+        inputQueue.clear();
+        inputPos = 0;
+    } else if(inputPos > InputSize()) {
+        inputQueue.erase(inputQueue.begin(), inputQueue.begin() + inputPos);
+        inputPos = 0;
+    }
+
+    for(int packet = 0; packet < transfer->actual_length; packet += maxPacketSize) {
+        const int packetEnd = std::min(packet + maxPacketSize, transfer->actual_length);
+        if(packetEnd - packet > FtdiStatusSize)
+            inputQueue.insert(inputQueue.end(), transfer->buffer + packet + FtdiStatusSize,
+                              transfer->buffer + packetEnd);
+    }
+
+    if(!closing)
+        Submit(transfer);
+}
+
+void LibusbTransport::Submit(libusb_transfer* transfer)
+{
+    const int result = libusb_submit_transfer(transfer);
+    if(result == LIBUSB_SUCCESS)
+        ++transfersInFlight;
+    else if(linkError == FT_OK)
+        linkError = result == LIBUSB_ERROR_NO_DEVICE ? FT_DEVICE_NOT_FOUND : FT_IO_ERROR;
+}
+
+bool LibusbTransport::Control(unsigned char request, unsigned short value)
+{
+    const uint8_t requestType = LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE | LIBUSB_ENDPOINT_OUT;
+    const int result = libusb_control_transfer(handle, requestType, request, value, FtdiPortIndex, 0, 0,
+                                               LinkTimeout);
+    return result < 0 ? Failed(result) : true;
+}
+
+bool LibusbTransport::HandleEvents(const Clock::duration& timeout)
+{
+    const long long us = std::chrono::duration_cast<std::chrono::microseconds>(timeout).count();
+    timeval tv;
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
+    const int result = libusb_handle_events_timeout_completed(context, &tv, 0);
+    if(result != LIBUSB_SUCCESS && result != LIBUSB_ERROR_INTERRUPTED)
+        return Failed(result);
+    if(linkError != FT_OK) {
+        status = linkError;
+        // A lost device stays an error, other transfer errors are reported once.
+        if(linkError != FT_DEVICE_NOT_FOUND)
+            linkError = FT_OK;
+        return false;
+    }
+    if(!transfersInFlight) {
+        status = FT_IO_ERROR;
+        return false;
+    }
+    return true;
+}
+
+bool LibusbTransport::Failed(int error)
+{
+    psi::LogDebug() << "[LibusbTransport] " << libusb_error_name(error) << ".\n";
+    switch(error) {
+    case LIBUSB_ERROR_NO_DEVICE:
+    case LIBUSB_ERROR_NOT_FOUND:
+        status = FT_DEVICE_NOT_FOUND;
+        break;
+    case LIBUSB_ERROR_INVALID_PARAM:
+        status = FT_INVALID_PARAMETER;
+        break;
+    case LIBUSB_ERROR_NO_MEM:
+        status = FT_INSUFFICIENT_RESOURCES;
+        break;
+    case LIBUSB_ERROR_NOT_SUPPORTED:
+        status = FT_NOT_SUPPORTED;
+        break;
+    case LIBUSB_ERROR_ACCESS:
+    case LIBUSB_ERROR_BUSY:
+        status = FT_DEVICE_NOT_OPENED;
+        break;
+    default:
+        status = FT_IO_ERROR;
+    }
+    return false;
+}
+
+} // psi
+
+#endif /* HAVE_LIBUSB_1_0 */
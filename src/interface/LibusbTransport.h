@@ -0,0 +1,79 @@
+/*!
+ * \file LibusbTransport.h
+ * \brief Definition of LibusbTransport class.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "UsbTransport.h"
+
+struct libusb_context;
+struct libusb_device_handle;
+struct libusb_transfer;
+
+namespace psi {
+
+/*!
+ * Asynchronous transport that talks to the FTDI chip of the testboard through libusb-1.0. Several bulk-in transfers
+ * are kept in flight all the time, so the testboard can send while the host is busy. The completion callbacks strip
+ * the FTDI status bytes and append the payload to the input queue with block copies, reads are served from there.
+ * The callbacks run inside libusb event handling, which is driven by Read, BytesAvailable and WaitForData.
+ */
+class LibusbTransport : public UsbTransport {
+public:
+    static const unsigned NumberOfTransfers = 8;
+    static const unsigned TransferSize = 16384;
+
+    LibusbTransport();
+    virtual ~LibusbTransport();
+
+    virtual bool EnumFirst(unsigned int &nDevices);
+    virtual bool EnumNext(char name[]);
+    virtual bool Open(const char* serialNumber);
+    virtual void Close();
+    virtual bool Write(const void* data, uint32_t size);
+    virtual bool Read(void* buffer, uint32_t size, uint32_t& received);
+    virtual bool BytesAvailable(uint32_t& size);
+    virtual bool WaitForData(uint32_t minBytes, unsigned timeout);
+    virtual bool Purge();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static void ReadCallback(libusb_transfer* transfer);
+    void ReadCompleted(libusb_transfer* transfer);
+    void Submit(libusb_transfer* transfer);
+
+    /// Opens the testboard with the given serial number. Serial numbers of all testboards are added to the list.
+    libusb_device_handle* OpenTestboard(const char* serialNumber, std::vector<std::string>* serialNumbers);
+    bool Control(unsigned char request, unsigned short value);
+    bool HandleEvents(const Clock::duration& timeout);
+    size_t InputSize() const {
+        return inputQueue.size() - inputPos;
+    }
+
+    /// Stores the FT_STATUS code that corresponds to the libusb error and returns false.
+    bool Failed(int error);
+
+private:
+    libusb_context* context;
+    libusb_device_handle* handle;
+    std::vector<std::string> serialNumbers;
+    unsigned enumPos;
+
+    std::vector<libusb_transfer*> transfers;
+    std::vector<unsigned char> transferBuffers;
+    unsigned transfersInFlight;
+    int maxPacketSize;
+    bool closing;
+    int linkError;
+
+    std::vector<unsigned char> inputQueue;
+    size_t inputPos;
+};
+
+} // psi
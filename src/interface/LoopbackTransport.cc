@@ -0,0 +1,93 @@
+/*!
+ * \file LoopbackTransport.cc
+ * \brief Implementation of LoopbackTransport class.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "ftd2xx.h"
+#include "LoopbackTransport.h"
+
+namespace psi {
+
+bool LoopbackTransport::EnumFirst(unsigned int &nDevices)
+{
+    nDevices = 1;
+    enumPos = 0;
+    status = FT_OK;
+    return true;
+}
+
+bool LoopbackTransport::EnumNext(char name[])
+{
+    if(enumPos >= 1) return false;
+    std::strcpy(name, "loopback");
+    enumPos++;
+    return true;
+}
+
+bool LoopbackTransport::Open(const char*)
+{
+    queue.clear();
+    readPos = 0;
+    isOpen = true;
+    status = FT_OK;
+    return true;
+}
+
+void LoopbackTransport::Close()
+{
+    isOpen = false;
+    queue.clear();
+    readPos = 0;
+}
+
+bool LoopbackTransport::Write(const void* data, uint32_t size)
+{
+    if(!isOpen) {
+        status = FT_DEVICE_NOT_OPENED;
+        return false;
+    }
+    // The consumed part is dropped once it is larger than the unread one, so that the queue does not grow forever.
+    if(readPos > queue.size() - readPos) {
+        queue.erase(queue.begin(), queue.begin() + readPos);
+        readPos = 0;
+    }
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    queue.insert(queue.end(), bytes, bytes + size);
+    return true;
+}
+
+bool LoopbackTransport::Read(void* buffer, uint32_t size, uint32_t& received)
+{
+    if(!isOpen) {
+        status = FT_DEVICE_NOT_OPENED;
+        return false;
+    }
+    received = std::min<size_t>(size, queue.size() - readPos);
+    if(received)
+        std::memcpy(buffer, &queue[readPos], received);
+    readPos += received;
+    return true;
+}
+
+bool LoopbackTransport::BytesAvailable(uint32_t& size)
+{
+    size = queue.size() - readPos;
+    return isOpen;
+}
+
+bool LoopbackTransport::WaitForData(uint32_t minBytes, unsigned)
+{
+    return isOpen && queue.size() - readPos >= minBytes;
+}
+
+bool LoopbackTransport::Purge()
+{
+    queue.clear();
+    readPos = 0;
+    return isOpen;
+}
+
+} // psi
@@ -0,0 +1,39 @@
+/*!
+ * \file LoopbackTransport.h
+ * \brief Definition of LoopbackTransport class.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "UsbTransport.h"
+
+namespace psi {
+
+/*!
+ * Stand-in for the testboard that returns every written byte back to the reader. It measures the throughput of the
+ * host side of the link without hardware, no testboard command is answered meaningfully.
+ */
+class LoopbackTransport : public UsbTransport {
+public:
+    LoopbackTransport() : isOpen(false), enumPos(0), readPos(0) {}
+
+    virtual bool EnumFirst(unsigned int &nDevices);
+    virtual bool EnumNext(char name[]);
+    virtual bool Open(const char* serialNumber);
+    virtual void Close();
+    virtual bool Write(const void* data, uint32_t size);
+    virtual bool Read(void* buffer, uint32_t size, uint32_t& received);
+    virtual bool BytesAvailable(uint32_t& size);
+    virtual bool WaitForData(uint32_t minBytes, unsigned timeout);
+    virtual bool Purge();
+
+private:
+    bool isOpen;
+    unsigned enumPos;
+    std::vector<unsigned char> queue;
+    size_t readPos;
+};
+
+} // psi
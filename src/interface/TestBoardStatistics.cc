@@ -0,0 +1,146 @@
+/*!
+ * \file TestBoardStatistics.cc
+ * \brief Implementation of TestBoardStatistics class.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "TestBoardStatistics.h"
+
+namespace {
+struct ByTotalTime {
+    const psi::TestBoardStatistics::Snapshot& counters;
+    explicit ByTotalTime(const psi::TestBoardStatistics::Snapshot& _counters) : counters(_counters) {}
+    bool operator()(unsigned first, unsigned second) const
+    {
+        return counters[first].TotalTime() > counters[second].TotalTime();
+    }
+};
+} // anonymous namespace
+
+namespace psi {
+
+TestBoardStatistics::Counters::Counters()
+    : calls(0), bytesOut(0), bytesIn(0), linkTime(0), sleepTime(0), maxLatency(0)
+{
+    std::fill(latency, latency + NumberOfLatencyBins, 0);
+}
+
+void TestBoardStatistics::Counters::Subtract(const Counters& other)
+{
+    calls -= other.calls;
+    bytesOut -= other.bytesOut;
+    bytesIn -= other.bytesIn;
+    linkTime -= other.linkTime;
+    sleepTime -= other.sleepTime;
+    for(unsigned n = 0; n < NumberOfLatencyBins; ++n)
+        latency[n] -= other.latency[n];
+}
+
+TestBoardStatistics::LinkTimer::~LinkTimer()
+{
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    TestBoardStatistics::Singleton().AddLinkTime(elapsed.count());
+}
+
+TestBoardStatistics& TestBoardStatistics::Singleton()
+{
+    static TestBoardStatistics statistics;
+    return statistics;
+}
+
+TestBoardStatistics::TestBoardStatistics()
+    : enabled(true), counters(NumberOfCommands), names(NumberOfCommands), current(NoCommand), callTime(0),
+      busyTime(0)
+{
+    names[NoCommand] = "(none)";
+}
+
+void TestBoardStatistics::SetCommandNames(const char* const* _names, unsigned nNames)
+{
+    for(unsigned n = 0; n < nNames && n < NoCommand; ++n)
+        names[n] = _names[n];
+}
+
+std::string TestBoardStatistics::CommandName(unsigned command) const
+{
+    if(command < NumberOfCommands && !names[command].empty())
+        return names[command];
+    std::ostringstream ss;
+    ss << "CMD_" << command;
+    return ss.str();
+}
+
+void TestBoardStatistics::BeginCommand(unsigned command)
+{
+    if(!enabled) return;
+    EndCall();
+    current = std::min(command, NoCommand);
+    ++counters[current].calls;
+}
+
+void TestBoardStatistics::AddLinkTime(double seconds)
+{
+    if(!enabled) return;
+    counters[current].linkTime += seconds;
+    callTime += seconds;
+    busyTime += seconds;
+}
+
+void TestBoardStatistics::AddSleepTime(double seconds)
+{
+    if(!enabled) return;
+    counters[current].sleepTime += seconds;
+    callTime += seconds;
+    busyTime += seconds;
+}
+
+void TestBoardStatistics::EndCall()
+{
+    Counters& c = counters[current];
+    unsigned bin = 0;
+    for(double us = callTime * 1e6; us >= 1 && bin < NumberOfLatencyBins - 1; us /= 2)
+        ++bin;
+    ++c.latency[bin];
+    c.maxLatency = std::max(c.maxLatency, callTime);
+    callTime = 0;
+}
+
+void TestBoardStatistics::Reset()
+{
+    std::fill(counters.begin(), counters.end(), Counters());
+    current = NoCommand;
+    callTime = 0;
+}
+
+void TestBoardStatistics::Print(std::ostream& s, const Snapshot& since) const
+{
+    Snapshot delta(counters);
+    if(since.size() == delta.size()) {
+        for(unsigned n = 0; n < NumberOfCommands; ++n)
+            delta[n].Subtract(since[n]);
+    }
+
+    std::vector<unsigned> order;
+    for(unsigned n = 0; n < NumberOfCommands; ++n) {
+        if(delta[n].calls || delta[n].TotalTime() > 0)
+            order.push_back(n);
+    }
+    std::sort(order.begin(), order.end(), ByTotalTime(delta));
+
+    s << std::left << std::setw(28) << "command" << std::right << std::setw(10) << "calls" << std::setw(12)
+      << "bytes out" << std::setw(12) << "bytes in" << std::setw(12) << "link, s" << std::setw(12) << "sleep, s"
+      << std::setw(12) << "max, ms" << "\n";
+    for(std::vector<unsigned>::const_iterator iter = order.begin(); iter != order.end(); ++iter) {
+        const Counters& c = delta[*iter];
+        s << std::left << std::setw(28) << CommandName(*iter) << std::right << std::setw(10) << c.calls
+          << std::setw(12) << c.bytesOut << std::setw(12) << c.bytesIn << std::fixed << std::setprecision(3)
+          << std::setw(12) << c.linkTime << std::setw(12) << c.sleepTime << std::setw(12) << c.maxLatency * 1e3
+          << "\n";
+        s.unsetf(std::ios_base::floatfield);
+    }
+}
+
+} // psi
@@ -0,0 +1,95 @@
+/*!
+ * \file TestBoardStatistics.h
+ * \brief Definition of TestBoardStatistics class.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*!
+ * Wraps a statement that records testboard statistics. The statement is removed when the statistics are disabled
+ * with 'configure --disable-tb-statistics'. Translation units that use it should include config.h first.
+ */
+#if ENABLE_TB_STATISTICS
+#  define TB_STATISTICS(statement) statement
+#else
+#  define TB_STATISTICS(statement)
+#endif
+
+namespace psi {
+
+/*!
+ * \brief Per-command statistics of the USB link to the testboard.
+ *
+ * Each command sent by CTestboard opens a call; the bytes written and read, the time spent in blocking USB
+ * operations and in fixed delays are attributed to the last command sent. The latency of a call is the sum of its
+ * link and sleep time, histogrammed in bins of powers of two microseconds. The statistics are not synchronized, they
+ * are only updated from the thread that talks to the testboard.
+ */
+class TestBoardStatistics {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const unsigned NumberOfCommands = 256;
+    static const unsigned NoCommand = NumberOfCommands - 1;
+    /// Bin 0 counts calls shorter than 1 us, bin n > 0 calls in [2^(n-1), 2^n) us, the last bin is open-ended.
+    static const unsigned NumberOfLatencyBins = 24;
+
+    struct Counters {
+        uint64_t calls, bytesOut, bytesIn;
+        double linkTime, sleepTime, maxLatency; // seconds
+        uint64_t latency[NumberOfLatencyBins];
+        Counters();
+        void Subtract(const Counters& other);
+        double TotalTime() const { return linkTime + sleepTime; }
+    };
+    typedef std::vector<Counters> Snapshot;
+
+    /// Measures the time of a blocking USB operation.
+    class LinkTimer {
+    public:
+        LinkTimer() : start(Clock::now()) {}
+        ~LinkTimer();
+    private:
+        Clock::time_point start;
+    };
+
+    static TestBoardStatistics& Singleton();
+
+    bool Enabled() const { return enabled; }
+    void Enable(bool enable) { enabled = enable; }
+    void SetCommandNames(const char* const* names, unsigned nNames);
+    std::string CommandName(unsigned command) const;
+
+    void BeginCommand(unsigned command);
+    void AddBytesOut(unsigned nBytes) { if(enabled) counters[current].bytesOut += nBytes; }
+    void AddBytesIn(unsigned nBytes) { if(enabled) counters[current].bytesIn += nBytes; }
+    void AddLinkTime(double seconds);
+    void AddSleepTime(double seconds);
+
+    const Snapshot& Current() const { return counters; }
+    /// Link and sleep time of all commands since the start of the program, not affected by Reset().
+    double BusyTime() const { return busyTime; }
+    void Reset();
+
+    /// Prints the commands that were called since the snapshot, the most time consuming first.
+    void Print(std::ostream& s, const Snapshot& since = Snapshot()) const;
+
+private:
+    TestBoardStatistics();
+    void EndCall();
+
+private:
+    bool enabled;
+    Snapshot counters;
+    std::vector<std::string> names;
+    unsigned current;
+    double callTime, busyTime;
+};
+
+} // psi
@@ -4,13 +4,16 @@
  */
 
 #include "../config.h"
-#if HAVE_LIBUSB_1_0_LIBUSB_H
-#  include <libusb-1.0/libusb.h>
-#endif
 
-#include "psi/log.h"
+#include <algorithm>
+#include <cstring>
+
+#include "psi/exception.h"
+#include "psi/date_time.h"
 
 #include "USBInterface.h"
+#include "FtdiTransport.h"
+#include "TestBoardStatistics.h"
 
 const char* CUSB::GetErrorMsg(int error)
 {
@@ -58,31 +61,52 @@ const char* CUSB::GetErrorMsg(int error)
 }
 
 
+CUSB::CUSB()
+    : isUSB_open(false), ftStatus(FT_OK), enumPos(0), enumCount(0), transport(new psi::FtdiTransport()), m_posW(0),
+      m_posR(0), m_sizeR(0)
+{
+}
+
+
+void CUSB::SetTransport(psi::UsbTransport* _transport)
+{
+    if (isUSB_open)
+        THROW_PSI_EXCEPTION("USB transport can not be changed while the connection is open.");
+    transport.reset(_transport);
+}
+
+
+bool CUSB::TransportFailed()
+{
+    ftStatus = transport->GetLastError();
+    return false;
+}
+
+
 bool CUSB::EnumFirst(unsigned int &nDevices)
 {
-    ftStatus = FT_ListDevices(&enumCount,
-                              NULL, FT_LIST_NUMBER_ONLY);
-    if (ftStatus != FT_OK) {
-        nDevices = enumCount = enumPos = 0;
-        return false;
+    if (replayer) {
+        nDevices = enumCount = 1;
+        enumPos = 0;
+        return true;
+    }
+    if (!transport->EnumFirst(nDevices)) {
+        nDevices = 0;
+        return TransportFailed();
     }
-
-    nDevices = enumCount;
-    enumPos = 0;
     return true;
 }
 
 
 bool CUSB::EnumNext(char name[])
 {
-    if (enumPos >= enumCount) return false;
-    ftStatus = FT_ListDevices((PVOID)enumPos, name, FT_LIST_BY_INDEX);
-    if (ftStatus != FT_OK) {
-        enumCount = enumPos = 0;
-        return false;
+    if (replayer) {
+        if (enumPos >= enumCount) return false;
+        std::strcpy(name, "replay");
+        enumPos++;
+        return true;
     }
-
-    enumPos++;
+    if (!transport->EnumNext(name)) return TransportFailed();
     return true;
 }
 
@@ -95,81 +119,9 @@ bool CUSB::Open(char serialNumber[])
     }
 
     m_posR = m_sizeR = m_posW = 0;
-    ftStatus = FT_OpenEx(serialNumber, FT_OPEN_BY_SERIAL_NUMBER, &ftHandle);
-    if (ftStatus != FT_OK) {
-#if HAVE_LIBUSB_1_0_LIBUSB_H
-        /* maybe the ftdi_sio and usbserial kernel modules are attached to the device */
-        /* try to detach them using the libusb library directly */
-
-        /* prepare libusb structures */
-        libusb_device ** list;
-        libusb_device_handle *handle;
-        struct libusb_device_descriptor descriptor;
-
-        /* initialise libusb and get device list*/
-        libusb_init(NULL);
-        ssize_t ndevices = libusb_get_device_list(NULL, &list);
-        if (ndevices < 0)
-            return false;
-
-        char serial [20];
-
-        bool found = false;
-
-        /* loop over all USB devices */
-        for (int dev = 0; dev < ndevices; dev++) {
-            /* get the device descriptor */
-            int ok = libusb_get_device_descriptor(list[dev], &descriptor);
-            if (ok != 0)
-                continue;
-
-            /* we're only interested in devices with one vendor and product ID */
-            if (descriptor.idVendor != 0x0403 || descriptor.idProduct != 0x6001)
-                continue;
-
-            /* open the device */
-            ok = libusb_open(list[dev], &handle);
-            if (ok != 0)
-                continue;
-
-            /* Read the serial number from the device */
-            ok = libusb_get_string_descriptor_ascii(handle, descriptor.iSerialNumber, (unsigned char *) serial, 20);
-            if (ok < 0)
-                continue;
-
-            /* Check the device serial number */
-            if (std::string(serialNumber) == std::string(serial)) {
-                /* that's our device */
-                found = true;
-
-                /* Detach the kernel module from the device */
-                ok = libusb_detach_kernel_driver(handle, 0);
-                if (ok == 0)
-                    psi::LogInfo() << "Detached kernel driver from selected testboard.\n";
-                else
-                    psi::LogInfo() << "Unable to detach kernel driver from selected testboard.\n";
-                break;
-            }
-
-            libusb_close(handle);
-        }
-
-        libusb_free_device_list(list, 1);
-
-        /* if the device was not found in the previous loop, don't try again */
-        if (!found)
-            return false;
-
-        /* try to re-open with the detached device */
-        ftStatus = FT_OpenEx(serialNumber, FT_OPEN_BY_SERIAL_NUMBER, &ftHandle);
-        if (ftStatus != FT_OK)
-            return false;
-#else
-        return false;
-#endif /* HAVE_LIBUSB_1_0_LIBUSB_H */
-    }
+    ftStatus = FT_OK;
+    if (!replayer && !transport->Open(serialNumber)) return TransportFailed();
 
-    FT_SetTimeouts(ftHandle, 300000, 300000);
     isUSB_open = true;
     return true;
 }
@@ -178,8 +130,35 @@ bool CUSB::Open(char serialNumber[])
 void CUSB::Close()
 {
     if (!isUSB_open) return;
-    FT_Close(ftHandle);
+    if (!replayer) transport->Close();
     isUSB_open = 0;
+    recorder.reset();
+    replayer.reset();
+}
+
+
+void CUSB::StartRecording(const std::string& traceFileName)
+{
+    replayer.reset();
+    recorder.reset(new psi::UsbTraceRecorder(traceFileName));
+}
+
+
+void CUSB::StartReplay(const std::string& traceFileName, double timeScale)
+{
+    recorder.reset();
+    replayer.reset(new psi::UsbTraceReplayer(traceFileName, timeScale));
+}
+
+
+void CUSB::Delay(const psi::Time& delay)
+{
+    if (replayer) {
+        replayer->ReplayDelay(delay / psi::seconds);
+        return;
+    }
+    psi::Sleep(delay);
+    if (recorder) recorder->RecordDelay(delay / psi::seconds);
 }
 
 
@@ -187,12 +166,17 @@ bool CUSB::Write(unsigned int bytesToWrite, const void *buffer)
 {
     if (!isUSB_open) return false;
 
-    unsigned int k = 0;
-    for (k = 0; k < bytesToWrite; k++) {
+    TB_STATISTICS(psi::TestBoardStatistics::Singleton().AddBytesOut(bytesToWrite));
+    const unsigned char* source = (const unsigned char*)buffer;
+    while (bytesToWrite) {
         if (m_posW >= USBWRITEBUFFERSIZE) {
             if (!Flush()) return false;
         }
-        m_bufferW[m_posW++] = ((unsigned char*)buffer)[k];
+        const unsigned int n = std::min<unsigned int>(bytesToWrite, USBWRITEBUFFERSIZE - m_posW);
+        std::memcpy(m_bufferW + m_posW, source, n);
+        m_posW += n;
+        source += n;
+        bytesToWrite -= n;
     }
     return true;
 }
@@ -200,22 +184,23 @@ bool CUSB::Write(unsigned int bytesToWrite, const void *buffer)
 
 bool CUSB::Flush()
 {
-    DWORD bytesWritten; // @KA : unsigned int -> DWORD
-    DWORD bytesToWrite = m_posW; // @KA : unsigned int -> DWORD
+    const uint32_t bytesToWrite = m_posW;
     m_posW = 0;
 
     if (!isUSB_open) return false;
 
     if (!bytesToWrite) return true;
 
-    ftStatus = FT_Write(ftHandle, m_bufferW, bytesToWrite, &bytesWritten);
-
-    if (ftStatus != FT_OK) return false;
-    if (bytesWritten != bytesToWrite) {
-        ftStatus = FT_IO_ERROR;
-        return false;
+    TB_STATISTICS(psi::TestBoardStatistics::LinkTimer linkTimer);
+    if (replayer) {
+        replayer->ReplayWrite(m_bufferW, bytesToWrite);
+        return true;
     }
 
+    const psi::UsbTrace::Clock::time_point start = psi::UsbTrace::Clock::now();
+    if (!transport->Write(m_bufferW, bytesToWrite)) return TransportFailed();
+    if (recorder) recorder->RecordWrite(m_bufferW, bytesToWrite, start);
+
     return true;
 }
 
@@ -223,22 +208,32 @@ bool CUSB::FillBuffer(unsigned int minBytesToRead)
 {
     if (!isUSB_open) return false;
 
-    DWORD bytesAvailable, bytesToRead; // @KA : unsigned int -> DWORD
+    if (replayer) {
+        if (m_posR < m_sizeR) return false;
+        TB_STATISTICS(psi::TestBoardStatistics::LinkTimer linkTimer);
+        m_sizeR = replayer->ReplayRead(m_bufferR, USBREADBUFFERSIZE);
+        m_posR = 0;
+        return true;
+    }
+
+    uint32_t bytesAvailable, bytesToRead;
 
-    ftStatus = FT_GetQueueStatus(ftHandle, &bytesAvailable);
-    if (ftStatus != FT_OK) return false;
+    if (!transport->BytesAvailable(bytesAvailable)) return TransportFailed();
 
     if (m_posR < m_sizeR) return false;
 
     bytesToRead = (bytesAvailable > minBytesToRead) ? bytesAvailable : minBytesToRead;
     if (bytesToRead > USBREADBUFFERSIZE) bytesToRead = USBREADBUFFERSIZE;
 
-    ftStatus = FT_Read(ftHandle, m_bufferR, bytesToRead, &m_sizeR);
+    TB_STATISTICS(psi::TestBoardStatistics::LinkTimer linkTimer);
+    const psi::UsbTrace::Clock::time_point start = psi::UsbTrace::Clock::now();
+    const bool ok = transport->Read(m_bufferR, bytesToRead, m_sizeR);
     m_posR = 0;
-    if (ftStatus != FT_OK) {
+    if (!ok) {
         m_sizeR = 0;
-        return false;
+        return TransportFailed();
     }
+    if (recorder) recorder->RecordRead(m_bufferR, m_sizeR, start);
     return true;
 }
 
@@ -250,44 +245,85 @@ bool CUSB::Read(unsigned int bytesToRead, void *buffer, unsigned int &bytesRead)
 
     if (!isUSB_open) return false;
 
-    unsigned int i;
-
-    for (i = 0; i < bytesToRead; i++) {
-        if (m_posR < m_sizeR)
-            ((unsigned char*)buffer)[i] = m_bufferR[m_posR++];
+    unsigned char* destination = (unsigned char*)buffer;
+    while (bytesRead < bytesToRead) {
+        if (m_posR >= m_sizeR) {
+            // timeout (bytesRead < bytesToRead)
+            if (timeout) break;
 
-        else if (!timeout) {
-            unsigned int n = bytesToRead - i;
+            unsigned int n = bytesToRead - bytesRead;
             if (n > USBREADBUFFERSIZE) n = USBREADBUFFERSIZE;
 
             if (!FillBuffer(n)) return false;
             if (m_sizeR < n) timeout = true;
-
-            if (m_posR < m_sizeR)
-                ((unsigned char*)buffer)[i] = m_bufferR[m_posR++];
-            else {
-                // timeout (bytesRead < bytesToRead)
-                bytesRead = i;
-                return true;
-            }
+            if (m_posR >= m_sizeR) break;
         }
 
-        else {
-            bytesRead = i;
-            return true;
-        }
+        const unsigned int n = std::min<unsigned int>(bytesToRead - bytesRead, m_sizeR - m_posR);
+        std::memcpy(destination + bytesRead, m_bufferR + m_posR, n);
+        m_posR += n;
+        bytesRead += n;
     }
 
-    bytesRead = bytesToRead;
+    TB_STATISTICS(psi::TestBoardStatistics::Singleton().AddBytesIn(bytesRead));
     return true;
 }
 
 
+bool CUSB::ReadDirect(unsigned int bytesToRead, void *buffer, unsigned int &bytesRead)
+{
+    bytesRead = 0;
+    if (!isUSB_open) return false;
+
+    const unsigned int buffered = std::min<unsigned int>(m_sizeR - m_posR, bytesToRead);
+    if (buffered) {
+        std::memcpy(buffer, m_bufferR + m_posR, buffered);
+        m_posR += buffered;
+        bytesRead = buffered;
+    }
+    if (bytesRead == bytesToRead) {
+        TB_STATISTICS(psi::TestBoardStatistics::Singleton().AddBytesIn(bytesRead));
+        return true;
+    }
+
+    TB_STATISTICS(psi::TestBoardStatistics::LinkTimer linkTimer);
+    unsigned char* destination = (unsigned char*)buffer + bytesRead;
+    uint32_t received = 0;
+    if (replayer)
+        received = replayer->ReplayRead(destination, bytesToRead - bytesRead);
+    else {
+        const psi::UsbTrace::Clock::time_point start = psi::UsbTrace::Clock::now();
+        if (!transport->Read(destination, bytesToRead - bytesRead, received)) return TransportFailed();
+        if (recorder) recorder->RecordRead(destination, received, start);
+    }
+    bytesRead += received;
+    TB_STATISTICS(psi::TestBoardStatistics::Singleton().AddBytesIn(bytesRead));
+    return true;
+}
+
+
+bool CUSB::WaitForData(unsigned int minBytes, unsigned int timeout)
+{
+    if (!isUSB_open) return false;
+    const unsigned int buffered = m_sizeR - m_posR;
+    if (buffered >= minBytes) return true;
+
+    TB_STATISTICS(psi::TestBoardStatistics::LinkTimer linkTimer);
+    if (replayer) return replayer->ReplayPoll();
+    const psi::UsbTrace::Clock::time_point start = psi::UsbTrace::Clock::now();
+    const bool dataAvailable = transport->WaitForData(minBytes - buffered, timeout);
+    if (!dataAvailable) ftStatus = transport->GetLastError();
+    if (recorder) recorder->RecordPoll(dataAvailable, start);
+    return dataAvailable;
+}
+
+
 bool CUSB::Clear()
 {
     if (!isUSB_open) return false;
 
-    ftStatus = FT_Purge(ftHandle, FT_PURGE_RX | FT_PURGE_TX);
+    ftStatus = FT_OK;
+    if (!replayer && !transport->Purge()) ftStatus = transport->GetLastError();
     m_posR = m_sizeR = 0;
     m_posW = 0;
 
@@ -5,38 +5,44 @@
 
 #pragma once
 
-#include "ftd2xx.h"
+#include <string>
+#include <boost/scoped_ptr.hpp>
+
+#include "psi/units.h"
+#include "UsbTrace.h"
+#include "UsbTransport.h"
 
 #define USBWRITEBUFFERSIZE  150000
 #define USBREADBUFFERSIZE   150000
 
 /*!
  * \brief Class provides basic functionalities to use the USB interface
+ *
+ * The data is buffered in both directions, the transfers themselves are done by a psi::UsbTransport.
  */
 class CUSB {
     bool isUSB_open;
-    FT_HANDLE ftHandle;
-    FT_STATUS ftStatus;
+    int ftStatus;
 
-    uintptr_t enumPos;
+    unsigned int enumPos;
     unsigned int enumCount;
 
-    DWORD m_posW; // @KA : unsigned int -> DWORD
+    boost::scoped_ptr<psi::UsbTransport> transport;
+
+    uint32_t m_posW;
     unsigned char m_bufferW[USBWRITEBUFFERSIZE];
 
-    DWORD m_posR, m_sizeR; // @KA : unsigned int -> DWORD
+    uint32_t m_posR, m_sizeR;
     unsigned char m_bufferR[USBREADBUFFERSIZE];
 
+    boost::scoped_ptr<psi::UsbTraceRecorder> recorder;
+    boost::scoped_ptr<psi::UsbTraceReplayer> replayer;
+
     bool FillBuffer(unsigned int minBytesToRead);
+    bool TransportFailed();
 
 public:
-    CUSB() {
-        m_posR = m_sizeR = m_posW = 0;
-        isUSB_open = false;
-        ftHandle = 0;
-        ftStatus = 0;
-        enumPos = enumCount = 0;
-    }
+    CUSB();
     ~CUSB() {
         Close();
     }
@@ -51,9 +57,37 @@ public:
     bool Connected() {
         return isUSB_open;
     };
+
+    /// Replaces the transport (FTDI by default) by the given one and takes its ownership. Only while closed.
+    void SetTransport(psi::UsbTransport* _transport);
+
+    /// Records all traffic of the connection opened afterwards into the trace file.
+    void StartRecording(const std::string& traceFileName);
+
+    /*!
+     * Plays the trace back instead of talking to a testboard. The connection is opened without a device, the
+     * recorded link times and delays are multiplied by the time scale.
+     */
+    void StartReplay(const std::string& traceFileName, double timeScale);
+
+    /// Host-side delay that is part of the communication protocol, recorded and replayed with the trace.
+    void Delay(const psi::Time& delay);
+
     bool Write(unsigned int bytesToWrite, const void *buffer);
     bool Flush();
     bool Read(unsigned int bytesToRead, void *buffer, unsigned int &bytesRead);
+
+    /*!
+     * Reads into the caller buffer. Bytes already buffered are moved with a single block copy, the rest is
+     * read by the transport directly into the destination without passing through the internal read buffer.
+     */
+    bool ReadDirect(unsigned int bytesToRead, void *buffer, unsigned int &bytesRead);
+
+    /*!
+     * Polls the device until at least minBytes are available for reading or timeout (in ms) expires.
+     * Returns true if the data is available.
+     */
+    bool WaitForData(unsigned int minBytes, unsigned int timeout);
     bool _Read(void *buffer, unsigned int bytesToRead) {
         unsigned int bytesRead;
         if (!Read(bytesToRead, (unsigned char *)buffer, bytesRead)) return false;
@@ -0,0 +1,181 @@
+/*!
+ * \file UsbTrace.cc
+ * \brief Implementation of UsbTraceRecorder and UsbTraceReplayer classes.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include "psi/exception.h"
+#include "psi/date_time.h"
+#include "UsbTrace.h"
+
+namespace {
+template<typename Value>
+void WriteValue(std::ostream& s, const Value& value)
+{
+    s.write(reinterpret_cast<const char*>(&value), sizeof(Value));
+}
+
+template<typename Value>
+bool ReadValue(std::istream& s, Value& value)
+{
+    return s.read(reinterpret_cast<char*>(&value), sizeof(Value)).good();
+}
+
+uint32_t Microseconds(const psi::UsbTrace::Clock::duration& duration)
+{
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+} // anonymous namespace
+
+namespace psi {
+
+const char* UsbTrace::RecordTypeName(unsigned type)
+{
+    switch(type) {
+    case Write:
+        return "write";
+    case Read:
+        return "read";
+    case Poll:
+        return "poll";
+    case Delay:
+        return "delay";
+    }
+    return "unknown";
+}
+
+UsbTraceRecorder::UsbTraceRecorder(const std::string& _fileName)
+    : fileName(_fileName), file(fileName.c_str(), std::ios::binary | std::ios::trunc),
+      traceStart(UsbTrace::Clock::now())
+{
+    if(!file.is_open())
+        THROW_PSI_EXCEPTION("Unable to create USB trace file '" << fileName << "'.");
+    file.write(UsbTrace::Magic(), std::strlen(UsbTrace::Magic()));
+    const uint32_t version = UsbTrace::Version;
+    WriteValue(file, version);
+}
+
+void UsbTraceRecorder::RecordWrite(const void* data, uint32_t size, const UsbTrace::Clock::time_point& start)
+{
+    WriteRecord(UsbTrace::Write, start, Microseconds(UsbTrace::Clock::now() - start), data, size);
+}
+
+void UsbTraceRecorder::RecordRead(const void* data, uint32_t size, const UsbTrace::Clock::time_point& start)
+{
+    WriteRecord(UsbTrace::Read, start, Microseconds(UsbTrace::Clock::now() - start), data, size);
+}
+
+void UsbTraceRecorder::RecordPoll(bool dataAvailable, const UsbTrace::Clock::time_point& start)
+{
+    const unsigned char result = dataAvailable;
+    WriteRecord(UsbTrace::Poll, start, Microseconds(UsbTrace::Clock::now() - start), &result, 1);
+}
+
+void UsbTraceRecorder::RecordDelay(double seconds)
+{
+    WriteRecord(UsbTrace::Delay, UsbTrace::Clock::now(), static_cast<uint32_t>(seconds * 1e6 + 0.5), 0, 0);
+}
+
+void UsbTraceRecorder::WriteRecord(UsbTrace::RecordType type, const UsbTrace::Clock::time_point& start,
+                                   uint32_t duration, const void* data, uint32_t size)
+{
+    const uint8_t recordType = type;
+    const uint64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(start - traceStart).count();
+    WriteValue(file, recordType);
+    WriteValue(file, timestamp);
+    WriteValue(file, duration);
+    WriteValue(file, size);
+    if(size)
+        file.write(static_cast<const char*>(data), size);
+    if(!file.good())
+        THROW_PSI_EXCEPTION("Unable to write into USB trace file '" << fileName << "'.");
+}
+
+UsbTraceReplayer::UsbTraceReplayer(const std::string& _fileName, double _timeScale)
+    : fileName(_fileName), file(fileName.c_str(), std::ios::binary), timeScale(_timeScale), recordId(0),
+      duration(0)
+{
+    if(!file.is_open())
+        THROW_PSI_EXCEPTION("Unable to open USB trace file '" << fileName << "'.");
+    const size_t magicSize = std::strlen(UsbTrace::Magic());
+    std::vector<char> magic(magicSize);
+    uint32_t version;
+    if(!file.read(&magic[0], magicSize).good() || std::memcmp(&magic[0], UsbTrace::Magic(), magicSize)
+            || !ReadValue(file, version))
+        THROW_PSI_EXCEPTION("File '" << fileName << "' is not a USB trace.");
+    if(version != UsbTrace::Version)
+        THROW_PSI_EXCEPTION("USB trace '" << fileName << "' has unsupported version " << version << ".");
+}
+
+void UsbTraceReplayer::ReplayWrite(const void* data, uint32_t size)
+{
+    NextRecord(UsbTrace::Write);
+    if(payload.size() != size || (size && std::memcmp(&payload[0], data, size))) {
+        size_t position = 0;
+        while(position < size && position < payload.size()
+              && payload[position] == static_cast<const unsigned char*>(data)[position])
+            ++position;
+        THROW_PSI_EXCEPTION("USB trace '" << fileName << "' diverged at record #" << recordId << ": the host wrote "
+                            << size << " bytes instead of " << payload.size() << ", first difference at byte "
+                            << position << ".");
+    }
+    Wait(duration * 1e-6);
+}
+
+uint32_t UsbTraceReplayer::ReplayRead(void* buffer, uint32_t maxSize)
+{
+    NextRecord(UsbTrace::Read);
+    if(payload.size() > maxSize)
+        THROW_PSI_EXCEPTION("USB trace '" << fileName << "' diverged at record #" << recordId << ": the host reads "
+                            << maxSize << " bytes, but " << payload.size() << " bytes were received.");
+    if(!payload.empty())
+        std::memcpy(buffer, &payload[0], payload.size());
+    Wait(duration * 1e-6);
+    return payload.size();
+}
+
+bool UsbTraceReplayer::ReplayPoll()
+{
+    NextRecord(UsbTrace::Poll);
+    if(payload.size() != 1)
+        THROW_PSI_EXCEPTION("USB trace '" << fileName << "' is corrupted at record #" << recordId << ".");
+    Wait(duration * 1e-6);
+    return payload[0];
+}
+
+void UsbTraceReplayer::ReplayDelay(double seconds)
+{
+    NextRecord(UsbTrace::Delay);
+    if(std::abs(duration * 1e-6 - seconds) > 1e-6)
+        THROW_PSI_EXCEPTION("USB trace '" << fileName << "' diverged at record #" << recordId << ": the host waits "
+                            << seconds << " s instead of " << duration * 1e-6 << " s.");
+    Wait(seconds);
+}
+
+void UsbTraceReplayer::NextRecord(UsbTrace::RecordType expectedType)
+{
+    uint8_t type;
+    uint64_t timestamp;
+    uint32_t size;
+    ++recordId;
+    if(!ReadValue(file, type) || !ReadValue(file, timestamp) || !ReadValue(file, duration) || !ReadValue(file, size))
+        THROW_PSI_EXCEPTION("USB trace '" << fileName << "' ended at record #" << recordId << ", but the host "
+                            << "requested a " << UsbTrace::RecordTypeName(expectedType) << ".");
+    if(type != expectedType)
+        THROW_PSI_EXCEPTION("USB trace '" << fileName << "' diverged at record #" << recordId << ": the host "
+                            << "requested a " << UsbTrace::RecordTypeName(expectedType) << " instead of a "
+                            << UsbTrace::RecordTypeName(type) << ".");
+    payload.resize(size);
+    if(size && !file.read(reinterpret_cast<char*>(&payload[0]), size).good())
+        THROW_PSI_EXCEPTION("USB trace '" << fileName << "' is truncated at record #" << recordId << ".");
+}
+
+void UsbTraceReplayer::Wait(double seconds) const
+{
+    if(timeScale > 0 && seconds > 0)
+        psi::Sleep(seconds * timeScale * psi::seconds);
+}
+
+} // psi
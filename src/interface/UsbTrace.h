@@ -0,0 +1,77 @@
+/*!
+ * \file UsbTrace.h
+ * \brief Definition of UsbTraceRecorder and UsbTraceReplayer classes.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace psi {
+
+/*!
+ * Binary trace of the USB traffic with the testboard. The file starts with the magic string and the format version,
+ * followed by records of type (uint8), time since the start of the trace in us (uint64), duration of the operation
+ * in us (uint32), payload size (uint32) and payload. All numbers are stored in the host byte order.
+ */
+struct UsbTrace {
+    enum RecordType { Write = 1, Read = 2, Poll = 3, Delay = 4 };
+    typedef std::chrono::steady_clock Clock;
+    static const char* Magic() { return "PSI46USB"; }
+    static const uint32_t Version = 1;
+    static const char* RecordTypeName(unsigned type);
+};
+
+/// Writes the bytes sent to and received from the testboard, the results of the polls and the host delays.
+class UsbTraceRecorder {
+public:
+    explicit UsbTraceRecorder(const std::string& _fileName);
+
+    void RecordWrite(const void* data, uint32_t size, const UsbTrace::Clock::time_point& start);
+    void RecordRead(const void* data, uint32_t size, const UsbTrace::Clock::time_point& start);
+    void RecordPoll(bool dataAvailable, const UsbTrace::Clock::time_point& start);
+    void RecordDelay(double seconds);
+
+private:
+    void WriteRecord(UsbTrace::RecordType type, const UsbTrace::Clock::time_point& start, uint32_t duration,
+                     const void* data, uint32_t size);
+
+private:
+    std::string fileName;
+    std::ofstream file;
+    UsbTrace::Clock::time_point traceStart;
+};
+
+/*!
+ * Plays a trace back instead of the testboard. The bytes sent by the host are compared with the recorded ones, an
+ * exception is thrown at the first difference. Reads and polls return the recorded results. Link times and delays
+ * are reproduced multiplied by the time scale: 1 replays in real time, 0 as fast as possible.
+ */
+class UsbTraceReplayer {
+public:
+    UsbTraceReplayer(const std::string& _fileName, double _timeScale);
+
+    void ReplayWrite(const void* data, uint32_t size);
+    /// Copies the next recorded read into the buffer and returns the number of bytes.
+    uint32_t ReplayRead(void* buffer, uint32_t maxSize);
+    bool ReplayPoll();
+    void ReplayDelay(double seconds);
+
+private:
+    void NextRecord(UsbTrace::RecordType expectedType);
+    void Wait(double seconds) const;
+
+private:
+    std::string fileName;
+    std::ifstream file;
+    double timeScale;
+    uint64_t recordId;
+    uint32_t duration;
+    std::vector<unsigned char> payload;
+};
+
+} // psi
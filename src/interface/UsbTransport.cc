@@ -0,0 +1,34 @@
+/*!
+ * \file UsbTransport.cc
+ * \brief Implementation of UsbTransport class.
+ */
+
+#include "../config.h"
+
+#include "psi/exception.h"
+#include "UsbTransport.h"
+#include "FtdiTransport.h"
+#include "LoopbackTransport.h"
+#if HAVE_LIBUSB_1_0
+#  include "LibusbTransport.h"
+#endif
+
+namespace psi {
+
+UsbTransport* UsbTransport::Make(const std::string& name)
+{
+    if(name == "FTDI")
+        return new FtdiTransport();
+    if(name == "libusb") {
+#if HAVE_LIBUSB_1_0
+        return new LibusbTransport();
+#else
+        THROW_PSI_EXCEPTION("USB transport 'libusb' is not available: psi46expert is compiled without libusb-1.0.");
+#endif
+    }
+    if(name == "Loopback")
+        return new LoopbackTransport();
+    THROW_PSI_EXCEPTION("USB transport '" << name << "' is not supported.");
+}
+
+} // psi
@@ -0,0 +1,56 @@
+/*!
+ * \file UsbTransport.h
+ * \brief Definition of UsbTransport class.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace psi {
+
+/*!
+ * Byte stream to and from the testboard used by CUSB. Implementations: FtdiTransport (D2XX library),
+ * LibusbTransport (asynchronous bulk transfers, if libusb-1.0 is available) and LoopbackTransport (no hardware).
+ * Errors are reported as FT_STATUS codes, so that CUSB::GetErrorMsg can describe them for all transports.
+ */
+class UsbTransport {
+public:
+    /// Link timeout of the blocking reads and writes in ms.
+    static const unsigned LinkTimeout = 300000;
+
+    /// Creates a transport by the name: "FTDI", "libusb" or "Loopback".
+    static UsbTransport* Make(const std::string& name);
+
+    UsbTransport() : status(0) {}
+    virtual ~UsbTransport() {}
+
+    int GetLastError() const {
+        return status;
+    }
+
+    virtual bool EnumFirst(unsigned int &nDevices) = 0;
+    virtual bool EnumNext(char name[]) = 0;
+    virtual bool Open(const char* serialNumber) = 0;
+    virtual void Close() = 0;
+
+    virtual bool Write(const void* data, uint32_t size) = 0;
+
+    /// Reads until size bytes are received or the link timeout expires.
+    virtual bool Read(void* buffer, uint32_t size, uint32_t& received) = 0;
+
+    /// Number of bytes that can be read without waiting.
+    virtual bool BytesAvailable(uint32_t& size) = 0;
+
+    /// Waits until at least minBytes can be read without waiting or timeout (in ms) expires.
+    virtual bool WaitForData(uint32_t minBytes, unsigned timeout) = 0;
+
+    /// Discards all data in both directions that is not yet transferred.
+    virtual bool Purge() = 0;
+
+protected:
+    int status;
+};
+
+} // psi
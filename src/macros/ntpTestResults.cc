@@ -3,7 +3,12 @@
 #include <fstream>
 #include <string.h>
 #include <dirent.h>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include <map>
 #include <vector>
 
 #include "TSystem.h"
@@ -13,6 +18,9 @@
 #include "TH1.h"
 #include "TH2.h"
 #include "TTree.h"
+#include "TChain.h"
+#include "TObjArray.h"
+#include "TObjString.h"
 #include "TParameter.h"
 #include "TGraph.h"
 #include "TF1.h"
@@ -1366,6 +1374,113 @@ void ntpTestResults::findHalfModules(const char *dir)
     else if (halfModule == 2) setHalfModulesB();
 }
 
+// ======================================================================
+// -- Production database driver
+// ======================================================================
+
+// ----------------------------------------------------------------------
+// -- Newest modification time of the regular files in a directory, 0 if it does not exist
+time_t newestFileTime(const char *dir)
+{
+    time_t newest(0);
+    DIR *pDir = opendir(dir);
+    if (!pDir) return 0;
+    struct dirent *entry;
+    struct stat info;
+    while ((entry = readdir(pDir))) {
+        TString name = TString(dir) + "/" + entry->d_name;
+        if (!stat(name.Data(), &info) && S_ISREG(info.st_mode) && info.st_mtime > newest) newest = info.st_mtime;
+    }
+    closedir(pDir);
+    return newest;
+}
+
+
+// ----------------------------------------------------------------------
+// -- An ntuple has to be (re)built if it is missing or older than any input of the module test
+bool needsUpdate(const char *dir, const char *temperature, int module)
+{
+    struct stat info;
+    if (stat(Form("module-%s-%04d.root", temperature, module), &info)) return true;
+    const TString testDir = TString(dir) + "/" + temperature;
+    const TString dtlDir = TString(dir) + "/dtlscan";
+    return newestFileTime(testDir.Data()) > info.st_mtime || newestFileTime(dtlDir.Data()) > info.st_mtime;
+}
+
+
+// ----------------------------------------------------------------------
+int processModule(const char *dir, const char *temperature, int force)
+{
+    cout << Form("-> ntuple(%s, %s)", dir, temperature) << endl;
+    ntpTestResults a(dir, temperature, force);
+    if (!a.isOK()) {
+        cout << Form("..... problem with  ntuple(%s, %s)", dir, temperature) << endl;
+        return 1;
+    }
+    a.findHalfModules(Form("%s/dtlscan", dir));
+    a.fillNtuple();
+    return 0;
+}
+
+
+// ----------------------------------------------------------------------
+// -- Runs processModule for all tests on up to nWorkers processes. ROOT is not thread-safe, so the workers are
+// -- forked processes, each with its own input and output TFile.
+int processModules(const vector<pair<TString, TString> > &tests, int nWorkers)
+{
+    int failed(0), running(0), status;
+    for (unsigned i = 0; i < tests.size(); ++i) {
+        const char *dir = tests[i].first.Data(), *temperature = tests[i].second.Data();
+        if (nWorkers <= 1) {
+            failed += processModule(dir, temperature, 1);
+            continue;
+        }
+        if (running == nWorkers) {
+            wait(&status);
+            --running;
+            if (!WIFEXITED(status) || WEXITSTATUS(status)) ++failed;
+        }
+        cout.flush();
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            status = processModule(dir, temperature, 1);
+            cout.flush();
+            fflush(stdout);
+            _exit(status);
+        }
+        if (pid < 0) failed += processModule(dir, temperature, 1);
+        else ++running;
+    }
+    while (running > 0) {
+        wait(&status);
+        --running;
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) ++failed;
+    }
+    return failed;
+}
+
+
+// ----------------------------------------------------------------------
+// -- Merges all module ntuples of a temperature into modules-<temperature>.root, indexed by module number
+void mergeNtuples(const char *temperature)
+{
+    TString pattern(Form("module-%s-*.root", temperature));
+    pattern.ReplaceAll("+", "\\+");
+    TChain chain("mod");
+    chain.Add(pattern.Data());
+    if (!chain.GetEntries()) return;
+
+    const TString fileName(Form("modules-%s.root", temperature));
+    TFile merged(fileName.Data(), "RECREATE");
+    TTree *tree = chain.CloneTree(-1, "fast");
+    tree->BuildIndex("nmod");
+    tree->Write();
+    merged.Close();
+    cout << "Merged " << chain.GetEntries() << " modules into " << fileName.Data() << endl;
+}
+
+
 // ======================================================================
 int main(int argc, char *argv[])
 {
@@ -1376,25 +1491,23 @@ int main(int argc, char *argv[])
     char temperature[100];
     sprintf(temperature, "T-10a");
     int all(0), force(0);
+    int nWorkers = sysconf(_SC_NPROCESSORS_ONLN);
 
     for (int i = 0; i < argc; i++) {
         if (!strcmp(argv[i], "-a"))  all   = 1;
         if (!strcmp(argv[i], "-f"))  force = 1;
-        if (!strcmp(argv[i], "-d"))  sprintf(baseDir, argv[++i]);    // base directory
-        if (!strcmp(argv[i], "-m"))  sprintf(baseDir, argv[++i]);    // base directory
-        if (!strcmp(argv[i], "-t"))  sprintf(temperature, argv[++i]); // temperature
+        if (!strcmp(argv[i], "-d"))  sprintf(baseDir, "%s", argv[++i]);    // base directory
+        if (!strcmp(argv[i], "-m"))  sprintf(baseDir, "%s", argv[++i]);    // base directory
+        if (!strcmp(argv[i], "-t"))  sprintf(temperature, "%s", argv[++i]); // temperature(s), comma separated
+        if (!strcmp(argv[i], "-j"))  nWorkers = atoi(argv[++i]);           // number of worker processes
     }
 
     if (all) {
-        // -- Get all directories in baseDir
+        // -- Get all directories in baseDir, the latest test of each module
         chdir(baseDir);
 
-        const int MAXMOD(2000);
         TString fname;
-        TString aDirs[MAXMOD];
-        for (int i = 0; i < MAXMOD; ++i) {
-            aDirs[i] = "-";
-        }
+        map<int, TString> aDirs;
 
         int module, bla;
         const char *file;
@@ -1411,35 +1524,40 @@ int main(int argc, char *argv[])
                 continue;
             }
 
-            if (!strcmp(aDirs[module].Data(), "-")) {
+            map<int, TString>::iterator iter = aDirs.find(module);
+            if (iter == aDirs.end()) {
                 aDirs[module] = fname;
-            } else {
-                if (fname.Data() > aDirs[module].Data()) {
-                    cout << "replacing " << aDirs[module] << "  with " << fname << endl;
-                    aDirs[module] = fname;
-                }
+            } else if (fname > iter->second) {
+                cout << "replacing " << iter->second << "  with " << fname << endl;
+                iter->second = fname;
             }
         }
-
-        char dir[1000];
-        for (int i = 0; i < MAXMOD; ++i) {
-            if (!strcmp(aDirs[i].Data(), "-")) continue;
-            fname = aDirs[i];
-            sprintf(dir, fname.Data());
-            fname += TString(Form("/%s", temperature));
-            cout << fname.Data() << endl;
-
-            cout << Form("-> ntuple(%s, %s)", dir, temperature) << endl;
-            //      ntuple(dir, temperature);
-            ntpTestResults a(dir, temperature, force);
-            if (a.isOK()) {
-                a.findHalfModules(Form("%s/dtlscan", dir));
-                a.fillNtuple();
-            } else {
-                cout << Form("..... problem with  ntuple(%s, %s)", dir, temperature)
-                     << endl;
+        gSystem->FreeDirectory(pDir);
+
+        // -- Select the tests with missing or outdated ntuples
+        TObjArray *temperatures = TString(temperature).Tokenize(",");
+        for (int t = 0; t < temperatures->GetEntriesFast(); ++t) {
+            const TString temp = ((TObjString*)temperatures->At(t))->GetString();
+            vector<pair<TString, TString> > tests;
+            int upToDate(0);
+            struct stat info;
+            for (map<int, TString>::const_iterator iter = aDirs.begin(); iter != aDirs.end(); ++iter) {
+                if (stat((iter->second + "/" + temp).Data(), &info) || !S_ISDIR(info.st_mode)) continue;
+                if (force || needsUpdate(iter->second.Data(), temp.Data(), iter->first))
+                    tests.push_back(make_pair(iter->second, temp));
+                else
+                    ++upToDate;
             }
+            cout << temp << ": " << tests.size() << " tests to process, " << upToDate << " up to date, "
+                 << nWorkers << " workers" << endl;
+
+            const int failed = processModules(tests, nWorkers);
+            if (failed) cout << "..... " << failed << " tests failed for " << temp << endl;
+
+            if (!tests.empty() || stat(Form("modules-%s.root", temp.Data()), &info))
+                mergeNtuples(temp.Data());
         }
+        delete temperatures;
 
     } else {
         //    ntuple(baseDir, temperature);
@@ -1451,4 +1569,3 @@ int main(int argc, char *argv[])
     return 0;
 
 }
-
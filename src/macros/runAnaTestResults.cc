@@ -4,6 +4,8 @@
 #include <cmath>
 #include <cstdlib>
 
+#include <TSystem.h>
+
 #include "anaTestResults.hh"
 
 using namespace std;
@@ -39,8 +41,16 @@ int main(int argc, char *argv[])
         cout << "Using " << Form("%s", file) << endl;
         pA->Add(Form("%s", file));
     } else {
-        cout << "Using " << Form("%s/module-%s-*.root", dir, temp) << endl;
-        pA->Add(Form("%s/module-%s-*.root", dir, temp));
+        // -- prefer the merged file written by ntpTestResults -a, the '+' is escaped only for the wildcard
+        TString merged(Form("%s/modules-%s.root", dir, temp));
+        merged.ReplaceAll("\\+", "+");
+        if (!gSystem->AccessPathName(merged.Data())) {
+            cout << "Using " << merged.Data() << endl;
+            pA->Add(merged.Data());
+        } else {
+            cout << "Using " << Form("%s/module-%s-*.root", dir, temp) << endl;
+            pA->Add(Form("%s/module-%s-*.root", dir, temp));
+        }
     }
 
     anaTestResults b(pA);
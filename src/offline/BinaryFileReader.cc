@@ -9,6 +9,7 @@
 
 #include "BinaryFileReader.h"
 #include "PHCalibration.h"
+#include "LevelFinder.h"
 
 
 BinaryFileReader::BinaryFileReader(const char* f, int nroc, int ref)
@@ -166,6 +167,14 @@ void BinaryFileReader::init()
     sprintf(name, "%subtbm%s", module, fTag);
     hUBTBM = new TH1F(name, "tbm ultrablack", nBinLH, LHMin, LHMax);
 
+    fLevelFinder = new psi::analysis::LevelFinder(2 + 2 * fNROC, nBinLH, LHMin, LHMax);
+    fLevelFinder->SetSearch(kTbmUbChannel, psi::analysis::LevelSearch(psi::analysis::ClusteringPeaks, 1));
+    fLevelFinder->SetSearch(kTbmLevelChannel, psi::analysis::LevelSearch(psi::analysis::ClusteringPeaks, 4));
+    for(int roc = 0; roc < fNROC; roc++) {
+        fLevelFinder->SetSearch(rocUbChannel(roc), psi::analysis::LevelSearch(psi::analysis::ClusteringPeaks, 2));
+        fLevelFinder->SetSearch(rocLevelChannel(roc), psi::analysis::LevelSearch(psi::analysis::ClusteringPeaks, 6));
+    }
+
     sprintf(name, "%slvltbm%s", module, fTag);
     hLVLTBM = new TH1F(name, "tbm levles", nBinLH, LHMin, LHMax);
 
@@ -308,14 +317,18 @@ void BinaryFileReader::init()
     // initialize geometry utitilty
     fRocGeometry = RocGeometry(27 * 0.0150, 40.5 * 0.0100);
 
+    eventTree = 0;
+    clusterTree = 0;
+    fColumnFile = 0;
     if(fIsModule) {
+        // filled in batches by flushEvents, large baskets keep the number of compressed writes small
         eventTree = new TTree("events", "events");
-        eventTree->Branch("row", &tRow, "row/I");
-        eventTree->Branch("col", &tCol, "col/I");
-        eventTree->Branch("roc", &tRoc, "roc/I");
-        eventTree->Branch("ph", &tPH, "ph/I");
-        eventTree->Branch("vcal", &tVcal, "vcal/F");
-        eventTree->Branch("eventNr", &fnDataWithHits, "eventNr/I");
+        eventTree->Branch("row", &tRow, "row/I", kEventBasketSize);
+        eventTree->Branch("col", &tCol, "col/I", kEventBasketSize);
+        eventTree->Branch("roc", &tRoc, "roc/I", kEventBasketSize);
+        eventTree->Branch("ph", &tPH, "ph/I", kEventBasketSize);
+        eventTree->Branch("vcal", &tVcal, "vcal/F", kEventBasketSize);
+        eventTree->Branch("eventNr", &tEventNr, "eventNr/I", kEventBasketSize);
 
         clusterTree = new TTree("clusters", "clusters");
         clusterTree->Branch("charge", &tCluCharge, "charge/F");
@@ -327,7 +340,15 @@ void BinaryFileReader::init()
 // ----------------------------------------------------------------------
 BinaryFileReader::~BinaryFileReader()
 {
+    // the tree may be gone together with its file, only the column file gets the remaining hits
+    if(fColumnFile) {
+        fEventColumns.write(*fColumnFile);
+        fColumnFile->close();
+        delete fColumnFile;
+    }
+
     // delete the biggest chunks
+    delete fLevelFinder;
     for(int i = 0; i < fNROC; i++) {
         delete hRocMap[i];
         delete hRocMapInt[i];
@@ -682,29 +703,31 @@ int BinaryFileReader::getType()
 void BinaryFileReader::updateHistos()
 {
     if (fTBMHeader[0] == 0) dump();
-    hUBTBM->Fill(fTBMHeader[0]);
-    hUBTBM->Fill(fTBMHeader[1]);
-    hUBTBM->Fill(fTBMHeader[2]);
-    hLVLTBM->Fill(fTBMHeader[3]);
-    hLVLTBM->Fill(fTBMHeader[4]);
-    hLVLTBM->Fill(fTBMHeader[5]);
-    hLVLTBM->Fill(fTBMHeader[6]);
-    hLVLTBM->Fill(fTBMHeader[7]);
+    // the level finder histograms are filled in the same pass, levels are searched in them by Levels()
+    psi::analysis::LevelHistograms& lh = fLevelFinder->Histograms();
+    for(int k = 0; k < 3; k++) {
+        hUBTBM->Fill(fTBMHeader[k]);
+        lh.Fill(kTbmUbChannel, fTBMHeader[k]);
+    }
+    for(int k = 3; k < 8; k++) {
+        hLVLTBM->Fill(fTBMHeader[k]);
+        lh.Fill(kTbmLevelChannel, fTBMHeader[k]);
+    }
     hNHit->Fill(fNHit);
     for(int roc = 0; roc < fNROC; roc++) {
         hNHitRoc[roc]->Fill(fHitROC[roc]);
         int i = fOffs[roc];
         hUBBROC[roc]->Fill(fData[i]);
         hUBBROC[roc]->Fill(fData[i + 1]);
+        lh.Fill(rocUbChannel(roc), fData[i]);
+        lh.Fill(rocUbChannel(roc), fData[i + 1]);
         h3rdClk[roc]->Fill(fData[i + 2]);
         i += 3; // move pointer to hit data
         for(int hit = 0; hit < fHitROC[roc]; hit++) {
-
-            hADROC[roc]->Fill(fData[i  ]);
-            hADROC[roc]->Fill(fData[i + 1]);
-            hADROC[roc]->Fill(fData[i + 2]);
-            hADROC[roc]->Fill(fData[i + 3]);
-            hADROC[roc]->Fill(fData[i + 4]);
+            for(int k = 0; k < 5; k++) {
+                hADROC[roc]->Fill(fData[i + k]);
+                lh.Fill(rocLevelChannel(roc), fData[i + k]);
+            }
             hPHROC[roc]->Fill(fData[i + 5]);
 
             i += 6; //  next hit
@@ -718,7 +741,7 @@ void BinaryFileReader::updateHistos()
 int BinaryFileReader::findLevels(TH1F* h, int n0, float* level, int algorithm)
 {
     const int debug = 0;
-    int npeak = 0; // return number of peaks found
+    std::vector<double> peaks;
     if (debug) cout << "findLevels>" << endl;
     if(algorithm == 1) {
 
@@ -732,55 +755,23 @@ int BinaryFileReader::findLevels(TH1F* h, int n0, float* level, int algorithm)
             Int_t bin = h->GetXaxis()->FindBin(xp);
             Float_t yp = h->GetBinContent(bin);
             if (yp / TMath::Sqrt(yp) < 2) continue;
-            level[npeak] = xpeaks[p];
-            npeak++;
-            //    cout << npeak << " " << xpeaks[p] << endl;
+            peaks.push_back(xpeaks[p]);
+            //    cout << peaks.size() << " " << xpeaks[p] << endl;
         }
 
     } else {
 
-        // clustering type peak finding
-        const int nmiss = 3; // max number of missing/low  bins within a peak
-        const float threshold = h->GetMaximum() / 100. + 1; // ignore bins below threshold
-        int nlow = nmiss + 1; // to make sure the first entry starts a peak
-        float s = 0;
-        float sx = 0;
-        if (debug) cout << " bin clustering threshold=" << threshold << endl;
-        for(int b = 0; b < h->GetNbinsX(); b++) {
-            if (debug) cout << Form("%5d  %10.1f   %10.1f   %3d %3d\n", b, h->GetBinCenter(b), h->GetBinContent(b), npeak, nlow);
-            if(h->GetBinContent(b) > threshold) {
-                if(nlow > nmiss) {
-                    // start a new peak
-                    s = 0; // reset sums for mean
-                    sx = 0;
-                    npeak++;
-                }
-                // add to peak
-                s += float(h->GetBinContent(b));
-                sx += float(h->GetBinCenter(b)) * float(h->GetBinContent(b));
-                level[npeak - 1] = sx / s;
-                nlow = 0;
-            } else {
-                nlow++;
-            }
-        }
+        // clustering type peak finding, same as used by the level finder (bin 0 is the underflow)
+        psi::analysis::FindPeaksByClustering(h->GetArray() + 1, h->GetNbinsX(), h->GetXaxis()->GetXmin(),
+                                             h->GetBinWidth(1), peaks);
     }
 
-
     /* merge peaks if more than expected */
-    while((n0 > 0) && (npeak > n0)) {
-        int m = 0;
-        for(int i = 1; i < (npeak - 1); i++) {
-            if((level[i + 1] - level[i]) < level[m + 1] - level[m]) m = i;
-        }
-        cout << "merged levels " << level[m] << " " << level[m + 1] << endl;
-        level[m] = (level[m] + level[m + 1]) / 2.; // better if weighted?
-        for(int i = m + 1; i < (npeak - 1); i++) {
-            level[i] = level[i + 1];
-        }
-        npeak--;
+    if(n0 > 0) psi::analysis::MergeClosestPeaks(peaks, n0);
+    for(size_t p = 0; p < peaks.size(); p++) {
+        level[p] = peaks[p];
     }
-    return npeak;
+    return peaks.size();
 }
 
 
@@ -800,13 +791,28 @@ Double_t BinaryFileReader::findLowestValue(TH1F* h, Float_t threshold)
 
 
 
+// ----------------------------------------------------------------------
+int BinaryFileReader::copyLevels(int channel, float* level)
+{
+    const std::vector<double>& peaks = fLevelFinder->Levels(channel);
+    for(size_t p = 0; p < peaks.size(); p++) {
+        level[p] = peaks[p];
+    }
+    return peaks.size();
+}
+
+
+
 // ----------------------------------------------------------------------
 void BinaryFileReader::Levels()
 {
+    // clustering peak search of all channels in parallel, only channels with new data since the last call are redone
+    fLevelFinder->Update();
+
     float lubb[100];
     float l[100];
     int n;
-    n = findLevels(hUBTBM, 1, l, 2 );
+    n = copyLevels(kTbmUbChannel, l);
     if(n == 1) {
         fUbTBM = (int) (0.8 * l[0]);
     } else {
@@ -814,7 +820,7 @@ void BinaryFileReader::Levels()
     }
 
     // TBM event counter levels
-    n = findLevels(hLVLTBM,  4, l, 2);
+    n = copyLevels(kTbmLevelChannel, l);
     if(n == 4) {
         //if(fUbTBM>l[0])  fUbTBM=l[0];
         fTBM[0] = (int) (0.5 * (fUbTBM + l[0]));
@@ -829,7 +835,7 @@ void BinaryFileReader::Levels()
 
     for (int roc = 0; roc < fNROC; roc++) {
         //cout <<" level finding roc " << roc << endl;
-        n = findLevels(hUBBROC[roc], 2, lubb, 2);
+        n = copyLevels(rocUbChannel(roc), lubb);
         if(n == 2) {
             fUbROC[roc] = (int) (0.8 * lubb[0] + 0.1 * lubb[1]);
             Double_t phmin = findLowestValue(hPHROC[roc]);
@@ -842,7 +848,7 @@ void BinaryFileReader::Levels()
             cout << "   nlevel = " << n << endl;
         }
 
-        n = findLevels(hADROC[roc], 6, l, 2);
+        n = copyLevels(rocLevelChannel(roc), l);
         if(n != 6) {
             cout << " roc " << roc << "  retry level finding " << endl;
             n = findLevels(hADROC[roc], 6, l, 1);
@@ -1126,23 +1132,44 @@ vector<cluster> BinaryFileReader::getHits()
     */
 
     // decodePixels should have been called before to fill pixel buffer pb
+    vector<cluster> v = findClusters(pb, fNHit);
+    fillClusterTree(v);
+    return v;
+}
+
+
 
+// ----------------------------------------------------------------------
+void BinaryFileReader::fillClusterTree(const vector<cluster>& v)
+{
+    for(vector<cluster>::const_iterator c = v.begin(); c != v.end(); c++) {
+        tCluCharge = c->charge;
+        tCluSize = c->size;
+        clusterTree->Fill();
+    }
+}
+
+
+
+// ----------------------------------------------------------------------
+vector<cluster> BinaryFileReader::findClusters(const pixel* pixels, int nHit) const
+{
     // simple clusterization
     // cluster search radius fCluCut ( allows fCluCut-1 empty pixels)
 
     vector<cluster> v;
-    if(fNHit == 0) return v;
-    int* gone = new int[fNHit];
-    int* layer = new int[fNHit];
-    for(int i = 0; i < fNHit; i++) {
+    if(nHit == 0) return v;
+    int* gone = new int[nHit];
+    int* layer = new int[nHit];
+    for(int i = 0; i < nHit; i++) {
         gone[i] = 0;
-        layer[i] = fLayerMap[pb[i].roc];
+        layer[i] = fLayerMap[pixels[i].roc];
     }
     int seed = 0;
-    while(seed < fNHit) {
+    while(seed < nHit) {
         // start a new cluster
         cluster c;
-        c.vpix.push_back(pb[seed]);
+        c.vpix.push_back(pixels[seed]);
         gone[seed] = 1;
         c.charge = 0.;
         c.size = 0;
@@ -1155,14 +1182,14 @@ vector<cluster> BinaryFileReader::getHits()
         int growing;
         do {
             growing = 0;
-            for(int i = 0; i < fNHit; i++) {
+            for(int i = 0; i < nHit; i++) {
                 if( (!gone[i]) && (layer[i] == c.layer) ) {
                     for(unsigned int p = 0; p < c.vpix.size(); p++) {
-                        int dr = c.vpix.at(p).row - pb[i].row;
-                        int dc = c.vpix.at(p).col - pb[i].col;
+                        int dr = c.vpix.at(p).row - pixels[i].row;
+                        int dc = c.vpix.at(p).col - pixels[i].col;
                         if(    (dr >= -fCluCut) && (dr <= fCluCut)
                                 && (dc >= -fCluCut) && (dc <= fCluCut) ) {
-                            c.vpix.push_back(pb[i]);
+                            c.vpix.push_back(pixels[i]);
                             gone[i] = 1;
                             growing = 1;
                             break;//important!
@@ -1200,25 +1227,64 @@ vector<cluster> BinaryFileReader::getHits()
         }
         if(nBig > 0) {
             v.push_back(c);
-            tCluCharge = c.charge;
-            tCluSize = c.size;
-            clusterTree->Fill();
         }
         //look for a new seed
-        while((++seed < fNHit) && (gone[seed]));
+        while((++seed < nHit) && (gone[seed]));
     }
     // nothing left,  return clusters
-    delete layer;
-    delete gone;
+    delete[] layer;
+    delete[] gone;
     return v;
 }
 
 
 
+// ----------------------------------------------------------------------
+// hits of all following events are also written to a columnar file, see EventColumns.h
+void BinaryFileReader::setColumnOutput(const char* fileName)
+{
+    fColumnFile = new ofstream(fileName, ios::binary);
+    if(!fColumnFile->is_open()) {
+        cout << msgId() << "can not open column file " << fileName << endl;
+        delete fColumnFile;
+        fColumnFile = 0;
+        return;
+    }
+    EventColumns::writeHeader(*fColumnFile);
+}
+
+
+
+// ----------------------------------------------------------------------
+void BinaryFileReader::flushEvents()
+{
+    if(eventTree) {
+        int h = 0;
+        for(int e = 0; e < fEventColumns.nEvents(); e++) {
+            tEventNr = fEventColumns.eventNr[e];
+            const int last = h + fEventColumns.eventHits[e];
+            for(; h < last; h++) {
+                tRoc = fEventColumns.roc[h];
+                tCol = fEventColumns.col[h];
+                tRow = fEventColumns.row[h];
+                tPH = fEventColumns.ph[h];
+                tVcal = fEventColumns.vcal[h];
+                eventTree->Fill();
+            }
+        }
+    }
+    if(fColumnFile) fEventColumns.write(*fColumnFile);
+    fEventColumns.clear();
+}
+
+
+
 // ----------------------------------------------------------------------
 // fills pixels into the pixel buffer pb[]
 void BinaryFileReader::decodePixels()
 {
+    const bool keepHits = (eventTree || fColumnFile) && (fNHit > 0);
+    if(keepHits) fEventColumns.addEvent(fnDataWithHits);
     int k = 0;
     for(int roc = 0; roc < fNROC; roc++) {
         int j = fOffs[roc] + 3;
@@ -1251,25 +1317,14 @@ void BinaryFileReader::decodePixels()
                 hPHVcalROC[roc]->Fill(pb[k].anaVcal);
             }
 
-            //fill eventTree
-            tRoc = roc;
-            tCol = pb[k].colROC;
-            tRow = pb[k].rowROC;
-            tPH = pb[k].ana;
-            tVcal = pb[k].anaVcal;
-            eventTree->Fill();
-
-//       if (tRoc == 10) // && tCol == 51 && tRow == 71)
-//       {
-//          printf("%i %i %i\n", tRoc, tCol, tRow);
-// 	 for (int l = 0; l < 100; l++) printf("%i ", fData[l]);
-// 	 printf("\n");
-//       }
+            // buffered for eventTree, written by flushEvents
+            if(keepHits) fEventColumns.addHit(roc, pb[k].colROC, pb[k].rowROC, pb[k].ana, pb[k].anaVcal);
 
             j += 6;
             k++;
         }
     }
+    if(fEventColumns.nHits() >= kEventBatchHits) flushEvents();
 
 
     // convert to local/module coordinates
@@ -1370,6 +1425,9 @@ int BinaryFileReader::readRecord()
         fnInfiniteRO++;
     }
 
+    // the last batch of buffered hits must reach the tree before the caller writes it
+    if (fEOF) flushEvents();
+
     return words;
 }
 
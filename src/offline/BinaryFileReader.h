@@ -8,12 +8,18 @@
 #include <vector>
 #include "RocGeometry.h"
 #include "ConfigReader.h"
+#include "EventColumns.h"
 #include <TTree.h>
 
 
 #include "pixelForReadout.h"
 class PHCalibration;
 class TH1F;
+namespace psi {
+namespace analysis {
+class LevelFinder;
+}
+}
 class TH2F;
 
 class BinaryFileReader {
@@ -99,6 +105,17 @@ public:
     TH1F* hPHROC[16];
     TH1F* hPHVcalROC[16];
 
+    // channels of the level finder: tbm ultrablack, tbm levels, then ultrablack/black and address levels per roc
+    psi::analysis::LevelFinder* fLevelFinder;
+    static const int kTbmUbChannel = 0;
+    static const int kTbmLevelChannel = 1;
+    static int rocUbChannel(int roc) {
+        return 2 + 2 * roc;
+    }
+    static int rocLevelChannel(int roc) {
+        return 3 + 2 * roc;
+    }
+
     TH1F* hLVLTBMUsed;
     TH1F* hADROCUsed[16];
     TH2F* hDeconv[16];
@@ -128,9 +145,15 @@ public:
     TH1F *hPH, *hVcal;
 
     TTree *eventTree, *clusterTree;
-    int tCol, tRow, tPH, tRoc, tCluSize;
+    int tCol, tRow, tPH, tRoc, tEventNr, tCluSize;
     float tVcal, tCluCharge;
 
+    // decoded hits waiting to be written to eventTree and fColumnFile, the tree still gets one entry per hit
+    static const int kEventBatchHits = 100000;
+    static const int kEventBasketSize = 256000;
+    EventColumns fEventColumns;
+    ofstream* fColumnFile;
+
 public:
     BinaryFileReader(const char* f = "mtb.bin", int nroc = 16, int ref = 0);
     BinaryFileReader(const char* f = "mtb.bin", const char *layermap = "0",
@@ -161,6 +184,7 @@ public:
     void updateHistos();
     Double_t findLowestValue(TH1F* h, Float_t threshold = 0);
     int  findLevels(TH1F* h, int n0, float* level, int algorithm = 1);
+    int  copyLevels(int channel, float* level);
     void Levels();
     void updateLevels();
     void writeNewLevels();
@@ -168,6 +192,8 @@ public:
     void readLevels(const char* levelFile, int mode = 0);
     int  decode(int adc, int nLevel, int* level);
     void  decodePixels();
+    void setColumnOutput(const char* fileName);
+    void flushEvents();   // writes the buffered hits, done at the end of the file, call it if reading stops earlier
     void dump(int level = 0);
     void printTrailer();
     long long getBC() {
@@ -186,6 +212,9 @@ public:
     float rowToY(int row);
     void toLocal(pixel& p);
     vector<cluster> getHits();
+    // clustering without side effects, may be called from several threads at once
+    vector<cluster> findClusters(const pixel* pixels, int nHit) const;
+    void fillClusterTree(const vector<cluster>& v);
     pixel pb[1001];
     pixel* getPixels() {
         return pb;
@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdexcept>
+#include "EventColumns.h"
+
+static const char columnsMagic[] = "PSIHITS1";
+
+
+/************************************************************/
+template<typename T>
+static void writeColumn(std::ostream& s, const std::vector<T>& v)
+{
+    if(!v.empty()) s.write(reinterpret_cast<const char*>(&v[0]), v.size() * sizeof(T));
+}
+
+template<typename T>
+static bool readColumn(std::istream& s, std::vector<T>& v, uint32_t n)
+{
+    v.resize(n);
+    if(n) s.read(reinterpret_cast<char*>(&v[0]), n * sizeof(T));
+    return !s.fail();
+}
+
+
+/************************************************************/
+void EventColumns::clear()
+{
+    eventNr.clear();
+    eventHits.clear();
+    roc.clear();
+    col.clear();
+    row.clear();
+    ph.clear();
+    vcal.clear();
+}
+
+
+/************************************************************/
+void EventColumns::writeHeader(std::ostream& s)
+{
+    s.write(columnsMagic, 8);
+}
+
+
+/************************************************************/
+bool EventColumns::readHeader(std::istream& s)
+{
+    char magic[8];
+    s.read(magic, 8);
+    return !s.fail() && (strncmp(magic, columnsMagic, 8) == 0);
+}
+
+
+/************************************************************/
+void EventColumns::write(std::ostream& s) const
+{
+    if(eventNr.empty()) return;
+    const uint32_t n[2] = { uint32_t(eventNr.size()), uint32_t(roc.size()) };
+    s.write(reinterpret_cast<const char*>(n), sizeof(n));
+    writeColumn(s, eventNr);
+    writeColumn(s, eventHits);
+    writeColumn(s, roc);
+    writeColumn(s, col);
+    writeColumn(s, row);
+    writeColumn(s, ph);
+    writeColumn(s, vcal);
+}
+
+
+/************************************************************/
+bool EventColumns::read(std::istream& s)
+{
+    clear();
+    if(s.peek() == std::istream::traits_type::eof()) return false;
+    uint32_t n[2];
+    s.read(reinterpret_cast<char*>(n), sizeof(n));
+    bool ok = !s.fail() && readColumn(s, eventNr, n[0]) && readColumn(s, eventHits, n[0])
+              && readColumn(s, roc, n[1]) && readColumn(s, col, n[1]) && readColumn(s, row, n[1])
+              && readColumn(s, ph, n[1]) && readColumn(s, vcal, n[1]);
+    if(!ok) {
+        clear();
+        throw std::runtime_error("Truncated event columns block.");
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef EVENTCOLUMNS_H
+#define EVENTCOLUMNS_H
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+/* Decoded hits of a series of events, one array per quantity.
+   BinaryFileReader collects the hits here and writes them out in batches,
+   to the events tree and optionally to a columnar binary file.
+
+   The file starts with the magic "PSIHITS1" and is followed by blocks until
+   the end of the file. A block is
+     uint32 nEvents, uint32 nHits,
+     int32 eventNr[nEvents], uint32 eventHits[nEvents],
+     uint8 roc[nHits], int8 col[nHits], int8 row[nHits], int16 ph[nHits],
+     float vcal[nHits]
+   in host byte order. The hits of event e follow the hits of event e-1.
+   This class does not depend on ROOT, so other readers can use it directly. */
+class EventColumns {
+public:
+    void addEvent(int nr) {
+        eventNr.push_back(nr);
+        eventHits.push_back(0);
+    }
+    // adds a hit to the last event
+    void addHit(int r, int c, int rw, int p, float v) {
+        roc.push_back(r);
+        col.push_back(c);
+        row.push_back(rw);
+        ph.push_back(p);
+        vcal.push_back(v);
+        eventHits.back()++;
+    }
+    int nEvents() const {
+        return eventNr.size();
+    }
+    int nHits() const {
+        return roc.size();
+    }
+    void clear();
+
+    static void writeHeader(std::ostream& s);
+    static bool readHeader(std::istream& s);
+    void write(std::ostream& s) const;   // appends one block
+    // replaces the content by the next block, false at the end of the file,
+    // throws std::runtime_error if the file ends within a block
+    bool read(std::istream& s);
+
+    std::vector<int> eventNr;
+    std::vector<unsigned int> eventHits;
+    std::vector<unsigned char> roc;
+    std::vector<signed char> col, row;   // -1 for invalid addresses
+    std::vector<short> ph;
+    std::vector<float> vcal;
+};
+
+#endif
@@ -6,11 +6,14 @@
 //#include "ConfigReader.h"
 #include "EventReader.h"
 #include "PHCalibration.h"
+#include "HitGrid.h"
 #include<stdio.h>
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <deque>
 #include <math.h>
+#include <pthread.h>
 
 // pixel hit and cluster struct
 #include "pixelForReadout.h"
@@ -70,6 +73,8 @@ void EventReader::init()
     }
     */
     fAlignmentFile = 0;
+    fEvent = NULL;
+    fNThreads = 1;
 
 
     // re-do level files if requested
@@ -272,6 +277,141 @@ void EventReader::init()
 
 
 
+/****************************************************************/
+// events waiting for a worker, shared between the reading thread and the workers
+struct EventPipeline {
+    pthread_mutex_t mutex;
+    pthread_cond_t queued, done;
+    deque<EventRecord*> todo;
+    bool finished;
+};
+
+struct EventWorker {
+    pthread_t thread;
+    EventPipeline* pipeline;
+    EventReader* shard;
+    vector<TH1*> copies;
+};
+
+void* EventReader::runWorker(void* arg)
+{
+    EventWorker* w = (EventWorker*) arg;
+    EventPipeline* p = w->pipeline;
+    pthread_mutex_lock(&p->mutex);
+    for(;;) {
+        while(p->todo.empty() && !p->finished) {
+            pthread_cond_wait(&p->queued, &p->mutex);
+        }
+        if(p->todo.empty()) break;
+        EventRecord* e = p->todo.front();
+        p->todo.pop_front();
+        pthread_mutex_unlock(&p->mutex);
+        w->shard->processEvent(*e);
+        pthread_mutex_lock(&p->mutex);
+        e->processed = true;
+        pthread_cond_broadcast(&p->done);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return NULL;
+}
+
+/****************************************************************/
+template<class T> static void detachHisto(T*& h, vector<TH1*>& masters, vector<TH1*>& copies)
+{
+    masters.push_back(h);
+    h = (T*) h->Clone();
+    h->SetDirectory(0);
+    h->Reset();
+    copies.push_back(h);
+}
+
+// replaces the histograms filled by processEvent with empty copies owned by the caller
+void EventReader::detachHistos(vector<TH1*>& masters, vector<TH1*>& copies)
+{
+    detachHisto(hNPixMod, masters, copies);
+    detachHisto(hNCluMod, masters, copies);
+    detachHisto(hNCluTracking, masters, copies);
+    for(int i = 0; i < 16; i++) {
+        detachHisto(hNCluModRocExt[i], masters, copies);
+        detachHisto(hNCluModRocInt[i], masters, copies);
+    }
+    for(int layer = 0; layer < 5; layer++) {
+        detachHisto(hQCluLayer[layer], masters, copies);
+        detachHisto(hSizeCluLayer[layer], masters, copies);
+    }
+    detachHisto(hNPixRoc, masters, copies);
+    detachHisto(hNCluRoc, masters, copies);
+    detachHisto(hNCluRoc1, masters, copies);
+    detachHisto(hNCluRoc2, masters, copies);
+    detachHisto(hNCluRoc3, masters, copies);
+    detachHisto(hNCluRoc4, masters, copies);
+    detachHisto(hNCluShadowExt, masters, copies);
+    detachHisto(hNCluShadowInt, masters, copies);
+    detachHisto(hNCluShadowCal, masters, copies);
+    detachHisto(hRocEmpty, masters, copies);
+    detachHisto(hNCluCorr, masters, copies);
+    detachHisto(hNPixCorr, masters, copies);
+
+    // findTracks and goodTrack
+    detachHisto(hNSeedPair, masters, copies);
+    detachHisto(hNTracksPerSeed, masters, copies);
+    detachHisto(hFitChisq, masters, copies);
+    detachHisto(hDistTLayer1, masters, copies);
+    detachHisto(hDistTLayer2, masters, copies);
+    detachHisto(hDxTLayer1, masters, copies);
+    detachHisto(hDxTLayer2, masters, copies);
+    detachHisto(hDyTLayer1, masters, copies);
+    detachHisto(hDyTLayer2, masters, copies);
+    detachHisto(hDxDyTLayer1, masters, copies);
+    detachHisto(hDxDyTLayer2, masters, copies);
+    detachHisto(hDxPhiTLayer1, masters, copies);
+    detachHisto(hDxPhiTLayer2, masters, copies);
+    detachHisto(hDyPhiTLayer1, masters, copies);
+    detachHisto(hDyPhiTLayer2, masters, copies);
+    detachHisto(hScint, masters, copies);
+    detachHisto(hDistDUT, masters, copies);
+    detachHisto(hDxDUT, masters, copies);
+    detachHisto(hDyDUT, masters, copies);
+    detachHisto(hDxDyDUT, masters, copies);
+    detachHisto(hDxPhiDUT, masters, copies);
+    detachHisto(hDyPhiDUT, masters, copies);
+    detachHisto(hDxSx, masters, copies);
+    detachHisto(hDySy, masters, copies);
+    detachHisto(hDUTh2, masters, copies);
+    detachHisto(hDUTh1, masters, copies);
+    detachHisto(hDUTh1a, masters, copies);
+    detachHisto(hDUTnH1, masters, copies);
+    detachHisto(hDUTnH2, masters, copies);
+    detachHisto(hMissing, masters, copies);
+    detachHisto(hFound, masters, copies);
+}
+
+/****************************************************************/
+void EventReader::resetCounters()
+{
+    for(int i = 0; i < 16; i++) {
+        for(int j = 0; j < 26; j++) fNCluModDcol[i][j] = 0;
+        for(int j = 0; j < 26; j++) fNTrkModDcol[i][j] = 0;
+    }
+    fNCluModSum = 0;
+    fNCluModEvt = 0;
+    fNTrkModSum = 0;
+}
+
+void EventReader::addCounters(const EventReader* shard)
+{
+    for(int i = 0; i < 16; i++) {
+        for(int j = 0; j < 26; j++) fNCluModDcol[i][j] += shard->fNCluModDcol[i][j];
+        for(int j = 0; j < 26; j++) fNTrkModDcol[i][j] += shard->fNTrkModDcol[i][j];
+    }
+    fNCluModSum += shard->fNCluModSum;
+    fNCluModEvt += shard->fNCluModEvt;
+    fNTrkModSum += shard->fNTrkModSum;
+}
+
+
+
+
 /****************************************************************/
 void EventReader::loop(int nEvent)
 {
@@ -293,6 +433,31 @@ void EventReader::loop(int nEvent)
     int mStat = 0; // 0 means no more data, 1=good >1=corrupt
     int rStat = 0;
 
+    // events are read and synchronized here, clustering and tracking runs on fNThreads workers
+    // which fill their own copies of the histograms
+    EventPipeline pipeline;
+    vector<EventWorker> workers;
+    vector<TH1*> masters;
+    deque<EventRecord*> inFlight;
+    const unsigned int maxInFlight = 4 * fNThreads;
+    if(fNThreads > 1) {
+        pthread_mutex_init(&pipeline.mutex, NULL);
+        pthread_cond_init(&pipeline.queued, NULL);
+        pthread_cond_init(&pipeline.done, NULL);
+        pipeline.finished = false;
+        workers.resize(fNThreads);
+        for(int i = 0; i < fNThreads; i++) {
+            workers[i].pipeline = &pipeline;
+            workers[i].shard = new EventReader(*this);
+            workers[i].shard->resetCounters();
+            masters.clear();
+            workers[i].shard->detachHistos(masters, workers[i].copies);
+        }
+        for(int i = 0; i < fNThreads; i++) {
+            pthread_create(&workers[i].thread, NULL, EventReader::runWorker, &workers[i]);
+        }
+    }
+
     if( fMod ) mStat = fMod->readGoodDataEvent();
     if( fRoc ) rStat = fRoc->readGoodDataEvent();
 
@@ -432,144 +597,244 @@ void EventReader::loop(int nEvent)
             cout << endl;
         }
 
-        // get hits/clusters and sort them by layer
-        for(int i = 0; i < 5; i++) {
-            fHits[i].clear();
-        }
+        if( (fMod && useMod) || (fRoc && useRoc) ) {
+            EventRecord* e = new EventRecord();
+            if(fMod && useMod) {
+                e->useMod = true;
+                e->modTrigType = fMod->getTrigType();
+                e->modPixels.assign(fMod->getPixels(), fMod->getPixels() + fMod->getNHit());
+            }
+            if(fRoc && useRoc) {
+                e->useRoc = true;
+                e->rocTrigType = fRoc->getTrigType();
+                e->rocPixels.assign(fRoc->getPixels(), fRoc->getPixels() + fRoc->getNHit());
+            }
 
-        double xl[3];
-        int nCluMod, nCluRoc;
-        if(fMod && useMod) {
-            int nhmod = fMod->getNHit();
-            vector<cluster> mclu = fMod->getHits();
-            hNPixMod->Fill(nhmod);
-            nCluMod = mclu.size();
-            hNCluMod->Fill(mclu.size());
-            int nHitTracking = 0;
-            int nHitModRoc[16] = {0};
-            for(vector<cluster>::iterator c = mclu.begin(); c != mclu.end(); c++) {
-                xl[0] = (*c).xy[0];
-                xl[1] = (*c).xy[1];
-                xl[2] = 0; // set local z=0
-                fPlane[(*c).layer].localToGlobal(xl, (*c).xyz);
-                fHits[(*c).layer].push_back((*c));
-                hQCluLayer[c->layer]->Fill(c->charge);
-                hSizeCluLayer[c->layer]->Fill(c->size);
-                if( (xl[0] > -0.3) && (xl[0] < 0.3) && (xl[1] > -1.0) && (xl[1] < -0.3) ) {
-                    nHitTracking++;
+            if( e->useMod && e->useRoc ) {
+                time = fMod->getTrigBC();
+                dTime = time - oldTime;
+                oldTime = time;
+                hNPixD->Fill(time / 40.e6);
+                if(oldTime > 0) hDeltaT->Fill(dTime);
+                hDeltaTt->Fill((float)(fRoc->getBC() - fRoc->getTrigBC()));
+                // check tbm event counter
+                int dtbm = fRoc->getTBMTrigger() - fMod->getTBMTrigger();
+                if(dtbm < 0) {
+                    dtbm += 256;
                 }
-                int r = c->vpix.begin()->roc;
-                int d = c->vpix.begin()->colROC / 2;
-                nHitModRoc[r]++;
-                if( fMod->getTrigType() == BinaryFileReader::kExternalTrigger) {
-                    fNCluModDcol[r][d]++;
-                    fNCluModSum++;
+                if(!(dtbm == dtbmtrig)) {
+                    if(!(dtbmtrig == -1)) {
+                        cout << "!!! Warning !!! :  TBM trigger count offset changed from " << dtbmtrig << " to " << dtbm << endl;
+                    }
+                    dtbmtrig = dtbm;
                 }
             }
-            if( fMod->getTrigType() == BinaryFileReader::kExternalTrigger) {
-                fNCluModEvt++;
-                hNCluTracking->Fill(nHitTracking);
-                for(int i = 0; i < 16; i++) hNCluModRocExt[i]->Fill(nHitModRoc[i]);
+
+            if(fNThreads > 1) {
+                // hand the event to the workers, commit finished events in reading order
+                pthread_mutex_lock(&pipeline.mutex);
+                pipeline.todo.push_back(e);
+                pthread_cond_signal(&pipeline.queued);
+                inFlight.push_back(e);
+                while( !inFlight.empty() && (inFlight.front()->processed || inFlight.size() > maxInFlight) ) {
+                    while(!inFlight.front()->processed) {
+                        pthread_cond_wait(&pipeline.done, &pipeline.mutex);
+                    }
+                    EventRecord* f = inFlight.front();
+                    inFlight.pop_front();
+                    pthread_mutex_unlock(&pipeline.mutex);
+                    commitEvent(*f);
+                    delete f;
+                    pthread_mutex_lock(&pipeline.mutex);
+                }
+                pthread_mutex_unlock(&pipeline.mutex);
             } else {
-                for(int i = 0; i < 16; i++) hNCluModRocInt[i]->Fill(nHitModRoc[i]);
+                processEvent(*e);
+                commitEvent(*e);
+                delete e;
             }
         }
 
 
-        if(fRoc && useRoc) {
-            int nhroc = fRoc->getNHit();
-            vector<cluster> rclu = fRoc->getHits();
-            nCluRoc = rclu.size();
-            hNPixRoc->Fill(nhroc);
 
-            hNCluRoc->Fill(rclu.size());
-            int nc[4] = {0};
-            int nShadow = 0;
-            for(vector<cluster>::iterator c = rclu.begin(); c != rclu.end(); c++) {
-                if(c->charge > fQminTrk) {
-                    nc[c->layer]++;
-                }
-                hQCluLayer[c->layer]->Fill(c->charge);
-                hSizeCluLayer[c->layer]->Fill(c->size);
-                if( (c->layer == 2) && (c->charge > fQminTrk) &&
-                        (c->col >= fShadowColMin) && (c->col <= fShadowColMax) &&
-                        (c->row >= fShadowRowMin) && (c->row <= fShadowRowMax) ) {
-                    nShadow++;
-                }
-            }
-            hNCluRoc1->Fill(nc[0]);
-            hNCluRoc2->Fill(nc[1]);
-            hNCluRoc3->Fill(nc[2]);
-            hNCluRoc4->Fill(nc[3]);
-            if(fRoc->getTrigType() == BinaryFileReader::kExternalTrigger) {
-                hNCluShadowExt->Fill(nShadow);
-            } else if(fRoc->getTrigType() == BinaryFileReader::kInternalTrigger) {
-                hNCluShadowInt->Fill(nShadow);
-            } else if(fRoc->getTrigType() == BinaryFileReader::kCalInject) {
-                hNCluShadowCal->Fill(nShadow);
-            }
+        if( fMod && readMod ) mStat = fMod->readDataEvent();
+        if( fRoc && readRoc ) rStat = fRoc->readDataEvent();
+        more = ( mStat | rStat );
 
+    }// event loop
 
-            if(nCluRoc == 0) {
-                if(fMod && useMod) {
-                    for(vector<cluster>::iterator c = fHits[4].begin(); c != fHits[4].end(); c++) {
-                        hRocEmpty->Fill(c->xy[0], c->xy[1]);
-                    }
-                }
+    if(fNThreads > 1) {
+        pthread_mutex_lock(&pipeline.mutex);
+        pipeline.finished = true;
+        pthread_cond_broadcast(&pipeline.queued);
+        pthread_mutex_unlock(&pipeline.mutex);
+        for(unsigned int i = 0; i < workers.size(); i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        for(deque<EventRecord*>::iterator e = inFlight.begin(); e != inFlight.end(); e++) {
+            commitEvent(**e);
+            delete *e;
+        }
+        // merge the histograms and counters of the workers
+        for(unsigned int i = 0; i < workers.size(); i++) {
+            for(unsigned int h = 0; h < masters.size(); h++) {
+                masters[h]->Add(workers[i].copies[h]);
+                delete workers[i].copies[h];
             }
+            addCounters(workers[i].shard);
+            delete workers[i].shard;
+        }
+        pthread_cond_destroy(&pipeline.queued);
+        pthread_cond_destroy(&pipeline.done);
+        pthread_mutex_destroy(&pipeline.mutex);
+    }
+
+    // hits still buffered for the event trees
+    if(fMod) fMod->flushEvents();
+    if(fRoc) fRoc->flushEvents();
+
+    if (fAlignmentFile) {
+        fAlignmentFile->close();
+    }
+}//void loop()
+
+
+/************************************************************/
+// clustering and tracking of one event, only touches the event, the histograms and counters of this reader
+void EventReader::processEvent(EventRecord& e)
+{
+    fEvent = &e;
+
+    // get hits/clusters and sort them by layer
+    for(int i = 0; i < 5; i++) {
+        fHits[i].clear();
+    }
 
-            for(vector<cluster>::iterator c = rclu.begin(); c != rclu.end(); c++) {
-                xl[0] = (*c).xy[0];
-                xl[1] = (*c).xy[1];
-                xl[2] = 0; // set local z=0
-                fPlane[(*c).layer].localToGlobal(xl, (*c).xyz);
-                if( isnan((*c).xyz[0])) cout << "zeter und mordio " << xl[0] << " " << xl[1] << endl;
-                fHits[(*c).layer].push_back((*c));
+    double xl[3];
+    int nCluMod = 0, nCluRoc = 0;
+    if(e.useMod) {
+        int nhmod = e.modPixels.size();
+        e.modClusters = fMod->findClusters(nhmod ? &e.modPixels[0] : NULL, nhmod);
+        vector<cluster>& mclu = e.modClusters;
+        hNPixMod->Fill(nhmod);
+        nCluMod = mclu.size();
+        hNCluMod->Fill(mclu.size());
+        int nHitTracking = 0;
+        int nHitModRoc[16] = {0};
+        for(vector<cluster>::iterator c = mclu.begin(); c != mclu.end(); c++) {
+            xl[0] = (*c).xy[0];
+            xl[1] = (*c).xy[1];
+            xl[2] = 0; // set local z=0
+            fPlane[(*c).layer].localToGlobal(xl, (*c).xyz);
+            fHits[(*c).layer].push_back((*c));
+            hQCluLayer[c->layer]->Fill(c->charge);
+            hSizeCluLayer[c->layer]->Fill(c->size);
+            if( (xl[0] > -0.3) && (xl[0] < 0.3) && (xl[1] > -1.0) && (xl[1] < -0.3) ) {
+                nHitTracking++;
+            }
+            int r = c->vpix.begin()->roc;
+            int d = c->vpix.begin()->colROC / 2;
+            nHitModRoc[r]++;
+            if( e.modTrigType == BinaryFileReader::kExternalTrigger) {
+                fNCluModDcol[r][d]++;
+                fNCluModSum++;
             }
         }
+        if( e.modTrigType == BinaryFileReader::kExternalTrigger) {
+            fNCluModEvt++;
+            hNCluTracking->Fill(nHitTracking);
+            for(int i = 0; i < 16; i++) hNCluModRocExt[i]->Fill(nHitModRoc[i]);
+        } else {
+            for(int i = 0; i < 16; i++) hNCluModRocInt[i]->Fill(nHitModRoc[i]);
+        }
+    }
 
 
+    if(e.useRoc) {
+        int nhroc = e.rocPixels.size();
+        e.rocClusters = fRoc->findClusters(nhroc ? &e.rocPixels[0] : NULL, nhroc);
+        vector<cluster>& rclu = e.rocClusters;
+        nCluRoc = rclu.size();
+        hNPixRoc->Fill(nhroc);
 
-        if( fMod && useMod && fRoc && useRoc) {
-
-            hNCluCorr->Fill(nCluRoc, nCluMod);
-            hNPixCorr->Fill(fRoc->getNHit(), fMod->getNHit());
-            if (fAlignmentFile) {
-                dumpHits(fAlignmentFile);
+        hNCluRoc->Fill(rclu.size());
+        int nc[4] = {0};
+        int nShadow = 0;
+        for(vector<cluster>::iterator c = rclu.begin(); c != rclu.end(); c++) {
+            if(c->charge > fQminTrk) {
+                nc[c->layer]++;
             }
-            time = fMod->getTrigBC();
-            dTime = time - oldTime;
-            oldTime = time;
-            hNPixD->Fill(time / 40.e6);
-            if(oldTime > 0) hDeltaT->Fill(dTime);
-            hDeltaTt->Fill((float)(fRoc->getBC() - fRoc->getTrigBC()));
-            // check tbm event counter
-            int dtbm = fRoc->getTBMTrigger() - fMod->getTBMTrigger();
-            if(dtbm < 0) {
-                dtbm += 256;
+            hQCluLayer[c->layer]->Fill(c->charge);
+            hSizeCluLayer[c->layer]->Fill(c->size);
+            if( (c->layer == 2) && (c->charge > fQminTrk) &&
+                    (c->col >= fShadowColMin) && (c->col <= fShadowColMax) &&
+                    (c->row >= fShadowRowMin) && (c->row <= fShadowRowMax) ) {
+                nShadow++;
             }
-            if(!(dtbm == dtbmtrig)) {
-                if(!(dtbmtrig == -1)) {
-                    cout << "!!! Warning !!! :  TBM trigger count offset changed from " << dtbmtrig << " to " << dtbm << endl;
+        }
+        hNCluRoc1->Fill(nc[0]);
+        hNCluRoc2->Fill(nc[1]);
+        hNCluRoc3->Fill(nc[2]);
+        hNCluRoc4->Fill(nc[3]);
+        if(e.rocTrigType == BinaryFileReader::kExternalTrigger) {
+            hNCluShadowExt->Fill(nShadow);
+        } else if(e.rocTrigType == BinaryFileReader::kInternalTrigger) {
+            hNCluShadowInt->Fill(nShadow);
+        } else if(e.rocTrigType == BinaryFileReader::kCalInject) {
+            hNCluShadowCal->Fill(nShadow);
+        }
+
+
+        if(nCluRoc == 0) {
+            if(e.useMod) {
+                for(vector<cluster>::iterator c = fHits[4].begin(); c != fHits[4].end(); c++) {
+                    hRocEmpty->Fill(c->xy[0], c->xy[1]);
                 }
-                dtbmtrig = dtbm;
             }
+        }
 
-            fv = NULL;
-            findTracks();
+        for(vector<cluster>::iterator c = rclu.begin(); c != rclu.end(); c++) {
+            xl[0] = (*c).xy[0];
+            xl[1] = (*c).xy[1];
+            xl[2] = 0; // set local z=0
+            fPlane[(*c).layer].localToGlobal(xl, (*c).xyz);
+            if( isnan((*c).xyz[0])) cout << "zeter und mordio " << xl[0] << " " << xl[1] << endl;
+            fHits[(*c).layer].push_back((*c));
         }
+    }
 
 
 
-        if( fMod && readMod ) mStat = fMod->readDataEvent();
-        if( fRoc && readRoc ) rStat = fRoc->readDataEvent();
-        more = ( mStat | rStat );
+    if( e.useMod && e.useRoc) {
+        hNCluCorr->Fill(nCluRoc, nCluMod);
+        hNPixCorr->Fill(e.rocPixels.size(), e.modPixels.size());
+        findTracks();
+        // keep the hits for the alignment file
+        for(int i = 0; i < 5; i++) {
+            e.hits[i].swap(fHits[i]);
+        }
+    }
+    fEvent = NULL;
+}
 
-    }// event loop
-    if (fAlignmentFile) {
-        fAlignmentFile->close();
+/************************************************************/
+// everything that has to happen in the order the events were read
+void EventReader::commitEvent(EventRecord& e)
+{
+    if(e.useMod) fMod->fillClusterTree(e.modClusters);
+    if(e.useRoc) fRoc->fillClusterTree(e.rocClusters);
+    if( e.useMod && e.useRoc && fAlignmentFile ) {
+        dumpHits(fAlignmentFile, e.hits);
     }
-}//void loop()
+    if(e.view) {
+        EventView* v = addEventView(e);
+        if(v) {
+            for(unsigned int i = 0; i + 4 <= e.viewTracks.size(); i += 4) {
+                v->addTrack(&e.viewTracks[i]);
+            }
+        }
+    }
+}
 
 /************************************************************/
 
@@ -596,18 +861,18 @@ void EventReader::printRunSummary()
 
 /************************************************************/
 
-void EventReader::dumpHits(ofstream *f)
+void EventReader::dumpHits(ofstream *f, vector<cluster>* hits)
 {
 
     fnAlignment++;
     int nevent = 0;
     for(int i = 0; i < 5; i++) {
-        nevent += fHits[i].size();
+        nevent += hits[i].size();
     }
     (*f) << fnAlignment << " " << nevent << endl;
 
     for(int i = 0; i < 5; i++) {
-        for(vector<cluster>::iterator c = fHits[i].begin(); c != fHits[i].end(); c++) {
+        for(vector<cluster>::iterator c = hits[i].begin(); c != hits[i].end(); c++) {
             *f << Form("%2d  %10f %10f %10f",
                        (*c).layer,	(*c).xyz[0] * 10, (*c).xyz[1] * 10, (*c).xyz[2] * 10) << endl;
         }
@@ -622,10 +887,23 @@ void EventReader::findTracks()
     double cov[4 * 4];
     double n[3];
     double x0[3];
+
+    // index the tracking layers once per event, the road search then only looks at hits near the intercept
+    vector<cluster>& hits3 = fHits[fTLayer1];
+    vector<cluster>& hits4 = fHits[fTLayer2];
+    HitGrid grid3, grid4;
+    grid3.build(hits3, fSearchRadius);
+    grid4.build(hits4, fSearchRadius);
+    vector<double> phi3(hits3.size()), phi4(hits4.size());
+    for(unsigned int i = 0; i < hits3.size(); i++) phi3[i] = atan2(hits3[i].xy[0], hits3[i].xy[1]);
+    for(unsigned int i = 0; i < hits4.size(); i++) phi4[i] = atan2(hits4[i].xy[0], hits4[i].xy[1]);
+    vector<double> dx4(hits4.size()), dy4(hits4.size()), dist4(hits4.size());
+    vector<int> road3, road4;
+
     // loop over hits in seed layers to form track candidates
     int nSeedPair = 0;
     fNFound = 0;
-    vector<cluster>::iterator c1, c2, c3, c4;
+    vector<cluster>::iterator c1, c2;
     for(c1 = fHits[fSeed1].begin(); c1 != fHits[fSeed1].end(); c1++) {
 
         //if( abs((*c1).xy[0])>0.3) break;
@@ -654,66 +932,63 @@ void EventReader::findTracks()
             // look for nearby hits in both tracking layers
             int TracksPerSeedPair = 0;
 
-            double xl3[3];
+            double xl3[3], xl4[3];
             fPlane[fTLayer1].interceptLocal(x0, n, xl3);
-
-            for(c3 = fHits[fTLayer1].begin(); c3 != fHits[fTLayer1].end(); c3++) {
-
-                double dx3 = (*c3).xy[0] - xl3[0];
-                double dy3 = (*c3).xy[1] - xl3[1];
-                double dist3 = hypot(dx3, dy3 );
-                double phi3 = atan2((*c3).xy[0], (*c3).xy[1]);
-
-
-                double xl4[3];
-                fPlane[fTLayer2].interceptLocal(x0, n, xl4);
-                int n4 = 0;
-
-                for(c4 = fHits[fTLayer2].begin(); c4 != fHits[fTLayer2].end(); c4++) {
-
-                    double dx4 = (*c4).xy[0] - xl4[0];
-                    double dy4 = (*c4).xy[1] - xl4[1];
-                    double dist4 = hypot(dx4, dy4 );
-                    double phi4 = atan2((*c4).xy[0], (*c4).xy[1]);
-                    if( dist4 < fSearchRadius * 0.5) {
-                        n4++;
+            fPlane[fTLayer2].interceptLocal(x0, n, xl4);
+
+            // four hit candidates, in the same order as a loop over all pairs of tracking layer hits
+            grid3.find(xl3[0], xl3[1], fSearchRadius, road3);
+            if(road3.empty()) road4.clear();
+            else grid4.find(xl4[0], xl4[1], fSearchRadius, road4);
+            for(unsigned int i3 = 0; i3 < road3.size(); i3++) {
+                for(unsigned int i4 = 0; i4 < road4.size(); i4++) {
+                    // we have found a four hit candidate, fit it
+                    double chisq = fitTrack(c1, c2, hits3.begin() + road3[i3], hits4.begin() + road4[i4], par, cov);
+                    hFitChisq->Fill(chisq);
+                    //if ( (chisq<fChiSqCut)&&(par[1]>(-0.7+0.64))&&(par[0]>-0.04) ){
+                    if ( (chisq < fChiSqCut) && (par[1] > (-0.7 + 0.64)) ) {
+                        //if ( chisq<fChiSqCut){
+                        TracksPerSeedPair++;
+                        goodTrack(par, 0);
+                        hScint->Fill(par[0] + fzScint * par[2], par[1] + fzScint * par[3]);
                     }
+                }
+            }
 
-                    if( dist3  < fSearchRadius * 0.5) {
-                        hDistTLayer2->Fill(dist4);
-                        hDxTLayer2->Fill(dx4);
-                        hDyTLayer2->Fill(dy4);
-                        hDxDyTLayer2->Fill(dx4, dy4);
-                        hDxPhiTLayer2->Fill(dx4, phi4);
-                        hDyPhiTLayer2->Fill(dy4, phi4);
+            // tracking layer 2 residuals are filled for every layer 1 hit within half of the search radius
+            int n3 = grid3.count(xl3[0], xl3[1], fSearchRadius * 0.5);
+            if(n3 > 0) {
+                for(unsigned int i4 = 0; i4 < hits4.size(); i4++) {
+                    dx4[i4] = hits4[i4].xy[0] - xl4[0];
+                    dy4[i4] = hits4[i4].xy[1] - xl4[1];
+                    dist4[i4] = hypot(dx4[i4], dy4[i4]);
+                }
+                for(int k = 0; k < n3; k++) {
+                    for(unsigned int i4 = 0; i4 < hits4.size(); i4++) {
+                        hDistTLayer2->Fill(dist4[i4]);
+                        hDxTLayer2->Fill(dx4[i4]);
+                        hDyTLayer2->Fill(dy4[i4]);
+                        hDxDyTLayer2->Fill(dx4[i4], dy4[i4]);
+                        hDxPhiTLayer2->Fill(dx4[i4], phi4[i4]);
+                        hDyPhiTLayer2->Fill(dy4[i4], phi4[i4]);
                     }
+                }
+            }
 
-                    if(( dist4 < fSearchRadius) && (dist3 < fSearchRadius) ) {
-                        // we have found a four hit candidate, fit it
-                        double chisq = fitTrack(c1, c2, c3, c4, par, cov);
-                        hFitChisq->Fill(chisq);
-                        //if ( (chisq<fChiSqCut)&&(par[1]>(-0.7+0.64))&&(par[0]>-0.04) ){
-                        if ( (chisq < fChiSqCut) && (par[1] > (-0.7 + 0.64)) ) {
-                            //if ( chisq<fChiSqCut){
-                            TracksPerSeedPair++;
-                            goodTrack(par, 0);
-                            hScint->Fill(par[0] + fzScint * par[2], par[1] + fzScint * par[3]);
-                        }
-                    } // c4 in road
-
-                }//c4 loop
-
-                // only fill c3 histos when c4-confirmed
-                if(n4 > 0) {
+            // only fill tracking layer 1 residuals when confirmed by layer 2
+            if(grid4.count(xl4[0], xl4[1], fSearchRadius * 0.5) > 0) {
+                for(unsigned int i3 = 0; i3 < hits3.size(); i3++) {
+                    double dx3 = hits3[i3].xy[0] - xl3[0];
+                    double dy3 = hits3[i3].xy[1] - xl3[1];
+                    double dist3 = hypot(dx3, dy3 );
                     hDistTLayer1->Fill(dist3);
                     hDxTLayer1->Fill(dx3);
                     hDyTLayer1->Fill(dy3);
                     hDxDyTLayer1->Fill(dx3, dy3);
-                    hDxPhiTLayer1->Fill(dx3, phi3);
-                    hDyPhiTLayer1->Fill(dy3, phi3);
+                    hDxPhiTLayer1->Fill(dx3, phi3[i3]);
+                    hDyPhiTLayer1->Fill(dy3, phi3[i3]);
                 }
-
-            }//c3 loop
+            }
             hNTracksPerSeed->Fill(TracksPerSeedPair);
 
         }//c2 loop
@@ -846,21 +1121,21 @@ void EventReader::goodTrack(double* par, int bg)
     hDUTnH2->Fill(nHit2);
     if(nHit1 == 0) {
         hMissing->Fill(xl[0], xl[1]);
-        if(!fv) fv = addEventView();
+        if(fEvent) fEvent->view = true;
     } else {
         hFound->Fill(xl[0], xl[1]);
         fNFound++;
     }
-    if(fv) {
-        fv->addTrack(par);    // event display
+    if(fEvent && fEvent->view) {
+        fEvent->viewTracks.insert(fEvent->viewTracks.end(), par, par + 4);    // event display
     }
 }
 
 
 
-EventView* EventReader::addEventView()
+EventView* EventReader::addEventView(const EventRecord& e)
 {
-    pixel* pb;
+    const pixel* pb;
     EventView* v = NULL;
     if(vev.size() < 100) {
         v = new EventView();
@@ -869,9 +1144,9 @@ EventView* EventReader::addEventView()
         }
         //v->fPlane[i]=&fPlane[i];
 
-        if(fRoc) {
-            pb = fRoc->getPixels();
-            int np = fRoc->getNHit();
+        if(e.useRoc) {
+            pb = e.rocPixels.empty() ? NULL : &e.rocPixels[0];
+            int np = e.rocPixels.size();
             for(int i = 0; i < np; i++) {
                 double w = 0.0150;
                 if((pb[i].colROC == 0) || (pb[i].colROC == 51)) {
@@ -885,9 +1160,9 @@ EventView* EventReader::addEventView()
                 //v->addPixel(pb[i].roc, pb[i].col, pb[i].row, pb[i]);
             }
         }
-        if(fMod) {
-            pb = fMod->getPixels();
-            for(int i = 0; i < fMod->getNHit(); i++) {
+        if(e.useMod) {
+            pb = e.modPixels.empty() ? NULL : &e.modPixels[0];
+            for(unsigned int i = 0; i < e.modPixels.size(); i++) {
                 double w = 0.0150;
                 if((pb[i].colROC == 0) || (pb[i].colROC == 51)) {
                     w = 0.0300;
@@ -5,8 +5,24 @@
 //#include "RocGeometry.h"
 #include "EventView.h"
 #include "Plane.h"
+class TH1;
 class TH2F;
 
+// one event on its way through the event loop, owns copies of the pixels so that the readers can move on
+struct EventRecord {
+    bool useMod, useRoc;
+    int modTrigType, rocTrigType;
+    vector<pixel> modPixels, rocPixels;
+    // filled by EventReader::processEvent
+    vector<cluster> modClusters, rocClusters;
+    vector<cluster> hits[5];
+    bool processed;
+    bool view;                 // a track missed the DUT, show the event
+    vector<double> viewTracks; // 4 parameters per track
+    EventRecord() : useMod(false), useRoc(false), modTrigType(0), rocTrigType(0),
+        processed(false), view(false) {}
+};
+
 class EventReader {
 
 private:
@@ -31,7 +47,15 @@ private:
     int fShadowRowMin, fShadowRowMax, fShadowColMin, fShadowColMax;
 
     vector<EventView *> vev;
-    EventView* fv;
+    EventRecord* fEvent;
+    int fNThreads;
+
+    void processEvent(EventRecord& e);
+    void commitEvent(EventRecord& e);
+    void detachHistos(vector<TH1*>& masters, vector<TH1*>& copies);
+    void resetCounters();
+    void addCounters(const EventReader* shard);
+    static void* runWorker(void* arg);
 
 public:
     BinaryFileReader* fMod;
@@ -99,13 +123,17 @@ public:
     EventReader(const char* telescope, const char* module);
     void init();
     void loop(int nEvent = 0);
+    // number of threads clustering and tracking events, 1 processes all events in the reading thread
+    void setNThreads(int n) {
+        fNThreads = n;
+    };
     void printRunSummary();
     void findTracks();
     double fitTrack(vector<cluster>::iterator c1, vector<cluster>::iterator c2,
                     vector<cluster>::iterator c3, vector<cluster>::iterator c4,
                     double* par, double* cov);
     void goodTrack(double *par, int bg = 0);
-    void dumpHits(ofstream *f);
+    void dumpHits(ofstream *f, vector<cluster>* hits);
     double lineFit(double* x, double* y, int n, double* slope, double* offset);
     void setVerbose(int v) {
         fVerbose = v;
@@ -129,7 +157,7 @@ public:
         return fDUTLayer;
     }
 
-    EventView* addEventView();
+    EventView* addEventView(const EventRecord& e);
     EventView* getEventView(unsigned int n);
     int getNEventView() {
         return vev.size();
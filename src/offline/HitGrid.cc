@@ -0,0 +1,102 @@
+#include <math.h>
+#include <algorithm>
+#include "BinaryFileReader.h"
+#include "HitGrid.h"
+
+
+/************************************************************/
+HitGrid::HitGrid()
+    : fHits(0), fCellSize(1), fXmin(0), fYmin(0), fNx(0), fNy(0)
+{
+}
+
+
+/************************************************************/
+void HitGrid::build(const std::vector<cluster>& hits, double cellSize)
+{
+    fHits = &hits;
+    fFirst.clear();
+    fIndex.clear();
+    fNx = fNy = 0;
+    if(hits.empty()) return;
+
+    double xmin = hits[0].xy[0], xmax = xmin, ymin = hits[0].xy[1], ymax = ymin;
+    for(unsigned int i = 1; i < hits.size(); i++) {
+        xmin = std::min(xmin, hits[i].xy[0]);
+        xmax = std::max(xmax, hits[i].xy[0]);
+        ymin = std::min(ymin, hits[i].xy[1]);
+        ymax = std::max(ymax, hits[i].xy[1]);
+    }
+    fCellSize = cellSize > 0 ? cellSize : 1;
+    fCellSize = std::max(fCellSize, std::max(xmax - xmin, ymax - ymin) / (maxCells - 1));
+    fXmin = xmin;
+    fYmin = ymin;
+    fNx = int((xmax - xmin) / fCellSize) + 1;
+    fNy = int((ymax - ymin) / fCellSize) + 1;
+
+    // counting sort of the hit indices by cell, keeps ascending order within each cell
+    std::vector<int> cell(hits.size());
+    fFirst.assign(fNx * fNy + 1, 0);
+    for(unsigned int i = 0; i < hits.size(); i++) {
+        int ix = std::min(int((hits[i].xy[0] - fXmin) / fCellSize), fNx - 1);
+        int iy = std::min(int((hits[i].xy[1] - fYmin) / fCellSize), fNy - 1);
+        cell[i] = ix * fNy + iy;
+        fFirst[cell[i] + 1]++;
+    }
+    for(int i = 0; i < fNx * fNy; i++) fFirst[i + 1] += fFirst[i];
+    std::vector<int> next(fFirst.begin(), fFirst.end() - 1);
+    fIndex.resize(hits.size());
+    for(unsigned int i = 0; i < hits.size(); i++) fIndex[next[cell[i]]++] = i;
+}
+
+
+/************************************************************/
+bool HitGrid::cellRange(double x, double y, double radius, int& ix1, int& ix2, int& iy1, int& iy2) const
+{
+    // also rejects NaN intercepts
+    if(!(x + radius >= fXmin && x - radius <= fXmin + fNx * fCellSize
+            && y + radius >= fYmin && y - radius <= fYmin + fNy * fCellSize)) return false;
+    ix1 = std::max(0, int(floor((x - radius - fXmin) / fCellSize)));
+    ix2 = std::min(fNx - 1, int(floor((x + radius - fXmin) / fCellSize)));
+    iy1 = std::max(0, int(floor((y - radius - fYmin) / fCellSize)));
+    iy2 = std::min(fNy - 1, int(floor((y + radius - fYmin) / fCellSize)));
+    return true;
+}
+
+
+/************************************************************/
+void HitGrid::find(double x, double y, double radius, std::vector<int>& result) const
+{
+    result.clear();
+    int ix1, ix2, iy1, iy2;
+    if(!fNx || !cellRange(x, y, radius, ix1, ix2, iy1, iy2)) return;
+    for(int ix = ix1; ix <= ix2; ix++) {
+        for(int iy = iy1; iy <= iy2; iy++) {
+            int c = ix * fNy + iy;
+            for(int k = fFirst[c]; k < fFirst[c + 1]; k++) {
+                const cluster& hit = (*fHits)[fIndex[k]];
+                if(hypot(hit.xy[0] - x, hit.xy[1] - y) < radius) result.push_back(fIndex[k]);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+}
+
+
+/************************************************************/
+int HitGrid::count(double x, double y, double radius) const
+{
+    int n = 0;
+    int ix1, ix2, iy1, iy2;
+    if(!fNx || !cellRange(x, y, radius, ix1, ix2, iy1, iy2)) return 0;
+    for(int ix = ix1; ix <= ix2; ix++) {
+        for(int iy = iy1; iy <= iy2; iy++) {
+            int c = ix * fNy + iy;
+            for(int k = fFirst[c]; k < fFirst[c + 1]; k++) {
+                const cluster& hit = (*fHits)[fIndex[k]];
+                if(hypot(hit.xy[0] - x, hit.xy[1] - y) < radius) n++;
+            }
+        }
+    }
+    return n;
+}
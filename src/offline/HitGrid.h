@@ -0,0 +1,31 @@
+#ifndef HITGRID_H
+#define HITGRID_H
+
+#include <vector>
+
+struct cluster;
+
+/* Uniform grid over the local (x,y) coordinates of the hits in one layer.
+   It is built once per event; a query returns the hits inside a circle
+   without looking at the hits far away from it. */
+class HitGrid {
+public:
+    HitGrid();
+    void build(const std::vector<cluster>& hits, double cellSize);
+    // indices of the hits with hypot(dx, dy) < radius, in ascending order
+    void find(double x, double y, double radius, std::vector<int>& result) const;
+    int count(double x, double y, double radius) const;
+
+private:
+    bool cellRange(double x, double y, double radius, int& ix1, int& ix2, int& iy1, int& iy2) const;
+
+    static const int maxCells = 512; // per axis, the cells grow if the hits are spread wider
+
+    const std::vector<cluster>* fHits;
+    double fCellSize, fXmin, fYmin;
+    int fNx, fNy;
+    std::vector<int> fFirst;    // hits of cell i are fIndex[fFirst[i]] ... fIndex[fFirst[i+1]-1]
+    std::vector<int> fIndex;
+};
+
+#endif
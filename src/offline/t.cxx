@@ -36,6 +36,8 @@ TCanvas* gCanvas;
  *  Options:                                                          *
  *     -roc      read roc datafile from run directory                 *
  *     -v        verbose mode                                         *
+ *     -j <n>    cluster and track events with n threads              *
+ *     -cols <f> also write the module hits to columnar file f          *
  *     -b        don't pop up histogram window                        *
  *     -l        bootstrap address levels (re-run without -l later)   *
  *                                                                    *
@@ -60,6 +62,7 @@ int main(int argc, char **argv)
   int verbose=0;
   int usePHcal=0;
   int nEvent=0;
+  int nThreads=1;
   int ed=0;
   double mua=0;
   int levelMode=0;
@@ -67,6 +70,7 @@ int main(int argc, char **argv)
   int fit=1;
   char rtbfilename[101]="";
   char mtbfilename[101]="";
+  char columnfilename[201]="";
   int phTrim=0;
   char rootfileName[200]="";
   char path[100]="";
@@ -79,6 +83,8 @@ int main(int argc, char **argv)
 		strncpy(rtbfilename,argv[++i],100);
     }else if (!strcmp(argv[i],"-fm")) {
 		strncpy(mtbfilename,argv[++i],100);
+    }else if (!strcmp(argv[i],"-cols")) {
+		strncpy(columnfilename,argv[++i],200);
     }else if (!strcmp(argv[i],"-b")) {	
       batch=1; 
     }else if (!strcmp(argv[i],"-ph")) {	
@@ -102,6 +108,8 @@ int main(int argc, char **argv)
       sscanf(argv[++i],"%lf",&mua);
     }else if (!strcmp(argv[i],"-n")){
       sscanf(argv[++i],"%d",&nEvent);
+    }else if (!strcmp(argv[i],"-j")){
+      sscanf(argv[++i],"%d",&nThreads);
     }else if (!strcmp(argv[i],"-ed")) {
       ed=1;
 	 }
@@ -127,6 +135,8 @@ int main(int argc, char **argv)
   
   if(alignment==2) reader->fAlignmentFile=new ofstream("alignment.dat");
   reader->setVerbose(verbose);
+  reader->setNThreads(nThreads);
+  if (reader->fMod && columnfilename[0]) reader->fMod->setColumnOutput(columnfilename);
   if (reader->fMod) reader->fMod->setAnaMin(-500);
   reader->loop(nEvent);
 
@@ -0,0 +1,41 @@
+/*!
+ * \file fingerprint.h
+ * \brief Definition of Fingerprint class.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace psi {
+
+/*!
+ * \brief 64-bit FNV-1a hash used to identify a set of parameters.
+ */
+class Fingerprint {
+public:
+    Fingerprint() : value(14695981039346656037ULL) {}
+
+    Fingerprint& Add(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for(size_t n = 0; n < size; ++n) {
+            value ^= bytes[n];
+            value *= 1099511628211ULL;
+        }
+        return *this;
+    }
+
+    Fingerprint& Add(const std::string& str) { return Add(str.data(), str.size() + 1); }
+    Fingerprint& Add(int v) { return Add(&v, sizeof(v)); }
+    Fingerprint& Add(unsigned v) { return Add(&v, sizeof(v)); }
+    Fingerprint& Add(uint64_t v) { return Add(&v, sizeof(v)); }
+
+    uint64_t Value() const { return value; }
+
+private:
+    uint64_t value;
+};
+
+} // psi
@@ -133,12 +133,11 @@ void psi::BiasVoltageController::SaveMeasurements() const
         const ThreadSafeVoltageSource::MeasurementCollection& measurements = voltageSource->Measurements();
         for(ThreadSafeVoltageSource::MeasurementCollection::const_iterator iter = measurements.begin();
             iter != measurements.end(); ++iter) {
-            measurementTree.current() = psi::DataStorage::ToStorageUnits(iter->Current);
-            measurementTree.voltage() = psi::DataStorage::ToStorageUnits(iter->Voltage);
-            measurementTree.timestamp() = psi::DataStorage::ToStorageUnits(iter->Timestamp);
-            measurementTree.Fill();
+            measurementTree.Push(psi::data::ElectricCurrentMeasurement(psi::DataStorage::ToStorageUnits(iter->Current),
+                                                                       psi::DataStorage::ToStorageUnits(iter->Voltage),
+                                                                       psi::DataStorage::ToStorageUnits(iter->Timestamp)));
         }
     }
-    measurementTree.RootTree().Write("", TObject::kWriteDelete);
+    measurementTree.Write("", TObject::kWriteDelete);
     psi::DataStorage::Active().GoToPreviousDirectory();
 }
@@ -22,6 +22,16 @@ static TBAnalogInterface* AnalogTestBoardMaker()
     return new AnalogTestBoard();
 }
 
+static TBAnalogInterface* RecordingTestBoardMaker()
+{
+    return new AnalogTestBoard(AnalogTestBoard::RecordUsbTrace);
+}
+
+static TBAnalogInterface* ReplayTestBoardMaker()
+{
+    return new AnalogTestBoard(AnalogTestBoard::ReplayUsbTrace);
+}
+
 static TBAnalogInterface* FakeTestBoardMaker()
 {
     return new FakeTestBoard();
@@ -31,6 +41,8 @@ static AnalogMakerMap CreateAnalogMakerMap()
 {
     AnalogMakerMap map;
     map["Analog"] = &AnalogTestBoardMaker;
+    map["Record"] = &RecordingTestBoardMaker;
+    map["Replay"] = &ReplayTestBoardMaker;
     map["Fake"] = &FakeTestBoardMaker;
     return map;
 }
@@ -3,11 +3,16 @@
  * \brief Implementation of TestControlNetwork class.
  */
 
+#include "../config.h"
+
+#include <sstream>
+
 #include "TestControlNetwork.h"
 #include "tests/IVCurve.h"
 #include "BasePixel/RawPacketDecoder.h"
 #include "BasePixel/DecoderCalibration.h"
 #include "BasePixel/TBAnalogInterface.h"
+#include "interface/TestBoardStatistics.h"
 #include <TApplication.h>
 #include <TSystem.h>
 #include <TBrowser.h>
@@ -124,6 +129,34 @@ void TestControlNetwork::Execute(const commands::SaveCurrentMeasurements&)
     biasVoltageController->SaveMeasurements();
 }
 
+void TestControlNetwork::Execute(const commands::TbStatistics& tbStatistics)
+{
+#if ENABLE_TB_STATISTICS
+    typedef commands::detail::TbStatisticsData Data;
+    psi::TestBoardStatistics& statistics = psi::TestBoardStatistics::Singleton();
+    switch(tbStatistics.getData().GetAction()) {
+    case Data::Show: {
+        std::ostringstream ss;
+        statistics.Print(ss);
+        psi::LogInfo(LOG_HEAD) << "Testboard command statistics"
+                               << (statistics.Enabled() ? "" : " (disabled)") << ":\n" << ss.str();
+        break;
+    }
+    case Data::Reset:
+        statistics.Reset();
+        break;
+    case Data::Enable:
+        statistics.Enable(true);
+        break;
+    case Data::Disable:
+        statistics.Enable(false);
+        break;
+    }
+#else
+    psi::LogInfo(LOG_HEAD) << "Testboard command statistics are disabled at configure time.\n";
+#endif
+}
+
 void TestControlNetwork::Execute(const commands::Show&)
 {
     new TCanvas();
@@ -142,6 +175,7 @@ void TestControlNetwork::ShortCalibration()
 }
 
 // Tries to automatically adjust Vana
+// All modules are powered and measured through the same testboard, so they are adjusted one after another.
 void TestControlNetwork::AdjustVana()
 {
     for (unsigned i = 0; i < modules.size(); i++)
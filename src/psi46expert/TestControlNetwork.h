@@ -28,6 +28,7 @@ public:
     void Execute(const commands::Calibration&);
     void Execute(const commands::Show&);
     void Execute(const commands::SaveCurrentMeasurements&);
+    void Execute(const commands::TbStatistics& tbStatistics);
 
 private:
     void Initialize();
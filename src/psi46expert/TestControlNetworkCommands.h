@@ -78,9 +78,41 @@ private:
     unsigned maxTryCount;
 };
 
+class TbStatisticsData {
+public:
+    enum Action { Show, Reset, Enable, Disable };
+    static TbStatisticsData Parse(const std::vector<std::string>& commandLineArguments) {
+        typedef std::map<std::string, Action> ActionMap;
+        static ActionMap actionMap;
+        if(!actionMap.size()) {
+            actionMap["show"] = Show;
+            actionMap["reset"] = Reset;
+            actionMap["on"] = Enable;
+            actionMap["off"] = Disable;
+        }
+        static const std::string exceptionHeader = "tb_statistics command";
+        static const std::string exceptionMessage = "Usage: tb_statistics <action>, where action=show|reset|on|off";
+        if(commandLineArguments.size() > 2)
+            throw incorrect_command_exception(exceptionHeader, exceptionMessage);
+        if(commandLineArguments.size() == 1)
+            return TbStatisticsData(Show);
+        ActionMap::const_iterator iter = actionMap.find(commandLineArguments[1]);
+        if(iter == actionMap.end())
+            throw incorrect_command_exception(exceptionHeader, exceptionMessage);
+        return TbStatisticsData(iter->second);
+    }
+    TbStatisticsData(Action _action) : action(_action) {}
+    Action GetAction() const {
+        return action;
+    }
+private:
+    Action action;
+};
+
 } //detail
 PSI_CONTROL_TARGETED_COMMAND(TestControlNetwork, Bias, BiasData)
 PSI_CONTROL_TARGETED_COMMAND(TestControlNetwork, AddressDecoding, AddressDecodingData)
+PSI_CONTROL_TARGETED_COMMAND(TestControlNetwork, TbStatistics, TbStatisticsData)
 
 PSI_CONTROL_SIMPLE_TARGETED_COMMAND(TestControlNetwork, PreTest)
 PSI_CONTROL_SIMPLE_TARGETED_COMMAND(TestControlNetwork, FullTest)
@@ -111,6 +143,8 @@ public:
             map["pre_test"] = Descriptor(new PreTestPrototype(), "run pre-test", "run pre-test");
             map["calibration"] = Descriptor(new CalibrationPrototype(), "run calibration", "run calibration");
             map["show"] = Descriptor(new ShowPrototype(), "show results", "Usage: show");
+            map["tb_statistics"] = Descriptor(new TbStatisticsPrototype(), "show testboard command statistics",
+                                              "Usage: tb_statistics <action>, where action=show|reset|on|off");
             map["save_current_measurements"] = Descriptor(new ShowPrototype(), "save electric current measurements", "save electric current measurements");
         }
         return map;
@@ -8,6 +8,7 @@
 #include "psi/exception.h"
 #include "TestDoubleColumn.h"
 #include "BasePixel/TBInterface.h"
+#include "BasePixel/PhaseProfiler.h"
 #include "TestRoc.h"
 
 TestDoubleColumn::TestDoubleColumn(boost::shared_ptr<TBAnalogInterface> _tbInterface, TestRoc& aRoc, unsigned dColumn)
@@ -23,6 +24,7 @@ TestDoubleColumn::TestDoubleColumn(boost::shared_ptr<TBAnalogInterface> _tbInter
 // Performs three double column tests, not debugged nor tested yet
 void TestDoubleColumn::DoubleColumnTest()
 {
+    const PhaseProfiler::Scope phase("DoubleColumnTest");
     TestWBCSBC();
     TestTimeStampBuffer();
     TestDataBuffer();
@@ -241,10 +243,10 @@ bool TestDoubleColumn::IsIncluded(boost::shared_ptr<const TestRange> testRange)
     return testRange && testRange->IncludesDoubleColumn(roc->GetChipId(), doubleColumn);
 }
 
-void TestDoubleColumn::ADCData(short data[], unsigned readoutStop[])
+bool TestDoubleColumn::ADCData(short data[], unsigned readoutStop[])
 {
     roc->SetChip();
     roc->Flush();
-    tbInterface->DoubleColumnADCData(doubleColumn, data, readoutStop);
+    return tbInterface->DoubleColumnADCData(doubleColumn, data, readoutStop);
 }
 
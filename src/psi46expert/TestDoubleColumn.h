@@ -46,7 +46,7 @@ public:
     void DisarmPixel(unsigned column, unsigned row);
 
     bool IsIncluded(boost::shared_ptr<const TestRange> testRange) const;
-    void ADCData(short data[], unsigned readoutStop[]);
+    bool ADCData(short data[], unsigned readoutStop[]);
 
 
 
@@ -3,6 +3,8 @@
  * \brief Implementation of TestModule class.
  */
 
+#include <algorithm>
+
 #include "psi/log.h"
 #include "psi/date_time.h"
 
@@ -10,6 +12,7 @@
 #include "BasePixel/TestRange.h"
 #include "BasePixel/ThresholdMap.h"
 #include "BasePixel/DataStorage.h"
+#include "BasePixel/PhaseProfiler.h"
 
 #include "tests/SCurveTest.h"
 #include "tests/FullTest.h"
@@ -24,6 +27,7 @@
 #include "tests/TimeWalkStudy.h"
 #include "tests/PixelAlive.h"
 #include "tests/BumpBonding.h"
+#include "tests/Trim.h"
 #include "tests/TrimLow.h"
 #include "tests/PHRange.h"
 #include "tests/Xray.h"
@@ -34,6 +38,49 @@
 
 namespace {
 const std::string LOG_HEAD = "TestModule";
+
+/// State of the threshold scan of one pixel on one ROC.
+struct ThresholdScan {
+    enum Phase { Bracket, Backward, Forward, Done };
+    Phase phase;
+    int value, seed;
+    unsigned width;
+    bool aboveSeen;
+};
+
+int ClampDac(int value)
+{
+    return std::max(0, std::min(255, value));
+}
+
+/// Step of the sampling point scan: delays the testboard signals and arms the test pixel again.
+struct SamplingPointStep {
+    TestRoc* roc;
+    TBAnalogInterface* tbInterface;
+    int clk, sda, ctr, tin;
+    bool tbmEmulator, debug;
+
+    SamplingPointStep(TestRoc* _roc, TBAnalogInterface* _tbInterface, int _clk, int _sda, int _ctr, int _tin,
+                      bool _tbmEmulator, bool _debug)
+        : roc(_roc), tbInterface(_tbInterface), clk(_clk), sda(_sda), ctr(_ctr), tin(_tin),
+          tbmEmulator(_tbmEmulator), debug(_debug) {}
+
+    void operator()(unsigned delay) const
+    {
+        if (debug)
+            psi::LogDebug(LOG_HEAD) << "Delay " << delay << ".\n";
+        if (delay)
+            roc->DisarmPixel(5, 5);
+
+        tbInterface->SetTBParameter(TBParameters::clk, (clk + delay) );
+        tbInterface->SetTBParameter(TBParameters::sda, (sda + delay) );
+        tbInterface->SetTBParameter(TBParameters::ctr, (ctr + delay) );
+        tbInterface->SetTBParameter(TBParameters::tin, (tin + delay) );
+        if(tbmEmulator) tbInterface->SetTBParameter(TBParameters::rda, (100 - (tin + delay)) ); // ask chris to be true with the tbmemulator
+
+        roc->ArmPixel(5, 5); //pixel must not be enabled during setting of the tb parameters above
+    }
+};
 } // anonymous namespace
 
 TestModule::TestModule(int aCNId, boost::shared_ptr<TBAnalogInterface> aTBInterface)
@@ -83,7 +130,7 @@ void TestModule::FullTestAndCalibration()
 void TestModule::Calibration()
 {
     for (unsigned i = 0; i < rocs.size(); i++) GetRoc(i).DoPhCalibration();
-    for (unsigned i = 0; i < rocs.size(); i++) GetRoc(i).DoTrim();
+    DoTest(boost::shared_ptr<Test>(new Trim(FullRange(), tbInterface)));
 }
 
 void TestModule::ShortCalibration()
@@ -126,6 +173,7 @@ void TestModule::ShortTestAndCalibration()
 
 void TestModule::DoTest(boost::shared_ptr<Test> aTest)
 {
+    const PhaseProfiler::Scope phase("ModuleAction");
     aTest->ModuleAction(*this);
 }
 
@@ -179,9 +227,9 @@ void TestModule::DigiCurrent()
 
 void TestModule::AdjustSamplingPoint()
 {
+    static const int nDelays = 25, nTrig = 10;
     bool debug = false;
-    short data[10000], ph[25];
-    unsigned short count;
+    short ph[nDelays];
     FILE *file;
 
     if (debug) {
@@ -208,37 +256,39 @@ void TestModule::AdjustSamplingPoint()
         psi::LogInfo() << "clk " << clk << std::endl;
     const ConfigParameters& configParameters = ConfigParameters::Singleton();
 
-    for (int delay = 0; delay < 25; ++delay) {
-        if (debug)
-            psi::LogDebug(LOG_HEAD) << "Delay " << delay << ".\n";
-
-        tbInterface->SetTBParameter(TBParameters::clk, (clk + delay) );
-        tbInterface->SetTBParameter(TBParameters::sda, (sda + delay) );
-        tbInterface->SetTBParameter(TBParameters::ctr, (ctr + delay) );
-        tbInterface->SetTBParameter(TBParameters::tin, (tin + delay) );
-        if(configParameters.TbmEmulator()) tbInterface->SetTBParameter(TBParameters::rda, (100 - (tin + delay)) ); // ask chris to be true with the tbmemulator
-
-
-        tbInterface->Flush();
-
-        int nTrig = 10;
-
-        GetRoc(0).ArmPixel(5, 5); //pixel must not be enabled during setting of the tb parameters above
-        tbInterface->Flush();
-
-        tbInterface->ADCRead(data, count, nTrig);
-
-        GetRoc(0).DisarmPixel(5, 5);
+    // All delays are scanned in one command list, the pixel of the previous delay is disarmed by the next step.
+    TestRoc& roc = GetRoc(0);
+    std::vector<ADCSpan> readouts;
+    const bool scanned = tbInterface->ADCScan(nDelays, SamplingPointStep(&roc, tbInterface.get(), clk, sda, ctr, tin,
+                                                                         configParameters.TbmEmulator(), debug),
+                                              nTrig, readouts);
+    roc.DisarmPixel(5, 5);
+    if (!scanned) {
+        psi::LogError(LOG_HEAD) << "Sampling point scan failed: the testboard did not answer all ADC readouts."
+                                << " Keeping the previous sampling point.\n";
+        tbInterface->SetTBParameter(TBParameters::clk, clk);
+        tbInterface->SetTBParameter(TBParameters::sda, sda);
+        tbInterface->SetTBParameter(TBParameters::ctr, ctr);
+        tbInterface->SetTBParameter(TBParameters::tin, tin);
+        tbInterface->SetTBParameter(TBParameters::rda, rda);
+        GetRoc(0).SetDAC(DACParameters::CtrlReg, ctrlReg);
+        GetRoc(0).SetDAC(DACParameters::Vcal, vcal);
         tbInterface->Flush();
+        if (debug) fclose(file);
+        return;
+    }
+    tbInterface->Flush();
 
-        if (count > 16) ph[delay] = data[16];
+    for (int delay = 0; delay < nDelays; ++delay) {
+        const ADCSpan& data = readouts[delay];
+        if (data.size() > 16) ph[delay] = data[16];
         else ph[delay] = -9999;
 
         if (debug) {
 
-            psi::LogInfo() << "count " << count << std::endl;
+            psi::LogInfo() << "count " << data.size() << std::endl;
             fprintf(file, "%+.3i: ", clk + delay);
-            for (int i = 0; i < count; i++) fprintf(file, "%+.3i ", data[i]);
+            for (unsigned i = 0; i < data.size(); i++) fprintf(file, "%+.3i ", data[i]);
             fprintf(file, "\n");
         }
     }
@@ -250,7 +300,7 @@ void TestModule::AdjustSamplingPoint()
 
     short maxPH = -9999;
     int maxDelay = 0, lowerDelay, upperDelay;
-    for (int i = 0; i < 25; i++) {
+    for (int i = 0; i < nDelays; i++) {
         if (debug)
             psi::LogInfo() << "ph " << ph[i] << std::endl;
         if (ph[i] > maxPH) {
@@ -425,7 +475,23 @@ void TestModule::AdjustTBMUltraBlack()
     DoTest(boost::shared_ptr<Test>(new TBMUbCheck(fullRange, tbInterface)));
 }
 
-// Tries to automatically adjust Vana, may not work yet
+// -- Analog current after it has settled: sampled until two consecutive readings agree
+psi::ElectricCurrent TestModule::GetSettledIA()
+{
+    static const psi::ElectricCurrent tolerance = 0.0002 * psi::amperes;
+    static const unsigned maxSamples = 5;
+
+    psi::ElectricCurrent current = tbInterface->GetIA();
+    for(unsigned n = 1; n < maxSamples; ++n) {
+        const psi::ElectricCurrent previous = current;
+        current = tbInterface->GetIA();
+        if(psi::abs(current - previous) < tolerance)
+            break;
+    }
+    return current;
+}
+
+// -- Adjusts Vana of all ROCs, one ROC at a time, to draw goalCurrent each
 void TestModule::AdjustVana(psi::ElectricCurrent goalCurrent)
 {
     std::vector<int> vana(rocs.size());
@@ -438,8 +504,7 @@ void TestModule::AdjustVana(psi::ElectricCurrent goalCurrent)
         GetRoc(iRoc).SetDAC(DACParameters::Vsf, 0);
     }
     tbInterface->Flush();
-    psi::Sleep(0.5 * psi::seconds);
-    const psi::ElectricCurrent current0 = tbInterface->GetIA();
+    const psi::ElectricCurrent current0 = GetSettledIA();
 
     psi::LogDebug() << "[TestModule] ZeroCurrent " << current0 << std::endl;
 
@@ -452,8 +517,7 @@ void TestModule::AdjustVana(psi::ElectricCurrent goalCurrent)
         GetRoc(iRoc).SetDAC(DACParameters::Vsf, vsf[iRoc]);
     }
     tbInterface->Flush();
-    psi::Sleep(0.5 * psi::seconds);
-    psi::ElectricCurrent current = tbInterface->GetIA();
+    const psi::ElectricCurrent current = GetSettledIA();
 
     psi::LogDebug() << "[TestModule] TotalCurrent " << current << std::endl;
 }
@@ -711,3 +775,122 @@ void TestModule::WriteDACParameterFile( const char* filename)
 {
     for (unsigned i = 0; i < rocs.size(); i++) rocs[i]->WriteDACParameterFile(filename);
 }
+
+void TestModule::ChipThreshold(const std::vector<TestRoc*>& selectedRocs, const TestRange& testRange, int start,
+                               int step, int thrLevel, int nTrig, DACParameters::Register dacReg, bool xtalk,
+                               bool cals, std::vector< std::vector<int> >& data,
+                               const std::vector<ThresholdCache::Seeds>* seeds)
+{
+    static const int NO_THRESHOLD = 255;
+    const size_t nSelected = selectedRocs.size();
+    if (!ConfigParameters::Singleton().ModuleThresholdScan() || nSelected < 2 || !tbInterface->TBMPresent()) {
+        // The firmware scan of each ROC is the default, the host driven module scan is enabled in the config.
+        data.resize(nSelected);
+        for (size_t n = 0; n < nSelected; n++) {
+            data[n].resize(psi::ROCNUMCOLS * psi::ROCNUMROWS);
+            const int rocStart = seeds ? ThresholdCache::StartValue(seeds->at(n), start) : start;
+            selectedRocs[n]->ChipThreshold(rocStart, step, thrLevel, nTrig, dacReg, xtalk, cals, &data[n][0]);
+        }
+        return;
+    }
+
+    std::vector<int> counts(rocs.size()), lastThreshold(nSelected, start);
+    std::vector<ThresholdScan> scans(nSelected);
+    std::vector< std::vector<bool> > enabledDoubleColumns(nSelected, std::vector<bool>(psi::ROCNUMDCOLS, false));
+    data.assign(nSelected, std::vector<int>(psi::ROCNUMCOLS * psi::ROCNUMROWS, NO_THRESHOLD));
+
+    for (unsigned col = 0; col < psi::ROCNUMCOLS; col++) {
+        for (unsigned row = 0; row < psi::ROCNUMROWS; row++) {
+            const unsigned calRow = xtalk ? (row == psi::ROCNUMROWS - 1 ? row - 1 : row + 1) : row;
+            bool scanning = false;
+            for (size_t n = 0; n < nSelected; n++) {
+                TestRoc& roc = *selectedRocs[n];
+                scans[n].phase = ThresholdScan::Done;
+                if (!testRange.IncludesPixel(roc.GetChipId(), col, row)) continue;
+                roc.EnablePixel(col, row);
+                enabledDoubleColumns[n][col / 2] = true;
+                if (cals) roc.Cals(col, calRow);
+                else roc.Cal(col, calRow);
+                scans[n].phase = ThresholdScan::Backward;
+                scans[n].value = lastThreshold[n];
+                scans[n].aboveSeen = false;
+                if (seeds && !seeds->at(n).empty()) {
+                    const ThresholdCache::Seed& seed = seeds->at(n)[col * psi::ROCNUMROWS + row];
+                    if (seed.width) {
+                        // Start below the previous threshold, the bracket is widened if it is already above.
+                        scans[n].phase = ThresholdScan::Bracket;
+                        scans[n].seed = seed.threshold;
+                        scans[n].width = seed.width;
+                        scans[n].value = ClampDac(seed.threshold - static_cast<int>(seed.width) * step);
+                    }
+                }
+                scanning = true;
+            }
+
+            while (scanning) {
+                for (size_t n = 0; n < nSelected; n++) {
+                    if (scans[n].phase != ThresholdScan::Done)
+                        selectedRocs[n]->RocSetDAC(dacReg, scans[n].value);
+                }
+                tbInterface->Flush();
+                if (!tbInterface->ModulePixelHits(col, row, nTrig, rocs.size(), &counts[0])) {
+                    // The counts of a failed readout are not trusted, the pixel gets no threshold on any ROC.
+                    psi::LogError(LOG_HEAD) << "ChipThreshold: readout of pixel (" << col << ", " << row
+                                            << ") failed, no threshold is recorded for it.\n";
+                    for (size_t n = 0; n < nSelected; n++)
+                        scans[n].phase = ThresholdScan::Done;
+                    break;
+                }
+
+                scanning = false;
+                for (size_t n = 0; n < nSelected; n++) {
+                    ThresholdScan& scan = scans[n];
+                    if (scan.phase == ThresholdScan::Done) continue;
+                    const bool above = counts.at(selectedRocs[n]->GetAoutChipPosition()) >= thrLevel;
+                    int threshold = -1;
+                    if (scan.phase == ThresholdScan::Bracket && above) {
+                        scan.width *= 2;
+                        const int lower = ClampDac(scan.seed - static_cast<int>(scan.width) * step);
+                        if (lower == scan.value) threshold = scan.value;
+                        else scan.value = lower;
+                    } else if (scan.phase == ThresholdScan::Backward && above) {
+                        scan.aboveSeen = true;
+                        if (scan.value - step < 0 || scan.value - step > 255) threshold = scan.value;
+                        else scan.value -= step;
+                    } else if (scan.phase == ThresholdScan::Backward && scan.aboveSeen) {
+                        threshold = scan.value + step;
+                    } else if (above) {
+                        threshold = scan.value;
+                    } else if (scan.value + step < 0 || scan.value + step > 255) {
+                        threshold = NO_THRESHOLD;
+                    } else {
+                        scan.phase = ThresholdScan::Forward;
+                        scan.value += step;
+                    }
+
+                    if (threshold >= 0) {
+                        scan.phase = ThresholdScan::Done;
+                        data[n][col * psi::ROCNUMROWS + row] = threshold;
+                        if (threshold != NO_THRESHOLD) lastThreshold[n] = threshold;
+                    } else
+                        scanning = true;
+                }
+            }
+
+            for (size_t n = 0; n < nSelected; n++) {
+                TestRoc& roc = *selectedRocs[n];
+                if (!testRange.IncludesPixel(roc.GetChipId(), col, row)) continue;
+                roc.DisablePixel(col, row);
+                roc.ClrCal();
+            }
+        }
+    }
+
+    for (size_t n = 0; n < nSelected; n++) {
+        for (unsigned dcol = 0; dcol < psi::ROCNUMDCOLS; dcol++) {
+            if (enabledDoubleColumns[n][dcol]) selectedRocs[n]->DisableDoubleColumn(dcol * 2);
+        }
+        selectedRocs[n]->RocSetDAC(dacReg, selectedRocs[n]->GetDAC(dacReg));
+    }
+    tbInterface->Flush();
+}
@@ -9,6 +9,7 @@
 #include "TestRoc.h"
 #include "BasePixel/Test.h"
 #include "BasePixel/TestRange.h"
+#include "BasePixel/ThresholdCache.h"
 
 /*!
  * \brief This class provides support for the tests on the Module level
@@ -32,6 +33,7 @@ public:
     void DumpParameters();
     void DataTriggerLevelScan();
     void AdjustVana(psi::ElectricCurrent goalCurrent = 0.024 * psi::amperes);
+    psi::ElectricCurrent GetSettledIA();
     void AdjustAllDACParameters();
     void AdjustDACParameters();
     void AdjustUltraBlackLevel();
@@ -47,6 +49,20 @@ public:
     void VanaVariation();
     void Scurves();
 
+    /*!
+     * Measures the thresholds of several ROCs of the module at once. The same pixel is calibrated on every ROC, the
+     * DAC of each ROC follows its own scan and the readout of each step is decoded into all ROC blocks. A scan starts
+     * from the threshold of the previous pixel of the same ROC. data[n] is filled for selectedRocs[n] in the layout
+     * of TestRoc::ChipThreshold, 255 marks the pixels without a threshold in the DAC range.
+     * With seeds, the scan of a pixel starts at the lower edge of the bracket around its seed instead.
+     * Pixels whose readout fails get no threshold. The module scan is used only if ModuleThresholdScan is set in the
+     * config, otherwise every ROC runs the firmware scan.
+     */
+    void ChipThreshold(const std::vector<TestRoc*>& selectedRocs, const TestRange& testRange, int start, int step,
+                       int thrLevel, int nTrig, DACParameters::Register dacReg, bool xtalk, bool cals,
+                       std::vector< std::vector<int> >& data,
+                       const std::vector<ThresholdCache::Seeds>* seeds = 0);
+
     void IanaScan();
 
     unsigned NRocs();
@@ -3,7 +3,9 @@
  * \brief Implementation of TestRoc class.
  */
 
+#include <cmath>
 #include <iomanip>
+#include <map>
 
 #include <TF1.h>
 #include <TGraph.h>
@@ -12,8 +14,10 @@
 #include "psi/date_time.h"
 #include "TestRoc.h"
 #include "TestDoubleColumn.h"
+#include "TestModule.h"
 #include "BasePixel/TBAnalogInterface.h"
 #include "BasePixel/CalibrationTable.h"
+#include "BasePixel/PhaseProfiler.h"
 #include "tests/PHCalibration.h"
 #include "analysis/Analysis.h"
 #include "tests/PixelAlive.h"
@@ -45,7 +49,8 @@
 TestRoc::TestRoc(boost::shared_ptr<TBAnalogInterface> aTBInterface, TestModule& _testModule, int aChipId, int aHubId,
                  int aPortId, int anAoutChipPosition)
     : tbInterface(aTBInterface), testModule(&_testModule), chipId(aChipId), hubId(aHubId), portId(aPortId),
-      aoutChipPosition(anAoutChipPosition), dacParameters(new DACParameters()), fullRange(new TestRange())
+      aoutChipPosition(anAoutChipPosition), dacParameters(new DACParameters()), fullRange(new TestRange()),
+      lastVana(140), vanaSlope(0.0005 * psi::amperes)
 {
     doubleColumns.assign(psi::ROCNUMDCOLS, boost::shared_ptr<TestDoubleColumn>());
     for (unsigned i = 0; i < psi::ROCNUMDCOLS; i++) {
@@ -104,6 +109,7 @@ void TestRoc::ChipTest()
 // -- Performs a test for this roc
 void TestRoc::DoTest(boost::shared_ptr<Test> aTest)
 {
+    const PhaseProfiler::Scope phase(Test::RocPhaseName(*this));
     aTest->RocAction(*this);
 }
 
@@ -125,8 +131,6 @@ void TestRoc::PhError()
 {
     int offset;
     int nReadouts = 1000;
-    short data[psi::FIFOSIZE];
-    unsigned short count;
     ArmPixel(20, 20);
     offset = chipId * 3 + 16;
 
@@ -152,8 +156,8 @@ void TestRoc::PhError()
         //SetDAC("VIbias_roc",Tvcal);
         TH1D *phHist = new TH1D(Form("phHistVcal%d", vcal[Tvcal]), Form("phHistVcal%d", vcal[Tvcal]), 4000, -2000., 2000.);
         for (int i = 0; i < nReadouts; i++) {
-            tbInterface->ADCRead(data, count, 1);
-            if (count > offset) phHist->Fill(data[offset]);
+            const ADCSpan data = tbInterface->AcquireADC(1);
+            if ((int)data.size() > offset) phHist->Fill(data[offset]);
         }
         psi::LogInfo() << "Vcal = " << vcal[Tvcal] << ", PH " << std::setprecision(1) << phHist->GetMean()
                        << "+- " << std::setprecision(2) << phHist->GetRMS() << std::endl;
@@ -274,60 +278,56 @@ void TestRoc::PowerOnTest(int nTests)
     }
 }
 
-// Tries to automatically adjust Vana, may not work yet
+// -- Adjusts Vana to draw the goal analog current on top of current0
+// -- Secant steps based on the slope model of this ROC; bisection once the target is bracketed.
 int TestRoc::AdjustVana(psi::ElectricCurrent current0, psi::ElectricCurrent goalcurrent)
 {
-    int vana = 140;
-    psi::ElectricCurrent currentMeasured, currentMeasuredOld;
-    SetDAC(DACParameters::Vana, vana);
-    Flush();
-    sleep(1);
-    currentMeasured = tbInterface->GetIA();
+    static const unsigned maxMeasurements = 12;
+    static const int vanaMin = 0, vanaMax = 255;
 
-    //guess value, slope is roughly 0.5 mA / DAC
+    const psi::ElectricCurrent target = current0 + goalcurrent;
+    std::map<int, psi::ElectricCurrent> measured;
+    int low = vanaMin - 1, high = vanaMax + 1; // current(low) < target <= current(high)
 
-    psi::ElectricCurrent currentDiff = currentMeasured - current0 - goalcurrent;
-    int dacDiff = (int)(currentDiff / (0.0005 * psi::amperes));
-    vana -= dacDiff;
-    if (vana < 0) vana = 0;
-    if (vana > 255) vana = 255;
-    SetDAC(DACParameters::Vana, vana);
-    Flush();
-    sleep(1);
-    currentMeasured = tbInterface->GetIA();
+    int vana = lastVana, previous = -1;
+    for(;;) {
+        SetDAC(DACParameters::Vana, vana);
+        Flush();
+        const psi::ElectricCurrent current = testModule->GetSettledIA();
+        measured[vana] = current;
+        if(current < target)
+            low = vana;
+        else
+            high = vana;
+        if(high - low <= 1 || measured.size() >= maxMeasurements)
+            break;
 
-    if (currentMeasured < current0 + goalcurrent) {
-        do {
-            vana++;
-            SetDAC(DACParameters::Vana, vana);
-            Flush();
-            sleep(.1);
-            currentMeasuredOld = currentMeasured;
-            currentMeasured = tbInterface->GetIA();
-        } while (currentMeasured < current0 + goalcurrent  && vana < 255);
-        if (psi::abs(currentMeasuredOld - current0 - goalcurrent)
-                < psi::abs(currentMeasured - current0 - goalcurrent)) {
-            vana--;
-            currentMeasured = currentMeasuredOld;
-        }
-    } else {
-        do {
-            vana--;
-            SetDAC(DACParameters::Vana, vana);
-            Flush();
-            sleep(0.1);
-            currentMeasuredOld = currentMeasured;
-            currentMeasured = tbInterface->GetIA();
-        } while (currentMeasured > current0 + goalcurrent  && vana > 0);
-        if (psi::abs(currentMeasuredOld - current0 - goalcurrent)
-                < psi::abs(currentMeasured - current0 - goalcurrent)) {
-            vana++;
-            currentMeasured = currentMeasuredOld;
+        if(previous >= 0) {
+            const psi::ElectricCurrent slope = (current - measured[previous]) / double(vana - previous);
+            if(slope > 0.0 * psi::amperes)
+                vanaSlope = slope;
         }
+        int next = vana + static_cast<int>(std::floor((target - current) / vanaSlope + 0.5));
+        if(next == vana)
+            next += current < target ? 1 : -1;
+        if(next <= low || next >= high)
+            next = (low + high) / 2;
+        previous = vana;
+        vana = next;
     }
 
-    psi::LogDebug() << "[TestRoc] Vana is set to " << vana
-                    << " Current: " << ( currentMeasured - current0) << std::endl;
+    std::map<int, psi::ElectricCurrent>::const_iterator best = measured.begin();
+    for(std::map<int, psi::ElectricCurrent>::const_iterator iter = measured.begin(); iter != measured.end(); ++iter) {
+        if(psi::abs(iter->second - target) < psi::abs(best->second - target))
+            best = iter;
+    }
+    vana = best->first;
+    lastVana = vana;
+    SetDAC(DACParameters::Vana, vana);
+    Flush();
+
+    psi::LogDebug() << "[TestRoc] Vana is set to " << vana << " Current: " << (best->second - current0)
+                    << " after " << measured.size() << " measurements." << std::endl;
 
     return vana;
 }
@@ -93,6 +93,7 @@ public:
     boost::shared_ptr<DACParameters> SaveDacParameters();
     void RestoreDacParameters(boost::shared_ptr<DACParameters> dacParameters = boost::shared_ptr<DACParameters>());
     void SetDAC(DACParameters::Register reg, int value);
+    const DACParameters& GetDACParameters() const { return *dacParameters; }
     void DisableDoubleColumn(int col);
     void Mask();
     void EnableAllPixels();
@@ -136,4 +137,8 @@ private:
     std::vector< boost::shared_ptr<TestDoubleColumn> > doubleColumns;
     boost::shared_ptr<DACParameters> dacParameters, savedDacParameters;
     boost::shared_ptr<TestRange> fullRange;
+
+    /// Starting point and current per DAC unit for the next AdjustVana, updated by each adjustment.
+    int lastVana;
+    psi::ElectricCurrent vanaSlope;
 };
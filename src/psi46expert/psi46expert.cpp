@@ -14,6 +14,7 @@
 #include "BasePixel/constants.h"
 #include "psi/log.h"
 #include "BasePixel/DataStorage.h"
+#include "BasePixel/Test.h"
 #include "BasePixel/VoltageSourceFactory.h"
 #include "PsiShell.h"
 #include "BasePixel/FakeTestBoard.h"
@@ -111,6 +112,9 @@ bool ParseProgramArguments(int argc, char* argv[])
     boost::shared_ptr<psi::DataStorage> dataStorage(
                 new psi::DataStorage(configParameters.FullRootFileName(), detectorName, operatorName));
     psi::DataStorage::setActive(dataStorage);
+    dataStorage->Enable();
+    Test::LoadPerformedTests();
+    dataStorage->Disable();
 
     return true;
 }
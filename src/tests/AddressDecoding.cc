@@ -50,7 +50,11 @@ void AddressDecoding::DoubleColumnAction(TestDoubleColumn& doubleColumn)
 {
     if (!fdebug) {
         if (doubleColumn.IsIncluded(testRange)) {
-            doubleColumn.ADCData(data, readoutStop);
+            if (!doubleColumn.ADCData(data, readoutStop)) {
+                psi::LogError() << "[AddressDecoding] Readout of double column " << doubleColumn.DoubleColumnNumber()
+                                << " failed, its pixels are not analysed." << std::endl;
+                return;
+            }
 
             for (unsigned k = 0; k < 2 * psi::ROCNUMROWS; k++) {
                 TestPixel& pixel = doubleColumn.GetPixel(k);
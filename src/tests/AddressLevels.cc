@@ -14,7 +14,6 @@
 #include "BasePixel/RawPacketDecoder.h"
 #include "BasePixel/DecoderCalibration.h"
 #include <TLine.h>
-#include <TMath.h>
 
 using namespace DecoderCalibrationConstants;
 
@@ -22,14 +21,28 @@ bool AddressLevels::fPrintDebug   = false;
 //bool AddressLevels::fPrintDebug   = true;
 
 AddressLevels::AddressLevels(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface)
-    : Test("AddressLevels", testRange), tbInterface(aTBInterface) {}
+    : Test("AddressLevels", testRange), tbInterface(aTBInterface), fModuleScan(false),
+      levelFinder(1 + RawPacketDecoderConstants::MAX_ROCS, 4000, -2000, 2000)
+{
+    levelFinder.SetSearch(0, psi::analysis::LevelSearch(psi::analysis::ZonePeaks, NUM_LEVELSTBM + 1, 30));
+    for(unsigned n = 0; n < RawPacketDecoderConstants::MAX_ROCS; ++n)
+        levelFinder.SetSearch(1 + n, psi::analysis::LevelSearch(psi::analysis::ZonePeaks, NUM_LEVELSROC + 1, 50));
+}
 
 void AddressLevels::ModuleAction(TestModule& module)
 {
     for ( unsigned iroc = 0; iroc < module.NRocs(); iroc++ ) fTestedROC[iroc] = false;
 
     TestTBM();
+    fModuleScan = true;
     Test::ModuleAction(module); // This is where RocAction will be called from
+    fModuleScan = false;
+
+    levelFinder.Update(0, 0);
+    FindTBMLimits();
+    for ( unsigned iroc = 0; iroc < module.NRocs(); iroc++ ) {
+        if ( fTestedROC[iroc] ) FindRocLimits(iroc);
+    }
 
 //---  write address level limits into ASCII file
 //     (only if the address levels have been determined for all ROCs)
@@ -67,15 +80,26 @@ void AddressLevels::RocAction(TestRoc& roc)
     for (int i = 0; i < 4000; i++) adcHistogramROC->SetBinContent(i + 1, data[i]);
     histograms->AddLast(adcHistogramROC);
 
-    int numLimitsROC = 0;
-    FindDecoderLevels(adcHistogramROC, numLimitsROC, fLimitsROC[roc.GetAoutChipPosition()], NUM_LEVELSROC + 1, 50);
+    const unsigned aoutChipPosition = roc.GetAoutChipPosition();
+    levelFinder.Histograms().SetChannel(1 + aoutChipPosition, data);
+    fChipId[aoutChipPosition] = roc.GetChipId();
+    fTestedROC[aoutChipPosition] = true;
 
-    fTestedROC[roc.GetAoutChipPosition()] = true;
+    if ( !fModuleScan ) {
+        levelFinder.UpdateChannel(1 + aoutChipPosition);
+        FindRocLimits(aoutChipPosition);
+    }
+}
+
+void AddressLevels::FindRocLimits(unsigned aoutChipPosition)
+{
+    const int chipId = fChipId[aoutChipPosition];
+    const int numLimitsROC = DecoderLimits(1 + aoutChipPosition, fLimitsROC[aoutChipPosition], NUM_LEVELSROC + 1);
 
     if ( fPrintDebug ) {
-        psi::LogInfo() << "ROC (" << roc.GetChipId() << ") address level limits = { ";
+        psi::LogInfo() << "ROC (" << chipId << ") address level limits = { ";
         for ( int ilevel = 0; ilevel < (numLimitsROC + 1); ilevel++ ) {
-            psi::LogInfo() << fLimitsROC[roc.GetAoutChipPosition()][ilevel] << " ";
+            psi::LogInfo() << fLimitsROC[aoutChipPosition][ilevel] << " ";
         }
         psi::LogInfo() << "}" << std::endl;
     }
@@ -83,7 +107,7 @@ void AddressLevels::RocAction(TestRoc& roc)
     if ( numLimitsROC != 6 ) {
         psi::LogInfo() << "[AddressLevels] Error: Can not calibrate decoder. "
                        << ( numLimitsROC + 1) << " peaks were found in ADC "
-                       << "spectrum of ROC #" << roc.GetChipId() << '.'
+                       << "spectrum of ROC #" << chipId << '.'
                        << std::endl;
 
 //--- in case the ROC address levels cannot be calibrated
@@ -93,7 +117,7 @@ void AddressLevels::RocAction(TestRoc& roc)
         psi::LogDebug() << "[AddressLevels] Setting ROC UltraBlack level to level "
                         << "of TBM UltraBlack." << std::endl;
 
-        fLimitsROC[roc.GetAoutChipPosition()][0] = fLimitsTBM[0];
+        fLimitsROC[aoutChipPosition][0] = fLimitsTBM[0];
         return;
     }
 }
@@ -106,9 +130,12 @@ void AddressLevels::TestTBM()
     tbInterface->TBMAddressLevels(data);
     for (int i = 0; i < 4000; i++) adcHistogramTBM->SetBinContent(i + 1, data[i]);
     histograms->AddLast(adcHistogramTBM);
+    levelFinder.Histograms().SetChannel(0, data);
+}
 
-    int numLimitsTBM = 0;
-    FindDecoderLevels(adcHistogramTBM, numLimitsTBM, fLimitsTBM, NUM_LEVELSTBM + 1, 30);
+void AddressLevels::FindTBMLimits()
+{
+    const int numLimitsTBM = DecoderLimits(0, fLimitsTBM, NUM_LEVELSTBM + 1);
 
     if ( fPrintDebug ) {
         psi::LogInfo() << "TBM address level limits = { ";
@@ -127,54 +154,19 @@ void AddressLevels::TestTBM()
     }
 }
 
-void AddressLevels::FindDecoderLevels(TH1* adcHistogram, int& numLimits, short limits[], int maxLimits, int integralLimit)
+// Limits are the middles between neighbouring peaks, the last one is the upper edge of the ADC range.
+int AddressLevels::DecoderLimits(unsigned channel, short limits[], unsigned maxLimits)
 {
-    int peakStart[7], peakStop[7], peakMean[7], peak = 0;
-    bool zeroZone = true, endZone;
-
-    for (int i = -2000; i < 2000; i++) {
-//          if ( fPrintDebug ){
-//            psi::LogInfo() << "bin = " << i << " : bin-content = " << adcHistogram->GetBinContent(i+2000+1) << endl;
-//      if ( zeroZone ) psi::LogInfo() << " zero zone" << endl;
-//      else psi::LogInfo() << " not zero zone" << endl;
-//          }
-
-        if (zeroZone) {
-            int integral = 0;
-            for (int k = 0; k < 10; k++) {
-                if ( (i + k + 2000 + 1 < 4000) ) integral += TMath::Nint(adcHistogram->GetBinContent(i + k + 2000 + 1));
-            }
-
-            endZone = (adcHistogram->GetBinContent(i + 2000 + 1) > 0 && integral > integralLimit) ? true : false;
-
-            if (endZone) {
-                if ( fPrintDebug )
-                    psi::LogInfo() << "end zero zone " << i << std::endl;
-                peakStart[peak] = i;
-                zeroZone = false;
-            }
-        } else {
-            int integral = 0;
-            for (int k = 0; k < 15; k++) {
-                if ( (i + k + 2000 + 1 < 4000) ) integral += TMath::Nint(adcHistogram->GetBinContent(i + k + 2000 + 1));
-            }
-
-            endZone = (adcHistogram->GetBinContent(i + 2000 + 1) == 0 && integral < integralLimit) ? true : false;
-
-            if (endZone) {
-                if ( peak < maxLimits ) {
-                    peakStop[peak] = i;
-                    peak++;
-                    zeroZone = true;
-                } else
-                    psi::LogInfo() << "Error in <AddressLevels::FindDecoderLevels>: too many address levels found !\n";
-            }
-        }
+    const std::vector<double>& peaks = levelFinder.Levels(channel);
+    if ( !levelFinder.Complete(channel) && peaks.size() == maxLimits )
+        psi::LogInfo() << "Error in <AddressLevels::DecoderLimits>: too many address levels found !\n";
+    if ( peaks.empty() ) return -1;
+
+    for (size_t i = 0; i + 1 < peaks.size(); i++) {
+        const int peakMean = static_cast<int>(peaks[i]), nextPeakMean = static_cast<int>(peaks[i + 1]);
+        limits[i] = peakMean + (nextPeakMean - peakMean) / 2;
     }
+    limits[peaks.size() - 1] = 2000;
 
-    for (int i = 0; i < peak; i++) peakMean[i] = (peakStop[i] + peakStart[i]) / 2;
-    for (int i = 0; i < (peak - 1); i++) limits[i] = peakMean[i] + (peakMean[i + 1] - peakMean[i]) / 2;
-    limits[peak - 1] = 2000;
-
-    numLimits = peak - 1;
+    return peaks.size() - 1;
 }
@@ -10,9 +10,14 @@
 #include "BasePixel/Test.h"
 #include "BasePixel/RawPacketDecoder.h"
 #include "BasePixel/DecoderCalibration.h"
+#include "analysis/LevelFinder.h"
 
 /*!
  * \brief Test of the address levels.
+ *
+ * In a module test the ADC histograms of the TBM and of all ROCs are taken first, one after another, and the decoder
+ * levels are then searched in all of them at once by a parallel LevelFinder. If RocAction is called directly, e.g. by
+ * FullTest, the levels of the ROC are searched right away.
  */
 class AddressLevels : public Test {
 public:
@@ -23,8 +28,10 @@ public:
 
 private:
     void TestTBM();
+    void FindTBMLimits();
+    void FindRocLimits(unsigned aoutChipPosition);
 
-    void FindDecoderLevels(TH1* adcHistogram, int& numLimits, short limits[], int maxLimits, int integralLimit);
+    int DecoderLimits(unsigned channel, short limits[], unsigned maxLimits);
 
     boost::shared_ptr<TBAnalogInterface> tbInterface;
     unsigned short count;
@@ -37,6 +44,11 @@ private:
     short fLimitsTBM[DecoderCalibrationConstants::NUM_LEVELSTBM + 1];
     short fLimitsROC[RawPacketDecoderConstants::MAX_ROCS][DecoderCalibrationConstants::NUM_LEVELSROC + 1];
     bool fTestedROC[RawPacketDecoderConstants::MAX_ROCS];
+    bool fModuleScan;
+    int fChipId[RawPacketDecoderConstants::MAX_ROCS];
+
+    /// Channel 0 is the TBM, channel 1 + n the ROC at the analog output position n.
+    psi::analysis::LevelFinder levelFinder;
 
     static bool fPrintDebug;
 };
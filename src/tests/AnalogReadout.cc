@@ -14,14 +14,11 @@ AnalogReadout::AnalogReadout(PTestRange testRange, boost::shared_ptr<TBAnalogInt
 
 void AnalogReadout::ModuleAction(TestModule&)
 {
-    unsigned short counter;
-    short data[psi::FIFOSIZE];
-
     int emptyReadoutLengthADC = tbInterface->GetEmptyReadoutLengthADC();
-    tbInterface->ADCRead(data, counter, 100);
+    const ADCSpan data = tbInterface->AcquireADC(100);
 
-    int max = counter;
-    if (counter > emptyReadoutLengthADC) max = emptyReadoutLengthADC;
+    int max = data.size();
+    if (max > emptyReadoutLengthADC) max = emptyReadoutLengthADC;
     TH1D *histo = new TH1D("AnalogReadout", "AnalogReadout", emptyReadoutLengthADC, 0, emptyReadoutLengthADC);
     for (int i = 0; i < max; i++) {
         histo->SetBinContent(i + 1, data[i]);
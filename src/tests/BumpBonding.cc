@@ -25,41 +25,66 @@ BumpBonding::BumpBonding(PTestRange testRange, boost::shared_ptr<TBAnalogInterfa
     calXTalkNTrig = testParameters.BumpBondingCalXTalkNTrig();
 }
 
+void BumpBonding::ModuleAction(TestModule& module)
+{
+    const std::vector<TestRoc*> rocs = IncludedRocs(module);
+    if (!rocs.empty())
+        RocsAction(rocs);
+}
+
 void BumpBonding::RocAction(TestRoc& roc)
+{
+    RocsAction(std::vector<TestRoc*>(1, &roc));
+}
+
+void BumpBonding::RocsAction(const std::vector<TestRoc*>& rocs)
 {
     ThresholdMap thresholdMap;
+    std::vector< boost::shared_ptr<DACParameters> > savedDacs;
 
-    SaveDacParameters(roc);
-    roc.ClrCal();
-    roc.Mask();
-    roc.SetDAC(DACParameters::Vcal, 200);
-    roc.SetDAC(DACParameters::CtrlReg, 4);
+    for (size_t n = 0; n < rocs.size(); n++) {
+        TestRoc& roc = *rocs[n];
+        savedDacs.push_back(roc.SaveDacParameters());
+        roc.ClrCal();
+        roc.Mask();
+        roc.SetDAC(DACParameters::Vcal, 200);
+        roc.SetDAC(DACParameters::CtrlReg, 4);
+    }
     tbInterface->Flush();
 
-    TH2D* calXtalk = thresholdMap.MeasureMap(ThresholdMap::CalXTalkMapParameters, roc, *testRange,
-                                             calXTalkThrLevel, calXTalkNTrig, 0);
-    TH1D* calXtalkDistribution = Analysis::Distribution(calXtalk);
-    vthrComp = static_cast<int>( calXtalkDistribution->GetMean() + 3. * calXtalkDistribution->GetRMS() );
+    const std::vector<TH2D*> calXtalk = thresholdMap.MeasureMaps(ThresholdMap::CalXTalkMapParameters, rocs,
+                                                                 *testRange, calXTalkThrLevel, calXTalkNTrig, 0);
+    std::vector<TH1D*> calXtalkDistribution;
+    for (size_t n = 0; n < rocs.size(); n++) {
+        calXtalkDistribution.push_back(Analysis::Distribution(calXtalk[n]));
+        const int vthrComp = static_cast<int>( calXtalkDistribution[n]->GetMean()
+                                               + 3. * calXtalkDistribution[n]->GetRMS() );
 
-    psi::LogInfo() << "Setting VthrComp to " << vthrComp << ".\n";
+        psi::LogInfo() << "ROC #" << rocs[n]->GetChipId() << ": setting VthrComp to " << vthrComp << ".\n";
 
-    roc.SetDAC(DACParameters::VthrComp, vthrComp);
+        rocs[n]->SetDAC(DACParameters::VthrComp, vthrComp);
+    }
     tbInterface->Flush();
 
-    TH2D* vcals = thresholdMap.MeasureMap(ThresholdMap::VcalsThresholdMapParameters, roc, *testRange, thrLevel, nTrig,
-                                          0);
-    TH2D* xtalk = thresholdMap.MeasureMap(ThresholdMap::XTalkMapParameters, roc, *testRange, thrLevel, nTrig, 0);
-    TH2D *difference = Analysis::DifferenceMap(vcals, xtalk, Form("vcals_xtalk_C%i", roc.GetChipId()));
+    const std::vector<TH2D*> vcals = thresholdMap.MeasureMaps(ThresholdMap::VcalsThresholdMapParameters, rocs,
+                                                              *testRange, thrLevel, nTrig, 0);
+    const std::vector<TH2D*> xtalk = thresholdMap.MeasureMaps(ThresholdMap::XTalkMapParameters, rocs, *testRange,
+                                                              thrLevel, nTrig, 0);
+
+    for (size_t n = 0; n < rocs.size(); n++) {
+        TestRoc& roc = *rocs[n];
+        TH2D *difference = Analysis::DifferenceMap(vcals[n], xtalk[n], Form("vcals_xtalk_C%i", roc.GetChipId()));
 
-    RestoreDacParameters(roc);
+        roc.RestoreDacParameters(savedDacs[n]);
 
-    histograms->Add(calXtalk);
-    histograms->Add(vcals);
-    histograms->Add(xtalk);
-    histograms->Add(difference);
+        histograms->Add(calXtalk[n]);
+        histograms->Add(vcals[n]);
+        histograms->Add(xtalk[n]);
+        histograms->Add(difference);
 
-    histograms->Add(Analysis::Distribution(vcals));
-    histograms->Add(Analysis::Distribution(xtalk));
-    histograms->Add(Analysis::Distribution(difference));
-    histograms->Add(calXtalkDistribution);
+        histograms->Add(Analysis::Distribution(vcals[n]));
+        histograms->Add(Analysis::Distribution(xtalk[n]));
+        histograms->Add(Analysis::Distribution(difference));
+        histograms->Add(calXtalkDistribution[n]);
+    }
 }
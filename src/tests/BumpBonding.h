@@ -15,10 +15,14 @@ class BumpBonding : public Test {
 public:
     BumpBonding(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface);
 
+    virtual void ModuleAction(TestModule& module);
     virtual void RocAction(TestRoc& roc);
 
+private:
+    /// Measures the maps of all ROCs at once.
+    void RocsAction(const std::vector<TestRoc*>& rocs);
+
 private:
     boost::shared_ptr<TBAnalogInterface> tbInterface;
     unsigned thrLevel, nTrig, calXTalkThrLevel, calXTalkNTrig;
-    int vthrComp;
 };
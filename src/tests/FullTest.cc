@@ -4,9 +4,11 @@
  */
 
 #include "psi/log.h"
+#include "psi/fingerprint.h"
 
 #include "BasePixel/TBAnalogInterface.h"
 #include "BasePixel/ConfigParameters.h"
+#include "psi46expert/TestModule.h"
 #include "FullTest.h"
 #include "PixelAlive.h"
 #include "BumpBonding.h"
@@ -23,15 +25,16 @@
 #include "AnalogReadout.h"
 
 FullTest::FullTest(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface)
-    : Test("FullTest", testRange), tbInterface(aTBInterface) {}
+    : Test("FullTest", testRange), tbInterface(aTBInterface),
+      resume(ConfigParameters::Singleton().ResumeFullTest()) {}
 
 void FullTest::ModuleAction(TestModule& module)
 {
     DoTest<TemperatureTest>(module);
-    DoTest<SCurveTest>(module);
+    DoResumableTest<SCurveTest>(module, "SCurveTest");
     if(!ConfigParameters::Singleton().TbmEmulator())
-        DoTest<TBMTest>(module);
-    DoTest<AnalogReadout>(module);
+        DoResumableTest<TBMTest>(module, "TBMTest");
+    DoResumableTest<AnalogReadout>(module, "AnalogReadout");
     Test::ModuleAction(module);
     DoTest<TemperatureTest>(module);
 }
@@ -41,11 +44,66 @@ void FullTest::RocAction(TestRoc& roc)
     psi::LogDebug() << "[FullTest] Chip #" << roc.GetChipId() << ".\n";
 
     DoTest<PixelAlive>(roc);
-    DoTest<BumpBonding>(roc);
+    DoResumableTest<BumpBonding>(roc, "BumpBonding");
     DoTest<TrimBits>(roc);
     DoTest<TemperatureTest>(roc);
-    DoTest<AddressDecoding>(roc);
+    DoResumableTest<AddressDecoding>(roc, "AddressDecoding");
     DoTest<AddressLevels>(roc);
 
     psi::LogDebug() << "[FullTest] done for chip " << roc.GetChipId() << ".\n";
 }
+
+void FullTest::DoAction(Test& test, TestModule& module)
+{
+    test.ModuleAction(module);
+}
+
+void FullTest::DoAction(Test& test, TestRoc& roc)
+{
+    test.RocAction(roc);
+}
+
+std::string FullTest::CheckpointName(TestModule&, const std::string& stepName)
+{
+    return "FullTest_" + stepName + "_module";
+}
+
+std::string FullTest::CheckpointName(TestRoc& roc, const std::string& stepName)
+{
+    std::ostringstream ss;
+    ss << "FullTest_" << stepName << "_C" << roc.GetChipId();
+    return ss.str();
+}
+
+// -- Module-level steps depend on the TBM settings and on the state of all ROCs in the test range
+uint64_t FullTest::Fingerprint(TestModule& module)
+{
+    psi::Fingerprint fingerprint;
+    fingerprint.Add(module.GetTBM().GetParameters().Fingerprint());
+    for(unsigned n = 0; n < module.NRocs(); ++n) {
+        TestRoc& roc = module.GetRoc(n);
+        if(testRange && testRange->IncludesRoc(roc.GetChipId()))
+            fingerprint.Add(Fingerprint(roc));
+    }
+    return fingerprint.Value();
+}
+
+uint64_t FullTest::Fingerprint(TestRoc& roc)
+{
+    psi::Fingerprint fingerprint;
+    fingerprint.Add(roc.GetChipId());
+    fingerprint.Add(roc.GetDACParameters().Fingerprint());
+    fingerprint.Add(tbInterface->GetTBParameters().Fingerprint());
+
+    int trim[psi::ROCNUMROWS * psi::ROCNUMCOLS];
+    roc.GetTrimValues(trim);
+    fingerprint.Add(trim, sizeof(trim));
+
+    if(testRange) {
+        for(const TestRange::Pixel& pixel : testRange->Pixels(roc.GetChipId())) {
+            fingerprint.Add(pixel.column);
+            fingerprint.Add(pixel.row);
+        }
+    }
+    return fingerprint.Value();
+}
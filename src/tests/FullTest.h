@@ -3,10 +3,20 @@
  * \brief Definition of FullTest class.
  */
 
+#include <stdint.h>
+
+#include "psi/log.h"
 #include "BasePixel/Test.h"
+#include "BasePixel/DataStorage.h"
 
 /*!
  * \brief Full test of a module
+ *
+ * Each (test, ROC) step is checkpointed into the data storage together with a fingerprint of the DAC, trim and
+ * testboard parameters it was run with. If the full test is restarted with the same output file, steps with
+ * an unchanged fingerprint and existing output are skipped. Steps that leave state behind for the later steps are
+ * never skipped: PixelAlive marks the pixels with mask defects as not alive, TrimBits leaves the trim bits changed and
+ * AddressLevels determines the decoder levels.
  */
 class FullTest : public Test {
 public:
@@ -32,5 +42,34 @@ private:
         //CollectHistograms(test);
     }
 
+    template<typename T, typename Target>
+    void DoResumableTest(Target& target, const std::string& stepName)
+    {
+        const std::string checkpointName = CheckpointName(target, stepName);
+        const uint64_t fingerprint = Fingerprint(target);
+        if(resume && psi::DataStorage::Active().HasCheckpoint(checkpointName, fingerprint)) {
+            psi::LogInfo() << "[FullTest] " << checkpointName << " is already done with the same parameters."
+                           << " Skipping.\n";
+            return;
+        }
+
+        std::string outputDirectory;
+        {
+            T test(testRange, tbInterface);
+            DoAction(test, target);
+            outputDirectory = psi::data::TestNameProvider::TestResultsTreeName(test.GetRecord().id,
+                                                                                test.GetRecord().name);
+        }
+        psi::DataStorage::Active().SaveCheckpoint(checkpointName, fingerprint, outputDirectory);
+    }
+
+    static void DoAction(Test& test, TestModule& module);
+    static void DoAction(Test& test, TestRoc& roc);
+    static std::string CheckpointName(TestModule& module, const std::string& stepName);
+    static std::string CheckpointName(TestRoc& roc, const std::string& stepName);
+    uint64_t Fingerprint(TestModule& module);
+    uint64_t Fingerprint(TestRoc& roc);
+
     boost::shared_ptr<TBAnalogInterface> tbInterface;
+    bool resume;
 };
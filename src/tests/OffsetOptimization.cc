@@ -3,6 +3,8 @@
  * \brief Implementation of OffsetOptimization class.
  */
 
+#include <boost/bind.hpp>
+
 #include "TCanvas.h"
 #include <TF1.h>
 #include "BasePixel/TBAnalogInterface.h"
@@ -45,13 +47,10 @@ void OffsetOptimization::DoDacDacScan(TestPixel& pixel)
 {
     psi::LogDebug() << "[OffsetOptimization] DAC DAC Scan" << std::endl;
 
-    int dacValue1Size = (dac1Stop - dac1Start) / dac1Step; // VOffsetR0
-    int dacValue2Size = (dac2Stop - dac2Start) / dac2Step; // VOffsetOp
-    int linearRange;
-    short result[256];
-    int optimalOp, optimalR0;
-    int VcalRangeMax = -99;
-    int index1 = 0, index2 = 0;
+    const DacOptimizer::Range r0Range(dac1Start, dac1Stop, dac1Step); // VOffsetR0
+    const DacOptimizer::Range opRange(dac2Start, dac2Stop, dac2Step); // VOffsetOp
+    int dacValue1Size = r0Range.Size() - 1;
+    int dacValue2Size = opRange.Size() - 1;
 
     std::ostringstream histo2Name;
     histo2Name << "Linear_Range_of_Vcal_c" << pixel.GetColumn() << "r" << pixel.GetRow()
@@ -73,57 +72,63 @@ void OffsetOptimization::DoDacDacScan(TestPixel& pixel)
     minPhHisto->GetYaxis()->SetTitle("VoffsetOp [DAC units]");
     minPhHisto->GetZaxis()->SetTitle("starting PH");
 
-    int r0, op;
-    for (int i = 0; i <= dacValue1Size; i++) {
-        r0 = dac1Start + i * dac1Step;
-        pixel.GetRoc().SetDAC(DACParameters::VOffsetR0, r0);
-
-        for (int k = 0; k <= dacValue2Size; k++) {
-            op = dac2Start + k * dac2Step;
-            pixel.GetRoc().SetDAC(DACParameters::VoffsetOp, op);
+    // The linear range is searched along VOffsetR0 and VOffsetOp in turn, starting from the middle of the ranges.
+    DacOptimizer optimizer("VOffsetR0, VOffsetOp", boost::bind(&OffsetOptimization::LinearRange, this,
+                                                               boost::ref(pixel), histo2, minPhHisto, _1));
+    DacOptimizer::Point start;
+    start.push_back(r0Range.Value(r0Range.Size() / 2));
+    start.push_back(opRange.Value(opRange.Size() / 2));
+    std::vector<DacOptimizer::Range> ranges;
+    ranges.push_back(r0Range);
+    ranges.push_back(opRange);
+    const DacOptimizer::Point best = optimizer.CoordinateSearch(start, ranges);
+    optimizer.LogSummary(best, r0Range.Size() * opRange.Size());
 
-            std::ostringstream histoName;
-            histoName << "PHVcal_VoffsetOp" << op << "_VOffsetR0" << r0
-                      << "_C" << pixel.GetRoc().GetChipId();
+    histograms->Add(minPhHisto);
+    histograms->Add(histo2);
 
-            TH1D *histo = new TH1D(histoName.str().c_str(), histoName.str().c_str(), 256, 0, 256);
+    const int optimalR0 = best.at(0);
+    const int optimalOp = best.at(1);
 
-            // PHDac( dac, dacRange, Trig, position, output)
-            tbInterface->PHDac( 25, 256, phDacScan.GetNTrig(), 16 + pixel.GetRoc().GetAoutChipPosition() * 3, result);
+    psi::LogDebug() << "[OffsetOptimization] Vcal Range Max: " << optimizer.Evaluate(best)
+                    << " @ VOffsetR0: " << optimalR0
+                    << " @ VOffsetOp: " << optimalOp << std::endl;
 
-            for (int dac = 0; dac < 256; dac++) histo->SetBinContent( dac + 1, result[dac]);
+    psi::LogDebug() << "[OffsetOptimization] Pixel Column: " << pixel.GetColumn()
+                    << " Row: " << pixel.GetRow() << std::endl;
+}
 
-            histo->SetMaximum( result[255] + 100);
+// -- Linear range of the PH vs Vcal curve for VOffsetR0 and VOffsetOp given by the point
+double OffsetOptimization::LinearRange(TestPixel& pixel, TH2D* linearRangeHisto, TH2D* minPhHisto,
+                                       const DacOptimizer::Point& point)
+{
+    const int r0 = point.at(0), op = point.at(1);
+    pixel.GetRoc().SetDAC(DACParameters::VOffsetR0, r0);
+    pixel.GetRoc().SetDAC(DACParameters::VoffsetOp, op);
 
-            linearRange = static_cast<int>( phDacScan.FindLinearRange(histo) );
+    std::ostringstream histoName;
+    histoName << "PHVcal_VoffsetOp" << op << "_VOffsetR0" << r0
+              << "_C" << pixel.GetRoc().GetChipId();
 
-            if (linearRange > VcalRangeMax) {
-                VcalRangeMax = linearRange;
-                index1 = i;
-                index2 = k;
-            }
-            psi::LogDebug() << "[OffsetOptimization] Linear Range: " << linearRange << std::endl;
+    TH1D *histo = new TH1D(histoName.str().c_str(), histoName.str().c_str(), 256, 0, 256);
 
-            histo2->SetBinContent(i + 1, k + 1, linearRange);
-            minPhHisto->SetBinContent(i + 1, k + 1, phDacScan.GetMinPh());
+    // PHDac( dac, dacRange, Trig, position, output)
+    short result[256];
+    tbInterface->PHDac( 25, 256, phDacScan.GetNTrig(), 16 + pixel.GetRoc().GetAoutChipPosition() * 3, result);
 
-            histograms->Add(histo);
+    for (int dac = 0; dac < 256; dac++) histo->SetBinContent( dac + 1, result[dac]);
 
-            psi::LogDebug() << "[OffsetOptimization] VOffsetR0: " << r0
-                            << " VOffsetOp: " << op << std::endl;
-        }
-    }
+    histo->SetMaximum( result[255] + 100);
 
-    histograms->Add(minPhHisto);
-    histograms->Add(histo2);
+    const int linearRange = static_cast<int>( phDacScan.FindLinearRange(histo) );
+    psi::LogDebug() << "[OffsetOptimization] Linear Range: " << linearRange << std::endl;
 
-    optimalOp = dac2Start + index2 * dac2Step;
-    optimalR0 = dac1Start + index1 * dac1Step;
+    linearRangeHisto->SetBinContent(linearRangeHisto->FindBin(r0, op), linearRange);
+    minPhHisto->SetBinContent(minPhHisto->FindBin(r0, op), phDacScan.GetMinPh());
 
-    psi::LogDebug() << "[OffsetOptimization] Vcal Range Max: " << VcalRangeMax
-                    << " @ VOffsetR0: " << optimalR0
-                    << " @ VOffsetOp: " << optimalOp << std::endl;
+    histograms->Add(histo);
 
-    psi::LogDebug() << "[OffsetOptimization] Pixel Column: " << pixel.GetColumn()
-                    << " Row: " << pixel.GetRow() << std::endl;
+    psi::LogDebug() << "[OffsetOptimization] VOffsetR0: " << r0
+                    << " VOffsetOp: " << op << std::endl;
+    return linearRange;
 }
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "BasePixel/Test.h"
+#include "BasePixel/DacOptimizer.h"
 #include "PhDacScan.h"
 #include <TH2D.h>
 #include <TH1D.h>
@@ -22,6 +23,7 @@ public:
 
 private:
     void DoDacDacScan(TestPixel& pixel);
+    double LinearRange(TestPixel& pixel, TH2D* linearRangeHisto, TH2D* minPhHisto, const DacOptimizer::Point& point);
 
 private:
     boost::shared_ptr<TBAnalogInterface> tbInterface;
@@ -14,6 +14,7 @@
 #include "DacDependency.h"
 #include "PHCalibration.h"
 #include "BasePixel/TestParameters.h"
+#include "data/PixelRawDataFile.h"
 
 PHCalibration::PHCalibration(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface)
     : Test("PHCalibration", testRange), tbInterface(aTBInterface)
@@ -114,6 +115,16 @@ void PHCalibration::RocAction(TestRoc& roc)
     fprintf(file, "\n");
     fprintf(file, "\n");
 
+    // == Binary file with the same content, N/A is stored as 7777
+
+    sprintf(fname, "%s/phCalibration_C%i.bin", configParameters.Directory().c_str(), roc.GetChipId());
+    std::vector<int32_t> rawDataParameters;
+    rawDataParameters.push_back(mode);
+    rawDataParameters.insert(rawDataParameters.end(), vcal, vcal + vcalSteps);
+    rawDataParameters.insert(rawDataParameters.end(), ctrlReg, ctrlReg + vcalSteps);
+    psi::data::PixelRawDataWriter rawData(fname, psi::data::PixelRawDataKind::PHCalibration, vcalSteps,
+                                          rawDataParameters);
+
     // == Determine appropriate CalDel and VthrComp
 
     bool debug = false;
@@ -188,6 +199,7 @@ void PHCalibration::RocAction(TestRoc& roc)
         for (unsigned k = 0; k < psi::ROCNUMROWS * psi::ROCNUMCOLS; k++) ph[i][k] = data[k];
     }
 
+    std::vector<int16_t> values(vcalSteps);
     for (int col = 0; col < 52; col++) {
         for (int row = 0; row < 80; row++) {
             if (testRange->IncludesPixel(roc.GetChipId(), col, row)) {
@@ -197,11 +209,20 @@ void PHCalibration::RocAction(TestRoc& roc)
                     else fprintf(file, "  N/A ");
                 }
                 fprintf(file, "   Pix %2i %2i\n", col, row);
+
+                for (int i = 0; i < vcalSteps; i++)
+                    values[i] = static_cast<int16_t>(ph[i][col * psi::ROCNUMROWS + row]);
+                rawData.AddPixel(roc.GetChipId(), col, row, 0, values.data(), vcalSteps);
             }
         }
     }
 
     fclose(file);
+    try {
+        rawData.Close();
+    } catch(std::exception& e) {
+        psi::LogError() << "[PHCalibration] " << e.what() << std::endl;
+    }
     RestoreDacParameters(roc);
 }
 
@@ -3,6 +3,8 @@
  * \brief Definition of PHRange class.
  */
 
+#include <boost/bind.hpp>
+
 #include "TH1D.h"
 
 #include "psi/log.h"
@@ -153,6 +155,26 @@ int PHRange::PH(TestRoc& roc, int ctrlReg, int vcal, int calDel, int vthrComp, i
     return ph;
 }
 
+void PHRange::SetPHDacs(TestRoc& roc, const DacOptimizer::Point& point)
+{
+    roc.SetDAC(DACParameters::VIbias_PH, point.at(0));
+    roc.SetDAC(DACParameters::VoffsetOp, point.at(1));
+}
+
+// -- Difference between the measured PH range and the goal range for VIbias_PH and VoffsetOp given by the point
+double PHRange::RangeDifference(TestRoc& roc, int goalRange, const DacOptimizer::Point& point)
+{
+    SetPHDacs(roc, point);
+    return PHMax(roc) - PHMin(roc) - goalRange;
+}
+
+// -- Distance between the maximal PH and the TBM ultra black level for VIbias_PH and VoffsetOp given by the point
+double PHRange::PositionDifference(TestRoc& roc, const DacOptimizer::Point& point)
+{
+    SetPHDacs(roc, point);
+    return TMath::Abs(tbmUbLevel) - PHMax(roc);
+}
+
 void PHRange::RocAction(TestRoc& roc)
 {
     psi::LogDebug() << "[PHRange] Roc #" << roc.GetChipId() << '.' << std::endl;
@@ -160,91 +182,45 @@ void PHRange::RocAction(TestRoc& roc)
     SaveDacParameters(roc);
     Init(roc);
 
-    int vibiasPh = 90, offsetOp = 40, stepSize;
     int goalRange = 2 * TMath::Abs(tbmUbLevel) - phSafety;
-    int loopnumber = 0;
-    int diffRange, diffPos, diffRangeOld, diffPosOld;
-
-    // loop to achieve best range & best position
+    int diffRange = 0, diffPos = 0;
 
     if (debug)
         psi::LogInfo() << "goalRange " << goalRange << std::endl;
 
-    roc.SetDAC(DACParameters::VIbias_PH, vibiasPh);
-    roc.SetDAC(DACParameters::VoffsetOp, offsetOp);
-    roc.Flush();
-
-    do {
+    // The PH range grows with VIbias_PH and the PH position shifts with VoffsetOp. Each of them is found by
+    // bisection while the other one is fixed. Both depend a bit on the other DAC, so the search is repeated.
+    const DacOptimizer::Range vibiasPhRange(0, 230), offsetOpRange(0, 255);
+    DacOptimizer rangeOptimizer("VIbias_PH", boost::bind(&PHRange::RangeDifference, this, boost::ref(roc),
+                                                         goalRange, _1));
+    DacOptimizer positionOptimizer("VoffsetOp", boost::bind(&PHRange::PositionDifference, this, boost::ref(roc),
+                                                            _1));
+    DacOptimizer::Point point;
+    point.push_back(90);
+    point.push_back(40);
+
+    for (int loopnumber = 0; loopnumber < 3; loopnumber++) {
         if (debug)
             psi::LogInfo() << "loop: " << loopnumber << std::endl;
-        if (loopnumber == 0) stepSize = 5;
-        else stepSize = 1;
-
-        diffRange = PHMax(roc) - PHMin(roc) - goalRange;
-        if (diffRange > 0) {
-            do {
-                vibiasPh -= stepSize;
-                roc.SetDAC(DACParameters::VIbias_PH, vibiasPh);
-                diffRangeOld = diffRange;
-                diffRange = PHMax(roc) - PHMin(roc) - goalRange;
-            } while (diffRange > 0 && vibiasPh > stepSize);
-            if (TMath::Abs(diffRangeOld) < TMath::Abs(diffRange)) {
-                vibiasPh += stepSize;
-                roc.SetDAC(DACParameters::VIbias_PH, vibiasPh);
-            }
-        } else {
-            do {
-                vibiasPh += stepSize;
-                roc.SetDAC(DACParameters::VIbias_PH, vibiasPh);
-                diffRangeOld = diffRange;
-                diffRange = PHMax(roc) - PHMin(roc) - goalRange;
-            } while (diffRange < 0 && vibiasPh < 230 - stepSize);
-            if (TMath::Abs(diffRangeOld) < TMath::Abs(diffRange)) {
-                vibiasPh -= stepSize;
-                roc.SetDAC(DACParameters::VIbias_PH, vibiasPh);
-            }
-        }
 
-        diffPos = TMath::Abs(tbmUbLevel) - PHMax(roc);
-        if (diffPos > 0) {
-            do {
-                offsetOp += stepSize;
-                roc.SetDAC(DACParameters::VoffsetOp, offsetOp);
-                diffPosOld = diffPos;
-                diffPos = TMath::Abs(tbmUbLevel) - PHMax(roc);
-            } while (diffPos > 0 && offsetOp < 255 - stepSize);
-            if (TMath::Abs(diffPosOld) < TMath::Abs(diffPos)) {
-                offsetOp -= stepSize;
-                roc.SetDAC(DACParameters::VoffsetOp, offsetOp);
-            }
-        } else {
-            do {
-                offsetOp -= stepSize;
-                roc.SetDAC(DACParameters::VoffsetOp, offsetOp);
-                diffPosOld = diffPos;
-                diffPos = TMath::Abs(tbmUbLevel) - PHMax(roc);
-            } while (diffPos < 0 && offsetOp > stepSize);
-            if (TMath::Abs(diffPosOld) < TMath::Abs(diffPos)) {
-                offsetOp += stepSize;
-                roc.SetDAC(DACParameters::VoffsetOp, offsetOp);
-            }
-        }
+        point = rangeOptimizer.Bisection(point, 0, vibiasPhRange, 0.);
+        point = positionOptimizer.Bisection(point, 1, offsetOpRange, 0.);
 
-        diffRange = PHMax(roc) - PHMin(roc) - goalRange;
-        diffPos = TMath::Abs(tbmUbLevel) - PHMax(roc);
+        diffRange = static_cast<int>(rangeOptimizer.Evaluate(point));
+        diffPos = static_cast<int>(positionOptimizer.Evaluate(point));
         if (debug)
             psi::LogInfo() << "diffRange " << diffRange << " diffPos " << diffPos << std::endl;
-        loopnumber++;
-    } while ((TMath::Abs(diffRange) > 5 || TMath::Abs(diffPos) > 5) && loopnumber < 3);
-
+        if (TMath::Abs(diffRange) <= 5 && TMath::Abs(diffPos) <= 5) break;
+    }
+    rangeOptimizer.LogSummary(point, vibiasPhRange.Size());
+    positionOptimizer.LogSummary(point, offsetOpRange.Size());
 
     RestoreDacParameters(roc);
 
-    roc.SetDAC(DACParameters::VIbias_PH, vibiasPh);
-    roc.SetDAC(DACParameters::VoffsetOp, offsetOp);
+    SetPHDacs(roc, point);
 
-    psi::LogDebug() << "[PHRange] VIbias_PH " << vibiasPh << " VoffsetOp "
-                    << offsetOp << std::endl;
+    psi::LogDebug() << "[PHRange] VIbias_PH " << point.at(0) << " VoffsetOp "
+                    << point.at(1) << std::endl;
 
     roc.Flush();
 
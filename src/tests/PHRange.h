@@ -6,6 +6,7 @@
 #pragma once
 
 #include "BasePixel/Test.h"
+#include "BasePixel/DacOptimizer.h"
 
 /*!
  * \brief Sets the VIbias_roc and the VOffsetOp DAC so that PH is within the range -tbmublevel+safety ... +tbmublevel
@@ -22,6 +23,9 @@ private:
     int PHMax(TestRoc& roc);
     int PH(TestRoc& roc, int ctrlReg, int vcal, int calDel, int vthrComp, int vtrim, int pixel);
     void ValidationPlot(TestRoc& roc);
+    void SetPHDacs(TestRoc& roc, const DacOptimizer::Point& point);
+    double RangeDifference(TestRoc& roc, int goalRange, const DacOptimizer::Point& point);
+    double PositionDifference(TestRoc& roc, const DacOptimizer::Point& point);
 
 private:
     boost::shared_ptr<TBAnalogInterface> tbInterface;
@@ -3,10 +3,13 @@
  * \brief Implementation of PHTest class.
  */
 
+#include <algorithm>
+
 #include "PHTest.h"
 #include "psi46expert/TestRoc.h"
 #include "BasePixel/TBAnalogInterface.h"
 #include "BasePixel/TestParameters.h"
+#include "analysis/Analysis.h"
 
 PHTest::PHTest(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface)
     : Test("PHTest", testRange), tbInterface(aTBInterface)
@@ -22,16 +25,13 @@ void PHTest::RocAction(TestRoc& roc)
     if (mode == 0) {
         std::ostringstream mapName;
         mapName << "PH_C" << roc.GetChipId();
-        map = new TH2D(mapName.str().c_str(), mapName.str().c_str(), psi::ROCNUMCOLS, 0, psi::ROCNUMCOLS,
-                       psi::ROCNUMROWS, 0, psi::ROCNUMROWS);
         int data[psi::ROCNUMROWS * psi::ROCNUMCOLS], offset;
         if (tbInterface->TBMPresent()) offset = 16;
         else offset = 9;
         roc.AoutLevelChip(offset + roc.GetAoutChipPosition() * 3, nTrig, data);
-        for (unsigned col = 0; col < psi::ROCNUMCOLS; col++) {
-            for (unsigned row = 0; row < psi::ROCNUMROWS; row++)
-                map->SetBinContent(col + 1, row + 1, data[col * psi::ROCNUMROWS + row]);
-        }
+        double values[psi::ROCNUMROWS * psi::ROCNUMCOLS];
+        std::copy(data, data + psi::ROCNUMROWS * psi::ROCNUMCOLS, values);
+        map = Analysis::ToMap(values, mapName.str());
         histograms->Add(map);
 
     }
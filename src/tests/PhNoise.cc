@@ -7,12 +7,12 @@
 
 #include "psi/log.h"
 
-#include <TMath.h>
-
 #include "PhNoise.h"
 #include "psi46expert/TestRoc.h"
 #include "psi46expert/TestModule.h"
 #include "BasePixel/TBAnalogInterface.h"
+#include "analysis/Analysis.h"
+#include "analysis/PixelAccumulator.h"
 
 bool PhNoise::debug = true;
 
@@ -26,8 +26,8 @@ void PhNoise::ModuleAction(TestModule& module)
     else offset = 2; //either tbm black or roc black
     TH1D *black = new TH1D("black", "black", 4000, -2000., 2000.);
     for (int i = 0; i < nReadouts; i++) {
-        tbInterface->ADCRead(data, count, 1);
-        if (count > offset) black->Fill(data[offset]);
+        const ADCSpan data = tbInterface->AcquireADC(1);
+        if ((int)data.size() > offset) black->Fill(data[offset]);
     }
 
     if (debug)
@@ -40,36 +40,35 @@ void PhNoise::ModuleAction(TestModule& module)
 
 void PhNoise::RocAction(TestRoc& roc)
 {
-    int data[psi::ROCNUMROWS * psi::ROCNUMCOLS], offset;
+    static const unsigned nPixels = psi::ROCNUMROWS * psi::ROCNUMCOLS;
+    static const unsigned debugPixel = 2393;
+
+    int data[nPixels], offset;
     if (tbInterface->TBMPresent()) offset = 16;
     else offset = 9;
     int phPosition = offset + roc.GetAoutChipPosition() * 3;
 
-    TH2D *phMean = CreateMap("phMean", roc.GetChipId());
-    TH2D *phSquaredMean = CreateMap("phSquaredMean", roc.GetChipId());
-    TH2D *phVariance =  CreateMap("phVariance", roc.GetChipId());
-
+    psi::analysis::PixelAccumulator accumulator(nPixels);
     for (int i = 0; i < nReadouts; i++) {
         roc.AoutLevelChip(phPosition, 1, data);
-        for (unsigned k = 0; k < psi::ROCNUMROWS * psi::ROCNUMCOLS; k++) {
-            if (debug && k == 2393)
-                psi::LogInfo() << k << " ph " << data[k] << std::endl;
-            phMean->Fill(k / psi::ROCNUMROWS, k % psi::ROCNUMROWS, data[k]);
-            phSquaredMean->Fill(k / psi::ROCNUMROWS, k % psi::ROCNUMROWS, data[k]*data[k]);
-        }
-    }
-    double mean, squaredMean, variance;
-    for (unsigned k = 0; k < psi::ROCNUMROWS * psi::ROCNUMCOLS; k++) {
-        mean = phMean->GetBinContent(k / psi::ROCNUMROWS + 1, k % psi::ROCNUMROWS + 1);
-        squaredMean = phSquaredMean->GetBinContent(k / psi::ROCNUMROWS + 1, k % psi::ROCNUMROWS + 1);
-        variance = TMath::Sqrt((squaredMean - mean * mean / nReadouts) / (nReadouts - 1));
-        phVariance->Fill(k / psi::ROCNUMROWS, k % psi::ROCNUMROWS, variance);
-        if (debug && k == 2393)
-            psi::LogInfo() << "phMean " << (mean / nReadouts) << " phSquaredMean " << (squaredMean / nReadouts)
-                           << " variance " << variance << std::endl;
+        if (debug)
+            psi::LogInfo() << debugPixel << " ph " << data[debugPixel] << std::endl;
+        accumulator.Add(data);
     }
 
-    histograms->Add(phMean);
-    histograms->Add(phSquaredMean);
-    histograms->Add(phVariance);
+    if (debug)
+        psi::LogInfo() << "phMean " << accumulator.Mean(debugPixel) << " variance "
+                       << accumulator.StandardDeviation(debugPixel) << std::endl;
+
+    std::ostringstream suffix;
+    suffix << "_C" << roc.GetChipId();
+    psi::analysis::PixelMap phMean = psi::analysis::PixelMap::Roc("phMean" + suffix.str());
+    accumulator.Means(phMean.Data());
+    AddMap(phMean);
+    psi::analysis::PixelMap phSquaredMean = psi::analysis::PixelMap::Roc("phSquaredMean" + suffix.str());
+    accumulator.MeanSquares(phSquaredMean.Data());
+    AddMap(phSquaredMean);
+    psi::analysis::PixelMap phVariance = psi::analysis::PixelMap::Roc("phVariance" + suffix.str());
+    accumulator.StandardDeviations(phVariance.Data());
+    AddMap(phVariance);
 }
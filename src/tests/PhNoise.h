@@ -20,8 +20,6 @@ public:
 
 private:
     boost::shared_ptr<TBAnalogInterface> tbInterface;
-    unsigned short count;
-    short data[psi::FIFOSIZE];
     static const int nReadouts = 1000;
     static bool debug;
 };
@@ -52,6 +52,14 @@ void SCurveTest::ModuleAction(TestModule& module)
         mapParameters = &ThresholdMap::VcalThresholdMapParameters;
     }
 
+    sprintf(fname, "%s/SCurveData.bin", configParameters.Directory().c_str());
+    std::vector<int32_t> rawDataParameters;
+    rawDataParameters.push_back(mode);
+    rawDataParameters.push_back(dacReg);
+    rawDataParameters.push_back(nTrig);
+    rawData.reset(new psi::data::PixelRawDataWriter(fname, psi::data::PixelRawDataKind::SCurve, MaxSCurvePoints,
+                  rawDataParameters));
+
     for (unsigned i = 0; i <  module.NRocs(); i++) {
 
         // == Open file
@@ -81,6 +89,13 @@ void SCurveTest::ModuleAction(TestModule& module)
         module.GetRoc(i).RestoreDacParameters();
         fclose(file[i]);
     }
+
+    try {
+        rawData->Close();
+    } catch(std::exception& e) {
+        psi::LogError() << "[SCurveTest] " << e.what() << std::endl;
+    }
+    rawData.reset();
 }
 
 void SCurveTest::RocAction(TestRoc& roc)
@@ -121,37 +136,44 @@ void SCurveTest::DoubleColumnAction(TestDoubleColumn& doubleColumn)
             tbInterface->SCurveColumn(iCol, nTrig, dacReg, thr, trims, chipId, sCurve);
 
             double x[255], y[255];
-            int start, stop, n, position = 0;
+            int start, stop, n;
+
+            // The curves of row iRow start at iRow * nRocs * 32 in sCurve.
+            for (int iRoc = 0; iRoc < nRocs; iRoc++) {
+                const TestRange::PixelRange pixels = testRange->Pixels(chipId[iRoc], doubleColumn.DoubleColumnNumber());
+                for (TestRange::PixelIterator iter = pixels.begin(); iter != pixels.end(); ++iter) {
+                    const TestRange::Pixel pixel = *iter;
+                    if (pixel.column != iCol) continue;
+                    const unsigned iRow = pixel.row;
+                    const int position = iRow * nRocs * 32;
+                    n = 0;
+                    start = thr[iRow * nRocs + iRoc] - 16;
+                    stop = thr[iRow * nRocs + iRoc] + 16;
+                    if (start < 0) start = 0;
+                    if (stop > 255) stop = 255;
+
+                    for (int vthr = start; vthr < stop; vthr++) {
+                        if (mode == 1) x[n] = CalibrationTable::VcalDAC(0, vthr);
+                        else x[n] = vthr;
+                        y[n] = sCurve[position + (vthr - start) * nRocs + iRoc];
+                        n++;
+                    }
 
-            for (unsigned iRow = 0; iRow < psi::ROCNUMROWS; iRow++) {
-                for (int iRoc = 0; iRoc < nRocs; iRoc++) {
-                    if (testRange->IncludesPixel(chipId[iRoc], iCol, iRow)) {
-                        n = 0;
-                        start = thr[iRow * nRocs + iRoc] - 16;
-                        stop = thr[iRow * nRocs + iRoc] + 16;
-                        if (start < 0) start = 0;
-                        if (stop > 255) stop = 255;
-
-                        for (int vthr = start; vthr < stop; vthr++) {
-                            if (mode == 1) x[n] = CalibrationTable::VcalDAC(0, vthr);
-                            else x[n] = vthr;
-                            y[n] = sCurve[position + (vthr - start) * nRocs + iRoc];
-                            n++;
-                        }
-
-                        if (ConfigParameters::Singleton().GuiMode()) {
-                            graph = new TGraph(n, x, y);
-                            graph->SetNameTitle(Form("SCurve_c%ir%i_C%d", iCol, iRow, chipId[iRoc]), Form("SCurve_c%ir%i_C%d", iCol, iRow, chipId[iRoc]));
-                            histograms->Add(graph);
-                            graph->Write();
-                        }
-
-                        fprintf(file[iRoc], "%2i %3i ", n, start);
-                        for (int i = 0; i < n; i++) fprintf(file[iRoc], "%3i ", (int)y[i]);
-                        fprintf(file[iRoc], "\n");
+                    if (ConfigParameters::Singleton().GuiMode()) {
+                        graph = new TGraph(n, x, y);
+                        graph->SetNameTitle(Form("SCurve_c%ir%i_C%d", iCol, iRow, chipId[iRoc]), Form("SCurve_c%ir%i_C%d", iCol, iRow, chipId[iRoc]));
+                        histograms->Add(graph);
+                        graph->Write();
                     }
+
+                    fprintf(file[iRoc], "%2i %3i ", n, start);
+                    for (int i = 0; i < n; i++) fprintf(file[iRoc], "%3i ", (int)y[i]);
+                    fprintf(file[iRoc], "\n");
+
+                    int16_t values[MaxSCurvePoints];
+                    for (int i = 0; i < n; i++) values[i] = static_cast<int16_t>(y[i]);
+                    rawData->AddPixel(chipId[iRoc], iCol, iRow, start, values, n);
                 }
-                position += nRocs * 32;
             }
         }
     }
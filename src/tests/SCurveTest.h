@@ -5,9 +5,12 @@
 
 #pragma once
 
-#include "BasePixel/Test.h"
+#include <boost/scoped_ptr.hpp>
 #include <TH2D.h>
 
+#include "BasePixel/Test.h"
+#include "data/PixelRawDataFile.h"
+
 /*!
  * \brief SCurve measurements
  */
@@ -27,4 +30,6 @@ private:
     TH2D *map[psi::MODULENUMROCS];
     bool testDone;
     FILE *file[psi::MODULENUMROCS];
+    boost::scoped_ptr<psi::data::PixelRawDataWriter> rawData;
+    static const unsigned MaxSCurvePoints = 32;
 };
@@ -40,7 +40,7 @@ void SCurveTestBeam::RocAction(TestRoc& roc)
     unsigned short count;
     int nReadouts, readoutStart[256];
     short data[psi::FIFOSIZE];
-    bool noError, pixelFound;
+    bool noError;
 
     int nMaxTrigs = 5, nTriggers;
     double x[255], y[255], ph[255], vcal[255], xErr[255], yErr[255];
@@ -90,23 +90,19 @@ void SCurveTestBeam::RocAction(TestRoc& roc)
             } while (!noError);
 
             for (int k = 0; k < nReadouts; k++) {
-                pixelFound = false;
-                int nDecodedPixelHitsModule = RawPacketDecoder::Singleton()->decode(
-                            (int)count, &data[readoutStart[k]], decodedModuleReadout, NUM_ROCSMODULE);
-                psi::LogDebug() << "[SCurveTestBeam] nDec " << nDecodedPixelHitsModule
-                                << std::endl;
-                for (int iroc = 0; iroc < NUM_ROCSMODULE; iroc++) {
-                    int nDecodedPixelHitsROC = decodedModuleReadout.roc[iroc].numPixelHits;
-                    for (int ipixelhit = 0; ipixelhit < nDecodedPixelHitsROC; ipixelhit++) {
-                        DecodedReadoutPixel decodedPixelHit = decodedModuleReadout.roc[iroc].pixelHit[ipixelhit];
-                        if ((decodedPixelHit.rowROC == row) && (decodedPixelHit.columnROC == column)) {
-                            pixelFound = true;
-                            ph[i] += decodedPixelHit.analogPulseHeight;
-                        }
-                    }
+                // Only the pixel armed in this ROC receives calibrate signals, so only the hits of this ROC are
+                // decoded, located by its analog output position like in AddressDecoding. Hits at the same
+                // address in other ROCs of a module are noise and are no longer counted into the efficiency
+                // and the pulse height.
+                DecodedReadoutPixel decodedPixelHit;
+                const int pixelFound = RawPacketDecoder::Singleton()->decodePixel(
+                            (int)count, &data[readoutStart[k]], NUM_ROCSMODULE, roc.GetAoutChipPosition(), column, row,
+                            decodedPixelHit);
+                psi::LogDebug() << "[SCurveTestBeam] pixelFound " << pixelFound << std::endl;
+                if (pixelFound > 0) {
+                    ph[i] += decodedPixelHit.analogPulseHeight;
+                    y[i]++;
                 }
-
-                if (pixelFound) y[i]++;
             }
         }
         ph[i] /= y[i];
@@ -19,7 +19,6 @@ public:
 
 private:
     boost::shared_ptr<TBAnalogInterface> tbInterface;
-    DecodedReadoutModule decodedModuleReadout;
     int nTrig, mode, vthr, vcal, sCurve[256];
     DACParameters::Register dacReg;
     TH2D *map;
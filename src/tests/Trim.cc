@@ -29,124 +29,174 @@ void Trim::AddMap(TH2D* calMap)
     histograms->Add(distr);
 }
 
+void Trim::ModuleAction(TestModule& module)
+{
+    const std::vector<TestRoc*> rocs = IncludedRocs(module);
+    if (!rocs.empty())
+        RocsAction(rocs);
+}
+
 void Trim::RocAction(TestRoc& roc)
 {
-    TestPixel *maxPixel = 0;
-    double thrMax, thr, thrMin;
-    TH2D *calMap;
+    RocsAction(std::vector<TestRoc*>(1, &roc));
+}
+
+std::vector<TH2D*> Trim::MeasureMaps(const ThresholdMap::Parameters& parameters, const std::vector<RocState>& states,
+                                     unsigned mapId)
+{
+    std::vector<TestRoc*> rocs;
+    for (size_t n = 0; n < states.size(); n++)
+        rocs.push_back(states[n].roc);
+    return thresholdMap.MeasureMaps(parameters, rocs, *testRange, nTrig, mapId);
+}
+
+void Trim::RocsAction(const std::vector<TestRoc*>& rocs)
+{
+    double thrMax, thr;
+    std::vector<RocState> states, goodStates;
 
     if (doubleWbc) thresholdMap.SetDoubleWbc();
 
-    psi::LogInfo() << "[Trim] Roc #" << roc.GetChipId() << ": Start." << std::endl;
-    SaveDacParameters(roc);
+    for (size_t n = 0; n < rocs.size(); n++) {
+        TestRoc& roc = *rocs[n];
+        psi::LogInfo() << "[Trim] Roc #" << roc.GetChipId() << ": Start." << std::endl;
+        RocState state;
+        state.roc = &roc;
+        state.savedDacParameters = roc.SaveDacParameters();
+        states.push_back(state);
 
-    roc.SetTrim(15);
-    roc.SetDAC(DACParameters::Vtrim, 0);
+        roc.SetTrim(15);
+        roc.SetDAC(DACParameters::Vtrim, 0);
 
-    psi::LogDebug() << "[Trim] Setting Vcal to " << vcal << std::endl;
+        psi::LogDebug() << "[Trim] Setting Vcal to " << vcal << std::endl;
 
-    roc.SetDAC(DACParameters::Vcal, vcal);
-    roc.Flush();
+        roc.SetDAC(DACParameters::Vcal, vcal);
+    }
+    tbInterface->Flush();
 
     //Find good VthrComp
-    calMap = thresholdMap.MeasureMap(ThresholdMap::CalThresholdMapParameters, roc, *testRange, nTrig);
-    AddMap(calMap);
-    TH1D *distr = Analysis::Distribution(calMap, 255, 1., 254., 2);
-    double mean = distr->GetMean();
-    double rms = distr->GetRMS();
-    double thrMinLimit = TMath::Max(1., mean - 5.*rms);
-
-    thrMin = 255.;
-    thrMax = 0.;
-    int thr255 = 0;
-    for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
-        for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
-            if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
-                thr = calMap->GetBinContent(i + 1, k + 1);
-                if ((thr > thrMax) && (thr < 255.)) thrMax = thr;
-                if ((thr < thrMin) && (thr > thrMinLimit)) thrMin = thr;
-                if (thr == 255.) thr255++;
+    std::vector<TH2D*> calMaps = MeasureMaps(ThresholdMap::CalThresholdMapParameters, states, 0);
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        TH2D* calMap = calMaps[n];
+        AddMap(calMap);
+        TH1D *distr = Analysis::Distribution(calMap, 255, 1., 254., 2);
+        double mean = distr->GetMean();
+        double rms = distr->GetRMS();
+        double thrMinLimit = TMath::Max(1., mean - 5.*rms);
+
+        double thrMin = 255.;
+        thrMax = 0.;
+        int thr255 = 0;
+        for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
+            for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
+                if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
+                    thr = calMap->GetBinContent(i + 1, k + 1);
+                    if ((thr > thrMax) && (thr < 255.)) thrMax = thr;
+                    if ((thr < thrMin) && (thr > thrMinLimit)) thrMin = thr;
+                    if (thr == 255.) thr255++;
+                }
             }
         }
-    }
-    psi::LogDebug() << "[Trim] There are " << thr255 << " pixels with "
-                    << "threshold 255." << std::endl;
-    psi::LogDebug() << "[Trim] Theshold range is [ " << thrMin << ", "
-                    << thrMax << "]." << std::endl;
-
-    if (thrMax == 0.) {
-        psi::LogInfo() << "[Trim] Error: Can not find maximum threshold."
-                       << std::endl;
+        psi::LogDebug() << "[Trim] Roc #" << roc.GetChipId() << ": there are " << thr255 << " pixels with "
+                        << "threshold 255." << std::endl;
+        psi::LogDebug() << "[Trim] Roc #" << roc.GetChipId() << ": theshold range is [ " << thrMin << ", "
+                        << thrMax << "]." << std::endl;
+
+        if (thrMax == 0.) {
+            psi::LogInfo() << "[Trim] Roc #" << roc.GetChipId() << ": Error: Can not find maximum threshold."
+                           << std::endl;
+            continue;
+        }
 
-        return;
+        states[n].thrMin = thrMin;
+        roc.SetDAC(DACParameters::VthrComp, (int)thrMin);
+        psi::LogDebug() << "[Trim] Roc #" << roc.GetChipId() << ": VthrComp is set to "
+                        << static_cast<int>( thrMin) << std::endl;
+        goodStates.push_back(states[n]);
     }
-
-    roc.SetDAC(DACParameters::VthrComp, (int)thrMin);
-    psi::LogDebug() << "[Trim] VthrComp is set to " << static_cast<int>( thrMin)
-                    << std::endl;
-    roc.Flush();
+    states.swap(goodStates);
+    goodStates.clear();
+    if (states.empty()) return;
+    tbInterface->Flush();
 
     //Determine minimal and maximal thresholds
-    calMap = thresholdMap.MeasureMap(ThresholdMap::VcalThresholdMapParameters, roc, *testRange, nTrig,
-                                     ++numberOfVcalThresholdMaps);
-    AddMap(calMap);
-    distr = Analysis::Distribution(calMap, 255, 1., 254., 2);
-    mean = distr->GetMean();
-    rms = distr->GetRMS();
-    double vcalMaxLimit = TMath::Min(254., mean + 5.*rms);
-
-    double vcalMin = 255.;
-    double vcalMax = 0.;
-    thr255 = 0;
-    for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
-        for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
-            if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
-                thr = calMap->GetBinContent(i + 1, k + 1);
-                if ((thr > vcalMax) && (thr < vcalMaxLimit)) {
-                    vcalMax = thr;
-                    maxPixel = &roc.GetPixel(i, k);
+    calMaps = MeasureMaps(ThresholdMap::VcalThresholdMapParameters, states, ++numberOfVcalThresholdMaps);
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        TH2D* calMap = calMaps[n];
+        TestPixel *maxPixel = 0;
+        AddMap(calMap);
+        TH1D *distr = Analysis::Distribution(calMap, 255, 1., 254., 2);
+        double mean = distr->GetMean();
+        double rms = distr->GetRMS();
+        double vcalMaxLimit = TMath::Min(254., mean + 5.*rms);
+
+        double vcalMin = 255.;
+        double vcalMax = 0.;
+        int thr255 = 0;
+        for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
+            for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
+                if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
+                    thr = calMap->GetBinContent(i + 1, k + 1);
+                    if ((thr > vcalMax) && (thr < vcalMaxLimit)) {
+                        vcalMax = thr;
+                        maxPixel = &roc.GetPixel(i, k);
+                    }
+                    if ((thr < vcalMin) && (thr > 1.)) vcalMin = thr;
+                    if (thr == 255.) thr255++;
                 }
-                if ((thr < vcalMin) && (thr > 1.)) vcalMin = thr;
-                if (thr == 255.) thr255++;
             }
         }
-    }
 
-    psi::LogDebug() << "[Trim] There are " << thr255 << " pixels with "
-                    << "Vcal 255." << std::endl;
-    psi::LogDebug() << "[Trim] Vcal range is [ " << vcalMin << ", "
-                    << vcalMax << "]." << std::endl;
+        psi::LogDebug() << "[Trim] Roc #" << roc.GetChipId() << ": there are " << thr255 << " pixels with "
+                        << "Vcal 255." << std::endl;
+        psi::LogDebug() << "[Trim] Roc #" << roc.GetChipId() << ": Vcal range is [ " << vcalMin << ", "
+                        << vcalMax << "]." << std::endl;
+
+        if (vcalMax == 0) {
+            psi::LogInfo() << "[Trim] Roc #" << roc.GetChipId() << ": Error: Vcal max = 0. Abort test." << std::endl;
+            continue;
+        }
 
-    if (vcalMax == 0) {
-        psi::LogInfo() << "[Trim] Error: Vcal max = 0. Abort test." << std::endl;
+        //Determine Vtrim
+        roc.EnableDoubleColumn(maxPixel->GetColumn());
+        states[n].vtrim = AdjustVtrim(*maxPixel);
+        roc.DisableDoubleColumn(maxPixel->GetColumn());
 
-        return;
+        roc.SetTrim(7);
+        goodStates.push_back(states[n]);
     }
+    states.swap(goodStates);
+    if (states.empty()) return;
 
-    //Determine Vtrim
-    roc.EnableDoubleColumn(maxPixel->GetColumn());
-    int vtrim = AdjustVtrim(*maxPixel);
-    roc.DisableDoubleColumn(maxPixel->GetColumn());
+    calMaps = MeasureMaps(ThresholdMap::VcalThresholdMapParameters, states, ++numberOfVcalThresholdMaps);
+    for (size_t n = 0; n < states.size(); n++) {
+        states[n].calMap = calMaps[n];
+        AddMap(calMaps[n]);
+    }
 
-    roc.SetTrim(7);
-    calMap = thresholdMap.MeasureMap(ThresholdMap::VcalThresholdMapParameters, roc, *testRange, nTrig,
-                                     ++numberOfVcalThresholdMaps);
-    AddMap(calMap);
+    TrimStep(states, 4);
+    TrimStep(states, 2);
+    TrimStep(states, 1);
+    TrimStep(states, 1);
 
-    calMap = TrimStep(roc, 4, calMap);
-    calMap = TrimStep(roc, 2, calMap);
-    calMap = TrimStep(roc, 1, calMap);
-    calMap = TrimStep(roc, 1, calMap);
+    calMaps = MeasureMaps(ThresholdMap::VcalThresholdMapParameters, states, ++numberOfVcalThresholdMaps);
+    for (size_t n = 0; n < states.size(); n++) {
+        AddMap(calMaps[n]);
 
-    calMap = thresholdMap.MeasureMap(ThresholdMap::VcalThresholdMapParameters, roc, *testRange, nTrig,
-                                     ++numberOfVcalThresholdMaps);
-    AddMap(calMap);
+        TestRoc& roc = *states[n].roc;
+        roc.RestoreDacParameters(states[n].savedDacParameters);
 
-    RestoreDacParameters(roc);
+        roc.SetDAC(DACParameters::Vtrim, states[n].vtrim);
+        roc.SetDAC(DACParameters::VthrComp, (int)states[n].thrMin);
 
-    roc.SetDAC(DACParameters::Vtrim, vtrim);
-    roc.SetDAC(DACParameters::VthrComp, (int)thrMin);
+        WriteParameterFiles(roc);
+    }
+}
 
+void Trim::WriteParameterFiles(TestRoc& roc)
+{
     const ConfigParameters& configParameters = ConfigParameters::Singleton();
     char dacFileName[100], trimFileName[100];
 
@@ -176,58 +226,75 @@ void Trim::RocAction(TestRoc& roc)
 }
 
 
-TH2D* Trim::TrimStep(TestRoc& roc, int correction, TH2D *calMapOld)
+void Trim::TrimStep(std::vector<RocState>& states, int correction)
 {
-    TH2D* betterCalMap = CreateMap("VcalThresholdMap", roc.GetChipId(), ++numberOfVcalThresholdMaps);
+    const unsigned betterMapId = ++numberOfVcalThresholdMaps;
+    const unsigned oldTrimMapId = ++numberOfTrimMaps;
+    const unsigned newTrimMapId = ++numberOfTrimMaps;
+    std::vector<TH2D*> trimMaps;
     int trim;
 
-    //save trim map
-    TH2D *trimMap = roc.TrimMap(++numberOfTrimMaps);
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        TH2D *calMapOld = states[n].calMap;
+
+        //save trim map
+        TH2D *trimMap = roc.TrimMap(oldTrimMapId);
+        trimMaps.push_back(trimMap);
 
-    //set new trim bits
-    for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
-        for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
-            if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
-                trim = (int)trimMap->GetBinContent(i + 1, k + 1);
+        //set new trim bits
+        for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
+            for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
+                if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
+                    trim = (int)trimMap->GetBinContent(i + 1, k + 1);
 
-                if (calMapOld->GetBinContent(i + 1, k + 1) > vcal) trim -= correction;
-                else trim += correction;
+                    if (calMapOld->GetBinContent(i + 1, k + 1) > vcal) trim -= correction;
+                    else trim += correction;
 
-                if (trim < 0) trim = 0;
-                if (trim > 15) trim = 15;
-                roc.GetPixel(i, k).SetTrim(trim);
+                    if (trim < 0) trim = 0;
+                    if (trim > 15) trim = 15;
+                    roc.GetPixel(i, k).SetTrim(trim);
+                }
             }
         }
+        AddMap(roc.TrimMap(newTrimMapId));
     }
-    AddMap(roc.TrimMap(++numberOfTrimMaps));
 
     //measure new result
-    TH2D *calMap = thresholdMap.MeasureMap(ThresholdMap::VcalThresholdMapParameters, roc, *testRange, nTrig,
-                                           ++numberOfVcalThresholdMaps);
-    AddMap(calMap);
-
-    // test if the result got better
-    for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
-        for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
-            if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
-                trim = roc.GetPixel(i, k).GetTrim();
-
-                if (TMath::Abs(calMap->GetBinContent(i + 1, k + 1) - vcal) <=
-                        TMath::Abs(calMapOld->GetBinContent(i + 1, k + 1) - vcal)) {
-                    // it's better now
-                    betterCalMap->SetBinContent(i + 1, k + 1, calMap->GetBinContent(i + 1, k + 1));
-                } else {
-                    // it's worse
-                    betterCalMap->SetBinContent(i + 1, k + 1, calMapOld->GetBinContent(i + 1, k + 1));
-                    roc.GetPixel(i, k).SetTrim((int)trimMap->GetBinContent(i + 1, k + 1));
+    const std::vector<TH2D*> calMaps = MeasureMaps(ThresholdMap::VcalThresholdMapParameters, states,
+                                                   ++numberOfVcalThresholdMaps);
+
+    const unsigned resultTrimMapId = ++numberOfTrimMaps;
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        TH2D *calMapOld = states[n].calMap;
+        TH2D *calMap = calMaps[n];
+        TH2D *trimMap = trimMaps[n];
+        TH2D* betterCalMap = CreateMap("VcalThresholdMap", roc.GetChipId(), betterMapId);
+        AddMap(calMap);
+
+        // test if the result got better
+        for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
+            for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
+                if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
+                    trim = roc.GetPixel(i, k).GetTrim();
+
+                    if (TMath::Abs(calMap->GetBinContent(i + 1, k + 1) - vcal) <=
+                            TMath::Abs(calMapOld->GetBinContent(i + 1, k + 1) - vcal)) {
+                        // it's better now
+                        betterCalMap->SetBinContent(i + 1, k + 1, calMap->GetBinContent(i + 1, k + 1));
+                    } else {
+                        // it's worse
+                        betterCalMap->SetBinContent(i + 1, k + 1, calMapOld->GetBinContent(i + 1, k + 1));
+                        roc.GetPixel(i, k).SetTrim((int)trimMap->GetBinContent(i + 1, k + 1));
+                    }
                 }
             }
         }
-    }
-
-    AddMap(roc.TrimMap(++numberOfTrimMaps));
 
-    return betterCalMap;
+        AddMap(roc.TrimMap(resultTrimMapId));
+        states[n].calMap = betterCalMap;
+    }
 }
 
 
@@ -15,12 +15,28 @@
 class Trim : public Test {
 public:
     Trim(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface);
+    virtual void ModuleAction(TestModule& module);
     virtual void RocAction(TestRoc& roc);
 
 private:
+    /// Trim state of a ROC. All ROCs are trimmed in parallel, so that their threshold maps are measured at once.
+    struct RocState {
+        TestRoc* roc;
+        boost::shared_ptr<DACParameters> savedDacParameters;
+        double thrMin;
+        int vtrim;
+        TH2D* calMap;
+        RocState() : roc(0), thrMin(0), vtrim(0), calMap(0) {}
+    };
+
+private:
+    void RocsAction(const std::vector<TestRoc*>& rocs);
+    std::vector<TH2D*> MeasureMaps(const ThresholdMap::Parameters& parameters, const std::vector<RocState>& states,
+                                   unsigned mapId);
     int AdjustVtrim(TestPixel& pixel);
     void AddMap(TH2D* calMap);
-    TH2D* TrimStep(TestRoc& roc, int correction, TH2D *calMapOld);
+    void TrimStep(std::vector<RocState>& states, int correction);
+    void WriteParameterFiles(TestRoc& roc);
 
 private:
     boost::shared_ptr<TBAnalogInterface> tbInterface;
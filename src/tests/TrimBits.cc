@@ -24,31 +24,52 @@ TrimBits::TrimBits(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aT
     nTrig = testParameters.TrimBitsNTrig();
 }
 
+void TrimBits::ModuleAction(TestModule& module)
+{
+    const std::vector<TestRoc*> rocs = IncludedRocs(module);
+    if (!rocs.empty())
+        RocsAction(rocs);
+}
+
 void TrimBits::RocAction(TestRoc& roc)
+{
+    RocsAction(std::vector<TestRoc*>(1, &roc));
+}
+
+void TrimBits::RocsAction(const std::vector<TestRoc*>& rocs)
 {
     ThresholdMap thresholdMap;
-    TH2D *map, *thrMap;
     static const size_t NUMBER_OF_RUNS = 4;
     int trim[NUMBER_OF_RUNS] = { 14, 13, 11, 7 };
     int vtrim[NUMBER_OF_RUNS] = { vtrim14, vtrim13, vtrim11, vtrim7 };
+    std::vector< boost::shared_ptr<DACParameters> > savedDacs;
 
-    SaveDacParameters(roc);
-
-    roc.SetDAC(DACParameters::Vtrim, 0);
+    for (size_t n = 0; n < rocs.size(); ++n) {
+        savedDacs.push_back(rocs[n]->SaveDacParameters());
+        rocs[n]->SetDAC(DACParameters::Vtrim, 0);
+    }
 
-    thrMap = thresholdMap.MeasureMap(ThresholdMap::CalThresholdMapParameters, roc, *testRange, nTrig, 1);
-    histograms->Add(thrMap);
+    const std::vector<TH2D*> thrMaps = thresholdMap.MeasureMaps(ThresholdMap::CalThresholdMapParameters, rocs,
+                                                                *testRange, nTrig, 1);
+    for (size_t n = 0; n < rocs.size(); ++n)
+        histograms->Add(thrMaps[n]);
 
     for (size_t i = 0; i < NUMBER_OF_RUNS; ++i) {
-        roc.SetDAC(DACParameters::Vtrim, vtrim[i]);
-        roc.SetTrim(trim[i]);
-
-        map = thresholdMap.MeasureMap(ThresholdMap::CalThresholdMapParameters, roc, *testRange, nTrig, i+2);
-        histograms->Add(map);
-        std::stringstream testHistoName;
-        testHistoName << "TrimBit" << trim[i] << "_C" << roc.GetChipId() << "_nb" << (i+2);
-        histograms->Add(Analysis::TrimBitTest(thrMap, map, testHistoName.str()));
+        for (size_t n = 0; n < rocs.size(); ++n) {
+            rocs[n]->SetDAC(DACParameters::Vtrim, vtrim[i]);
+            rocs[n]->SetTrim(trim[i]);
+        }
+
+        const std::vector<TH2D*> maps = thresholdMap.MeasureMaps(ThresholdMap::CalThresholdMapParameters, rocs,
+                                                                 *testRange, nTrig, i+2);
+        for (size_t n = 0; n < rocs.size(); ++n) {
+            histograms->Add(maps[n]);
+            std::stringstream testHistoName;
+            testHistoName << "TrimBit" << trim[i] << "_C" << rocs[n]->GetChipId() << "_nb" << (i+2);
+            histograms->Add(Analysis::TrimBitTest(thrMaps[n], maps[n], testHistoName.str()));
+        }
     }
 
-    RestoreDacParameters(roc);
+    for (size_t n = 0; n < rocs.size(); ++n)
+        rocs[n]->RestoreDacParameters(savedDacs[n]);
 }
@@ -13,8 +13,13 @@
 class TrimBits : public Test {
 public:
     TrimBits(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface);
+    virtual void ModuleAction(TestModule& module);
     virtual void RocAction(TestRoc& roc);
 
+private:
+    /// Measures the maps of all ROCs at once.
+    void RocsAction(const std::vector<TestRoc*>& rocs);
+
 private:
     boost::shared_ptr<TBAnalogInterface> tbInterface;
     int nTrig, vtrim14, vtrim13, vtrim11, vtrim7;
@@ -30,102 +30,158 @@ void TrimLow::AddMap(TH2D* calMap)
 }
 
 
+void TrimLow::ModuleAction(TestModule& module)
+{
+    const std::vector<TestRoc*> rocs = IncludedRocs(module);
+    if (!rocs.empty())
+        RocsAction(rocs);
+}
+
 void TrimLow::RocAction(TestRoc& roc)
 {
-    TestPixel *maxPixel = 0;
-    double thr, thrMin;
-    TH2D *calMap;
+    RocsAction(std::vector<TestRoc*>(1, &roc));
+}
+
+std::vector<TH2D*> TrimLow::MeasureMaps(const ThresholdMap::Parameters& parameters,
+                                        const std::vector<RocState>& states)
+{
+    std::vector<TestRoc*> rocs;
+    for (size_t n = 0; n < states.size(); n++)
+        rocs.push_back(states[n].roc);
+    return thresholdMap.MeasureMaps(parameters, rocs, *testRange, nTrig);
+}
+
+void TrimLow::RocsAction(const std::vector<TestRoc*>& rocs)
+{
+    double thr;
+    std::vector<RocState> states, goodStates;
 
     if (doubleWbc) thresholdMap.SetDoubleWbc();
 
-    psi::LogInfo() << "[TrimLow] ROC #" << roc.GetChipId() << ": Start." << std::endl;
-    SaveDacParameters(roc);
+    for (size_t n = 0; n < rocs.size(); n++) {
+        TestRoc& roc = *rocs[n];
+        psi::LogInfo() << "[TrimLow] ROC #" << roc.GetChipId() << ": Start." << std::endl;
+        RocState state;
+        state.roc = &roc;
+        state.savedDacParameters = roc.SaveDacParameters();
+        states.push_back(state);
 
-    //get VthrComp
-    roc.SetTrim(15);
-    roc.SetDAC(DACParameters::Vtrim, 0);
+        //get VthrComp
+        roc.SetTrim(15);
+        roc.SetDAC(DACParameters::Vtrim, 0);
 
-    psi::LogDebug() << "[TrimLow] Vcal " << vcal << std::endl;
+        psi::LogDebug() << "[TrimLow] Vcal " << vcal << std::endl;
 
-    roc.SetDAC(DACParameters::Vcal, vcal);
+        roc.SetDAC(DACParameters::Vcal, vcal);
+    }
     tbInterface->Flush();
 
-    thrMin = MinVthrComp(roc, ThresholdMap::CalThresholdMapParameters);
-    if (thrMin == -1.) return;
+    MinVthrComp(states, ThresholdMap::CalThresholdMapParameters);
+    for (size_t n = 0; n < states.size(); n++) {
+        if (states[n].thrMin == -1.) continue;
+        states[n].roc->SetDAC(DACParameters::Vcal, 100);
+        goodStates.push_back(states[n]);
+    }
+    states.swap(goodStates);
+    goodStates.clear();
+    if (states.empty()) return;
 
     thresholdMap.SetSingleWbc();
-    roc.SetDAC(DACParameters::Vcal, 100);
     tbInterface->Flush();
-    double thrMin2 = MinVthrComp(roc, ThresholdMap::NoiseMapParameters);
+    std::vector<RocState> noiseStates(states);
+    MinVthrComp(noiseStates, ThresholdMap::NoiseMapParameters);
     if (doubleWbc) thresholdMap.SetDoubleWbc();
 
-    if (thrMin2 - 10 < thrMin) thrMin = thrMin2 - 10;
-    roc.SetDAC(DACParameters::VthrComp, (int)thrMin);
-
-    psi::LogDebug() << "[TrimLow] VthrComp is set to "
-                    << static_cast<int>( thrMin) << std::endl;
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        const double thrMin2 = noiseStates[n].thrMin;
+        if (thrMin2 - 10 < states[n].thrMin) states[n].thrMin = thrMin2 - 10;
+        roc.SetDAC(DACParameters::VthrComp, (int)states[n].thrMin);
 
-    tbInterface->Flush();
+        psi::LogDebug() << "[TrimLow] ROC #" << roc.GetChipId() << ": VthrComp is set to "
+                        << static_cast<int>( states[n].thrMin) << std::endl;
+    }
 
     tbInterface->Flush();
 
     //Determine minimal and maximal vcal thresholds
-    calMap = thresholdMap.MeasureMap(ThresholdMap::VcalThresholdMapParameters, roc, *testRange, nTrig);
-    AddMap(calMap);
-    TH1D *distr = Analysis::Distribution(calMap, 255, 1., 254.);
-    double vcalMaxLimit = TMath::Min(254., distr->GetMean() + 5.*distr->GetRMS());
-
-    double vcalMin = 255., vcalMax = 0.;
-    int thr255 = 0;
-    for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
-        for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
-            if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
-                thr = calMap->GetBinContent(i + 1, k + 1);
-                if ((thr > vcalMax) && (thr < vcalMaxLimit)) {
-                    vcalMax = thr;
-                    maxPixel = &roc.GetPixel(i, k);
+    std::vector<TH2D*> calMaps = MeasureMaps(ThresholdMap::VcalThresholdMapParameters, states);
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        TH2D* calMap = calMaps[n];
+        TestPixel *maxPixel = 0;
+        AddMap(calMap);
+        TH1D *distr = Analysis::Distribution(calMap, 255, 1., 254.);
+        double vcalMaxLimit = TMath::Min(254., distr->GetMean() + 5.*distr->GetRMS());
+
+        double vcalMin = 255., vcalMax = 0.;
+        int thr255 = 0;
+        for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
+            for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
+                if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
+                    thr = calMap->GetBinContent(i + 1, k + 1);
+                    if ((thr > vcalMax) && (thr < vcalMaxLimit)) {
+                        vcalMax = thr;
+                        maxPixel = &roc.GetPixel(i, k);
+                    }
+                    if ((thr < vcalMin) && (thr > 1.)) vcalMin = thr;
+                    if (thr == 255.) thr255++;
                 }
-                if ((thr < vcalMin) && (thr > 1.)) vcalMin = thr;
-                if (thr == 255.) thr255++;
             }
         }
-    }
 
-    psi::LogDebug() << "[TrimLow] There are " << thr255 << " pixels with "
-                    << "Vcal 255." << std::endl;
-    psi::LogDebug() << "[TrimLow] Vcal range is [ " << vcalMin << ", "
-                    << vcalMax << "]." << std::endl;
+        psi::LogDebug() << "[TrimLow] ROC #" << roc.GetChipId() << ": there are " << thr255 << " pixels with "
+                        << "Vcal 255." << std::endl;
+        psi::LogDebug() << "[TrimLow] ROC #" << roc.GetChipId() << ": Vcal range is [ " << vcalMin << ", "
+                        << vcalMax << "]." << std::endl;
+
+        if (vcalMax == 0) {
+            psi::LogInfo() << "[TrimLow] ROC #" << roc.GetChipId() << ": Error: Vcal max = 0. Abort test."
+                           << std::endl;
+            continue;
+        }
 
-    if (vcalMax == 0) {
-        psi::LogInfo() << "[TrimLow] Error: Vcal max = 0. Abort test." << std::endl;
+        //Determine Vtrim
+        roc.EnableDoubleColumn(maxPixel->GetColumn());
+        states[n].vtrim = AdjustVtrim(*maxPixel);
+        roc.DisableDoubleColumn(maxPixel->GetColumn());
 
-        return;
+        if (!noTrimBits) roc.SetTrim(7);
+        goodStates.push_back(states[n]);
     }
-
-    //Determine Vtrim
-    roc.EnableDoubleColumn(maxPixel->GetColumn());
-    int vtrim = AdjustVtrim(*maxPixel);
-    roc.DisableDoubleColumn(maxPixel->GetColumn());
+    states.swap(goodStates);
+    if (states.empty()) return;
 
     if (!noTrimBits) {
-        roc.SetTrim(7);
-        calMap = thresholdMap.MeasureMap(ThresholdMap::VcalThresholdMapParameters, roc, *testRange, nTrig);
-        AddMap(calMap);
+        calMaps = MeasureMaps(ThresholdMap::VcalThresholdMapParameters, states);
+        for (size_t n = 0; n < states.size(); n++) {
+            states[n].calMap = calMaps[n];
+            AddMap(calMaps[n]);
+        }
 
-        calMap = TrimStep(roc, 4, calMap);
-        calMap = TrimStep(roc, 2, calMap);
-        calMap = TrimStep(roc, 1, calMap);
-        calMap = TrimStep(roc, 1, calMap);
+        TrimStep(states, 4);
+        TrimStep(states, 2);
+        TrimStep(states, 1);
+        TrimStep(states, 1);
 
-        calMap = thresholdMap.MeasureMap(ThresholdMap::VcalThresholdMapParameters, roc, *testRange, nTrig);
-        AddMap(calMap);
+        calMaps = MeasureMaps(ThresholdMap::VcalThresholdMapParameters, states);
+        for (size_t n = 0; n < states.size(); n++)
+            AddMap(calMaps[n]);
     }
 
-    RestoreDacParameters(roc);
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        roc.RestoreDacParameters(states[n].savedDacParameters);
 
-    roc.SetDAC(DACParameters::Vtrim, vtrim);
-    roc.SetDAC(DACParameters::VthrComp, (int)thrMin);
+        roc.SetDAC(DACParameters::Vtrim, states[n].vtrim);
+        roc.SetDAC(DACParameters::VthrComp, (int)states[n].thrMin);
 
+        WriteParameterFiles(roc);
+    }
+}
+
+void TrimLow::WriteParameterFiles(TestRoc& roc)
+{
     const ConfigParameters& configParameters = ConfigParameters::Singleton();
     char dacFileName[100], trimFileName[100];
 
@@ -154,95 +210,112 @@ void TrimLow::RocAction(TestRoc& roc)
     roc.WriteTrimConfiguration(trimFileName);
 }
 
-double TrimLow::MinVthrComp(TestRoc& roc, const ThresholdMap::Parameters &mapParameters)
+void TrimLow::MinVthrComp(std::vector<RocState>& states, const ThresholdMap::Parameters &mapParameters)
 {
     //Find good VthrComp
-    TH2D *calMap = thresholdMap.MeasureMap(mapParameters, roc, *testRange, nTrig);
-    AddMap(calMap);
-    TH1D *distr = Analysis::Distribution(calMap, 255, 1., 254.);
-    double thrMinLimit = TMath::Max(1., distr->GetMean() - 5.*distr->GetRMS());
-
-    double thrMin = 255., thrMax = 0., thr;
-    int thr255 = 0;
-    for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
-        for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
-            if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
-                thr = calMap->GetBinContent(i + 1, k + 1);
-                if ((thr > thrMax) && (thr < 255.)) thrMax = thr;
-                if ((thr < thrMin) && (thr > thrMinLimit)) thrMin = thr;
-                if (thr == 255.) thr255++;
+    const std::vector<TH2D*> calMaps = MeasureMaps(mapParameters, states);
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        TH2D *calMap = calMaps[n];
+        AddMap(calMap);
+        TH1D *distr = Analysis::Distribution(calMap, 255, 1., 254.);
+        double thrMinLimit = TMath::Max(1., distr->GetMean() - 5.*distr->GetRMS());
+
+        double thrMin = 255., thrMax = 0., thr;
+        int thr255 = 0;
+        for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
+            for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
+                if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
+                    thr = calMap->GetBinContent(i + 1, k + 1);
+                    if ((thr > thrMax) && (thr < 255.)) thrMax = thr;
+                    if ((thr < thrMin) && (thr > thrMinLimit)) thrMin = thr;
+                    if (thr == 255.) thr255++;
+                }
             }
         }
-    }
 
-    psi::LogDebug() << "[TrimLow] There are " << thr255 << " pixels with "
-                    << "threshold 255." << std::endl;
-    psi::LogDebug() << "[TrimLow] Theshold range is [ " << thrMin << ", "
-                    << thrMax << "]." << std::endl;
+        psi::LogDebug() << "[TrimLow] ROC #" << roc.GetChipId() << ": there are " << thr255 << " pixels with "
+                        << "threshold 255." << std::endl;
+        psi::LogDebug() << "[TrimLow] ROC #" << roc.GetChipId() << ": theshold range is [ " << thrMin << ", "
+                        << thrMax << "]." << std::endl;
 
-    if (thrMax == 0.) {
-        psi::LogInfo() << "[TrimLow] Error: Can not find maximum threshold."
-                       << std::endl;
+        if (thrMax == 0.) {
+            psi::LogInfo() << "[TrimLow] ROC #" << roc.GetChipId() << ": Error: Can not find maximum threshold."
+                           << std::endl;
+            thrMin = -1.;
+        }
 
-        return -1.;
+        states[n].thrMin = thrMin;
     }
-
-    return thrMin;
 }
 
 
-TH2D* TrimLow::TrimStep(TestRoc& roc, int correction, TH2D *calMapOld)
+void TrimLow::TrimStep(std::vector<RocState>& states, int correction)
 {
-    TH2D* betterCalMap = CreateMap("VcalThresholdMap", roc.GetChipId());
+    std::vector<TH2D*> trimMaps;
     int trim;
 
-    //save trim map
-    TH2D *trimMap = roc.TrimMap();
-
-    //set new trim bits
-    for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
-        for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
-            if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
-                trim = (int)trimMap->GetBinContent(i + 1, k + 1);
-                if ((calMapOld->GetBinContent(i + 1, k + 1) > vcal) && (calMapOld->GetBinContent(i + 1, k + 1) != 255))
-                    trim -= correction;
-                else
-                    trim += correction;
-
-                if (trim < 0) trim = 0;
-                if (trim > 15) trim = 15;
-                roc.GetPixel(i, k).SetTrim(trim);
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        TH2D *calMapOld = states[n].calMap;
+
+        //save trim map
+        TH2D *trimMap = roc.TrimMap();
+        trimMaps.push_back(trimMap);
+
+        //set new trim bits
+        for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
+            for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
+                if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
+                    trim = (int)trimMap->GetBinContent(i + 1, k + 1);
+                    if ((calMapOld->GetBinContent(i + 1, k + 1) > vcal)
+                            && (calMapOld->GetBinContent(i + 1, k + 1) != 255))
+                        trim -= correction;
+                    else
+                        trim += correction;
+
+                    if (trim < 0) trim = 0;
+                    if (trim > 15) trim = 15;
+                    roc.GetPixel(i, k).SetTrim(trim);
+                }
             }
         }
+        AddMap(roc.TrimMap());
     }
-    AddMap(roc.TrimMap());
 
     //measure new result
-    TH2D *calMap = thresholdMap.MeasureMap(ThresholdMap::VcalThresholdMapParameters, roc, *testRange, nTrig);
-    AddMap(calMap);
-
-    // test if the result got better
-    for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
-        for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
-            if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
-                trim = roc.GetPixel(i, k).GetTrim();
-
-                if (TMath::Abs(calMap->GetBinContent(i + 1, k + 1) - vcal) <=
-                        TMath::Abs(calMapOld->GetBinContent(i + 1, k + 1) - vcal)) {
-                    // it's better now
-                    betterCalMap->SetBinContent(i + 1, k + 1, calMap->GetBinContent(i + 1, k + 1));
-                } else {
-                    // it's worse
-                    betterCalMap->SetBinContent(i + 1, k + 1, calMapOld->GetBinContent(i + 1, k + 1));
-                    roc.GetPixel(i, k).SetTrim((int)trimMap->GetBinContent(i + 1, k + 1));
+    const std::vector<TH2D*> calMaps = MeasureMaps(ThresholdMap::VcalThresholdMapParameters, states);
+
+    for (size_t n = 0; n < states.size(); n++) {
+        TestRoc& roc = *states[n].roc;
+        TH2D *calMapOld = states[n].calMap;
+        TH2D *calMap = calMaps[n];
+        TH2D *trimMap = trimMaps[n];
+        TH2D* betterCalMap = CreateMap("VcalThresholdMap", roc.GetChipId());
+        AddMap(calMap);
+
+        // test if the result got better
+        for (unsigned i = 0; i < psi::ROCNUMCOLS; i++) {
+            for (unsigned k = 0; k < psi::ROCNUMROWS; k++) {
+                if (testRange->IncludesPixel(roc.GetChipId(), i, k)) {
+                    trim = roc.GetPixel(i, k).GetTrim();
+
+                    if (TMath::Abs(calMap->GetBinContent(i + 1, k + 1) - vcal) <=
+                            TMath::Abs(calMapOld->GetBinContent(i + 1, k + 1) - vcal)) {
+                        // it's better now
+                        betterCalMap->SetBinContent(i + 1, k + 1, calMap->GetBinContent(i + 1, k + 1));
+                    } else {
+                        // it's worse
+                        betterCalMap->SetBinContent(i + 1, k + 1, calMapOld->GetBinContent(i + 1, k + 1));
+                        roc.GetPixel(i, k).SetTrim((int)trimMap->GetBinContent(i + 1, k + 1));
+                    }
                 }
             }
         }
-    }
 
-    AddMap(roc.TrimMap());
-
-    return betterCalMap;
+        AddMap(roc.TrimMap());
+        states[n].calMap = betterCalMap;
+    }
 }
 
 int TrimLow::AdjustVtrim(TestPixel& pixel)
@@ -15,14 +15,30 @@
 class TrimLow : public Test {
 public:
     TrimLow(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface);
+    virtual void ModuleAction(TestModule& module);
     virtual void RocAction(TestRoc& roc);
     void SetVcal(int _vcal) { vcal = _vcal; }
 
 private:
-    double MinVthrComp(TestRoc& roc, const ThresholdMap::Parameters& mapParameters);
+    /// Trim state of a ROC. All ROCs are trimmed in parallel, so that their threshold maps are measured at once.
+    struct RocState {
+        TestRoc* roc;
+        boost::shared_ptr<DACParameters> savedDacParameters;
+        double thrMin;
+        int vtrim;
+        TH2D* calMap;
+        RocState() : roc(0), thrMin(0), vtrim(0), calMap(0) {}
+    };
+
+private:
+    void RocsAction(const std::vector<TestRoc*>& rocs);
+    std::vector<TH2D*> MeasureMaps(const ThresholdMap::Parameters& parameters, const std::vector<RocState>& states);
+    /// Sets thrMin of each state, -1 if the map has no thresholds.
+    void MinVthrComp(std::vector<RocState>& states, const ThresholdMap::Parameters& mapParameters);
     int AdjustVtrim(TestPixel& pixel);
     void AddMap(TH2D* calMap);
-    TH2D* TrimStep(TestRoc& roc, int correction, TH2D *calMapOld);
+    void TrimStep(std::vector<RocState>& states, int correction);
+    void WriteParameterFiles(TestRoc& roc);
     void NoTrimBits(bool aBool) { noTrimBits = aBool; }
 
 
@@ -3,6 +3,9 @@
  * \brief Implementation of UbCheck class.
  */
 
+#include <algorithm>
+#include <cmath>
+
 #include "TF1.h"
 #include "TH1D.h"
 #include "TH2.h"
@@ -14,6 +17,7 @@
 #include "UbCheck.h"
 #include "OffsetOptimization.h"
 #include "BasePixel/TestParameters.h"
+#include "analysis/Analysis.h"
 
 UbCheck::UbCheck(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface)
     : Test("UbCheck", testRange), tbInterface(aTBInterface)
@@ -26,12 +30,6 @@ void UbCheck::RocAction(TestRoc& roc)
     psi::LogInfo() << "UbCheck roc " << roc.GetChipId() << std::endl;
     const int testVcal = 200;
 
-    std::ostringstream histoName;
-    histoName << "PH" << testVcal << "_C" << roc.GetChipId();
-    TH1D *histo = new TH1D(histoName.str().c_str(), histoName.str().c_str(), 400, -2000., 2000.);
-    histo->GetXaxis()->SetTitle("PH");
-    histo->GetYaxis()->SetTitle("# pixels");
-
     SaveDacParameters(roc);
 
     // == Measure pulse height for all pixels
@@ -46,14 +44,27 @@ void UbCheck::RocAction(TestRoc& roc)
     tbInterface->Flush();
 
     roc.AoutLevelChip(phPosition, nTrig, data);
-    for (unsigned k = 0; k < psi::ROCNUMROWS * psi::ROCNUMCOLS; k++) histo->Fill(data[k]);
+    double values[psi::ROCNUMROWS * psi::ROCNUMCOLS];
+    std::copy(data, data + psi::ROCNUMROWS * psi::ROCNUMCOLS, values);
+
+    // Statistics of the pulse height distribution, restricted to the histogram range as in TH1::GetMean/GetRMS.
+    const psi::analysis::Distribution distribution =
+        psi::analysis::MakeDistribution(values, psi::ROCNUMROWS * psi::ROCNUMCOLS, 400, -2000., 2000.);
+    const double mean = distribution.sumw ? distribution.sumwx / distribution.sumw : 0.;
+    const double rms = distribution.sumw ?
+                       std::sqrt(std::max(0., distribution.sumwx2 / distribution.sumw - mean * mean)) : 0.;
     for (unsigned k = 0; k < psi::ROCNUMROWS * psi::ROCNUMCOLS; k++) {
-        if ((data[k] < minPixelPh) && (TMath::Abs(data[k] - histo->GetMean()) < 4 * histo->GetRMS())) {
+        if ((data[k] < minPixelPh) && (std::abs(data[k] - mean) < 4 * rms)) {
             minPixelPh = data[k];
             minPixel = k;
         }
     }
 
+    std::ostringstream histoName;
+    histoName << "PH" << testVcal << "_C" << roc.GetChipId();
+    TH1D *histo = Analysis::ToHistogram(distribution, histoName.str());
+    histo->GetXaxis()->SetTitle("PH");
+    histo->GetYaxis()->SetTitle("# pixels");
     histograms->Add(histo);
 
     if (debug)
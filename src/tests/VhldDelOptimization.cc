@@ -3,19 +3,14 @@
  * \brief Implementation of VhldDelOptimization class.
  */
 
-#include "TF1.h"
+#include <boost/bind.hpp>
+
 #include "TH1D.h"
-#include "TH2.h"
-#include "TCanvas.h"
+#include "TMath.h"
 #include "psi/log.h"
 #include "BasePixel/TBAnalogInterface.h"
-#include "BasePixel/ConfigParameters.h"
 #include "psi46expert/TestRoc.h"
-#include "PhDacScan.h"
 #include "VhldDelOptimization.h"
-#include "OffsetOptimization.h"
-#include "FigureOfMerit.h"
-#include "BasePixel/TestParameters.h"
 
 VhldDelOptimization::VhldDelOptimization(PTestRange testRange, boost::shared_ptr<TBAnalogInterface> aTBInterface)
     : Test("VhldDelOptimization", testRange), tbInterface(aTBInterface)
@@ -28,69 +23,69 @@ void VhldDelOptimization::RocAction(TestRoc& roc)
     psi::LogInfo() << "VhldDelOptimization roc " << roc.GetChipId() << std::endl;
 
     TH1D *VhldDelHist = new TH1D("VhldDel", "VhldDel", 26, 0, 260);
-    boost::shared_ptr<TestRange> pixelRange(new TestRange());
-    int bestHldDel;
 
     for (int col = 0; col < 5; col++) {
         for (int row = 0; row < 5; row++) {
-            pixelRange->AddPixel(roc.GetChipId(), col, row);
-            bestHldDel = AdjustVhldDel(roc, pixelRange);
+            const int bestHldDel = AdjustVhldDel(roc, col, row);
             VhldDelHist->Fill(bestHldDel);
         }
     }
     histograms->Add(VhldDelHist);
 }
 
-int VhldDelOptimization::AdjustVhldDel(TestRoc& roc, PTestRange pixelRange)
+int VhldDelOptimization::AdjustVhldDel(TestRoc& roc, unsigned column, unsigned row)
 {
-
-    roc.SetDAC(DACParameters::CtrlReg, 4);
-    tbInterface->Flush();
-
     const int vsfValue = 150, hldDelMin = 0, hldDelMax = 200, hldDelStep = 10;
-
-    TestParameters& testParameters = TestParameters::ModifiableSingleton();
-    testParameters.setPHdac1Start(vsfValue);   // Vsf
-    testParameters.setPHdac1Stop(vsfValue);
-    testParameters.setPHdac1Step(10);
-    testParameters.setPHdac2Start(hldDelMin);     // VhldDel
-    testParameters.setPHdac2Stop(hldDelMax);
-    testParameters.setPHdac2Step(hldDelStep);
+    const DacOptimizer::Range hldDelRange(hldDelMin, hldDelMax, hldDelStep);
 
     SaveDacParameters(roc);
+    roc.SetDAC(DACParameters::CtrlReg, 4);
+    roc.SetDAC(DACParameters::Vsf, vsfValue);
+    roc.ArmPixel(column, row);
+    tbInterface->Flush();
 
-    FigureOfMerit fom(pixelRange, tbInterface, DACParameters::Vsf, DACParameters::VhldDel, 3);
-    fom.RocAction(roc);
-    boost::shared_ptr<TList> histos = fom.GetHistos();
-    TIter next(histos.get());
-    if (debug) while (TH1 *histo = (TH1*)next()) histograms->Add(histo);
-
-    psi::LogInfo() << "dac1 = " << roc.GetDAC(DACParameters::Vsf)
-                   << " DAC1 = " << roc.GetDAC(DACParameters::VhldDel) << std::endl;
-
-    TH2D *qualityHist2D = (TH2D*)(histos->Last());
-    int nBins = (hldDelMax - hldDelMin) / hldDelStep;
-    TH1D *qualityHist1D = new TH1D("VhldDel", "VhldDel", nBins, hldDelMin, hldDelMax);
-
-    double maxLinearity = 0;
-    double maxBin = -1;
+    std::ostringstream qualityHistName;
+    qualityHistName << "VhldDel_c" << column << "r" << row << "_C" << roc.GetChipId();
+    TH1D *qualityHist1D = new TH1D(qualityHistName.str().c_str(), qualityHistName.str().c_str(),
+                                   hldDelRange.Size(), hldDelMin, hldDelMax + hldDelStep);
 
-    for (int n = 0; n <= nBins; n++) {
-        double linearRange = qualityHist2D->GetBinContent(1, n + 1);
-        qualityHist1D->SetBinContent(n + 1, linearRange);
-        if (linearRange > maxLinearity) {
-            maxLinearity = linearRange;
-            maxBin = hldDelMin + n * hldDelStep;
-        }
-    }
-    psi::LogInfo() << "max Linearity = " << maxLinearity << " @ VhldDel = " << maxBin <<  std::endl;
+    DacOptimizer optimizer("VhldDel", boost::bind(&VhldDelOptimization::LowRangeLinearity, this, boost::ref(roc),
+                                                  qualityHist1D, _1));
+    const DacOptimizer::Point best = optimizer.Surrogate(DacOptimizer::Point(1, hldDelMin), 0, hldDelRange);
+    optimizer.LogSummary(best, hldDelRange.Size());
     histograms->Add(qualityHist1D);
+
+    roc.DisarmPixel(column, row);
     RestoreDacParameters(roc);
 
-    hldDelValue = static_cast<int>( maxBin);
+    hldDelValue = optimizer.Evaluate(best) > 0 ? best.at(0) : -1;
 
     roc.SetDAC(DACParameters::VhldDel, hldDelValue);
     psi::LogInfo() << "VhldDel set to " << hldDelValue << std::endl;
 
     return hldDelValue;
 }
+
+// -- Linearity in the low range for the VhldDel value given by the point
+double VhldDelOptimization::LowRangeLinearity(TestRoc& roc, TH1D* qualityHist, const DacOptimizer::Point& point)
+{
+    const int hldDel = point.at(0);
+    roc.SetDAC(DACParameters::VhldDel, hldDel);
+
+    short result[256];
+    roc.SetDAC(DACParameters::CtrlReg, 0);
+    tbInterface->PHDac(25, 256, phDacScan.GetNTrig(), 16 + roc.GetAoutChipPosition() * 3, result);
+    roc.SetDAC(DACParameters::CtrlReg, 4);
+
+    std::ostringstream histoName;
+    histoName << "PHVcal_VhldDel" << hldDel << "_C" << roc.GetChipId();
+    TH1D *histo = new TH1D(histoName.str().c_str(), histoName.str().c_str(), 256, 0, 256);
+    for (int dac = 0; dac < 256; dac++) histo->SetBinContent(dac + 1, result[dac]);
+    histo->SetMaximum(result[255] + 100);
+    if (debug) histograms->Add(histo);
+
+    const double linearity = TMath::Abs(phDacScan.QualityLowRange(histo));
+    qualityHist->SetBinContent(qualityHist->FindBin(hldDel), linearity);
+    if (!debug) delete histo;
+    return linearity;
+}
@@ -6,6 +6,8 @@
 #pragma once
 
 #include "BasePixel/Test.h"
+#include "BasePixel/DacOptimizer.h"
+#include "PhDacScan.h"
 
 /*!
  * \brief Adjust VhldDel by optimizing the Linearity in the low range
@@ -16,9 +18,11 @@ public:
     virtual void RocAction(TestRoc& roc);
 
 private:
-    int AdjustVhldDel(TestRoc& roc, PTestRange pixelRange);
+    int AdjustVhldDel(TestRoc& roc, unsigned column, unsigned row);
+    double LowRangeLinearity(TestRoc& roc, TH1D* qualityHist, const DacOptimizer::Point& point);
 
 private:
     boost::shared_ptr<TBAnalogInterface> tbInterface;
+    PhDacScan phDacScan;
     int hldDelValue;
 };
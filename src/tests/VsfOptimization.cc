@@ -3,7 +3,11 @@
  * \brief Implementation of VsfOptimization class.
  */
 
+#include <cmath>
+#include <functional>
+#include <limits>
 #include <string>
+#include <boost/bind.hpp>
 
 #include <TRandom.h>
 #include <TMath.h>
@@ -106,6 +110,10 @@ int VsfOptimization::CurrentOpt2(TestRoc& roc)
     const DACParameters::Register DAC_REGISTER = DACParameters::Vsf;
 
     const std::string& dacName = DACParameters::GetRegisterName(DAC_REGISTER);
+    const int step = VsfStep();
+    if(par1Vsf < vsf.start || par1Vsf > vsf.stop)
+        THROW_PSI_EXCEPTION("Vsf " << par1Vsf << " from the linearity scan is outside of the Vsf range ["
+                            << vsf.start << ", " << vsf.stop << "].");
 
     // Get Digital Current corresponding to ZERO Vsf
     roc.SetDAC( DAC_REGISTER, 0);
@@ -113,54 +121,52 @@ int VsfOptimization::CurrentOpt2(TestRoc& roc)
     psi::Sleep(2.0 * psi::seconds);
     psi::ElectricCurrent dc0 = tbInterface->GetID();
 
-    // Get Digital Current corresponding to Vsf obtained from PH Linearity
-    // test
-    roc.SetDAC( DAC_REGISTER, par1Vsf);
-    tbInterface->Flush();
-    psi::Sleep(2.0 * psi::seconds);
-    psi::ElectricCurrent dcBestPar1 = tbInterface->GetID();
-
-    psi::LogInfo() << "dc0 =  " << dc0 << ", dcBestPar1 = " << dcBestPar1 << std::endl;
-
-    psi::ElectricCurrent diff = dcBestPar1 - dc0;
-
-    if( debug )
-        psi::LogInfo() << "diff = " << diff << std::endl;
+    psi::LogInfo() << "dc0 =  " << dc0 << std::endl;
+
+    // Search Vsf for value that gives Digital Current less then threshold
+    // specified in Input parameters file. Vsf is lowered by step starting
+    // from value obtained from PH Linearity test; the current increase is
+    // monotonic in Vsf, so the search is done by bisection.
+    const DacOptimizer::Range vsfRange(par1Vsf, par1Vsf % step, -step);
+    DacOptimizer optimizer(dacName + " current", boost::bind(&VsfOptimization::DigitalCurrentIncrease, this,
+                                                             boost::ref(roc), dc0, _1));
+    const double goal = psi::DataStorage::ToStorageUnits(goalCurrent);
+    const DacOptimizer::Point best = optimizer.Bisection(DacOptimizer::Point(1, par1Vsf), 0, vsfRange,
+                                                         boost::bind(std::less_equal<double>(), _1, goal));
+    optimizer.LogSummary(best, vsfRange.Size());
+    const int newVsf = best.at(0);
 
-    // Scan Vsf for value that gives Digital Current less then threshold
-    // specified in Input parameters file. Vsf will be lowered each time
-    // by step starting from value obtained from PH Linearity test
-    int step     = ( vsf.stop - vsf.start) / vsf.steps;
-    int dacValue = par1Vsf;
-    int newVsf   = par1Vsf;
-    for( psi::ElectricCurrent dc = 0.0 * psi::amperes; diff > goalCurrent; ) {
-        if( debug )
-            psi::LogInfo() << "+++++++++++++ while ++++++++++++++\n";
-
-        dacValue -= step;
-        roc.SetDAC( DAC_REGISTER, dacValue);
-
-        if( debug ) psi::LogInfo() << dacName << " set to " << dacValue << std::endl;
-
-        tbInterface->Flush();
-        psi::Sleep(2.0 * psi::seconds);
-        dc = tbInterface->GetID();
+    return newVsf;
+}
 
-        if( debug ) psi::LogInfo() << "Digital current: " << dc << std::endl;
+int VsfOptimization::VsfStep() const
+{
+    if(vsf.start < 0 || vsf.stop <= vsf.start || vsf.steps <= 0 || vsf.steps > vsf.stop - vsf.start)
+        THROW_PSI_EXCEPTION("Invalid Vsf scan range [" << vsf.start << ", " << vsf.stop << "] with " << vsf.steps
+                            << " steps.");
+    return (vsf.stop - vsf.start) / vsf.steps;
+}
 
-        diff = dc - dc0;
+// -- Increase of the digital current with respect to dc0 for the Vsf given by the point
+double VsfOptimization::DigitalCurrentIncrease(TestRoc& roc, psi::ElectricCurrent dc0,
+                                               const DacOptimizer::Point& point)
+{
+    roc.SetDAC(DACParameters::Vsf, point.at(0));
+    if( debug ) psi::LogInfo() << DACParameters::GetRegisterName(DACParameters::Vsf) << " set to " << point.at(0)
+                               << std::endl;
 
-        if( debug ) psi::LogInfo() << "diff = " << diff << std::endl;
-        if( debug ) psi::LogInfo() << "goalCurrent = " << goalCurrent << std::endl;
+    tbInterface->Flush();
+    psi::Sleep(2.0 * psi::seconds);
+    const psi::ElectricCurrent dc = tbInterface->GetID();
+    const psi::ElectricCurrent diff = dc - dc0;
 
-        newVsf = dacValue;
-    }
+    if( debug ) psi::LogInfo() << "Digital current: " << dc << std::endl;
+    if( debug ) psi::LogInfo() << "diff = " << diff << std::endl;
+    if( debug ) psi::LogInfo() << "goalCurrent = " << goalCurrent << std::endl;
 
-    return newVsf;
+    return psi::DataStorage::ToStorageUnits(diff);
 }
 
-
-
 int VsfOptimization::CurrentOpt(TestRoc& roc)
 {
     psi::ElectricCurrent dc[255] = {0.0 * psi::amperes};
@@ -201,18 +207,32 @@ Double_t FitfcnTan( Double_t *x, Double_t *par)
 {
     return par[3] + par[2] * TMath::TanH(par[0] * x[0] - par[1]);
 }
+
+// Linearity parameter below the goal. Failed fits give no information about the side of the goal, so they are
+// recorded to let the caller drop the bisection.
+struct Par1BelowGoal {
+    double goal;
+    bool* unknown;
+    Par1BelowGoal(double _goal, bool* _unknown) : goal(_goal), unknown(_unknown) {}
+    bool operator()(double par1) const
+    {
+        if(!std::isfinite(par1)) {
+            *unknown = true;
+            return false;
+        }
+        return par1 < goal;
+    }
+};
 }
 
 int VsfOptimization::Par1Opt(TestRoc& roc)
 {
-    double par1        = 777.;
-    double chindf      = 777;
     DACParameters::Register dacRegister = DACParameters::Vsf;
-    int    newVsf      = 150;
     int    offset = tbInterface->TBMPresent() ? 16 : 9;
     int    col;
 
     const std::string& dacName = DACParameters::GetRegisterName(dacRegister);
+    const int step = VsfStep();
 
     roc.SetDAC(DACParameters::CtrlReg, 4);
     // Get Column # that will be used for testing
@@ -224,79 +244,101 @@ int VsfOptimization::Par1Opt(TestRoc& roc)
 
     TH1D *hist = new TH1D( Form( "hist%i_ROC%i", dacRegister, roc.GetChipId()),
                            Form( "%s", dacName.c_str()), vsf.steps, vsf.start, vsf.stop);
-    newVsf = 150;
     roc.ArmPixel( col, 5);
 
-    int count = 1;
-
-    for( int dacValue = vsf.start, step = ( vsf.stop - vsf.start ) / vsf.steps;
-            dacValue < vsf.stop;
-            dacValue += step ) {
-        roc.SetDAC( dacRegister, dacValue);
+    // Linearity parameter decreases with Vsf, so the first Vsf with a good fit and par1 below the goal is
+    // searched by bisection instead of scanning all Vsf values. If a fit fails on the way, the bisection can not
+    // tell on which side of the goal that Vsf is, and the Vsf values are scanned in order as before.
+    const DacOptimizer::Range vsfRange(vsf.start, vsf.start + ( vsf.stop - vsf.start - 1 ) / step * step, step);
+    DacOptimizer optimizer(dacName + " linearity", boost::bind(&VsfOptimization::Par1, this, boost::ref(roc), hist,
+                                                               phFit, offset, _1));
+    bool unknown = false;
+    DacOptimizer::Point best = optimizer.Bisection(DacOptimizer::Point(1, vsf.start), 0, vsfRange,
+                                                   Par1BelowGoal(goalPar1, &unknown));
+    if(unknown) {
+        psi::LogDebug() << "[VsfOptimization] Failed linearity fits, scanning all " << dacName << " values.\n";
+        best = DacOptimizer::Point(1, vsfRange.last);
+        for(unsigned n = 0; n < vsfRange.Size(); ++n) {
+            const DacOptimizer::Point point(1, vsfRange.Value(n));
+            const double par1 = optimizer.Evaluate(point);
+            if(std::isfinite(par1) && par1 < goalPar1) {
+                best = point;
+                break;
+            }
+        }
+    }
+    optimizer.LogSummary(best, vsfRange.Size());
 
-        if( debug ) psi::LogInfo() << dacName << " set to " << dacValue << std::endl;
+    roc.SetDAC(dacRegister, best.at(0));
+    roc.DisarmPixel( col, 5);
+    histograms->Add( hist);
 
-        tbInterface->Flush();
+    return best.at(0);
+}
 
-        short result[256];
-        tbInterface->PHDac( 25, 256, phDacScan.GetNTrig(), offset + roc.GetAoutChipPosition() * 3, result);
-        TH1D *histo = new TH1D( Form( "Vsf%dROC%i", dacValue, roc.GetChipId()),
-                                Form( "Vsf%dROC%i", dacValue, roc.GetChipId()), 256, 0., 256.);
+// -- Linearity Fit Parameter for the Vsf given by the point. Bad fits are reported as infinitely non-linear.
+double VsfOptimization::Par1(TestRoc& roc, TH1D* par1Hist, TF1* phFit, int offset, const DacOptimizer::Point& point)
+{
+    const int dacValue = point.at(0);
+    roc.SetDAC( DACParameters::Vsf, dacValue);
 
-        for (int dac = 0; dac < 256; ++dac) {
-            histo->SetBinContent( dac + 1, 7777 == result[dac] ? 7777 : result[dac] );
-        }
+    if( debug ) psi::LogInfo() << DACParameters::GetRegisterName(DACParameters::Vsf) << " set to " << dacValue
+                               << std::endl;
 
-        // Find Bin with MINIMUM
-        double minFit = histo->GetBinCenter( histo->GetMinimumBin() );
+    tbInterface->Flush();
 
-        // you also need to cut off the upper part!
-        float delta;
-        int bin;
-        for( bin = histo->GetMinimumBin(); bin < 255; bin++) {
+    short result[256];
+    tbInterface->PHDac( 25, 256, phDacScan.GetNTrig(), offset + roc.GetAoutChipPosition() * 3, result);
+    TH1D *histo = new TH1D( Form( "Vsf%dROC%i", dacValue, roc.GetChipId()),
+                            Form( "Vsf%dROC%i", dacValue, roc.GetChipId()), 256, 0., 256.);
 
-            delta = histo->GetBinContent(bin + 1) - histo->GetBinContent(bin);
-            if (delta > 1000) break;
-        }
-        if( debug ) psi::LogInfo() << "upper BIN = " << bin << "bin center " << histo->GetBinCenter(bin) - 1 << std::endl;
-        if( debug ) psi::LogInfo() << "lower BIN = " <<  histo->GetMinimumBin() << "bin center " << minFit << std::endl;
-        // Fit Histogram
-        phFit->SetParameter( 0, 0.004);
-        phFit->SetParameter( 1, 1.4);
-        phFit->SetParameter( 2, 500.);
-        phFit->SetParameter( 3, -200.);
-        //set the fitting range such that the step is excluded
-        phFit->SetRange    ( minFit, histo->GetBinCenter(bin) - 1);
-        //phFit->SetParLimits( 2, 0, 10000);
+    for (int dac = 0; dac < 256; ++dac) {
+        histo->SetBinContent( dac + 1, 7777 == result[dac] ? 7777 : result[dac] );
+    }
 
-        histo->Fit( "phFit", "RQ", ""); //, minFit + 10, 255);
+    // Find Bin with MINIMUM
+    double minFit = histo->GetBinCenter( histo->GetMinimumBin() );
 
-        par1 = phFit->GetParameter( 1);
+    // you also need to cut off the upper part!
+    float delta;
+    int bin;
+    for( bin = histo->GetMinimumBin(); bin < 255; bin++) {
 
-        hist->SetBinContent( count, par1);
-        chindf = phFit->GetChisquare() / phFit->GetNDF();
+        delta = histo->GetBinContent(bin + 1) - histo->GetBinContent(bin);
+        if (delta > 1000) break;
+    }
+    if( debug ) psi::LogInfo() << "upper BIN = " << bin << "bin center " << histo->GetBinCenter(bin) - 1 << std::endl;
+    if( debug ) psi::LogInfo() << "lower BIN = " <<  histo->GetMinimumBin() << "bin center " << minFit << std::endl;
+    // Fit Histogram
+    phFit->SetParameter( 0, 0.004);
+    phFit->SetParameter( 1, 1.4);
+    phFit->SetParameter( 2, 500.);
+    phFit->SetParameter( 3, -200.);
+    //set the fitting range such that the step is excluded
+    phFit->SetRange    ( minFit, histo->GetBinCenter(bin) - 1);
+    //phFit->SetParLimits( 2, 0, 10000);
 
-        if( debug )
-            psi::LogInfo() << "par1 = " << par1 << std::endl;
+    histo->Fit( "phFit", "RQ", ""); //, minFit + 10, 255);
 
-        histo->GetYaxis()->SetRangeUser(-1000, 1500);
+    const double par1 = phFit->GetParameter( 1);
 
-        // Save Histogram in Output
-        histograms->Add( histo);
-        newVsf = dacValue;
+    par1Hist->SetBinContent( par1Hist->FindBin( dacValue), par1);
+    const double chindf = phFit->GetChisquare() / phFit->GetNDF();
 
-        if( debug )
-            psi::LogInfo() << "goalPar1 = " << goalPar1 << std::endl;
+    if( debug )
+        psi::LogInfo() << "par1 = " << par1 << std::endl;
 
-        if( par1 < goalPar1 && 0. < par1 && 20 > chindf) break;
+    histo->GetYaxis()->SetRangeUser(-1000, 1500);
 
-        ++count;
-    }
+    // Save Histogram in Output
+    histograms->Add( histo);
 
-    roc.DisarmPixel( col, 5);
-    histograms->Add( hist);
+    if( debug )
+        psi::LogInfo() << "goalPar1 = " << goalPar1 << std::endl;
 
-    return newVsf;
+    if( 0. < par1 && 20 > chindf)
+        return par1;
+    return std::numeric_limits<double>::infinity();
 }
 
 // Test 5 columns in step of 5 (1 pixel per column) to get mean linearity
@@ -11,6 +11,7 @@
 #include <TArrayD.h>
 #include "psi/units.h"
 #include "BasePixel/Test.h"
+#include "BasePixel/DacOptimizer.h"
 
 /*!
  * \brief Pulse height dependency on Vsf and VhldDel DACs
@@ -27,6 +28,10 @@ private:
     int CurrentOpt2(TestRoc& roc);
     int Par1Opt(TestRoc& roc);
     int TestCol(TestRoc& roc);
+    /// Step of the Vsf scans, throws if the configured range or number of steps is invalid.
+    int VsfStep() const;
+    double DigitalCurrentIncrease(TestRoc& roc, psi::ElectricCurrent dc0, const DacOptimizer::Point& point);
+    double Par1(TestRoc& roc, TH1D* par1Hist, TF1* phFit, int offset, const DacOptimizer::Point& point);
 
 private:
     // Group Input parameters